@@ -24,6 +24,16 @@ namespace glib {
 
 using namespace LWNode;
 
+/*
+  uvsource runs the libuv loop as a GSource of the default main context:
+
+  - The backend fd of libuv becomes readable when an fd it watches is ready.
+  - The next libuv timer is mapped to the ready time of the source, so that
+    GLib sleeps in poll() until then when nothing else happens.
+  - Each dispatch runs a single non-blocking libuv pass.
+
+  The main context is never iterated from inside the source.
+*/
 struct SourceData {
   GSource source;
   gpointer tag;
@@ -36,37 +46,37 @@ static GMainContext* gcontext;
 static GMainLoop* gmainLoop;
 static GSource* uvsource;
 static GSourceFuncs source_funcs;
-static bool gmainLoopDone = false;
 
 static gboolean GmainLoopPrepareCallback(GSource* source, gint* timeout) {
-  uv_update_time(uv_default_loop());
-  *timeout = uv_backend_timeout(uv_default_loop());
-
-  if (!uv_watcher_queue_empty(uv_default_loop())) {
+  uv_loop_t* loop = uv_default_loop();
+  uv_update_time(loop);
+
+  // Pending callbacks, idle handles or closing handles, and fds that libuv
+  // hasn't added to its backend yet; none of these wake the backend fd.
+  int uvTimeout = uv_backend_timeout(loop);
+  if (uvTimeout == 0 || !uv_watcher_queue_empty(loop)) {
+    *timeout = 0;
     return TRUE;
   }
 
-  return 0 == *timeout;
+  g_source_set_ready_time(
+      source,
+      uvTimeout < 0 ? -1
+                    : g_source_get_time(source) +
+                          static_cast<gint64>(uvTimeout) * 1000);
+  *timeout = -1;
+  return FALSE;
 }
 
 static gboolean GmainLoopCheckCallback(GSource* source) {
-  if (!uv_backend_timeout(uv_default_loop())) {
-    return TRUE;
-  }
-
-  return (G_IO_IN ==
-          g_source_query_unix_fd(source, ((SourceData*)source)->tag));
+  // GLib dispatches the source on its ready time by itself.
+  return g_source_query_unix_fd(source, ((SourceData*)source)->tag) != 0;
 }
 
 static gboolean GmainLoopDispatchCallback(GSource* source,
                                           GSourceFunc callback,
                                           gpointer user_data) {
-  assert(gcontext);
-  g_main_context_iteration(gcontext, FALSE);
-
-  if (gmainLoopDone) {
-    return G_SOURCE_REMOVE;
-  }
+  g_source_set_ready_time(source, -1);
 
   GmainLoopNodeBindings* node_bindings = ((SourceData*)source)->node_bindings;
 
@@ -92,7 +102,7 @@ void GmainLoopInit(GmainLoopNodeBindings* self) {
   ((SourceData*)uvsource)->tag = g_source_add_unix_fd(
       uvsource,
       uv_backend_fd(uv_default_loop()),
-      (GIOCondition)(G_IO_IN | G_IO_OUT | G_IO_ERR | G_IO_PRI));
+      (GIOCondition)(G_IO_IN | G_IO_ERR | G_IO_HUP));
   ((SourceData*)uvsource)->node_bindings = self;
 
   g_source_attach(uvsource, gcontext);
@@ -103,8 +113,15 @@ void GmainLoopStart() {
   assert(gcontext);
 
   g_main_loop_run(gmainLoop);
-  gmainLoopDone = true;
-  g_main_context_iteration(gcontext, TRUE);
+
+  // libuv isn't run from the main context any longer, whether or not the
+  // source removed itself when the loop quit.
+  g_source_destroy(uvsource);
+  g_source_unref(uvsource);
+  uvsource = nullptr;
+
+  // Give the other sources that are ready a last chance without blocking.
+  g_main_context_iteration(gcontext, FALSE);
 }
 
 void GmainLoopExit() {
@@ -0,0 +1,33 @@
+'use strict';
+
+// Compares ArrayBuffer allocation with and without the size-class pool of
+// lwnode, e.g. by running it again with
+// NODE_BENCHMARK_FLAGS=--arraybuffer-pool. With the pool, its counters are
+// printed to stderr.
+const common = require('../common.js');
+
+const bench = common.createBenchmark(main, {
+  type: ['ArrayBuffer', 'allocUnsafeSlow'],
+  len: [1024, 4096, 16384, 65536],
+  n: [1e5],
+});
+
+function main({ type, len, n }) {
+  const create = type === 'ArrayBuffer' ?
+    (length) => new ArrayBuffer(length) :
+    Buffer.allocUnsafeSlow;
+
+  bench.start();
+  for (let i = 0; i < n; i++) {
+    create(len);
+  }
+  bench.end(n);
+
+  const stats = process.lwnode && process.lwnode.getArrayBufferPoolStats();
+  if (stats && stats.enabled) {
+    console.error(`${stats.allocations} pooled allocations, ` +
+                  `${stats.cacheHits} cache hits, ` +
+                  `${stats.slabsMapped} slabs mapped, ` +
+                  `${stats.slabsUnmapped} unmapped`);
+  }
+}
@@ -0,0 +1,28 @@
+// Test the speed of creating net.Socket objects
+'use strict';
+
+const common = require('../common.js');
+const net = require('net');
+
+const bench = common.createBenchmark(main, {
+  n: [1e5],
+  handle: ['true', 'false'],
+}, {
+  flags: ['--expose-internals']
+});
+
+function main({ n, handle }) {
+  const { internalBinding } = require('internal/test/binding');
+  const { TCP, constants: TCPConstants } = internalBinding('tcp_wrap');
+
+  bench.start();
+  for (let i = 0; i < n; i++) {
+    const options = {};
+    if (handle === 'true') {
+      options.handle = new TCP(TCPConstants.SOCKET);
+    }
+    const socket = new net.Socket(options);
+    socket.destroy();
+  }
+  bench.end(n);
+}
@@ -15,7 +15,7 @@
  */
 
 const EventEmitter = require('events');
-const { validateCallback, validateInteger } = require('internal/validators');
+const { validateInteger } = require('internal/validators');
 const rawMethods = internalBinding('process_methods');
 
 /**
@@ -33,6 +33,17 @@ const rawMethods = internalBinding('process_methods');
 /** @type {number} msec time for idle GC interval time */
 const kGcInterval = 5000;
 
+/** @type {number} the number of samples kept by a MemWatcher */
+const kHistoryCapacity = 60;
+
+/** @type {number} the most samples a MemWatcher can keep (a day at 1 sec) */
+const kMaxHistoryCapacity = 24 * 60 * 60;
+
+// Events of the native MemWatcher
+const kStatsEvent = 1 << 0;
+const kMaxEvent = 1 << 1;
+const kLimitEvent = 1 << 2;
+
 /**
  * Converts a number into a human-readable string
  * @param {number} size number
@@ -65,22 +76,27 @@ function formatMemStats(size, option) {
  * @property {[string,number]} heap
  * @property {[string,number]} unmapped
  * @property {[string,number]} sinceLastGc
+ * @property {[string,number]} pssSwap
+ * @property {[string,number]} arrayBuffer
+ */
+
+/**
+ * @typedef {object} MemorySample
+ * @property {number} time msec since the epoch
+ * @property {number} heapSize
+ * @property {number} unmappedBytes
+ * @property {number} bytesSinceGC
+ * @property {number} pssSwap
+ * @property {number} arrayBufferBytes
  */
 
 /**
- * @param {{
- *  heapSize: number,
- *  bytesSinceGC: number,
- *  unmappedBytes: number,
- *  }} [stats=] if undefined, gc stats from native bindings is used.
+ * @param {MemorySample} [stats=] if undefined, a sample is taken now.
  * @return {MemoryStats}
  */
 function createMemStats(stats) {
   if (stats === undefined) {
-    stats = {
-      ...rawMethods.getGCMemoryStats(),
-      pssSwap: rawMethods.PssSwapUsage() * 1024,
-    };
+    stats = rawMethods.sampleMemory();
   }
 
   return {
@@ -88,6 +104,37 @@ function createMemStats(stats) {
     sinceLastGc: formatMemStats(stats.bytesSinceGC),
     unmapped: formatMemStats(stats.unmappedBytes),
     pssSwap: formatMemStats(stats.pssSwap),
+    arrayBuffer: formatMemStats(stats.arrayBufferBytes),
+  };
+}
+
+/**
+ * @typedef {object} CheckedResult
+ * @property {MemoryStats} max
+ * @property {MemoryStats} last
+ * @property {MemoryStats} current
+ * @property {MemoryStats} change
+ */
+
+/**
+ * @param {MemoryStats} last
+ * @param {MemoryStats} current
+ * @param {MemoryStats} max
+ * @return {CheckedResult}
+ */
+function createCheckedResult(last, current, max) {
+  /** @type {FileSizeOption} */
+  const option = { signed: true, fractionalDigits: 2 };
+  const change = {};
+  for (const key of Object.keys(current)) {
+    change[key] = formatMemStats(current[key][1] - last[key][1], option);
+  }
+
+  return {
+    max: Object.assign({}, max),
+    last: Object.assign({}, last),
+    current: Object.assign({}, current),
+    change,
   };
 }
 
@@ -102,6 +149,7 @@ class MemDiff {
     unmappedBytes: 0,
     bytesSinceGC: 0,
     pssSwap: 0,
+    arrayBufferBytes: 0,
   });
 
   constructor() {
@@ -120,228 +168,163 @@ class MemDiff {
   check() {
     this.#last = this.#cur;
     this.#cur = createMemStats();
-    this.#max = createMemStats({
-      heapSize: Math.max(this.#cur.heap[1], this.#max.heap[1]),
-      unmappedBytes: Math.max(this.#cur.unmapped[1], this.#max.unmapped[1]),
-      bytesSinceGC: Math.max(
-        this.#cur.sinceLastGc[1],
-        this.#max.sinceLastGc[1],
-      ),
-      pssSwap: Math.max(this.#cur.pssSwap[1], this.#max.pssSwap[1]),
-    });
-
-    /** @type {FileSizeOption} */
-    const heap = this.#cur.heap[1] - this.#last.heap[1];
-    const unmapped = this.#cur.unmapped[1] - this.#last.unmapped[1];
-    const sinceLastGc = this.#cur.sinceLastGc[1] - this.#last.sinceLastGc[1];
-    const pssSwap = this.#cur.pssSwap[1] - this.#last.pssSwap[1];
-    const option = { signed: true, fractionalDigits: 2 };
-
-    /**
-     * @typedef {object} CheckedResult
-     * @property {MemoryStats} max
-     * @property {MemoryStats} last
-     * @property {MemoryStats} current
-     * @property {MemoryStats} change
-     */
-    return {
-      max: Object.assign({}, this.#max),
-      last: Object.assign({}, this.#last),
-      current: Object.assign({}, this.#cur),
-      change: {
-        heap: formatMemStats(heap, option),
-        unmapped: formatMemStats(unmapped, option),
-        sinceLastGc: formatMemStats(sinceLastGc, option),
-        pssSwap: formatMemStats(pssSwap, option),
-      },
-    };
-  }
-}
 
-/**
- * @typedef {object} TrackRecord
- * @property {number} value
- * @property {Date} time
- */
-
-/**
- * @callback OnMaxUpdated
- * @param {{
- *  growth: number,
- *  current: number,
- *  count: number,
- *  elapsed: number,
- * }}
- */
-
-class MaxValueTracker {
-  #onMaxUpdated;
-  #maxIgnoreCount;
-  #records;
-  #count;
-  /**
-   * @param {number} maxIgnoreCount
-   * @param {{ onMaxUpdated: OnMaxUpdated }}
-   */
-  constructor(maxIgnoreCount = 2, { onMaxUpdated }) {
-    if (typeof onMaxUpdated != 'function') {
-      throw new TypeError('emitter');
+    const max = {};
+    for (const key of Object.keys(this.#cur)) {
+      max[key] = formatMemStats(
+        Math.max(this.#cur[key][1], this.#max[key][1]),
+      );
     }
-    /** @type {OnMaxUpdated} */
-    this.#onMaxUpdated = onMaxUpdated;
-    /** @type {number} */
-    this.#maxIgnoreCount = Math.max(maxIgnoreCount, 2);
-    /** @type {TrackRecord[]} */
-    this.#records = [];
-    /** @type {number} */
-    this.#count = 0;
-  }
+    this.#max = max;
 
-  /**
-   * @param {number} current a value to update
-   */
-  update(current) {
-    if (this.#records.length == 0) {
-      this.#addRecord(current);
-      return;
-    }
-
-    const { value: last } = this.#records.slice(-1)[0];
-
-    if (current > last) {
-      if (++this.#count >= this.#maxIgnoreCount) {
-        const now = new Date();
-        const { value: base, time: basetime } = this.#records[0];
-        const growth = current - base;
-        const elapsed = Math.round((now - basetime) / 1000);
-
-        this.#onMaxUpdated({ growth, current, count: this.#count, elapsed });
-
-        this.reset();
-        this.#addRecord(current, now);
-      } else {
-        this.#addRecord(current);
-      }
-    }
-  }
-
-  reset() {
-    this.#records = [];
-    this.#count = 0;
-  }
-
-  #addRecord(value, time = new Date()) {
-    this.#records.push({ value, time });
+    return createCheckedResult(this.#last, this.#cur, this.#max);
   }
 }
 
 /**
- * @callback OnLimitUpdated
- * @param {{
- *  current: number,
- *  limit: number,
- * }}
+ * MemWatcher samples memory on a native thread every `delay` msec and keeps
+ * the latest samples. The max and the limit are checked natively as well, so
+ * JavaScript is only called back when an event with listeners occurs.
  */
-
-class LimitValueTracker {
-  #onLimitUpdated;
-  #limit;
-  /**
-   * @param {number} limit
-   * @param {{ onLimitUpdated: OnLimitUpdated }}
-   */
-  constructor(limit, { onLimitUpdated }) {
-    validateInteger(limit);
-    validateCallback(onLimitUpdated);
-
-    /** @type {number} */
-    this.#limit = limit;
-
-    /** @type {OnLimitUpdated} */
-    this.#onLimitUpdated = onLimitUpdated;
-  }
-
-  /**
-   * @param {number} current a value to update
-   */
-  update(current) {
-    if (current > this.#limit) {
-      this.#onLimitUpdated({ current, limit: this.#limit });
-    }
-  }
-}
-
 class MemWatcher extends EventEmitter {
-  #statsTimerId;
-  #delay;
-  #diff;
-  #maxTracker;
-  #limitTracker;
+  #id;
+  #options;
   #memType;
 
   /**
-   * @param {number} delay heap size (bytes)
-   * @param {EventEmitter} emitter
+   * @param {number} delay msec time between samples
+   * @param {number} maxIgnoreCount growths of the max before `max` is emitted
    * @param {number} limit heap threshold size (bytes)
    * @param {string} memType `gc` or `pss` (default: pss)
+   * @param {number} capacity the number of samples kept in the history
    */
   constructor({
     delay = kGcInterval,
     maxIgnoreCount = 2,
     limit,
     memType = 'pss',
+    capacity = kHistoryCapacity,
   } = {}) {
     super([arguments]);
 
-    this.#delay = delay;
-    this.#statsTimerId = null;
-    this.#diff = new MemDiff();
-    this.#memType = memType == 'pss' ? 'pssSwap' : 'heap';
-
-    this.#maxTracker = new MaxValueTracker(maxIgnoreCount, {
-      onMaxUpdated: ({ growth, current, count, elapsed }) => {
-        this.emit('max', {
-          reason: `Max value growth occurred ${count} times over ${elapsed}s`,
-          change: [getHumanSize(growth, { signed: true }), growth],
-          currentMax: [getHumanSize(current), current],
-        });
-      },
-    });
-
+    // A watcher samples on a thread of its own, which must sleep between
+    // samples.
+    validateInteger(delay, 'delay', 1);
+    validateInteger(capacity, 'capacity', 1, kMaxHistoryCapacity);
+    validateInteger(maxIgnoreCount, 'maxIgnoreCount', 0);
     if (limit !== undefined) {
-      this.#limitTracker = new LimitValueTracker(limit, {
-        onLimitUpdated: ({ current, limit }) => {
-          const gap = current - limit;
-          const data = {
-            // reason: `Current memory usage exceeds the threshold value.`,
-            gap: [getHumanSize(gap, { signed: false }), gap],
-            current: [getHumanSize(current), current],
-            limit: [getHumanSize(limit), limit],
-          };
-          data.reason =
-            `Current memory usage (${data.current[0]}) exceeds ` +
-            `${data.gap[0]} over the threshold value (${data.limit[0]}).`;
-          this.emit('limit', data);
-        },
-      });
+      validateInteger(limit, 'limit', 0);
     }
 
+    this.#id = null;
+    this.#options = {
+      delay,
+      maxIgnoreCount,
+      limit,
+      usePss: memType == 'pss',
+      capacity,
+    };
+    this.#memType = memType == 'pss' ? 'pssSwap' : 'heapSize';
+
     this.setMaxListeners(5);
     this.on('newListener', this.#onnewListener);
     this.on('removeListener', this.#onremoveListener);
   }
 
   end() {
-    if (this.#statsTimerId) {
-      clearInterval(this.#statsTimerId);
-      this.#statsTimerId = null;
+    if (this.#id !== null) {
+      rawMethods.stopMemWatcher(this.#id);
+      this.#id = null;
+    }
+  }
+
+  /**
+   * @return {{time: Date, stats: MemoryStats}[]} from the oldest sample
+   */
+  history() {
+    if (this.#id === null) {
+      return [];
     }
+    return rawMethods.getMemWatcherHistory(this.#id).map((sample) => ({
+      time: new Date(sample.time),
+      stats: createMemStats(sample),
+    }));
   }
 
-  #hasListener() {
-    return ['stats', 'max', 'limit'].some(
-      (event) => this.listeners(event).length > 0,
-    );
+  /**
+   * @param {string} [addedEvent] an event whose listener is being added
+   * @return {number}
+   */
+  #events(addedEvent) {
+    const has = (event) =>
+      event == addedEvent || this.listeners(event).length > 0;
+
+    let events = 0;
+    if (has('stats')) events |= kStatsEvent;
+    if (has('max')) events |= kMaxEvent;
+    if (has('limit') && this.#options.limit !== undefined) {
+      events |= kLimitEvent;
+    }
+    return events;
+  }
+
+  #update(addedEvent) {
+    const events = this.#events(addedEvent);
+    if (events == 0) {
+      this.end();
+      return;
+    }
+
+    if (this.#id === null) {
+      const { delay, capacity, usePss, maxIgnoreCount, limit } = this.#options;
+      this.#id = rawMethods.startMemWatcher(
+        (report) => this.#onreport(report),
+        delay,
+        capacity,
+        usePss,
+        maxIgnoreCount,
+        limit ?? 0,
+      );
+    }
+    rawMethods.setMemWatcherEvents(this.#id, events);
+  }
+
+  #onreport(report) {
+    if (report.events & kStatsEvent) {
+      this.emit(
+        'stats',
+        createCheckedResult(
+          createMemStats(report.last),
+          createMemStats(report.current),
+          createMemStats(report.max),
+        ),
+      );
+    }
+
+    if (report.events & kMaxEvent) {
+      const { growth, growthCount, elapsed } = report;
+      const current = report.max[this.#memType];
+      this.emit('max', {
+        reason: `Max value growth occurred ${growthCount} times over ${elapsed}s`,
+        change: [getHumanSize(growth, { signed: true }), growth],
+        currentMax: [getHumanSize(current), current],
+      });
+    }
+
+    if (report.events & kLimitEvent) {
+      const current = report.current[this.#memType];
+      const limit = this.#options.limit;
+      const gap = current - limit;
+      const data = {
+        gap: [getHumanSize(gap, { signed: false }), gap],
+        current: [getHumanSize(current), current],
+        limit: [getHumanSize(limit), limit],
+      };
+      data.reason =
+        `Current memory usage (${data.current[0]}) exceeds ` +
+        `${data.gap[0]} over the threshold value (${data.limit[0]}).`;
+      this.emit('limit', data);
+    }
   }
 
   #onnewListener(event) {
@@ -349,20 +332,7 @@ class MemWatcher extends EventEmitter {
       case 'max':
       case 'stats':
       case 'limit':
-        if (this.#hasListener() == false) {
-          this.#statsTimerId = setInterval(() => {
-            let result = this.#diff.check();
-            this.emit('stats', result);
-
-            if (this.listeners('limit').length) {
-              this.#limitTracker?.update(result.current[this.#memType][1]);
-            }
-
-            if (this.listeners('max').length) {
-              this.#maxTracker?.update(result.max[this.#memType][1]);
-            }
-          }, this.#delay);
-        }
+        this.#update(event);
         break;
       default:
         break;
@@ -372,15 +342,9 @@ class MemWatcher extends EventEmitter {
   #onremoveListener(event) {
     switch (event) {
       case 'max':
-        this.#maxTracker?.reset();
-      // fall-through
-      case 'limit':
-        this.#limitTracker?.reset();
-      // fall-through
       case 'stats':
-        if (this.#hasListener() == false) {
-          this.end();
-        }
+      case 'limit':
+        this.#update();
         break;
       default:
         break;
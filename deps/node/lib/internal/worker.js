@@ -80,13 +80,22 @@ let cwdCounter;
 
 if (isMainThread) {
   // @lwnode
-  // cwdCounter = new Uint32Array(new SharedArrayBuffer(4));
-  cwdCounter = new Uint32Array(new ArrayBuffer(4));
+  // SharedArrayBuffer and Atomics are missing when the engine is built
+  // without threading. Workers can't see a chdir() then, as before.
+  const hasSharedMemory = typeof SharedArrayBuffer === 'function' &&
+                          typeof Atomics === 'object';
+  if (hasSharedMemory) {
+    cwdCounter = new Uint32Array(new SharedArrayBuffer(4));
+  } else {
+    cwdCounter = new Uint32Array(new ArrayBuffer(4));
+  }
   const originalChdir = process.chdir;
   process.chdir = function(path) {
-    // @lwnode
-    // Atomics.add(cwdCounter, 0, 1);
-    cwdCounter[0] = 1;
+    if (hasSharedMemory) {
+      Atomics.add(cwdCounter, 0, 1);
+    } else {
+      cwdCounter[0] = 1;
+    }
     originalChdir(path);
   };
 }
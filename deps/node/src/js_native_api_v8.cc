@@ -1265,6 +1265,55 @@ napi_status napi_define_properties(napi_env env,
   v8::Local<v8::Object> obj;
   CHECK_TO_OBJECT(env, context, obj, object);
 
+  // @lwnode
+#ifdef LWNODE
+  // Methods and values are data properties; consecutive ones are defined in
+  // a single engine entry. Pending ones are defined before an accessor so
+  // that the order of definitions is kept. A batch holds either methods or
+  // values, so a failure reports the status a single definition would:
+  // napi_generic_failure for a method and napi_invalid_arg for a value.
+  std::vector<v8::Local<v8::Name>> batch_names;
+  std::vector<v8::Local<v8::Value>> batch_values;
+  std::vector<v8::PropertyAttribute> batch_attributes;
+  napi_status batch_error = napi_ok;
+  batch_names.reserve(property_count);
+  batch_values.reserve(property_count);
+  batch_attributes.reserve(property_count);
+
+  auto define_batch = [&]() {
+    if (batch_names.empty()) {
+      return napi_ok;
+    }
+    auto define_maybe = obj->DefineOwnProperties(context,
+                                                 batch_names.size(),
+                                                 batch_names.data(),
+                                                 batch_values.data(),
+                                                 batch_attributes.data());
+    batch_names.clear();
+    batch_values.clear();
+    batch_attributes.clear();
+    return define_maybe.FromMaybe(false) ? napi_ok : batch_error;
+  };
+
+  auto add_to_batch = [&](v8::Local<v8::Name> name,
+                          v8::Local<v8::Value> value,
+                          const napi_property_descriptor* p,
+                          napi_status error) {
+    if (error != batch_error) {
+      napi_status status = define_batch();
+      if (status != napi_ok) {
+        return status;
+      }
+      batch_error = error;
+    }
+    batch_names.push_back(name);
+    batch_values.push_back(value);
+    batch_attributes.push_back(v8impl::V8PropertyAttributesFromDescriptor(p));
+    return napi_ok;
+  };
+#endif
+  // end @lwnode
+
   for (size_t i = 0; i < property_count; i++) {
     const napi_property_descriptor* p = &properties[i];
 
@@ -1306,6 +1355,15 @@ napi_status napi_define_properties(napi_env env,
         local_setter = maybe_setter.ToLocalChecked();
       }
 
+      // @lwnode
+#ifdef LWNODE
+      status = define_batch();
+      if (status != napi_ok) {
+        return napi_set_last_error(env, status);
+      }
+#endif
+      // end @lwnode
+
       v8::PropertyDescriptor descriptor(local_getter, local_setter);
       descriptor.set_enumerable((p->attributes & napi_enumerable) != 0);
       descriptor.set_configurable((p->attributes & napi_configurable) != 0);
@@ -1330,6 +1388,19 @@ napi_status napi_define_properties(napi_env env,
 
       CHECK_MAYBE_EMPTY(env, maybe_fn, napi_generic_failure);
 
+      // @lwnode
+#ifdef LWNODE
+      status = add_to_batch(property_name,
+                            maybe_fn.ToLocalChecked(),
+                            p,
+                            napi_generic_failure);
+      if (status != napi_ok) {
+        return napi_set_last_error(env, status);
+      }
+      continue;
+#endif
+      // end @lwnode
+
       v8::PropertyDescriptor descriptor(maybe_fn.ToLocalChecked(),
                                         (p->attributes & napi_writable) != 0);
       descriptor.set_enumerable((p->attributes & napi_enumerable) != 0);
@@ -1345,6 +1416,16 @@ napi_status napi_define_properties(napi_env env,
     } else {
       v8::Local<v8::Value> value = v8impl::V8LocalValueFromJsValue(p->value);
 
+      // @lwnode
+#ifdef LWNODE
+      status = add_to_batch(property_name, value, p, napi_invalid_arg);
+      if (status != napi_ok) {
+        return napi_set_last_error(env, status);
+      }
+      continue;
+#endif
+      // end @lwnode
+
       v8::PropertyDescriptor descriptor(value,
                                         (p->attributes & napi_writable) != 0);
       descriptor.set_enumerable((p->attributes & napi_enumerable) != 0);
@@ -1359,6 +1440,15 @@ napi_status napi_define_properties(napi_env env,
     }
   }
 
+  // @lwnode
+#ifdef LWNODE
+  napi_status status = define_batch();
+  if (status != napi_ok) {
+    return napi_set_last_error(env, status);
+  }
+#endif
+  // end @lwnode
+
   return GET_RETURN_STATUS(env);
 }
 
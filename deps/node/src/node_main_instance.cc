@@ -66,6 +66,8 @@ NodeMainInstance::NodeMainInstance(
       isolate_data_(nullptr),
       owns_isolate_(true) {
   params->array_buffer_allocator = array_buffer_allocator_.get();
+  // @lwnode
+  params->array_buffer_allocator_shared = array_buffer_allocator_;
   isolate_ = Isolate::Allocate();
   CHECK_NOT_NULL(isolate_);
   // Register the isolate on the platform before the isolate gets initialized,
@@ -87,7 +87,10 @@ class NodeMainInstance {
 
   std::vector<std::string> args_;
   std::vector<std::string> exec_args_;
-  std::unique_ptr<ArrayBufferAllocator> array_buffer_allocator_;
+  // @lwnode
+  // Shared with the isolate, which frees ArrayBuffers after it is disposed.
+  // std::unique_ptr<ArrayBufferAllocator> array_buffer_allocator_;
+  std::shared_ptr<ArrayBufferAllocator> array_buffer_allocator_;
 
   v8::Isolate* isolate_;
   MultiIsolatePlatform* platform_;
@@ -473,6 +473,12 @@ static void InitializeProcessMethods(Local<Object> target,
 #ifdef LWNODE
   LWNode::InitializeProcessMethods(target, context);
   env->SetMethod(target, "logger", Logger);
+  // Memory watchers hold a thread and references into this isolate.
+  env->AddCleanupHook(
+      [](void* arg) {
+        LWNode::StopMemWatchers(static_cast<Environment*>(arg)->isolate());
+      },
+      env);
 #endif
 }
 
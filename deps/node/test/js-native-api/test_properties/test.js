@@ -67,3 +67,16 @@ assert.strictEqual(test_object.hasNamedProperty(test_object, 'hiddenValue'),
                    true);
 assert.strictEqual(test_object.hasNamedProperty(test_object, 'doesnotexist'),
                    false);
+
+// A definition which fails reports napi_generic_failure for a method and
+// napi_invalid_arg for a value, whatever was defined before it.
+const napi_invalid_arg = 1;
+const napi_generic_failure = 9;
+for (const [addedIsMethod, expected] of [[true, napi_generic_failure],
+                                         [false, napi_invalid_arg]]) {
+  const object = Object.preventExtensions({ existing: 0 });
+  assert.strictEqual(test_object.defineTwoKinds(object, addedIsMethod),
+                     expected);
+  assert.ok('existing' in object);
+  assert.ok(!('added' in object));
+}
@@ -59,6 +59,32 @@ static napi_value HasNamedProperty(napi_env env, napi_callback_info info) {
   return result;
 }
 
+// Defines "existing" as a value or a method, then "added" as the other one,
+// and returns the status of napi_define_properties.
+static napi_value DefineTwoKinds(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value args[2];
+  NAPI_CALL(env, napi_get_cb_info(env, info, &argc, args, NULL, NULL));
+
+  NAPI_ASSERT(env, argc == 2, "Wrong number of arguments");
+
+  bool added_is_method;
+  NAPI_CALL(env, napi_get_value_bool(env, args[1], &added_is_method));
+
+  napi_property_descriptor properties[] = {
+    { "existing", 0, added_is_method ? NULL : Echo, 0, 0,
+      added_is_method ? args[1] : NULL, napi_writable | napi_configurable, 0 },
+    { "added", 0, added_is_method ? Echo : NULL, 0, 0,
+      added_is_method ? NULL : args[1], napi_default, 0 },
+  };
+  napi_status status = napi_define_properties(
+      env, args[0], sizeof(properties) / sizeof(*properties), properties);
+
+  napi_value result;
+  NAPI_CALL(env, napi_create_int32(env, status, &result));
+  return result;
+}
+
 EXTERN_C_START
 napi_value Init(napi_env env, napi_value exports) {
   napi_value number;
@@ -92,6 +118,7 @@ napi_value Init(napi_env env, napi_value exports) {
     { "readonlyAccessor1", 0, 0, GetValue, NULL, 0, napi_default, 0},
     { "readonlyAccessor2", 0, 0, GetValue, NULL, 0, napi_writable, 0},
     { "hasNamedProperty", 0, HasNamedProperty, 0, 0, 0, napi_default, 0 },
+    { "defineTwoKinds", 0, DefineTwoKinds, 0, 0, 0, napi_default, 0 },
   };
 
   NAPI_CALL(env, napi_define_properties(
@@ -0,0 +1,36 @@
+// Flags: --arraybuffer-pool --expose-gc
+'use strict';
+
+const common = require('../common');
+const assert = require('assert');
+
+if (!process.lwnode) common.skip("`process.lwnode` doesn't exist");
+
+const before = process.lwnode.getArrayBufferPoolStats();
+assert.strictEqual(before.enabled, true);
+
+const kCount = 1000;
+const kLengths = [2048, 4096, 10000, 65536];
+
+for (let round = 0; round < 2; round++) {
+  for (const length of kLengths) {
+    for (let i = 0; i < kCount; i++) {
+      const bytes = new Uint8Array(new ArrayBuffer(length));
+      // A reused block must be zero-filled again.
+      assert.strictEqual(bytes[0], 0);
+      assert.strictEqual(bytes[length - 1], 0);
+      bytes.fill(0xff);
+    }
+  }
+  global.gc();
+}
+
+// Buffers under 2KB stay on the malloc heap.
+new ArrayBuffer(1024);
+
+const after = process.lwnode.getArrayBufferPoolStats();
+const allocations = after.allocations - before.allocations;
+
+assert.ok(allocations >= 2 * kCount * kLengths.length);
+// The exact slab counts are checked by the ArrayBufferPoolSlabs cctest.
+assert.ok(after.cacheHits > before.cacheHits);
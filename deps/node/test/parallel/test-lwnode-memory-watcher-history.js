@@ -0,0 +1,63 @@
+'use strict';
+
+const common = require('../common');
+const assert = require('assert');
+
+if (!process.lwnode) common.skip("`process.lwnode` doesn't exist");
+
+const { MemWatcher } = process.lwnode;
+
+// Native watchers don't keep the event loop alive.
+const keepAlive = setTimeout(() => {}, common.platformTimeout(1000 * 60));
+let running = 2;
+
+function done(watcher) {
+  watcher.end();
+  if (--running == 0) clearTimeout(keepAlive);
+}
+
+// Options sizing native buffers are range checked.
+for (const options of [
+  { capacity: 0 },
+  { capacity: 24 * 60 * 60 + 1 },
+  { capacity: 1.5 },
+  { maxIgnoreCount: -1 },
+  { limit: -1 },
+]) {
+  assert.throws(() => new MemWatcher(options), { code: 'ERR_OUT_OF_RANGE' });
+}
+
+// history
+const kCapacity = 4;
+const watcher = new MemWatcher({ delay: 20, capacity: kCapacity });
+let count = 0;
+
+watcher.on(
+  'stats',
+  common.mustCallAtLeast((stats) => {
+    assert.strictEqual(stats.current.arrayBuffer.length, 2);
+    if (++count < kCapacity + 2) return;
+
+    const history = watcher.history();
+    assert.strictEqual(history.length, kCapacity);
+    for (let i = 1; i < history.length; i++) {
+      assert.ok(history[i - 1].time <= history[i].time);
+      assert.ok(history[i].stats.pssSwap[1] > 0);
+    }
+
+    done(watcher);
+    assert.deepStrictEqual(watcher.history(), []);
+  }, kCapacity + 2),
+);
+
+// limit
+const limitWatcher = new MemWatcher({ delay: 20, limit: 1 });
+
+limitWatcher.on(
+  'limit',
+  common.mustCall(({ current, limit }) => {
+    assert.strictEqual(limit[1], 1);
+    assert.ok(current[1] > 1);
+    done(limitWatcher);
+  }),
+);
@@ -0,0 +1,32 @@
+'use strict';
+
+const common = require('../common');
+const assert = require('assert');
+const { Worker } = require('worker_threads');
+
+if (!process.lwnode) common.skip("`process.lwnode` doesn't exist");
+
+const { MemWatcher } = process.lwnode;
+
+// A watcher must sleep between samples.
+for (const delay of [0, -1]) {
+  assert.throws(() => new MemWatcher({ delay }), {
+    code: 'ERR_OUT_OF_RANGE',
+  });
+}
+
+// A worker that exits without ending its watcher stops it on teardown.
+const worker = new Worker(`
+  const { parentPort } = require('worker_threads');
+  const watcher = new process.lwnode.MemWatcher({ delay: 10 });
+  watcher.on('stats', () => {});
+  parentPort.postMessage('started');
+`, { eval: true });
+
+worker.once('message', common.mustCall((message) => {
+  assert.strictEqual(message, 'started');
+}));
+
+worker.on('exit', common.mustCall((code) => {
+  assert.strictEqual(code, 0);
+}));
@@ -0,0 +1,22 @@
+// Flags: --smaps-sampler
+'use strict';
+
+const common = require('../common');
+const assert = require('assert');
+
+if (!process.lwnode) common.skip("`process.lwnode` doesn't exist");
+
+const { PssUsage, PssSwapUsage, RssUsage } = process.lwnode;
+
+function check() {
+  const pss = PssUsage();
+  const rss = RssUsage();
+  assert.ok(Number.isInteger(pss) && pss > 0);
+  assert.ok(Number.isInteger(rss) && rss >= pss);
+  assert.ok(PssSwapUsage() >= pss);
+}
+
+// The first sample is taken as soon as the sampler starts.
+check();
+
+setTimeout(common.mustCall(check), 1500);
@@ -0,0 +1,46 @@
+'use strict';
+
+// A SharedArrayBuffer posted to a worker refers to the same memory, and
+// Atomics.wait() and Atomics.notify() work across the two isolates.
+
+const common = require('../common');
+const assert = require('assert');
+const { Worker } = require('worker_threads');
+
+if (!process.lwnode) common.skip("`process.lwnode` doesn't exist");
+if (typeof SharedArrayBuffer !== 'function')
+  common.skip('the engine is built without SharedArrayBuffer');
+
+const shared = new Int32Array(new SharedArrayBuffer(8));
+
+const worker = new Worker(`
+  const { parentPort, workerData } = require('worker_threads');
+  const shared = workerData;
+  parentPort.postMessage('waiting');
+  // Woken by the main thread once it has stored 1, unless it already has
+  const result = Atomics.wait(shared, 0, 0, 10000);
+  const isWoken = result !== 'timed-out' && Atomics.load(shared, 0) === 1;
+  Atomics.store(shared, 1, isWoken ? 42 : -1);
+  Atomics.notify(shared, 1);
+  parentPort.postMessage(process.cwd());
+`, { eval: true, workerData: shared });
+
+worker.once('message', common.mustCall((message) => {
+  assert.strictEqual(message, 'waiting');
+
+  // The worker may not have started waiting yet, so notify until it wakes.
+  Atomics.store(shared, 0, 1);
+  while (Atomics.load(shared, 1) === 0) {
+    Atomics.notify(shared, 0);
+    Atomics.wait(shared, 1, 0, 10);
+  }
+  assert.strictEqual(Atomics.load(shared, 1), 42);
+
+  worker.once('message', common.mustCall((cwd) => {
+    assert.strictEqual(cwd, process.cwd());
+  }));
+}));
+
+worker.on('exit', common.mustCall((code) => {
+  assert.strictEqual(code, 0);
+}));
@@ -0,0 +1,95 @@
+'use strict';
+
+// Idle CPU and echo latency with the GLib main loop driving libuv.
+
+const common = require('../common');
+const assert = require('assert');
+const fs = require('fs');
+const net = require('net');
+const path = require('path');
+
+if (!process.lwnode) common.skip("`process.lwnode` doesn't exist");
+if (!common.isLinux) common.skip('gmain-loop is only built on Linux');
+
+// An installed module is used first, then the one built in this tree by
+// `tools/build-modules.sh gmain-loop --os=linux`.
+function resolveGmainLoop() {
+  try {
+    return require.resolve('gmain-loop');
+  } catch (e) {
+    if (e.code !== 'MODULE_NOT_FOUND') throw e;
+  }
+  const built = path.resolve(__dirname, '../../../../out/modules/linux',
+                             'gmain-loop');
+  return fs.existsSync(path.join(built, 'gmain-loop.node')) ? built : null;
+}
+
+const modulePath = resolveGmainLoop();
+if (!modulePath) {
+  common.skip('gmain-loop is neither installed nor built in out/modules');
+}
+// A module that is found but fails to load is a failure, not a skip.
+const gmainLoop = require(modulePath);
+
+// The main loop is chosen once this script has run.
+gmainLoop.init();
+
+const kIdleTime = 1000;
+const kEchoCount = 200;
+
+function measureIdleCpu(callback) {
+  const startCpu = process.cpuUsage();
+  const startTime = process.hrtime.bigint();
+
+  setTimeout(() => {
+    const cpu = process.cpuUsage(startCpu);
+    const elapsed = Number(process.hrtime.bigint() - startTime) / 1000;
+    const ratio = (cpu.user + cpu.system) / elapsed;
+    console.log(`idle cpu: ${(ratio * 100).toFixed(2)}%`);
+
+    // A loop that spins between timers burns the whole interval.
+    assert.ok(ratio < 0.2, `idle cpu ${ratio}`);
+    callback();
+  }, kIdleTime);
+}
+
+function measureEchoLatency(callback) {
+  const server = net.createServer((socket) => socket.pipe(socket));
+
+  server.listen(0, common.mustCall(() => {
+    const client = net.connect(server.address().port);
+    const latencies = [];
+    let sentTime;
+
+    function send() {
+      sentTime = process.hrtime.bigint();
+      client.write('x');
+    }
+
+    client.on('connect', send);
+    client.on('data', () => {
+      latencies.push(Number(process.hrtime.bigint() - sentTime) / 1e6);
+      if (latencies.length < kEchoCount) {
+        send();
+        return;
+      }
+
+      latencies.sort((a, b) => a - b);
+      const median = latencies[latencies.length >> 1];
+      const p99 = latencies[Math.floor(latencies.length * 0.99)];
+      console.log(`echo latency: median ${median.toFixed(3)}ms, ` +
+                  `p99 ${p99.toFixed(3)}ms`);
+
+      // Every round trip must be served when the fd becomes readable, not
+      // on the next timer or GLib event.
+      assert.ok(median < 10, `median latency ${median}ms`);
+
+      client.end();
+      server.close(callback);
+    });
+  }));
+}
+
+measureIdleCpu(common.mustCall(() => {
+  measureEchoLatency(common.mustCall());
+}));
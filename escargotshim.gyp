@@ -56,6 +56,7 @@
         'src/api/utils/logger/logger.cc',
         'src/api/arraybuffer-allocator.cc',
         'src/api/arraybuffer-deleter.cc',
+        'src/api/arraybuffer-pool.cc',
         'src/api/es-helper.cc',
         'src/api/es-v8-helper.cc',
         'src/api/engine.cc',
@@ -64,8 +65,12 @@
         'src/api/handlescope.cc',
         'src/api/isolate.cc',
         'src/api/context.cc',
+        'src/api/cpu-profiler.cc',
         'src/api/global-handles.cc',
         'src/api/global.cc',
+        'src/api/heap-profiler.cc',
+        'src/api/memory-measurement.cc',
+        'src/api/microtask-queue.cc',
         'src/api/function.cc',
         'src/api/object.cc',
         'src/api/stack-trace.cc',
@@ -74,6 +79,7 @@
         'src/lwnode/lwnode.cc',
         'src/lwnode/lwnode-loader.cc',
         'src/lwnode/lwnode-gc-strategy.cc',
+        'src/lwnode/lwnode-mem-watcher.cc',
       ],
       'defines': ['V8_PROMISE_INTERNAL_FIELD_COUNT=1',
         'LWNODE_ENABLE_EXPERIMENTAL_SERIALIZATION=1',
@@ -37,6 +37,9 @@ void InitializeProcessMethods(v8::Local<v8::Object> target,
                               v8::Local<v8::Context> context);
 
 void IdleGC(v8::Isolate* isolate = nullptr);
+// Stops the memory watchers started in the isolate, e.g. when its
+// environment is torn down.
+void StopMemWatchers(v8::Isolate* isolate);
 void initDebugger();
 bool dumpSelfMemorySnapshot();
 
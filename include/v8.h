@@ -3727,6 +3727,19 @@ class V8_EXPORT Object : public Value {
       Local<Context> context, Local<Name> key, Local<Value> value,
       PropertyAttribute attributes = None);
 
+  // @lwnode
+  // Defines |count| data properties at once, as DefineOwnProperty does for
+  // each of them in order. |attributes| may be nullptr to define them all
+  // with None.
+  //
+  // Returns true if every property is defined. Definitions stop at the
+  // first one that fails.
+  V8_WARN_UNUSED_RESULT Maybe<bool> DefineOwnProperties(
+      Local<Context> context, size_t count, const Local<Name>* keys,
+      const Local<Value>* values,
+      const PropertyAttribute* attributes = nullptr);
+  // end @lwnode
+
   // Implements Object.DefineProperty(O, P, Attributes), see Ecma-262 19.1.2.4.
   //
   // The defineProperty function is used to add an own property or
@@ -16,11 +16,14 @@
 
 #include "api.h"
 
+#include "api/cpu-profiler.h"
 #include "api/global.h"
+#include "api/microtask-queue.h"
 #include "api/utils.h"
 #include "base.h"
 
 #include <sstream>
+#include <vector>
 
 using namespace Escargot;
 using namespace EscargotShim;
@@ -861,21 +864,58 @@ Maybe<bool> v8::Object::Set(v8::Local<v8::Context> context,
                             uint32_t index,
                             v8::Local<Value> value) {
   API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
-  return Set(context,
-             Utils::NewLocal<Value>(lwIsolate->toV8(), ValueRef::create(index)),
-             value);
+
+  auto r = ObjectRefHelper::setProperty(VAL(*context)->context()->get(),
+                                        VAL(this)->value()->asObject(),
+                                        ValueRef::create(index),
+                                        VAL(*value)->value());
+
+  API_HANDLE_EXCEPTION(r, lwIsolate, Nothing<bool>());
+
+  return Just(true);
+}
+
+static Maybe<bool> createDataProperty(IsolateWrap* lwIsolate,
+                                      v8::Local<v8::Context> context,
+                                      ObjectRef* esObject,
+                                      ValueRef* esKey,
+                                      v8::Local<Value> value) {
+  auto r = ObjectRefHelper::defineDataProperty(
+      VAL(*context)->context()->get(),
+      esObject,
+      esKey,
+      ObjectRef::DataPropertyDescriptor(
+          VAL(*value)->value(),
+          static_cast<ObjectRef::PresentAttribute>(
+              ObjectRef::PresentAttribute::WritablePresent |
+              ObjectRef::PresentAttribute::EnumerablePresent |
+              ObjectRef::PresentAttribute::ConfigurablePresent)));
+
+  API_HANDLE_EXCEPTION(r, lwIsolate, Nothing<bool>());
+
+  return Just(r.result->asBoolean());
 }
 
 Maybe<bool> v8::Object::CreateDataProperty(v8::Local<v8::Context> context,
                                            v8::Local<Name> key,
                                            v8::Local<Value> value) {
-  LWNODE_RETURN_MAYBE(bool);
+  API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
+  return createDataProperty(lwIsolate,
+                            context,
+                            VAL(this)->value()->asObject(),
+                            VAL(*key)->value(),
+                            value);
 }
 
 Maybe<bool> v8::Object::CreateDataProperty(v8::Local<v8::Context> context,
                                            uint32_t index,
                                            v8::Local<Value> value) {
-  LWNODE_RETURN_MAYBE(bool);
+  API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
+  return createDataProperty(lwIsolate,
+                            context,
+                            VAL(this)->value()->asObject(),
+                            ValueRef::create(index),
+                            value);
 }
 
 PropertyDescriptor::PrivateData::PrivateData(Escargot::ValueRef* value) {
@@ -1067,6 +1107,41 @@ Maybe<bool> v8::Object::DefineOwnProperty(v8::Local<v8::Context> context,
   return Just(r.result->asBoolean());
 }
 
+Maybe<bool> v8::Object::DefineOwnProperties(
+    v8::Local<v8::Context> context,
+    size_t count,
+    const v8::Local<Name>* keys,
+    const v8::Local<Value>* values,
+    const v8::PropertyAttribute* attributes) {
+  API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
+
+  GCVector<ValueRef*> esKeys;
+  GCVector<ValueRef*> esValues;
+  std::vector<ObjectRef::PresentAttribute> esAttributes;
+  esKeys.reserve(count);
+  esValues.reserve(count);
+  esAttributes.reserve(count);
+
+  for (size_t i = 0; i < count; i++) {
+    esKeys.push_back(CVAL(*keys[i])->value());
+    esValues.push_back(CVAL(*values[i])->value());
+    esAttributes.push_back(V8Helper::toPresentAttribute(
+        attributes ? attributes[i] : PropertyAttribute::None));
+  }
+
+  auto r = ObjectRefHelper::defineDataProperties(
+      CVAL(*context)->context()->get(),
+      CVAL(this)->value()->asObject(),
+      count,
+      esKeys.data(),
+      esValues.data(),
+      esAttributes.data());
+
+  API_HANDLE_EXCEPTION(r, lwIsolate, Nothing<bool>());
+
+  return Just(r.result->asBoolean());
+}
+
 Maybe<bool> v8::Object::DefineProperty(v8::Local<v8::Context> context,
                                        v8::Local<Name> key,
                                        PropertyDescriptor& descriptor) {
@@ -1141,13 +1216,9 @@ Maybe<bool> v8::Object::SetPrivate(Local<Context> context,
                                    Local<Value> value) {
   API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
 
-  EvalResult r = ObjectRefHelper::setPrivate(VAL(*context)->context()->get(),
-                                             lwIsolate->privateValuesSymbol(),
-                                             VAL(this)->value()->asObject(),
-                                             VAL(*key)->value(),
-                                             VAL(*value)->value());
-
-  API_HANDLE_EXCEPTION(r, lwIsolate, Nothing<bool>());
+  ObjectRefHelper::setPrivate(VAL(this)->value()->asObject(),
+                              VAL(*key)->value(),
+                              VAL(*value)->value());
 
   return Just(true);
 }
@@ -1167,23 +1238,24 @@ MaybeLocal<Value> v8::Object::Get(Local<v8::Context> context,
 
 MaybeLocal<Value> v8::Object::Get(Local<Context> context, uint32_t index) {
   API_ENTER_WITH_CONTEXT(context, MaybeLocal<Value>());
-  return Get(
-      context,
-      Utils::NewLocal<Value>(lwIsolate->toV8(), ValueRef::create(index)));
+
+  auto r = ObjectRefHelper::getProperty(VAL(*context)->context()->get(),
+                                        VAL(this)->value()->asObject(),
+                                        ValueRef::create(index));
+
+  API_HANDLE_EXCEPTION(r, lwIsolate, MaybeLocal<Value>());
+
+  return Utils::NewLocal<Value>(lwIsolate->toV8(), r.result);
 }
 
 MaybeLocal<Value> v8::Object::GetPrivate(Local<Context> context,
                                          Local<Private> key) {
   API_ENTER_WITH_CONTEXT(context, MaybeLocal<Value>());
 
-  EvalResult r = ObjectRefHelper::getPrivate(VAL(*context)->context()->get(),
-                                             lwIsolate->privateValuesSymbol(),
-                                             VAL(this)->value()->asObject(),
+  auto esValue = ObjectRefHelper::getPrivate(VAL(this)->value()->asObject(),
                                              VAL(*key)->value());
 
-  API_HANDLE_EXCEPTION(r, lwIsolate, MaybeLocal<Value>());
-
-  return Utils::NewLocal<Value>(lwIsolate->toV8(), r.result);
+  return Utils::NewLocal<Value>(lwIsolate->toV8(), esValue);
 }
 
 Maybe<PropertyAttribute> v8::Object::GetPropertyAttributes(
@@ -1462,14 +1534,8 @@ Maybe<bool> v8::Object::DeletePrivate(Local<Context> context,
                                       Local<Private> key) {
   API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
 
-  auto r =
-      ObjectRefHelper::deletePrivateProperty(VAL(*context)->context()->get(),
-                                             lwIsolate->privateValuesSymbol(),
-                                             VAL(this)->value()->asObject(),
-                                             VAL(*key)->value());
-  API_HANDLE_EXCEPTION(r, lwIsolate, Nothing<bool>());
-
-  return Just(r.result->asBoolean());
+  return Just(ObjectRefHelper::deletePrivate(VAL(this)->value()->asObject(),
+                                             VAL(*key)->value()));
 }
 
 Maybe<bool> v8::Object::Has(Local<Context> context, Local<Value> key) {
@@ -1486,17 +1552,8 @@ Maybe<bool> v8::Object::Has(Local<Context> context, Local<Value> key) {
 Maybe<bool> v8::Object::HasPrivate(Local<Context> context, Local<Private> key) {
   API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
 
-  EvalResult r = ObjectRefHelper::getPrivate(VAL(*context)->context()->get(),
-                                             lwIsolate->privateValuesSymbol(),
-                                             VAL(this)->value()->asObject(),
-                                             VAL(*key)->value());
-
-  API_HANDLE_EXCEPTION(r, lwIsolate, Nothing<bool>());
-
-  if (r.result->isUndefined()) {
-    return Just(false);
-  }
-  return Just(true);
+  return Just(ObjectRefHelper::hasPrivate(VAL(this)->value()->asObject(),
+                                          VAL(*key)->value()));
 }
 
 Maybe<bool> v8::Object::Delete(Local<Context> context,
@@ -1504,9 +1561,13 @@ Maybe<bool> v8::Object::Delete(Local<Context> context,
 
 Maybe<bool> v8::Object::Has(Local<Context> context, uint32_t index) {
   API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
-  return Has(
-      context,
-      Utils::NewLocal<Value>(lwIsolate->toV8(), ValueRef::create(index)));
+
+  auto r = ObjectRefHelper::hasProperty(VAL(*context)->context()->get(),
+                                        VAL(this)->value()->asObject(),
+                                        ValueRef::create(index));
+  API_HANDLE_EXCEPTION(r, lwIsolate, Nothing<bool>());
+
+  return Just(r.result->asBoolean());
 }
 
 Maybe<bool> Object::SetAccessor(Local<Context> context,
@@ -1782,6 +1843,11 @@ MaybeLocal<Function> Function::New(Local<Context> context,
                             length,
                             behavior,
                             side_effect_type);
+  // Like V8, a function made here isn't cached, since the template can't be
+  // used again.
+  ExtraDataHelper::getFunctionTemplateExtraData(
+      CVAL(*functionTemplate)->ftpl())
+      ->setDoNotCache();
 
   return functionTemplate->GetFunction(context);
 }
@@ -1800,6 +1866,7 @@ MaybeLocal<Object> Function::NewInstance(Local<Context> context,
     arguments.push_back(VAL(*argv[i])->value());
   }
 
+  ScriptEntryScope scriptEntryScope(lwIsolate);
   auto r = Evaluator::execute(
       lwContext->get(),
       [](ExecutionStateRef* state,
@@ -1816,10 +1883,10 @@ MaybeLocal<Object> Function::NewInstance(Local<Context> context,
 
   auto esNewObject = r.result->asObject();
   ObjectData* existingNewObjectExtraData = nullptr;
-  if (ExtraDataHelper::getExtraData(esNewObject)) {
+  auto newObjectExtraData = ExtraDataHelper::getExtraData(esNewObject);
+  if (newObjectExtraData && !newObjectExtraData->isPrivateValuesData()) {
     // This objectData was added in ObjectTemplate::createObjectData();
-    existingNewObjectExtraData =
-        ExtraDataHelper::getExtraData(esNewObject)->asObjectData();
+    existingNewObjectExtraData = newObjectExtraData->asObjectData();
     LWNODE_CALL_TRACE_ID_LOG(
         EXTRADATA,
         "Function(%p)::NewInstance(): Existing extraData: %p",
@@ -1828,9 +1895,10 @@ MaybeLocal<Object> Function::NewInstance(Local<Context> context,
   }
 
   auto functionData = ExtraDataHelper::getExtraData(esFunction);
-  if (functionData) {
+  // @note a function created in JavaScript may have extra data only to keep
+  // its private values.
+  if (functionData && functionData->isFunctionData()) {
     // This functionData was added in FunctionTemplate::GetFunction()
-    LWNODE_CHECK(functionData->isFunctionData());
     LWNODE_CALL_TRACE_ID_LOG(
         EXTRADATA,
         "Function(%p)::NewInstance(): Existing functionData: %p\n",
@@ -1891,6 +1959,7 @@ MaybeLocal<v8::Value> Function::Call(Local<Context> context,
     arguments.push_back(VAL(*argv[i])->value());
   }
 
+  ScriptEntryScope scriptEntryScope(lwIsolate);
   lwIsolate->increaseCallDepth();
   auto r = Evaluator::execute(
       esContext,
@@ -1959,6 +2028,10 @@ MaybeLocal<v8::Value> Function::Call(Local<Context> context,
     return MaybeLocal<Value>();
   }
 
+  if (!lwIsolate->hasCallDepth()) {
+    VAL(*context)->context()->microtaskQueue()->onCallCompleted();
+  }
+
   return Utils::NewLocal<Value>(lwIsolate->toV8(), r.result);
 }
 
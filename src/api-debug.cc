@@ -15,6 +15,8 @@
  */
 
 #include "api.h"
+#include "api/cpu-profiler.h"
+#include "api/heap-profiler.h"
 #include "base.h"
 
 using namespace Escargot;
@@ -371,10 +373,6 @@ v8::MaybeLocal<v8::Array> v8::Object::PreviewEntries(bool* is_key_value) {
 
 // debug::PostponeInterruptsScope::~PostponeInterruptsScope() = default;
 
-// Local<String> CpuProfileNode::GetFunctionName() const {
-//   LWNODE_RETURN_LOCAL(String);
-// }
-
 // int debug::Coverage::BlockData::StartOffset() const {
 //   LWNODE_RETURN_0;
 // }
@@ -526,108 +524,147 @@ v8::MaybeLocal<v8::Array> v8::Object::PreviewEntries(bool* is_key_value) {
 //   LWNODE_RETURN_LOCAL(Message);
 // }
 
+static Local<String> newLocalString(const std::string& str) {
+  auto lwIsolate = IsolateWrap::GetCurrent();
+  return Utils::NewLocal<String>(
+      lwIsolate->toV8(), StringRef::createFromUTF8(str.data(), str.length()));
+}
+
+Local<String> CpuProfileNode::GetFunctionName() const {
+  return newLocalString(CpuProfileNodeWrap::fromV8(this)->functionName());
+}
+
 const char* CpuProfileNode::GetFunctionNameStr() const {
-  LWNODE_RETURN_NULLPTR;
+  return CpuProfileNodeWrap::fromV8(this)->functionName().c_str();
 }
 
 int CpuProfileNode::GetScriptId() const {
-  LWNODE_RETURN_0;
+  return CpuProfileNodeWrap::fromV8(this)->scriptId();
 }
 
 Local<String> CpuProfileNode::GetScriptResourceName() const {
-  LWNODE_RETURN_LOCAL(String);
+  return newLocalString(CpuProfileNodeWrap::fromV8(this)->url());
 }
 
 const char* CpuProfileNode::GetScriptResourceNameStr() const {
-  LWNODE_RETURN_NULLPTR;
+  return CpuProfileNodeWrap::fromV8(this)->url().c_str();
 }
 
 bool CpuProfileNode::IsScriptSharedCrossOrigin() const {
-  LWNODE_RETURN_FALSE;
+  return false;
 }
 
 int CpuProfileNode::GetLineNumber() const {
-  LWNODE_RETURN_0;
+  return CpuProfileNodeWrap::fromV8(this)->lineNumber();
 }
 
 int CpuProfileNode::GetColumnNumber() const {
-  LWNODE_RETURN_0;
+  return CpuProfileNodeWrap::fromV8(this)->columnNumber();
 }
 
 unsigned int CpuProfileNode::GetHitLineCount() const {
-  LWNODE_RETURN_0;
+  return CpuProfileNodeWrap::fromV8(this)->lineTicks().size();
 }
 
 bool CpuProfileNode::GetLineTicks(LineTick* entries,
                                   unsigned int length) const {
-  LWNODE_RETURN_FALSE;
+  auto& lineTicks = CpuProfileNodeWrap::fromV8(this)->lineTicks();
+  if (entries == nullptr || length < lineTicks.size()) {
+    return false;
+  }
+
+  unsigned int i = 0;
+  for (const auto& tick : lineTicks) {
+    entries[i].line = tick.first;
+    entries[i].hit_count = tick.second;
+    i++;
+  }
+  return true;
 }
 
 const char* CpuProfileNode::GetBailoutReason() const {
-  LWNODE_RETURN_NULLPTR;
+  return "";
 }
 
 unsigned CpuProfileNode::GetHitCount() const {
-  LWNODE_RETURN_0;
+  return CpuProfileNodeWrap::fromV8(this)->hitCount();
 }
 
 unsigned CpuProfileNode::GetNodeId() const {
-  LWNODE_RETURN_0;
+  return CpuProfileNodeWrap::fromV8(this)->id();
 }
 
 CpuProfileNode::SourceType CpuProfileNode::GetSourceType() const {
-  LWNODE_UNIMPLEMENT;
-  return kScript;
+  return CpuProfileNodeWrap::fromV8(this)->sourceType();
 }
 
 int CpuProfileNode::GetChildrenCount() const {
-  LWNODE_RETURN_0;
+  return CpuProfileNodeWrap::fromV8(this)->childrenCount();
 }
 
 const CpuProfileNode* CpuProfileNode::GetChild(int index) const {
-  LWNODE_RETURN_NULLPTR;
+  auto node = CpuProfileNodeWrap::fromV8(this);
+  if (index < 0 || static_cast<size_t>(index) >= node->childrenCount()) {
+    return nullptr;
+  }
+  return CpuProfileNodeWrap::toV8(node->child(index));
 }
 
 const CpuProfileNode* CpuProfileNode::GetParent() const {
-  LWNODE_RETURN_NULLPTR;
+  auto parent = CpuProfileNodeWrap::fromV8(this)->parent();
+  return parent ? CpuProfileNodeWrap::toV8(parent) : nullptr;
+}
+
+const std::vector<CpuProfileDeoptInfo>& CpuProfileNode::GetDeoptInfos() const {
+  // Escargot is an interpreter; there is no deoptimization.
+  static const std::vector<CpuProfileDeoptInfo> s_empty;
+  return s_empty;
 }
 
 void CpuProfile::Delete() {
-  LWNODE_RETURN_VOID;
+  auto profile = CpuProfileWrap::fromV8(this);
+  profile->profiler()->deleteProfile(profile);
 }
 
 Local<String> CpuProfile::GetTitle() const {
-  LWNODE_RETURN_LOCAL(String);
+  return newLocalString(CpuProfileWrap::fromV8(this)->title());
 }
 
 const CpuProfileNode* CpuProfile::GetTopDownRoot() const {
-  LWNODE_RETURN_NULLPTR;
+  return CpuProfileNodeWrap::toV8(CpuProfileWrap::fromV8(this)->root());
 }
 
 const CpuProfileNode* CpuProfile::GetSample(int index) const {
-  LWNODE_RETURN_NULLPTR;
+  auto profile = CpuProfileWrap::fromV8(this);
+  LWNODE_CHECK(index >= 0 &&
+               static_cast<size_t>(index) < profile->samplesCount());
+  return CpuProfileNodeWrap::toV8(profile->sample(index));
 }
 
 int64_t CpuProfile::GetSampleTimestamp(int index) const {
-  LWNODE_RETURN_0;
+  auto profile = CpuProfileWrap::fromV8(this);
+  LWNODE_CHECK(index >= 0 &&
+               static_cast<size_t>(index) < profile->samplesCount());
+  return profile->timestamp(index);
 }
 
 int64_t CpuProfile::GetStartTime() const {
-  LWNODE_RETURN_0;
+  return CpuProfileWrap::fromV8(this)->startTime();
 }
 
 int64_t CpuProfile::GetEndTime() const {
-  LWNODE_RETURN_0;
+  return CpuProfileWrap::fromV8(this)->endTime();
 }
 
 int CpuProfile::GetSamplesCount() const {
-  LWNODE_RETURN_0;
+  return CpuProfileWrap::fromV8(this)->samplesCount();
 }
 
 CpuProfiler* CpuProfiler::New(Isolate* isolate,
                               CpuProfilingNamingMode naming_mode,
                               CpuProfilingLoggingMode logging_mode) {
-  LWNODE_RETURN_NULLPTR;
+  return CpuProfilerWrap::toV8(
+      new CpuProfilerWrap(IsolateWrap::fromV8(isolate)));
 }
 
 CpuProfilingOptions::CpuProfilingOptions(CpuProfilingMode mode,
@@ -637,48 +674,75 @@ CpuProfilingOptions::CpuProfilingOptions(CpuProfilingMode mode,
     : mode_(mode),
       max_samples_(max_samples),
       sampling_interval_us_(sampling_interval_us) {
-  LWNODE_UNIMPLEMENT;
+  // NOTE: Filtering samples by context isn't supported, since the contexts
+  // of the frames of a stack aren't known. Samples of every context are
+  // recorded.
+  if (!filter_context.IsEmpty()) {
+    LWNODE_DLOG_WARN("CpuProfilingOptions: filter_context is ignored");
+  }
 }
 
 void* CpuProfilingOptions::raw_filter_context() const {
-  LWNODE_RETURN_NULLPTR;
+  return nullptr;
 }
 
 void CpuProfiler::Dispose() {
-  LWNODE_RETURN_VOID;
+  delete CpuProfilerWrap::fromV8(this);
 }
 
 // static
 void CpuProfiler::CollectSample(Isolate* isolate) {
-  LWNODE_RETURN_VOID;
+  // Only the profiler sampling on this thread can take the sample.
+  if (CpuProfilerWrap::current()) {
+    CpuProfilerWrap::current()->collectSample();
+  }
 }
 
 void CpuProfiler::SetSamplingInterval(int us) {
-  LWNODE_RETURN_VOID;
+  CpuProfilerWrap::fromV8(this)->setSamplingInterval(us);
 }
 
+// Like V8 on Linux, this has no effect. Precise sampling only changes the
+// timer resolution on Windows.
 void CpuProfiler::SetUsePreciseSampling(bool use_precise_sampling) {
-  LWNODE_RETURN_VOID;
+  LWNODE_CALL_TRACE();
 }
 
 void CpuProfiler::StartProfiling(Local<String> title,
                                  CpuProfilingOptions options) {
-  LWNODE_RETURN_VOID;
+  auto profiler = CpuProfilerWrap::fromV8(this);
+  if (options.sampling_interval_us() > 0) {
+    profiler->setSamplingInterval(options.sampling_interval_us());
+  }
+  profiler->startProfiling(VAL(*title)->value()->asString()->toStdUTF8String(),
+                           options.mode(),
+                           true,
+                           options.max_samples());
 }
 
 void CpuProfiler::StartProfiling(Local<String> title, bool record_samples) {
-  LWNODE_RETURN_VOID;
+  StartProfiling(
+      title,
+      CpuProfilingOptions(
+          kLeafNodeLineNumbers,
+          record_samples ? CpuProfilingOptions::kNoSampleLimit : 0));
 }
 
 void CpuProfiler::StartProfiling(Local<String> title,
                                  CpuProfilingMode mode,
                                  bool record_samples,
                                  unsigned max_samples) {
-  LWNODE_RETURN_VOID;
+  CpuProfilerWrap::fromV8(this)->startProfiling(
+      VAL(*title)->value()->asString()->toStdUTF8String(),
+      mode,
+      record_samples,
+      max_samples);
 }
 
 CpuProfile* CpuProfiler::StopProfiling(Local<String> title) {
-  LWNODE_RETURN_NULLPTR;
+  auto profile = CpuProfilerWrap::fromV8(this)->stopProfiling(
+      VAL(*title)->value()->asString()->toStdUTF8String());
+  return profile ? CpuProfileWrap::toV8(profile) : nullptr;
 }
 
 void CpuProfiler::UseDetailedSourcePositionsForProfiling(Isolate* isolate) {
@@ -743,105 +807,141 @@ void CodeEventHandler::Disable() {
 }
 
 HeapGraphEdge::Type HeapGraphEdge::GetType() const {
-  LWNODE_UNIMPLEMENT;
-  return kContextVariable;
+  return HeapGraphEdgeWrap::fromV8(this)->type();
 }
 
 Local<Value> HeapGraphEdge::GetName() const {
-  LWNODE_RETURN_LOCAL(Value);
+  auto edge = HeapGraphEdgeWrap::fromV8(this);
+  auto isolate = edge->snapshot()->isolate()->toV8();
+  if (edge->hasIndex()) {
+    return Integer::New(isolate, edge->nameOrIndex());
+  }
+  auto& name = edge->snapshot()->string(edge->nameOrIndex());
+  return Utils::NewLocal<String>(
+      isolate, StringRef::createFromUTF8(name.data(), name.length()));
 }
 
 const HeapGraphNode* HeapGraphEdge::GetFromNode() const {
-  LWNODE_RETURN_NULLPTR;
+  auto edge = HeapGraphEdgeWrap::fromV8(this);
+  return HeapGraphNodeWrap::toV8(edge->snapshot()->node(edge->from()));
 }
 
 const HeapGraphNode* HeapGraphEdge::GetToNode() const {
-  LWNODE_RETURN_NULLPTR;
+  auto edge = HeapGraphEdgeWrap::fromV8(this);
+  return HeapGraphNodeWrap::toV8(edge->snapshot()->node(edge->to()));
 }
 
 HeapGraphNode::Type HeapGraphNode::GetType() const {
-  LWNODE_UNIMPLEMENT;
-  return kHidden;
+  return HeapGraphNodeWrap::fromV8(this)->type();
 }
 
 Local<String> HeapGraphNode::GetName() const {
-  LWNODE_RETURN_LOCAL(String);
+  auto node = HeapGraphNodeWrap::fromV8(this);
+  auto& name = node->snapshot()->string(node->name());
+  return Utils::NewLocal<String>(
+      node->snapshot()->isolate()->toV8(),
+      StringRef::createFromUTF8(name.data(), name.length()));
 }
 
 SnapshotObjectId HeapGraphNode::GetId() const {
-  LWNODE_RETURN_0;
+  return HeapGraphNodeWrap::fromV8(this)->id();
 }
 
 size_t HeapGraphNode::GetShallowSize() const {
-  LWNODE_RETURN_0;
+  return HeapGraphNodeWrap::fromV8(this)->selfSize();
 }
 
 int HeapGraphNode::GetChildrenCount() const {
-  LWNODE_RETURN_0;
+  return HeapGraphNodeWrap::fromV8(this)->edges().size();
 }
 
 const HeapGraphEdge* HeapGraphNode::GetChild(int index) const {
-  LWNODE_RETURN_NULLPTR;
+  auto& edges = HeapGraphNodeWrap::fromV8(this)->edges();
+  if (index < 0 || static_cast<size_t>(index) >= edges.size()) {
+    return nullptr;
+  }
+  return HeapGraphEdgeWrap::toV8(&edges[index]);
 }
 
 void HeapSnapshot::Delete() {
-  LWNODE_RETURN_VOID;
+  auto snapshot = HeapSnapshotWrap::fromV8(this);
+  snapshot->isolate()->heapProfiler()->deleteHeapSnapshot(snapshot);
 }
 
 const HeapGraphNode* HeapSnapshot::GetRoot() const {
-  LWNODE_RETURN_NULLPTR;
+  return HeapGraphNodeWrap::toV8(HeapSnapshotWrap::fromV8(this)->node(0));
 }
 
 const HeapGraphNode* HeapSnapshot::GetNodeById(SnapshotObjectId id) const {
-  LWNODE_RETURN_NULLPTR;
+  auto node = HeapSnapshotWrap::fromV8(this)->nodeById(id);
+  return node ? HeapGraphNodeWrap::toV8(node) : nullptr;
 }
 
 int HeapSnapshot::GetNodesCount() const {
-  LWNODE_RETURN_0;
+  return HeapSnapshotWrap::fromV8(this)->nodesCount();
 }
 
 const HeapGraphNode* HeapSnapshot::GetNode(int index) const {
-  LWNODE_RETURN_NULLPTR;
+  auto snapshot = HeapSnapshotWrap::fromV8(this);
+  if (index < 0 || static_cast<size_t>(index) >= snapshot->nodesCount()) {
+    return nullptr;
+  }
+  return HeapGraphNodeWrap::toV8(snapshot->node(index));
 }
 
 SnapshotObjectId HeapSnapshot::GetMaxSnapshotJSObjectId() const {
-  LWNODE_RETURN_0;
+  return HeapSnapshotWrap::fromV8(this)->maxObjectId();
 }
 
 void HeapSnapshot::Serialize(OutputStream* stream,
                              HeapSnapshot::SerializationFormat format) const {
-  LWNODE_RETURN_VOID;
+  LWNODE_CHECK(format == kJSON);
+  HeapSnapshotWrap::fromV8(this)->serialize(stream);
 }
 
 int HeapProfiler::GetSnapshotCount() {
-  LWNODE_RETURN_0;
+  return HeapProfilerWrap::fromV8(this)->snapshotCount();
 }
 
 const HeapSnapshot* HeapProfiler::GetHeapSnapshot(int index) {
-  LWNODE_RETURN_NULLPTR;
+  auto profiler = HeapProfilerWrap::fromV8(this);
+  if (index < 0 || static_cast<size_t>(index) >= profiler->snapshotCount()) {
+    return nullptr;
+  }
+  return HeapSnapshotWrap::toV8(profiler->snapshot(index));
 }
 
 SnapshotObjectId HeapProfiler::GetObjectId(Local<Value> value) {
-  LWNODE_RETURN_0;
+  auto esValue = VAL(*value)->value();
+  if (!esValue->isObject() && !esValue->isString() && !esValue->isSymbol() &&
+      !esValue->isBigInt()) {
+    return kUnknownObjectId;
+  }
+  return HeapProfilerWrap::fromV8(this)->getObjectId(esValue);
 }
 
 SnapshotObjectId HeapProfiler::GetObjectId(NativeObject value) {
-  LWNODE_RETURN_0;
+  return HeapProfilerWrap::fromV8(this)->findNativeObjectId(value);
 }
 
 Local<Value> HeapProfiler::FindObjectById(SnapshotObjectId id) {
-  LWNODE_RETURN_LOCAL(Value);
+  auto value = HeapProfilerWrap::fromV8(this)->findObjectById(id);
+  if (!value) {
+    return Local<Value>();
+  }
+  return Utils::NewLocal<Value>(IsolateWrap::GetCurrent()->toV8(), value);
 }
 
 void HeapProfiler::ClearObjectIds() {
-  LWNODE_RETURN_VOID;
+  HeapProfilerWrap::fromV8(this)->clearObjectIds();
 }
 
 const HeapSnapshot* HeapProfiler::TakeHeapSnapshot(
     ActivityControl* control,
     ObjectNameResolver* resolver,
     bool treat_global_objects_as_roots) {
-  LWNODE_RETURN_NULLPTR;
+  return HeapSnapshotWrap::toV8(
+      HeapProfilerWrap::fromV8(this)->takeHeapSnapshot(control));
 }
 
 void HeapProfiler::StartTrackingHeapObjects(bool track_allocations) {
@@ -860,29 +960,36 @@ SnapshotObjectId HeapProfiler::GetHeapStats(OutputStream* stream,
 bool HeapProfiler::StartSamplingHeapProfiler(uint64_t sample_interval,
                                              int stack_depth,
                                              SamplingFlags flags) {
-  LWNODE_RETURN_FALSE;
+  // NOTE: Samples are never dropped on GC, so `flags` has no effect.
+  return HeapProfilerWrap::fromV8(this)->startSamplingHeapProfiler(
+      sample_interval, stack_depth);
 }
 
 void HeapProfiler::StopSamplingHeapProfiler() {
-  LWNODE_RETURN_VOID;
+  HeapProfilerWrap::fromV8(this)->stopSamplingHeapProfiler();
 }
 
 AllocationProfile* HeapProfiler::GetAllocationProfile() {
-  LWNODE_RETURN_NULLPTR;
+  auto profiler = HeapProfilerWrap::fromV8(this)->samplingProfiler();
+  if (!profiler) {
+    return nullptr;
+  }
+  return profiler->getAllocationProfile();
 }
 
 void HeapProfiler::DeleteAllHeapSnapshots() {
-  LWNODE_RETURN_VOID;
+  HeapProfilerWrap::fromV8(this)->deleteAllHeapSnapshots();
 }
 
 void HeapProfiler::AddBuildEmbedderGraphCallback(
     BuildEmbedderGraphCallback callback, void* data) {
-  LWNODE_UNIMPLEMENT_IGNORED;
+  HeapProfilerWrap::fromV8(this)->addBuildEmbedderGraphCallback(callback, data);
 }
 
 void HeapProfiler::RemoveBuildEmbedderGraphCallback(
     BuildEmbedderGraphCallback callback, void* data) {
-  LWNODE_RETURN_VOID;
+  HeapProfilerWrap::fromV8(this)->removeBuildEmbedderGraphCallback(callback,
+                                                                   data);
 }
 
 void EmbedderHeapTracer::SetStackStart(void* stack_start) {
@@ -17,6 +17,9 @@
 #include <memory>
 #include "api.h"
 #include "api/engine.h"
+#include "api/heap-profiler.h"
+#include "api/memory-measurement.h"
+#include "api/microtask-queue.h"
 #include "api/utils/cast.h"
 #include "base.h"
 #include "init/v8.h"
@@ -155,7 +158,7 @@ Local<Context> v8::Context::New(
     v8::MaybeLocal<Value> global_object,
     DeserializeInternalFieldsCallback internal_fields_deserializer,
     v8::MicrotaskQueue* microtask_queue) {
-  if (extensions || !global_object.IsEmpty() || microtask_queue) {
+  if (extensions || !global_object.IsEmpty()) {
     LWNODE_UNIMPLEMENT;
   }
 
@@ -178,6 +181,9 @@ Local<Context> v8::Context::New(
 
   auto lwContext =
       ContextWrap::New(IsolateWrap::fromV8(external_isolate), extensions);
+  if (microtask_queue) {
+    lwContext->setMicrotaskQueue(MicrotaskQueueWrap::fromV8(microtask_queue));
+  }
 
   if (esNewGlobalObjectTemplate) {
     auto esContext = lwContext->get();
@@ -1422,7 +1428,14 @@ v8::ArrayBuffer::Contents v8::ArrayBuffer::GetContents(bool externalize) {
 }
 
 void v8::ArrayBuffer::Detach() {
-  CVAL(this)->value()->asArrayBufferObject()->detachArrayBuffer();
+  auto esSelf = CVAL(this)->value()->asArrayBufferObject();
+  // The BackingStore may be attached to an ArrayBuffer in another isolate
+  // if it is being transferred.
+  if (esSelf->backingStore().hasValue()) {
+    IsolateWrap::GetCurrent()->detachBackingStore(
+        esSelf->backingStore().value());
+  }
+  esSelf->detachArrayBuffer();
 }
 
 size_t v8::ArrayBuffer::ByteLength() const {
@@ -1595,7 +1608,20 @@ size_t v8::TypedArray::Length() {
       Local<SharedArrayBuffer> shared_array_buffer,                            \
       size_t byte_offset,                                                      \
       size_t length) {                                                         \
-    LWNODE_RETURN_LOCAL(Type##Array);                                          \
+    auto lwIsolate = IsolateWrap::GetCurrent();                                \
+    auto esContext = lwIsolate->GetCurrentContext()->get();                    \
+    auto esSharedArrayBuffer =                                                 \
+        VAL(*shared_array_buffer)->value()->asSharedArrayBufferObject();       \
+                                                                               \
+    auto esArrayBufferView =                                                   \
+        ArrayBufferHelper::createView<Type##ArrayObjectRef>(                   \
+            esContext,                                                         \
+            esSharedArrayBuffer,                                               \
+            byte_offset,                                                       \
+            length,                                                            \
+            ArrayBufferHelper::ArrayType::kExternal##Type##Array);             \
+                                                                               \
+    return Utils::NewLocal<Type##Array>(lwIsolate->toV8(), esArrayBufferView); \
   }
 
 TYPED_ARRAYS(TYPED_ARRAY_NEW)
@@ -1913,12 +1939,11 @@ void Isolate::CheckMemoryPressure() {
 }
 
 HeapProfiler* Isolate::GetHeapProfiler() {
-  LWNODE_UNIMPLEMENT_IGNORED;
-  return nullptr;
+  return HeapProfilerWrap::toV8(IsolateWrap::fromV8(this)->heapProfiler());
 }
 
 void Isolate::SetIdle(bool is_idle) {
-  LWNODE_RETURN_VOID;
+  IsolateWrap::fromV8(this)->setIdle(is_idle);
 }
 
 ArrayBuffer::Allocator* Isolate::GetArrayBufferAllocator() {
@@ -2130,11 +2155,16 @@ Isolate::AllowJavascriptExecutionScope::~AllowJavascriptExecutionScope() {
 Isolate::SuppressMicrotaskExecutionScope::SuppressMicrotaskExecutionScope(
     Isolate* isolate, MicrotaskQueue* microtask_queue)
     : isolate_(reinterpret_cast<i::Isolate*>(isolate)),
-      microtask_queue_(nullptr) {
-  LWNODE_UNIMPLEMENT;
+      microtask_queue_(
+          microtask_queue
+              ? MicrotaskQueueWrap::fromV8(microtask_queue)
+              : IsolateWrap::fromV8(isolate)->defaultMicrotaskQueue()) {
+  MicrotaskQueueWrap::fromV8(microtask_queue_)->increaseSuppressions();
 }
 
-Isolate::SuppressMicrotaskExecutionScope::~SuppressMicrotaskExecutionScope() {}
+Isolate::SuppressMicrotaskExecutionScope::~SuppressMicrotaskExecutionScope() {
+  MicrotaskQueueWrap::fromV8(microtask_queue_)->decreaseSuppressions();
+}
 
 Isolate::SafeForTerminationScope::SafeForTerminationScope(v8::Isolate* isolate)
     : isolate_(reinterpret_cast<i::Isolate*>(isolate)), prev_value_(nullptr) {
@@ -2150,7 +2180,10 @@ i::Address* Isolate::GetDataFromSnapshotOnce(size_t index) {
 }
 
 void Isolate::GetHeapStatistics(HeapStatistics* heap_statistics) {
-  LWNODE_RETURN_VOID;
+  // Only the memory of ArrayBuffers is accounted for, as external memory.
+  auto lwIsolate = IsolateWrap::fromV8(this);
+  heap_statistics->external_memory_ =
+      lwIsolate->array_buffer_allocator_decorator()->currentMemorySize();
 }
 
 size_t Isolate::NumberOfHeapSpaces() {
@@ -2178,12 +2211,22 @@ bool Isolate::GetHeapCodeAndMetadataStatistics(
 
 v8::MaybeLocal<v8::Promise> Isolate::MeasureMemory(
     v8::Local<v8::Context> context, MeasureMemoryMode mode) {
-  LWNODE_RETURN_LOCAL(Promise);
+  Local<Promise::Resolver> resolver;
+  if (!Promise::Resolver::New(context).ToLocal(&resolver)) {
+    return MaybeLocal<Promise>();
+  }
+
+  MeasureMemory(MeasureMemoryDelegate::Default(this, context, resolver, mode),
+                MeasureMemoryExecution::kDefault);
+  return resolver->GetPromise();
 }
 
 bool Isolate::MeasureMemory(std::unique_ptr<MeasureMemoryDelegate> delegate,
                             MeasureMemoryExecution execution) {
-  LWNODE_RETURN_FALSE;
+  auto measurement = new MemoryMeasurementWrap(IsolateWrap::fromV8(this),
+                                               std::move(delegate));
+  measurement->start(execution);
+  return true;
 }
 
 std::unique_ptr<MeasureMemoryDelegate> MeasureMemoryDelegate::Default(
@@ -2191,7 +2234,8 @@ std::unique_ptr<MeasureMemoryDelegate> MeasureMemoryDelegate::Default(
     Local<Context> context,
     Local<Promise::Resolver> promise_resolver,
     MeasureMemoryMode mode) {
-  LWNODE_RETURN_NULLPTR;
+  return MemoryMeasurementWrap::createDefaultDelegate(
+      isolate, context, promise_resolver, mode);
 }
 
 void Isolate::GetStackSample(const RegisterState& state,
@@ -2247,40 +2291,54 @@ void Isolate::PerformMicrotaskCheckpoint() {
 }
 
 void Isolate::EnqueueMicrotask(Local<Function> v8_function) {
-  LWNODE_RETURN_VOID;
+  IsolateWrap::fromV8(this)->defaultMicrotaskQueue()->EnqueueMicrotask(
+      this, v8_function);
 }
 
 void Isolate::EnqueueMicrotask(MicrotaskCallback callback, void* data) {
-  LWNODE_RETURN_VOID;
+  IsolateWrap::fromV8(this)->defaultMicrotaskQueue()->EnqueueMicrotask(
+      this, callback, data);
 }
 
 void Isolate::SetMicrotasksPolicy(MicrotasksPolicy policy) {
-  LWNODE_CALL_TRACE();
+  IsolateWrap::fromV8(this)->defaultMicrotaskQueue()->setPolicy(policy);
 }
 
 MicrotasksPolicy Isolate::GetMicrotasksPolicy() const {
-  LWNODE_UNIMPLEMENT;
-  return MicrotasksPolicy();
+  auto lwIsolate = IsolateWrap::fromV8(const_cast<Isolate*>(this));
+  return lwIsolate->defaultMicrotaskQueue()->policy();
+}
+
+// A callback without data is registered with itself as the data.
+static void MicrotasksCompletedCallbackTrampoline(Isolate* isolate,
+                                                  void* data) {
+  reinterpret_cast<MicrotasksCompletedCallback>(data)(isolate);
 }
 
 void Isolate::AddMicrotasksCompletedCallback(
     MicrotasksCompletedCallback callback) {
-  LWNODE_RETURN_VOID;
+  AddMicrotasksCompletedCallback(MicrotasksCompletedCallbackTrampoline,
+                                 reinterpret_cast<void*>(callback));
 }
 
 void Isolate::AddMicrotasksCompletedCallback(
     MicrotasksCompletedCallbackWithData callback, void* data) {
-  LWNODE_RETURN_VOID;
+  IsolateWrap::fromV8(this)
+      ->defaultMicrotaskQueue()
+      ->AddMicrotasksCompletedCallback(callback, data);
 }
 
 void Isolate::RemoveMicrotasksCompletedCallback(
     MicrotasksCompletedCallback callback) {
-  LWNODE_RETURN_VOID;
+  RemoveMicrotasksCompletedCallback(MicrotasksCompletedCallbackTrampoline,
+                                    reinterpret_cast<void*>(callback));
 }
 
 void Isolate::RemoveMicrotasksCompletedCallback(
     MicrotasksCompletedCallbackWithData callback, void* data) {
-  LWNODE_RETURN_VOID;
+  IsolateWrap::fromV8(this)
+      ->defaultMicrotaskQueue()
+      ->RemoveMicrotasksCompletedCallback(callback, data);
 }
 
 void Isolate::SetUseCounterCallback(UseCounterCallback callback) {
@@ -2504,8 +2562,8 @@ void v8::Isolate::LocaleConfigurationChangeNotification() {
 // static
 std::unique_ptr<MicrotaskQueue> MicrotaskQueue::New(Isolate* isolate,
                                                     MicrotasksPolicy policy) {
-  LWNODE_UNIMPLEMENT;
-  return std::unique_ptr<MicrotaskQueue>();
+  return std::unique_ptr<MicrotaskQueue>(
+      new MicrotaskQueueWrap(IsolateWrap::fromV8(isolate), policy));
 }
 
 MicrotasksScope::MicrotasksScope(Isolate* isolate, MicrotasksScope::Type type)
@@ -2514,36 +2572,43 @@ MicrotasksScope::MicrotasksScope(Isolate* isolate, MicrotasksScope::Type type)
 MicrotasksScope::MicrotasksScope(Isolate* isolate,
                                  MicrotaskQueue* microtask_queue,
                                  MicrotasksScope::Type type)
-    : isolate_(nullptr), microtask_queue_(nullptr), run_(false) {
-  LWNODE_UNIMPLEMENT;
+    : isolate_(reinterpret_cast<i::Isolate*>(isolate)),
+      microtask_queue_(
+          microtask_queue
+              ? MicrotaskQueueWrap::fromV8(microtask_queue)
+              : IsolateWrap::fromV8(isolate)->defaultMicrotaskQueue()),
+      run_(type == MicrotasksScope::kRunMicrotasks) {
+  if (run_) {
+    MicrotaskQueueWrap::fromV8(microtask_queue_)->increaseScopeDepth();
+  }
 }
 
 MicrotasksScope::~MicrotasksScope() {
-  LWNODE_UNIMPLEMENT;
+  if (run_) {
+    auto queue = MicrotaskQueueWrap::fromV8(microtask_queue_);
+    if (queue->decreaseScopeDepth() == 0 &&
+        queue->policy() == MicrotasksPolicy::kScoped) {
+      queue->PerformCheckpoint(IsolateWrap::toV8(isolate_));
+    }
+  }
 }
 
 void MicrotasksScope::PerformCheckpoint(Isolate* v8_isolate) {
-  auto lwIsolate = IsolateWrap::fromV8(v8_isolate);
-  auto vmInstance = lwIsolate->vmInstance();
-
-  GCHeap::ProcessingHoldScope scope;
-
-  while (vmInstance->hasPendingJob()) {
-    auto r = vmInstance->executePendingJob();
-    if (!r.isSuccessful()) {
-      __DLOG_EVAL_EXCEPTION(r);
-      lwIsolate->SetTerminationOnExternalTryCatch();
-      return;
-    }
-  }
+  IsolateWrap::fromV8(v8_isolate)
+      ->defaultMicrotaskQueue()
+      ->PerformCheckpoint(v8_isolate);
 }
 
 int MicrotasksScope::GetCurrentDepth(Isolate* v8_isolate) {
-  LWNODE_RETURN_0;
+  return IsolateWrap::fromV8(v8_isolate)
+      ->defaultMicrotaskQueue()
+      ->GetMicrotasksScopeDepth();
 }
 
 bool MicrotasksScope::IsRunningMicrotasks(Isolate* v8_isolate) {
-  LWNODE_RETURN_FALSE;
+  return IsolateWrap::fromV8(v8_isolate)
+      ->defaultMicrotaskQueue()
+      ->IsRunningMicrotasks();
 }
 
 String::Utf8Value::Utf8Value(v8::Isolate* isolate, v8::Local<v8::Value> obj)
@@ -2655,7 +2720,7 @@ Local<Message> Exception::CreateMessage(Isolate* isolate,
 
   if (esException->isObject()) {
     auto esExtraData = ObjectRefHelper::getExtraData(esException->asObject());
-    if (esExtraData) {
+    if (esExtraData && esExtraData->isExceptionObjectData()) {
       auto esExceptionData = esExtraData->asExceptionObjectData();
       ExtraDataHelper::setExtraData(r.result->asObject(), esExceptionData);
     } else {
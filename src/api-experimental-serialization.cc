@@ -32,7 +32,12 @@ Maybe<bool> ValueSerializer::Delegate::WriteHostObject(Isolate* v8_isolate,
 
 Maybe<uint32_t> ValueSerializer::Delegate::GetSharedArrayBufferId(
     Isolate* v8_isolate, Local<SharedArrayBuffer> shared_array_buffer) {
-  LWNODE_RETURN_MAYBE(uint32_t);
+  // A SharedArrayBuffer can be shared only by an embedder that passes its
+  // backing store to the receiver.
+  ThrowDataCloneError(Utils::NewLocal<String>(
+      v8_isolate,
+      ErrorMessage::createErrorStringRef(ErrorMessageType::kDataCloneError)));
+  return Nothing<uint32_t>();
 }
 
 Maybe<uint32_t> ValueSerializer::Delegate::GetWasmModuleTransferId(
@@ -73,12 +78,17 @@ void ValueSerializer::WriteHeader() {
   private_->serializer.WriteHeader();
 }
 
-void ValueSerializer::SetTreatArrayBufferViewsAsHostObjects(bool mode) {}
+void ValueSerializer::SetTreatArrayBufferViewsAsHostObjects(bool mode) {
+  private_->serializer.SetTreatArrayBufferViewsAsHostObjects(mode);
+}
 
 Maybe<bool> ValueSerializer::WriteValue(Local<Context> context,
                                         Local<Value> value) {
-  bool result = private_->serializer.WriteValue(CVAL(*value)->value());
-  return Just(result);
+  // An exception has been thrown unless the value is written.
+  if (!private_->serializer.WriteValue(CVAL(*value)->value())) {
+    return Nothing<bool>();
+  }
+  return Just(true);
 }
 
 std::pair<uint8_t*, size_t> ValueSerializer::Release() {
@@ -88,23 +98,24 @@ std::pair<uint8_t*, size_t> ValueSerializer::Release() {
 
 void ValueSerializer::TransferArrayBuffer(uint32_t transfer_id,
                                           Local<ArrayBuffer> array_buffer) {
-  LWNODE_RETURN_VOID;
+  private_->serializer.TransferArrayBuffer(
+      transfer_id, CVAL(*array_buffer)->value()->asArrayBufferObject());
 }
 
 void ValueSerializer::WriteUint32(uint32_t value) {
-  private_->serializer.WriteUint32(value);
+  private_->serializer.WriteRawUint32(value);
 }
 
 void ValueSerializer::WriteUint64(uint64_t value) {
-  LWNODE_RETURN_VOID;
+  private_->serializer.WriteRawUint64(value);
 }
 
 void ValueSerializer::WriteDouble(double value) {
-  LWNODE_RETURN_VOID;
+  private_->serializer.WriteRawDouble(value);
 }
 
 void ValueSerializer::WriteRawBytes(const void* source, size_t length) {
-  LWNODE_RETURN_VOID;
+  private_->serializer.WriteRawBytes(source, length);
 }
 
 MaybeLocal<Object> ValueDeserializer::Delegate::ReadHostObject(
@@ -148,6 +159,13 @@ ValueDeserializer::~ValueDeserializer() {
 }
 
 Maybe<bool> ValueDeserializer::ReadHeader(Local<Context> context) {
+  API_ENTER_WITH_CONTEXT(context, Nothing<bool>());
+  if (!private_->deserializer.ReadHeader()) {
+    auto esContext = lwIsolate->GetCurrentContext()->get();
+    lwIsolate->ScheduleThrow(ExceptionHelper::createErrorObject(
+        esContext, ErrorMessageType::kDataCloneDeserializationVersionError));
+    return Nothing<bool>();
+  }
   return Just(true);
 }
 
@@ -157,7 +175,7 @@ void ValueDeserializer::SetSupportsLegacyWireFormat(
 }
 
 uint32_t ValueDeserializer::GetWireFormatVersion() const {
-  LWNODE_RETURN_0;
+  return private_->deserializer.version();
 }
 
 MaybeLocal<Value> ValueDeserializer::ReadValue(Local<Context> context) {
@@ -166,17 +184,17 @@ MaybeLocal<Value> ValueDeserializer::ReadValue(Local<Context> context) {
   auto output = private_->deserializer.ReadValue();
   if (!output.hasValue()) {
     LWNODE_CALL_TRACE_ID(SERIALIZER, "Cannot read value");
-    return Utils::NewLocal<Uint32>(
-        lwIsolate->toV8(),
-        ExceptionHelper::createErrorObject(esContext,
-                                           ErrorMessageType::kNotReadValue));
+    lwIsolate->ScheduleThrow(ExceptionHelper::createErrorObject(
+        esContext, ErrorMessageType::kDataCloneDeserializationError));
+    return MaybeLocal<Value>();
   }
-  return Utils::NewLocal<Uint32>(lwIsolate->toV8(), output.get());
+  return Utils::NewLocal<Value>(lwIsolate->toV8(), output.get());
 }
 
 void ValueDeserializer::TransferArrayBuffer(uint32_t transfer_id,
                                             Local<ArrayBuffer> array_buffer) {
-  LWNODE_RETURN_VOID;
+  private_->deserializer.TransferArrayBuffer(
+      transfer_id, CVAL(*array_buffer)->value()->asArrayBufferObject());
 }
 
 void ValueDeserializer::TransferSharedArrayBuffer(
@@ -185,19 +203,24 @@ void ValueDeserializer::TransferSharedArrayBuffer(
 }
 
 bool ValueDeserializer::ReadUint32(uint32_t* value) {
-  return private_->deserializer.ReadUint32(value);
+  return private_->deserializer.ReadRawUint32(value);
 }
 
 bool ValueDeserializer::ReadUint64(uint64_t* value) {
-  LWNODE_RETURN_FALSE;
+  return private_->deserializer.ReadRawUint64(value);
 }
 
 bool ValueDeserializer::ReadDouble(double* value) {
-  LWNODE_RETURN_FALSE;
+  return private_->deserializer.ReadRawDouble(value);
 }
 
 bool ValueDeserializer::ReadRawBytes(size_t length, const void** data) {
-  LWNODE_RETURN_FALSE;
+  const uint8_t* bytes = nullptr;
+  if (!private_->deserializer.ReadRawBytes(length, bytes)) {
+    return false;
+  }
+  *data = bytes;
+  return true;
 }
 }  // namespace v8
 
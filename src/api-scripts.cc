@@ -15,6 +15,8 @@
  */
 
 #include "api.h"
+#include "api/cpu-profiler.h"
+#include "api/microtask-queue.h"
 #include "base.h"
 
 using namespace Escargot;
@@ -123,6 +125,7 @@ MaybeLocal<Value> Script::Run(Local<Context> context) {
     return MaybeLocal<Value>();
   }
 
+  ScriptEntryScope scriptEntryScope(lwIsolate);
   auto r = Evaluator::execute(
       esScript->context(),
       [](ExecutionStateRef* state, ScriptRef* script) -> ValueRef* {
@@ -132,6 +135,10 @@ MaybeLocal<Value> Script::Run(Local<Context> context) {
 
   API_HANDLE_EXCEPTION(r, lwIsolate, MaybeLocal<Value>());
 
+  if (!lwIsolate->hasCallDepth()) {
+    lwContext->microtaskQueue()->onCallCompleted();
+  }
+
   return Utils::NewLocal<Value>(lwIsolate->toV8(), r.result);
 }
 
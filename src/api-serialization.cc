@@ -52,13 +52,20 @@ void ValueSerializer::Delegate::FreeBufferMemory(void* buffer) {
 }
 
 struct ValueSerializer::PrivateData {
-  explicit PrivateData(ValueSerializer::Delegate* delegate)
-      : delegate(delegate) {}
+  PrivateData(IsolateWrap* isolate, ValueSerializer::Delegate* delegate)
+      : isolate(isolate), delegate(delegate) {}
 
-  ~PrivateData() {}
+  ~PrivateData() {
+    for (auto backingStore : transferredBackingStores) {
+      isolate->endBackingStoreTransfer(backingStore);
+    }
+  }
 
+  IsolateWrap* isolate = nullptr;
   ValueSerializer::Delegate* delegate = nullptr;
   std::ostringstream stream;
+  // @note held by the isolate until the transfer ends
+  std::vector<BackingStoreRef*> transferredBackingStores;
 };
 
 ValueSerializer::ValueSerializer(Isolate* isolate)
@@ -67,7 +74,7 @@ ValueSerializer::ValueSerializer(Isolate* isolate)
 }
 
 ValueSerializer::ValueSerializer(Isolate* isolate, Delegate* delegate)
-    : private_(new PrivateData(delegate)) {}
+    : private_(new PrivateData(IsolateWrap::fromV8(isolate), delegate)) {}
 
 ValueSerializer::~ValueSerializer() {
   delete private_;
@@ -119,7 +126,14 @@ std::pair<uint8_t*, size_t> ValueSerializer::Release() {
 
 void ValueSerializer::TransferArrayBuffer(uint32_t transfer_id,
                                           Local<ArrayBuffer> array_buffer) {
-  LWNODE_RETURN_VOID;
+  // The contents are still copied, but the embedder hands the backing store
+  // over to the receiver after detaching the buffer.
+  auto esArrayBuffer = CVAL(*array_buffer)->value()->asArrayBufferObject();
+  if (esArrayBuffer->backingStore().hasValue()) {
+    auto backingStore = esArrayBuffer->backingStore().value();
+    private_->isolate->beginBackingStoreTransfer(backingStore);
+    private_->transferredBackingStores.push_back(backingStore);
+  }
 }
 
 void ValueSerializer::WriteUint32(uint32_t value) {
@@ -15,6 +15,8 @@
  */
 
 #include "api.h"
+#include "api/cpu-profiler.h"
+#include "api/heap-profiler.h"
 #include "base.h"
 
 using namespace Escargot;
@@ -186,6 +188,14 @@ static ValueRef* runNativeFunctionCallback(ExecutionStateRef* state,
     return nullptr;
   }
 
+  // A native callback is a safe point where pending profiler ticks and
+  // allocation samples can be resolved into the current JS stack.
+  CpuProfilerWrap::onSafePoint(state,
+                               CpuProfilerWrap::SafePoint::CallbackEntry);
+  if (SamplingHeapProfilerWrap::isSampling()) {
+    SamplingHeapProfilerWrap::sample(state);
+  }
+
   Local<Value> result;
   if (functionData->callback()) {
     LWNODE_CALL_TRACE_ID(TEMPLATE, "> Call JS callback");
@@ -197,7 +207,12 @@ static ValueRef* runNativeFunctionCallback(ExecutionStateRef* state,
                                   VAL(functionData->callbackData()),
                                   argc,
                                   argv);
-    functionData->callback()(info);
+    {
+      CallbackStateScope callbackStateScope(lwIsolate, state);
+      functionData->callback()(info);
+    }
+    CpuProfilerWrap::onSafePoint(state,
+                                 CpuProfilerWrap::SafePoint::CallbackExit);
     lwIsolate->decreaseCallDepth();
 
     lwIsolate->ThrowErrorIfHasException(state);
@@ -400,9 +415,18 @@ void FunctionTemplate::RemovePrototype() {
 MaybeLocal<v8::Function> FunctionTemplate::GetFunction(Local<Context> context) {
   API_ENTER_AND_EXIT_IF_TERMINATING(
       EsScopeFunctionTemplate, context, MaybeLocal<Function>());
-  auto esFunction = scope.self()->instantiate(scope.context());
-  auto functionTemplateData =
+  // Like V8, a template is instantiated once per context.
+  auto lwContext = scope.lwContext();
+  auto templateData =
       ExtraDataHelper::getFunctionTemplateExtraData(scope.self());
+  bool isCacheable = !templateData || !templateData->doNotCache();
+  if (isCacheable) {
+    if (auto esFunction = lwContext->getCachedFunction(scope.self())) {
+      return Utils::NewLocal<Function>(scope.v8Isolate(), esFunction);
+    }
+  }
+
+  auto esFunction = scope.self()->instantiate(scope.context());
 
   LWNODE_CALL_TRACE_ID_LOG(EXTRADATA,
                            "FunctionTemplate(%p)::GetFunction(%p)",
@@ -440,6 +464,9 @@ MaybeLocal<v8::Function> FunctionTemplate::GetFunction(Local<Context> context) {
     LWNODE_CHECK(false);
   }
 
+  if (isCacheable) {
+    lwContext->cacheFunction(scope.self(), esFunction);
+  }
   return Utils::NewLocal<Function>(scope.v8Isolate(), esFunction);
 }
 
@@ -468,7 +495,7 @@ bool FunctionTemplate::HasInstance(v8::Local<v8::Value> value) {
 
   auto esObject = esValue->asObject();
   auto extraData = ExtraDataHelper::getExtraData(esObject);
-  if (!extraData) {
+  if (!extraData || extraData->isPrivateValuesData()) {
     return false;
   }
 
@@ -608,6 +635,13 @@ class NamePropertyPolicy {
                                      ValueRef* value) {
     return Utils::ToLocal<Name>(value);
   }
+
+  // Keys filtered out here are looked up as if there were no handler.
+  static bool isIntercepted(PropertyHandlerFlags flags, ValueRef* value) {
+    return !value->isSymbol() ||
+           !(static_cast<int>(flags) &
+             static_cast<int>(PropertyHandlerFlags::kOnlyInterceptStrings));
+  }
 };
 
 class IndexPropertyPolicy {
@@ -617,6 +651,10 @@ class IndexPropertyPolicy {
     LWNODE_DCHECK(index != ValueRef::InvalidIndexPropertyValue);
     return index;
   }
+
+  static bool isIntercepted(PropertyHandlerFlags flags, ValueRef* value) {
+    return true;
+  }
 };
 
 template <typename T>
@@ -649,17 +687,29 @@ class ObjectTemplateSetHandlerCallbackHelper {
     return reinterpret_cast<ObjectTemplateLocalData<T>*>(data);
   }
 
+  // Keys filtered out skip the embedder callback and the handles made for it.
+  static bool isIntercepted(ObjectTemplateLocalData<T>* helperData,
+                            ValueRef* propertyName) {
+    return GetPropertyNamePolicy::isIntercepted(helperData->config.flags,
+                                                propertyName);
+  }
+
   static OptionalRef<ValueRef> getterCallback(ExecutionStateRef* state,
                                               ObjectRef* esSelf,
                                               ValueRef* esReceiver,
                                               void* data,
                                               ValueRef* propertyName) {
     auto helperData = getHelperData(data);
+    if (!isIntercepted(helperData, propertyName)) {
+      return OptionalRef<ValueRef>();
+    }
 
     PropertyCallbackInfoWrap<v8::Value> info(
         helperData->isolate, esSelf, esReceiver, VAL(*helperData->config.data));
 
     LWNODE_DCHECK_NOT_NULL(helperData->config.getter);
+    CallbackStateScope callbackStateScope(
+        IsolateWrap::fromV8(helperData->isolate), state);
     helperData->config.getter(
         GetPropertyNamePolicy::getPropertyName(state, propertyName), info);
 
@@ -677,11 +727,16 @@ class ObjectTemplateSetHandlerCallbackHelper {
                                               ValueRef* propertyName,
                                               ValueRef* esValue) {
     auto helperData = getHelperData(data);
+    if (!isIntercepted(helperData, propertyName)) {
+      return OptionalRef<ValueRef>();
+    }
 
     PropertyCallbackInfoWrap<v8::Value> info(
         helperData->isolate, esSelf, esReceiver, VAL(*helperData->config.data));
 
     LWNODE_DCHECK_NOT_NULL(helperData->config.setter);
+    CallbackStateScope callbackStateScope(
+        IsolateWrap::fromV8(helperData->isolate), state);
     helperData->config.setter(
         GetPropertyNamePolicy::getPropertyName(state, propertyName),
         v8::Utils::ToLocal<Value>(esValue),
@@ -703,11 +758,16 @@ class ObjectTemplateSetHandlerCallbackHelper {
                                                        void* data,
                                                        ValueRef* propertyName) {
     auto helperData = getHelperData(data);
+    if (!isIntercepted(helperData, propertyName)) {
+      return ObjectTemplatePropertyAttribute::PropertyAttributeNotExist;
+    }
 
     PropertyCallbackInfoWrap<v8::Integer> info(
         helperData->isolate, esSelf, esReceiver, VAL(*helperData->config.data));
 
     LWNODE_DCHECK_NOT_NULL(helperData->config.query);
+    CallbackStateScope callbackStateScope(
+        IsolateWrap::fromV8(helperData->isolate), state);
     helperData->config.query(
         GetPropertyNamePolicy::getPropertyName(state, propertyName), info);
 
@@ -736,11 +796,16 @@ class ObjectTemplateSetHandlerCallbackHelper {
                                                void* data,
                                                ValueRef* propertyName) {
     auto helperData = getHelperData(data);
+    if (!isIntercepted(helperData, propertyName)) {
+      return OptionalRef<ValueRef>();
+    }
 
     PropertyCallbackInfoWrap<v8::Boolean> info(
         helperData->isolate, esSelf, esReceiver, VAL(*helperData->config.data));
 
     LWNODE_DCHECK_NOT_NULL(helperData->config.deleter);
+    CallbackStateScope callbackStateScope(
+        IsolateWrap::fromV8(helperData->isolate), state);
     helperData->config.deleter(
         GetPropertyNamePolicy::getPropertyName(state, propertyName), info);
 
@@ -761,6 +826,8 @@ class ObjectTemplateSetHandlerCallbackHelper {
         helperData->isolate, esSelf, esReceiver, VAL(*helperData->config.data));
 
     LWNODE_DCHECK_NOT_NULL(helperData->config.enumerator);
+    CallbackStateScope callbackStateScope(
+        IsolateWrap::fromV8(helperData->isolate), state);
     helperData->config.enumerator(info);
 
     if (info.hasReturnValue()) {
@@ -787,6 +854,9 @@ class ObjectTemplateSetHandlerCallbackHelper {
       ValueRef* propertyName,
       const ObjectPropertyDescriptorRef& esDescriptor) {
     auto helperData = getHelperData(data);
+    if (!isIntercepted(helperData, propertyName)) {
+      return OptionalRef<ValueRef>();
+    }
 
     PropertyCallbackInfoWrap<v8::Value> info(
         helperData->isolate, esSelf, esReceiver, VAL(*helperData->config.data));
@@ -796,6 +866,8 @@ class ObjectTemplateSetHandlerCallbackHelper {
         const_cast<ObjectPropertyDescriptorRef*>(&esDescriptor));
 
     LWNODE_DCHECK_NOT_NULL(helperData->config.definer);
+    CallbackStateScope callbackStateScope(
+        IsolateWrap::fromV8(helperData->isolate), state);
     helperData->config.definer(
         GetPropertyNamePolicy::getPropertyName(state, propertyName),
         descriptor,
@@ -813,11 +885,16 @@ class ObjectTemplateSetHandlerCallbackHelper {
                                                   void* data,
                                                   ValueRef* propertyName) {
     auto helperData = getHelperData(data);
+    if (!isIntercepted(helperData, propertyName)) {
+      return OptionalRef<ValueRef>();
+    }
 
     PropertyCallbackInfoWrap<v8::Value> info(
         helperData->isolate, esSelf, esReceiver, VAL(*helperData->config.data));
 
     LWNODE_DCHECK_NOT_NULL(helperData->config.descriptor);
+    CallbackStateScope callbackStateScope(
+        IsolateWrap::fromV8(helperData->isolate), state);
     helperData->config.descriptor(
         GetPropertyNamePolicy::getPropertyName(state, propertyName), info);
 
@@ -843,6 +920,8 @@ void ObjectTemplate::SetHandler(
       NamePropertyPolicy>::applyHelper(config, esConfig);
 
   scope.self()->setNamedPropertyHandler(esConfig);
+  ExtraDataHelper::getObjectTemplateExtraData(scope.self())
+      ->setHasPropertyHandler();
 }
 
 void ObjectTemplate::MarkAsUndetectable() {
@@ -876,6 +955,8 @@ void ObjectTemplate::SetHandler(
       IndexPropertyPolicy>::applyHelper(config, esConfig);
 
   scope.self()->setIndexedPropertyHandler(esConfig);
+  ExtraDataHelper::getObjectTemplateExtraData(scope.self())
+      ->setHasPropertyHandler();
 }
 
 void ObjectTemplate::SetCallAsFunctionHandler(FunctionCallback callback,
@@ -15,70 +15,135 @@
  */
 
 #include "arraybuffer-allocator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "arraybuffer-pool.h"
 #include "utils/misc.h"
 
 namespace EscargotShim {
 
+ArrayBufferAllocatorDecorator::ArrayBufferAllocatorDecorator() {
+  if (ArrayBufferPool::isEnabled()) {
+    pool_ = ArrayBufferPool::getInstance();
+  }
+}
+
 void ArrayBufferAllocatorDecorator::set_array_buffer_allocator(
     v8::ArrayBuffer::Allocator* allocate) {
   array_buffer_allocator_ = allocate;
 }
 
-void* ArrayBufferAllocatorDecorator::Allocate(size_t length) {
-  LWNODE_CHECK_NOT_NULL(array_buffer_allocator_);
-  currentMemorySize_ += length;
-  if (currentMemorySize_ > peakMemorySize_) {
-    peakMemorySize_ = currentMemorySize_;
-  }
+void ArrayBufferAllocatorDecorator::set_array_buffer_allocator_shared(
+    std::shared_ptr<v8::ArrayBuffer::Allocator> allocator) {
+  array_buffer_allocator_shared_ = std::move(allocator);
+}
 
-  LWNODE_DLOG_INFO(
-      "malc: ab=%zuB | peak=%zuB", currentMemorySize_, peakMemorySize_);
+bool ArrayBufferAllocatorDecorator::isPooled(size_t length) const {
+  return pool_ != nullptr && ArrayBufferPool::canHold(length);
+}
 
-  return array_buffer_allocator_->Allocate(length);
+void* ArrayBufferAllocatorDecorator::allocateData(size_t length,
+                                                  bool zeroFill) {
+  if (isPooled(length)) {
+    return pool_->allocate(length, zeroFill);
+  }
+  return zeroFill ? array_buffer_allocator()->Allocate(length)
+                  : array_buffer_allocator()->AllocateUninitialized(length);
 }
 
-void* ArrayBufferAllocatorDecorator::AllocateUninitialized(size_t length) {
-  LWNODE_CHECK_NOT_NULL(array_buffer_allocator_);
-  currentMemorySize_ += length;
-  if (currentMemorySize_ > peakMemorySize_) {
-    peakMemorySize_ = currentMemorySize_;
+void ArrayBufferAllocatorDecorator::freeData(void* data, size_t length) {
+  if (isPooled(length)) {
+    pool_->free(data);
+  } else {
+    array_buffer_allocator()->Free(data, length);
   }
+}
 
-  LWNODE_DLOG_INFO(
-      "malc: ab=%zuB | peak=%zuB", currentMemorySize_, peakMemorySize_);
+void ArrayBufferAllocatorDecorator::increaseMemorySize(size_t length) {
+  size_t current =
+      currentMemorySize_.fetch_add(length, std::memory_order_relaxed) + length;
+  size_t peak = peakMemorySize_.load(std::memory_order_relaxed);
+  while (current > peak &&
+         !peakMemorySize_.compare_exchange_weak(
+             peak, current, std::memory_order_relaxed)) {
+  }
 
-  return array_buffer_allocator_->AllocateUninitialized(length);
+  LWNODE_CALL_TRACE_ID_LOG(
+      ARRAYBUFFER, "malc: ab=%zuB | peak=%zuB", current, peakMemorySize());
+}
+
+void ArrayBufferAllocatorDecorator::decreaseMemorySize(size_t length) {
+  currentMemorySize_.fetch_sub(length, std::memory_order_relaxed);
+
+  LWNODE_CALL_TRACE_ID_LOG(ARRAYBUFFER,
+                           "free: ab=%zuB | peak=%zuB",
+                           currentMemorySize(),
+                           peakMemorySize());
+}
+
+void* ArrayBufferAllocatorDecorator::Allocate(size_t length) {
+  LWNODE_CHECK_NOT_NULL(array_buffer_allocator());
+  void* data = allocateData(length, true);
+  if (LWNODE_LIKELY(data != nullptr)) {
+    increaseMemorySize(length);
+  }
+  return data;
+}
+
+void* ArrayBufferAllocatorDecorator::AllocateUninitialized(size_t length) {
+  LWNODE_CHECK_NOT_NULL(array_buffer_allocator());
+  void* data = allocateData(length, false);
+  if (LWNODE_LIKELY(data != nullptr)) {
+    increaseMemorySize(length);
+  }
+  return data;
 }
 
 void* ArrayBufferAllocatorDecorator::Reallocate(void* data,
                                                 size_t old_length,
                                                 size_t new_length) {
-  LWNODE_CHECK_NOT_NULL(array_buffer_allocator_);
-  currentMemorySize_ -= old_length;
-  currentMemorySize_ += new_length;
-  if (currentMemorySize_ > peakMemorySize_) {
-    peakMemorySize_ = currentMemorySize_;
+  LWNODE_CHECK_NOT_NULL(array_buffer_allocator());
+  void* newData = nullptr;
+  if (!isPooled(old_length) && !isPooled(new_length)) {
+    newData =
+        array_buffer_allocator()->Reallocate(data, old_length, new_length);
+  } else if (isPooled(old_length) &&
+             pool_->canResizeInPlace(old_length, new_length)) {
+    newData = data;
+    if (new_length > old_length) {
+      memset(static_cast<char*>(data) + old_length, 0, new_length - old_length);
+    }
+  } else {
+    // The data moves to another size class, or to or from the allocator.
+    newData = allocateData(new_length, true);
+    if (newData != nullptr || new_length == 0) {
+      if (newData != nullptr) {
+        memcpy(newData, data, std::min(old_length, new_length));
+      }
+      freeData(data, old_length);
+    }
   }
-
-  LWNODE_DLOG_INFO(
-      "malc: ab=%zuB | peak=%zuB", currentMemorySize_, peakMemorySize_);
-
-  return array_buffer_allocator_->Reallocate(data, old_length, new_length);
+  if (LWNODE_LIKELY(newData != nullptr) || new_length == 0) {
+    if (new_length > old_length) {
+      increaseMemorySize(new_length - old_length);
+    } else {
+      decreaseMemorySize(old_length - new_length);
+    }
+  }
+  return newData;
 }
 
 void ArrayBufferAllocatorDecorator::Free(void* data, size_t length) {
-  LWNODE_CHECK_NOT_NULL(array_buffer_allocator_);
-  currentMemorySize_ -= length;
-
-  LWNODE_DLOG_INFO(
-      "free: ab=%zuB | peak=%zuB", currentMemorySize_, peakMemorySize_);
-
-  return array_buffer_allocator_->Free(data, length);
+  LWNODE_CHECK_NOT_NULL(array_buffer_allocator());
+  decreaseMemorySize(length);
+  freeData(data, length);
 }
 
 void ArrayBufferAllocatorDecorator::printState() {
   LWNODE_DLOG_INFO(
-      "stat: ab=%zuB | peak: %zuB", currentMemorySize_, peakMemorySize_);
+      "stat: ab=%zuB | peak: %zuB", currentMemorySize(), peakMemorySize());
 }
 
 }  // namespace EscargotShim
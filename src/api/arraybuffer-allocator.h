@@ -17,28 +17,68 @@
 #pragma once
 
 #include <v8.h>
-#include "utils/gc-util.h"
+#include <atomic>
+#include <memory>
 
 namespace EscargotShim {
 
-class ArrayBufferAllocatorDecorator : public v8::ArrayBuffer::Allocator,
-                                      public gc {
+class ArrayBufferPool;
+
+// Counts the bytes of ArrayBuffers allocated through an allocator. The
+// counters are updated from any thread allocating ArrayBuffers, e.g. workers
+// and the threadpool. With --arraybuffer-pool, the data of small buffers
+// comes from ArrayBufferPool instead of the allocator.
+//
+// Each isolate has its own decorator. Data it allocated may be freed after the
+// isolate is disposed, so the decorator is reference counted: the isolate
+// holds one reference and each live allocation holds another. The allocator
+// of the embedder is used until the last one is freed. If it was given as a
+// shared_ptr, the decorator keeps it alive until then.
+class ArrayBufferAllocatorDecorator : public v8::ArrayBuffer::Allocator {
  public:
+  ArrayBufferAllocatorDecorator();
+
   void* Allocate(size_t length) override;
   void* AllocateUninitialized(size_t length) override;
   void* Reallocate(void* data, size_t old_length, size_t new_length) override;
   void Free(void* data, size_t length) override;
 
   void set_array_buffer_allocator(v8::ArrayBuffer::Allocator* allocate);
+  void set_array_buffer_allocator_shared(
+      std::shared_ptr<v8::ArrayBuffer::Allocator> allocator);
   v8::ArrayBuffer::Allocator* array_buffer_allocator() {
     return array_buffer_allocator_;
   }
+
+  void ref() { refCount_.fetch_add(1, std::memory_order_relaxed); }
+  void deref() {
+    if (refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  size_t currentMemorySize() const {
+    return currentMemorySize_.load(std::memory_order_relaxed);
+  }
+  size_t peakMemorySize() const {
+    return peakMemorySize_.load(std::memory_order_relaxed);
+  }
   void printState();
 
  private:
-  size_t currentMemorySize_ = 0;
-  size_t peakMemorySize_ = 0;
+  bool isPooled(size_t length) const;
+  void* allocateData(size_t length, bool zeroFill);
+  void freeData(void* data, size_t length);
+
+  void increaseMemorySize(size_t length);
+  void decreaseMemorySize(size_t length);
+
+  std::atomic<size_t> currentMemorySize_{0};
+  std::atomic<size_t> peakMemorySize_{0};
+  std::atomic<size_t> refCount_{1};
   v8::ArrayBuffer::Allocator* array_buffer_allocator_ = nullptr;
+  std::shared_ptr<v8::ArrayBuffer::Allocator> array_buffer_allocator_shared_;
+  ArrayBufferPool* pool_ = nullptr;
 };
 
 }  // namespace EscargotShim
@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arraybuffer-pool.h"
+
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+#include "global.h"
+#include "utils/misc.h"
+
+namespace EscargotShim {
+
+namespace {
+
+constexpr size_t kSlabSize = 1024 * 1024;
+// The first page of a slab holds its header, which keeps blocks page-aligned.
+constexpr size_t kSlabHeaderSize = 4 * 1024;
+constexpr size_t kMinBlockSize = 4 * 1024;
+constexpr size_t kMaxBlocksPerSlab =
+    (kSlabSize - kSlabHeaderSize) / kMinBlockSize;
+// Bytes a thread may keep cached per size class
+constexpr size_t kCacheBytes = 128 * 1024;
+constexpr size_t kMaxCachedBlocks = kCacheBytes / kMinBlockSize;
+// Empty slabs kept per size class until the next trim
+constexpr size_t kMaxEmptySlabs = 2;
+
+}  // namespace
+
+struct ArrayBufferPool::Slab {
+  Slab* prev = nullptr;
+  Slab* next = nullptr;
+  // Freed blocks, linked through their first word
+  void* freeList = nullptr;
+  size_t sizeClass = 0;
+  uint32_t capacity = 0;
+  // Blocks handed out, including the ones held in thread caches
+  uint32_t used = 0;
+  // Blocks carved so far; the pages of the others were never touched
+  uint32_t carved = 0;
+  bool isLinked = false;
+  // See setOwner()
+  void* owners[kMaxBlocksPerSlab] = {};
+};
+
+struct ArrayBufferPool::SizeClass {
+  std::mutex mutex;
+  // Slabs with a freed or an uncarved block
+  Slab* slabs = nullptr;
+  size_t emptySlabs = 0;
+};
+
+struct ArrayBufferPool::ThreadCache {
+  ~ThreadCache() {
+    if (pool) {
+      pool->flushCache(this);
+    }
+  }
+
+  ArrayBufferPool* pool = nullptr;
+  uint32_t epoch = 0;
+  size_t counts[kNumClasses] = {};
+  void* blocks[kNumClasses][kMaxCachedBlocks];
+};
+
+thread_local ArrayBufferPool::ThreadCache ArrayBufferPool::s_threadCache;
+
+bool ArrayBufferPool::isEnabled() {
+  static bool s_isEnabled =
+      Global::flags()->isOn(Flag::Type::ArrayBufferPool);
+  return s_isEnabled;
+}
+
+ArrayBufferPool* ArrayBufferPool::getInstance() {
+  // @note never deleted; thread caches are flushed as late as thread exit.
+  static ArrayBufferPool* s_instance = new ArrayBufferPool();
+  return s_instance;
+}
+
+ArrayBufferPool::ArrayBufferPool() : classes_(new SizeClass[kNumClasses]) {}
+
+size_t ArrayBufferPool::classOf(size_t length) {
+  LWNODE_DCHECK(canHold(length));
+  size_t sizeClass = 0;
+  while (blockSize(sizeClass) < length) {
+    sizeClass++;
+  }
+  return sizeClass;
+}
+
+size_t ArrayBufferPool::blockSize(size_t sizeClass) {
+  return kMinBlockSize << sizeClass;
+}
+
+size_t ArrayBufferPool::cacheCapacity(size_t sizeClass) {
+  return std::max<size_t>(2, kCacheBytes / blockSize(sizeClass));
+}
+
+ArrayBufferPool::Slab* ArrayBufferPool::slabOf(void* block) {
+  return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(block) &
+                                 ~(kSlabSize - 1));
+}
+
+static size_t blockIndexOf(void* block, size_t blockSize) {
+  uintptr_t offset = (reinterpret_cast<uintptr_t>(block) & (kSlabSize - 1)) -
+                     kSlabHeaderSize;
+  return offset / blockSize;
+}
+
+void ArrayBufferPool::setOwner(void* block, void* owner) {
+  Slab* slab = slabOf(block);
+  slab->owners[blockIndexOf(block, blockSize(slab->sizeClass))] = owner;
+}
+
+void* ArrayBufferPool::ownerOf(void* block) {
+  Slab* slab = slabOf(block);
+  return slab->owners[blockIndexOf(block, blockSize(slab->sizeClass))];
+}
+
+void* ArrayBufferPool::allocate(size_t length, bool zeroFill) {
+  size_t sizeClass = classOf(length);
+  ThreadCache* cache = &s_threadCache;
+  syncCache(cache);
+
+  void* block = nullptr;
+  bool isFresh = false;
+  if (cache->counts[sizeClass] > 0) {
+    block = cache->blocks[sizeClass][--cache->counts[sizeClass]];
+    cacheHits_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    block = allocateFromSlabs(sizeClass, cache, &isFresh);
+    if (LWNODE_UNLIKELY(block == nullptr)) {
+      return nullptr;
+    }
+  }
+
+  allocations_.fetch_add(1, std::memory_order_relaxed);
+  bytesInUse_.fetch_add(blockSize(sizeClass), std::memory_order_relaxed);
+
+  // The pages of a fresh block are zero-filled by the system.
+  if (zeroFill && !isFresh) {
+    memset(block, 0, length);
+  }
+  return block;
+}
+
+void ArrayBufferPool::free(void* data) {
+  size_t sizeClass = slabOf(data)->sizeClass;
+  ThreadCache* cache = &s_threadCache;
+  syncCache(cache);
+
+  bytesInUse_.fetch_sub(blockSize(sizeClass), std::memory_order_relaxed);
+
+  void** blocks = cache->blocks[sizeClass];
+  size_t& count = cache->counts[sizeClass];
+  if (count == cacheCapacity(sizeClass)) {
+    // Give the older half back so that the lock is taken once per batch.
+    size_t half = count / 2;
+    freeToSlabs(sizeClass, blocks, half);
+    memmove(blocks, blocks + half, (count - half) * sizeof(void*));
+    count -= half;
+  }
+  blocks[count++] = data;
+}
+
+bool ArrayBufferPool::canResizeInPlace(size_t oldLength, size_t newLength) {
+  return canHold(newLength) && classOf(oldLength) == classOf(newLength);
+}
+
+void* ArrayBufferPool::allocateFromSlabs(size_t sizeClass,
+                                         ThreadCache* cache,
+                                         bool* isFresh) {
+  SizeClass* cls = &classes_[sizeClass];
+  std::lock_guard<std::mutex> lock(cls->mutex);
+
+  // Refill the cache with freed blocks first. A block is carved only when
+  // none is left, which keeps untouched pages out of the resident set.
+  void** blocks = cache->blocks[sizeClass];
+  size_t& count = cache->counts[sizeClass];
+  size_t target = cacheCapacity(sizeClass) / 2 + 1;
+
+  Slab* slab = cls->slabs;
+  while (slab != nullptr && count < target) {
+    Slab* next = slab->next;
+    while (slab->freeList != nullptr && count < target) {
+      void* block = slab->freeList;
+      slab->freeList = *reinterpret_cast<void**>(block);
+      if (slab->used++ == 0) {
+        cls->emptySlabs--;
+      }
+      blocks[count++] = block;
+    }
+    if (slab->freeList == nullptr && slab->carved == slab->capacity) {
+      unlinkSlab(cls, slab);
+    }
+    slab = next;
+  }
+
+  if (count > 0) {
+    *isFresh = false;
+    return blocks[--count];
+  }
+
+  slab = cls->slabs;
+  if (slab == nullptr) {
+    slab = mapSlab(sizeClass);
+    if (LWNODE_UNLIKELY(slab == nullptr)) {
+      return nullptr;
+    }
+    linkSlab(cls, slab);
+    cls->emptySlabs++;
+  }
+
+  void* block = reinterpret_cast<char*>(slab) + kSlabHeaderSize +
+                slab->carved++ * blockSize(sizeClass);
+  if (slab->used++ == 0) {
+    cls->emptySlabs--;
+  }
+  if (slab->carved == slab->capacity) {
+    unlinkSlab(cls, slab);
+  }
+
+  *isFresh = true;
+  return block;
+}
+
+void ArrayBufferPool::freeToSlabs(size_t sizeClass,
+                                  void** blocks,
+                                  size_t count) {
+  SizeClass* cls = &classes_[sizeClass];
+  std::lock_guard<std::mutex> lock(cls->mutex);
+
+  for (size_t i = 0; i < count; i++) {
+    void* block = blocks[i];
+    Slab* slab = slabOf(block);
+    LWNODE_DCHECK(slab->sizeClass == sizeClass);
+
+    *reinterpret_cast<void**>(block) = slab->freeList;
+    slab->freeList = block;
+    if (!slab->isLinked) {
+      linkSlab(cls, slab);
+    }
+
+    if (--slab->used == 0 && ++cls->emptySlabs > kMaxEmptySlabs) {
+      unlinkSlab(cls, slab);
+      unmapSlab(slab);
+      cls->emptySlabs--;
+    }
+  }
+}
+
+void ArrayBufferPool::flushCache(ThreadCache* cache) {
+  for (size_t sizeClass = 0; sizeClass < kNumClasses; sizeClass++) {
+    if (cache->counts[sizeClass] > 0) {
+      freeToSlabs(
+          sizeClass, cache->blocks[sizeClass], cache->counts[sizeClass]);
+      cache->counts[sizeClass] = 0;
+    }
+  }
+}
+
+void ArrayBufferPool::syncCache(ThreadCache* cache) {
+  uint32_t epoch = epoch_.load(std::memory_order_relaxed);
+  if (LWNODE_UNLIKELY(cache->pool == nullptr)) {
+    cache->pool = this;
+    cache->epoch = epoch;
+  } else if (LWNODE_UNLIKELY(cache->epoch != epoch)) {
+    // trim() ran since this thread last used the pool.
+    flushCache(cache);
+    cache->epoch = epoch;
+  }
+}
+
+void ArrayBufferPool::trim() {
+  epoch_.fetch_add(1, std::memory_order_relaxed);
+  syncCache(&s_threadCache);
+
+  for (size_t sizeClass = 0; sizeClass < kNumClasses; sizeClass++) {
+    SizeClass* cls = &classes_[sizeClass];
+    std::lock_guard<std::mutex> lock(cls->mutex);
+
+    Slab* slab = cls->slabs;
+    while (slab != nullptr) {
+      Slab* next = slab->next;
+      if (slab->used == 0) {
+        unlinkSlab(cls, slab);
+        unmapSlab(slab);
+        cls->emptySlabs--;
+      }
+      slab = next;
+    }
+  }
+
+  trims_.fetch_add(1, std::memory_order_relaxed);
+
+  LWNODE_CALL_TRACE_ID_LOG(ARRAYBUFFER,
+                           "trim: pool=%zuB | slabs=%zu",
+                           bytesInUse_.load(std::memory_order_relaxed),
+                           slabsMapped_.load(std::memory_order_relaxed) -
+                               slabsUnmapped_.load(std::memory_order_relaxed));
+}
+
+ArrayBufferPool::Stats ArrayBufferPool::stats() const {
+  Stats stats;
+  stats.allocations = allocations_.load(std::memory_order_relaxed);
+  stats.cacheHits = cacheHits_.load(std::memory_order_relaxed);
+  stats.bytesInUse = bytesInUse_.load(std::memory_order_relaxed);
+  stats.slabsMapped = slabsMapped_.load(std::memory_order_relaxed);
+  stats.slabsUnmapped = slabsUnmapped_.load(std::memory_order_relaxed);
+  stats.trims = trims_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+ArrayBufferPool::Slab* ArrayBufferPool::mapSlab(size_t sizeClass) {
+  static_assert(sizeof(Slab) <= kSlabHeaderSize,
+                "The header of a slab must fit in its first page");
+
+  // Twice the size is mapped to cut an aligned slab out of it, so that the
+  // slab of a block is found by masking the address of the block.
+  void* mapped = mmap(nullptr,
+                      kSlabSize * 2,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1,
+                      0);
+  if (mapped == MAP_FAILED) {
+    return nullptr;
+  }
+
+  uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+  uintptr_t aligned = (start + kSlabSize - 1) & ~(kSlabSize - 1);
+  size_t head = aligned - start;
+  if (head > 0) {
+    munmap(mapped, head);
+  }
+  munmap(reinterpret_cast<void*>(aligned + kSlabSize), kSlabSize - head);
+
+  Slab* slab = new (reinterpret_cast<void*>(aligned)) Slab();
+  slab->sizeClass = sizeClass;
+  slab->capacity = (kSlabSize - kSlabHeaderSize) / blockSize(sizeClass);
+  slabsMapped_.fetch_add(1, std::memory_order_relaxed);
+  return slab;
+}
+
+void ArrayBufferPool::unmapSlab(Slab* slab) {
+  munmap(slab, kSlabSize);
+  slabsUnmapped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ArrayBufferPool::linkSlab(SizeClass* sizeClass, Slab* slab) {
+  slab->prev = nullptr;
+  slab->next = sizeClass->slabs;
+  if (sizeClass->slabs != nullptr) {
+    sizeClass->slabs->prev = slab;
+  }
+  sizeClass->slabs = slab;
+  slab->isLinked = true;
+}
+
+void ArrayBufferPool::unlinkSlab(SizeClass* sizeClass, Slab* slab) {
+  if (slab->prev != nullptr) {
+    slab->prev->next = slab->next;
+  } else {
+    sizeClass->slabs = slab->next;
+  }
+  if (slab->next != nullptr) {
+    slab->next->prev = slab->prev;
+  }
+  slab->prev = nullptr;
+  slab->next = nullptr;
+  slab->isLinked = false;
+}
+
+}  // namespace EscargotShim
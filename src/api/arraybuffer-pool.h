@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace EscargotShim {
+
+/*
+  ArrayBufferPool serves the data of small ArrayBuffers from size classes.
+
+  The engine lowers M_MMAP_THRESHOLD to 2KB so that memory goes back to the
+  system eagerly, which makes every ArrayBuffer of 2KB or more a mmap/munmap
+  pair of its own. The pool carves blocks of 4KB to 64KB out of 1MB slabs
+  instead. A freed block goes to a small cache of the freeing thread first,
+  and back to its slab when the cache overflows. Empty slabs are unmapped on
+  trim(), which runs on idle GC, or as soon as too many of them pile up.
+
+  The pool is process-wide since the data of an ArrayBuffer may be freed on
+  another thread than the one that allocated it, e.g. after a transfer.
+  It is enabled with --arraybuffer-pool.
+*/
+class ArrayBufferPool {
+ public:
+  struct Stats {
+    size_t allocations = 0;
+    size_t cacheHits = 0;
+    size_t bytesInUse = 0;
+    size_t slabsMapped = 0;
+    size_t slabsUnmapped = 0;
+    size_t trims = 0;
+  };
+
+  // Smaller buffers come from the malloc heap, not from their own mapping.
+  static constexpr size_t kMinSize = 2 * 1024;
+  static constexpr size_t kMaxSize = 64 * 1024;
+
+  static bool isEnabled();
+  static ArrayBufferPool* getInstance();
+
+  static bool canHold(size_t length) {
+    return length >= kMinSize && length <= kMaxSize;
+  }
+
+  // Returns nullptr if no slab can be mapped.
+  void* allocate(size_t length, bool zeroFill);
+  void free(void* data);
+  // True if the block of data can also hold newLength bytes.
+  bool canResizeInPlace(size_t oldLength, size_t newLength);
+
+  // Each block has a word in the header of its slab for its user to record
+  // who owns the block, e.g. the allocator it was accounted to.
+  static void setOwner(void* block, void* owner);
+  static void* ownerOf(void* block);
+
+  // Unmap the empty slabs. Blocks cached by other threads are given back
+  // the next time those threads allocate or free.
+  void trim();
+
+  Stats stats() const;
+
+ private:
+  struct Slab;
+  struct SizeClass;
+  struct ThreadCache;
+
+  static constexpr size_t kNumClasses = 5;
+
+  static thread_local ThreadCache s_threadCache;
+
+  ArrayBufferPool();
+
+  static size_t classOf(size_t length);
+  static size_t blockSize(size_t sizeClass);
+  static size_t cacheCapacity(size_t sizeClass);
+  static Slab* slabOf(void* block);
+
+  void* allocateFromSlabs(size_t sizeClass,
+                          ThreadCache* cache,
+                          bool* isFresh);
+  void freeToSlabs(size_t sizeClass, void** blocks, size_t count);
+  void flushCache(ThreadCache* cache);
+  void syncCache(ThreadCache* cache);
+
+  Slab* mapSlab(size_t sizeClass);
+  void unmapSlab(Slab* slab);
+  void linkSlab(SizeClass* sizeClass, Slab* slab);
+  void unlinkSlab(SizeClass* sizeClass, Slab* slab);
+
+  SizeClass* classes_;
+  std::atomic<uint32_t> epoch_{0};
+
+  std::atomic<size_t> allocations_{0};
+  std::atomic<size_t> cacheHits_{0};
+  std::atomic<size_t> bytesInUse_{0};
+  std::atomic<size_t> slabsMapped_{0};
+  std::atomic<size_t> slabsUnmapped_{0};
+  std::atomic<size_t> trims_{0};
+};
+
+}  // namespace EscargotShim
@@ -58,6 +58,7 @@ ContextWrap::ContextWrap(IsolateWrap* isolate,
                          v8::ExtensionConfiguration* extensionConfiguration) {
   isolate_ = isolate;
   context_ = ContextRef::create(isolate->vmInstance());
+  isolate->addContext(this);
   callSite_ = new CallSite(context_);
   val_ = context_;
   type_ = Type::Context;
@@ -100,6 +101,33 @@ ContextWrap* ContextWrap::fromV8(v8::Context* context) {
   return CVAL(context)->context();
 }
 
+MicrotaskQueueWrap* ContextWrap::microtaskQueue() {
+  if (microtaskQueue_) {
+    return microtaskQueue_;
+  }
+  return isolate_->defaultMicrotaskQueue();
+}
+
+ObjectRef* ContextWrap::getCachedFunction(
+    FunctionTemplateRef* functionTemplate) {
+  if (!functionCache_) {
+    return nullptr;
+  }
+  auto it = functionCache_->find(functionTemplate);
+  if (it == functionCache_->end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+void ContextWrap::cacheFunction(FunctionTemplateRef* functionTemplate,
+                                ObjectRef* function) {
+  if (!functionCache_) {
+    functionCache_ = new GCUnorderedMap<FunctionTemplateRef*, ObjectRef*>();
+  }
+  (*functionCache_)[functionTemplate] = function;
+}
+
 void ContextWrap::Enter() {
   isolate_->Enter();
   isolate_->pushContext(this);
@@ -23,6 +23,7 @@ namespace EscargotShim {
 
 class IsolateWrap;
 class CallSite;
+class MicrotaskQueueWrap;
 
 typedef GCUnorderedMap<int, void*> EmbedderDataMap;
 
@@ -55,12 +56,34 @@ class ContextWrap : public ValueWrap {
 
   CallSite* callSite() { return callSite_; }
 
+  // The Error constructor of this context, which Error.stackTraceLimit is
+  // read from even if the global 'Error' is replaced
+  Escargot::ObjectRef* errorConstructor() { return errorConstructor_; }
+  void setErrorConstructor(Escargot::ObjectRef* errorConstructor) {
+    errorConstructor_ = errorConstructor;
+  }
+
   void SetAbortScriptExecution(
       v8::Context::AbortScriptExecutionCallback callback);
   v8::Context::AbortScriptExecutionCallback getAbortScriptExecution();
 
   void initDebugger();
 
+  // The queue given to v8::Context::New(), or the default queue of the isolate
+  MicrotaskQueueWrap* microtaskQueue();
+  void setMicrotaskQueue(MicrotaskQueueWrap* queue) { microtaskQueue_ = queue; }
+
+  // Functions instantiated from FunctionTemplates in this context, so that
+  // FunctionTemplate::GetFunction() returns the same function again. Like
+  // V8, they live as long as the context; nullptr if none was instantiated.
+  Escargot::ObjectRef* getCachedFunction(
+      Escargot::FunctionTemplateRef* functionTemplate);
+  void cacheFunction(Escargot::FunctionTemplateRef* functionTemplate,
+                     Escargot::ObjectRef* function);
+  size_t functionCacheSize() const {
+    return functionCache_ ? functionCache_->size() : 0;
+  }
+
  private:
   EmbedderDataMap* embedder_data_{nullptr};
 
@@ -75,6 +98,12 @@ class ContextWrap : public ValueWrap {
   Escargot::ValueRef* security_token_ = nullptr;
 
   CallSite* callSite_ = nullptr;
+  Escargot::ObjectRef* errorConstructor_ = nullptr;
+  // @note owned by the embedder
+  MicrotaskQueueWrap* microtaskQueue_ = nullptr;
+
+  GCUnorderedMap<Escargot::FunctionTemplateRef*, Escargot::ObjectRef*>*
+      functionCache_ = nullptr;
 
   v8::Context::AbortScriptExecutionCallback abortScriptExecutionCallback_ =
       nullptr;
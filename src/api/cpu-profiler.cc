@@ -0,0 +1,692 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cpu-profiler.h"
+
+#include <errno.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+#include "global.h"
+#include "isolate.h"
+#include "utils/string-util.h"
+
+using namespace Escargot;
+
+namespace EscargotShim {
+
+static const char* kRootName = "(root)";
+static const char* kProgramName = "(program)";
+static const char* kIdleName = "(idle)";
+static const char* kGCName = "(garbage collector)";
+
+// --- CpuProfileNodeWrap ---
+
+CpuProfileNodeWrap* CpuProfileNodeWrap::findOrAddChild(
+    unsigned* nextId,
+    const std::string& functionName,
+    const std::string& url,
+    int scriptId,
+    int lineNumber,
+    int columnNumber,
+    int callerLineNumber,
+    v8::CpuProfileNode::SourceType type) {
+  // NOTE: V8 merges frames of the same function, so the column and line of a
+  // frame are not part of the key. The line of the call site in the parent
+  // is, if the profile separates nodes by it.
+  for (auto& child : children_) {
+    if (child->scriptId_ == scriptId && child->functionName_ == functionName &&
+        child->url_ == url && child->callerLineNumber_ == callerLineNumber) {
+      return child.get();
+    }
+  }
+
+  children_.emplace_back(new CpuProfileNodeWrap(this,
+                                                (*nextId)++,
+                                                functionName,
+                                                url,
+                                                scriptId,
+                                                lineNumber,
+                                                columnNumber,
+                                                callerLineNumber,
+                                                type));
+  return children_.back().get();
+}
+
+void CpuProfileNodeWrap::incrementHitCount(int line) {
+  hitCount_++;
+  if (line > 0) {
+    lineTicks_[line]++;
+  }
+}
+
+// --- CpuProfileWrap ---
+
+CpuProfileWrap::CpuProfileWrap(CpuProfilerWrap* profiler,
+                               IsolateWrap* isolate,
+                               const std::string& title,
+                               v8::CpuProfilingMode mode,
+                               bool recordSamples,
+                               unsigned maxSamples,
+                               int64_t startTime)
+    : profiler_(profiler),
+      isolate_(isolate),
+      title_(title),
+      mode_(mode),
+      recordSamples_(recordSamples),
+      maxSamples_(maxSamples),
+      startTime_(startTime),
+      endTime_(startTime) {
+  root_.reset(new CpuProfileNodeWrap(nullptr,
+                                     nextNodeId_++,
+                                     kRootName,
+                                     "",
+                                     v8::UnboundScript::kNoScriptId,
+                                     v8::CpuProfileNode::kNoLineNumberInfo,
+                                     v8::CpuProfileNode::kNoColumnNumberInfo,
+                                     v8::CpuProfileNode::kNoLineNumberInfo,
+                                     v8::CpuProfileNode::kInternal));
+}
+
+void CpuProfileWrap::addSample(const std::vector<Frame>& stack,
+                               int64_t timestamp) {
+  CpuProfileNodeWrap* node = root_.get();
+  int line = v8::CpuProfileNode::kNoLineNumberInfo;
+  int callerLine = v8::CpuProfileNode::kNoLineNumberInfo;
+  for (const auto& frame : stack) {
+    node = node->findOrAddChild(&nextNodeId_,
+                                frame.functionName,
+                                frame.url,
+                                frame.scriptId,
+                                frame.lineNumber,
+                                frame.columnNumber,
+                                callerLine,
+                                frame.sourceType);
+    line = frame.lineNumber;
+    // The line of a frame that isn't the leaf is that of its call site.
+    if (mode_ == v8::kCallerLineNumbers) {
+      callerLine = frame.lineNumber;
+    }
+  }
+  node->incrementHitCount(line);
+
+  if (recordSamples_ &&
+      (maxSamples_ == v8::CpuProfilingOptions::kNoSampleLimit ||
+       samples_.size() < maxSamples_)) {
+    samples_.push_back(node);
+    timestamps_.push_back(timestamp);
+  }
+}
+
+void CpuProfileWrap::addSample(const Frame& frame, int64_t timestamp) {
+  addSample(std::vector<Frame>{frame}, timestamp);
+}
+
+static void appendNodeJSON(std::string& out, const CpuProfileNodeWrap* node) {
+  out += "{\"id\":";
+  out += std::to_string(node->id());
+  out += ",\"callFrame\":{\"functionName\":";
+  strAppendJSONQuoted(out, node->functionName());
+  out += ",\"scriptId\":\"";
+  out += std::to_string(std::max(node->scriptId(), 0));
+  out += "\",\"url\":";
+  strAppendJSONQuoted(out, node->url());
+  // .cpuprofile uses 0-based positions.
+  out += ",\"lineNumber\":";
+  out += std::to_string(node->lineNumber() - 1);
+  out += ",\"columnNumber\":";
+  out += std::to_string(node->columnNumber() - 1);
+  out += "},\"hitCount\":";
+  out += std::to_string(node->hitCount());
+
+  if (node->childrenCount() > 0) {
+    out += ",\"children\":[";
+    for (size_t i = 0; i < node->childrenCount(); i++) {
+      if (i > 0) {
+        out += ',';
+      }
+      out += std::to_string(node->child(i)->id());
+    }
+    out += ']';
+  }
+
+  if (!node->lineTicks().empty()) {
+    out += ",\"positionTicks\":[";
+    bool first = true;
+    for (const auto& tick : node->lineTicks()) {
+      if (!first) {
+        out += ',';
+      }
+      first = false;
+      out += "{\"line\":";
+      out += std::to_string(tick.first);
+      out += ",\"ticks\":";
+      out += std::to_string(tick.second);
+      out += '}';
+    }
+    out += ']';
+  }
+  out += '}';
+}
+
+std::string CpuProfileWrap::toJSON() const {
+  std::string out;
+  out += "{\"nodes\":[";
+
+  // Nodes are listed in pre-order; every parent precedes its children.
+  std::vector<const CpuProfileNodeWrap*> worklist{root_.get()};
+  bool first = true;
+  while (!worklist.empty()) {
+    auto node = worklist.back();
+    worklist.pop_back();
+
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+    appendNodeJSON(out, node);
+
+    for (size_t i = node->childrenCount(); i > 0; i--) {
+      worklist.push_back(node->child(i - 1));
+    }
+  }
+
+  out += "],\"startTime\":";
+  out += std::to_string(startTime_);
+  out += ",\"endTime\":";
+  out += std::to_string(endTime_);
+
+  out += ",\"samples\":[";
+  for (size_t i = 0; i < samples_.size(); i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    out += std::to_string(samples_[i]->id());
+  }
+
+  out += "],\"timeDeltas\":[";
+  int64_t lastTimestamp = startTime_;
+  for (size_t i = 0; i < timestamps_.size(); i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    out += std::to_string(timestamps_[i] - lastTimestamp);
+    lastTimestamp = timestamps_[i];
+  }
+  out += "]}";
+
+  return out;
+}
+
+// --- CpuProfilerWrap ---
+
+THREAD_LOCAL CpuProfilerWrap* CpuProfilerWrap::s_profiler;
+
+void CpuProfilerWrap::TickRing::add(int64_t timestamp,
+                                    VMState state,
+                                    uint32_t segment) {
+  size_t head = head_.load(std::memory_order_relaxed);
+  size_t tail = tail_.load(std::memory_order_acquire);
+
+  // The consumer runs on this thread and only reads entries while consuming,
+  // so the newest entry can be updated in place otherwise.
+  if (head != tail && !consuming_.load(std::memory_order_seq_cst)) {
+    Tick& last = buffer_[(head + kCapacity - 1) % kCapacity];
+    if (last.state == state && last.segment == segment) {
+      last.count++;
+      last.lastTimestamp = timestamp;
+      return;
+    }
+  }
+
+  size_t next = (head + 1) % kCapacity;
+  if (next == tail) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  buffer_[head] = Tick{timestamp, timestamp, 1, segment, state};
+  head_.store(next, std::memory_order_release);
+}
+
+bool CpuProfilerWrap::TickRing::pop(Tick* tick) {
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail == head_.load(std::memory_order_acquire)) {
+    return false;
+  }
+
+  *tick = buffer_[tail];
+  tail_.store((tail + 1) % kCapacity, std::memory_order_release);
+  return true;
+}
+
+CpuProfilerWrap::CpuProfilerWrap(IsolateWrap* isolate) : isolate_(isolate) {}
+
+CpuProfilerWrap::~CpuProfilerWrap() {
+  stopSampler();
+}
+
+int64_t CpuProfilerWrap::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool CpuProfilerWrap::startProfiling(const std::string& title,
+                                     v8::CpuProfilingMode mode,
+                                     bool recordSamples,
+                                     unsigned maxSamples) {
+  for (auto& profile : activeProfiles_) {
+    if (profile->title() == title) {
+      // V8 ignores a request to start a profile already being recorded.
+      return false;
+    }
+  }
+
+  if (s_profiler && s_profiler != this) {
+    LWNODE_DLOG_WARN("another CpuProfiler is sampling on this thread");
+    return false;
+  }
+
+  activeProfiles_.emplace_back(new CpuProfileWrap(
+      this, isolate_, title, mode, recordSamples, maxSamples, now()));
+
+  if (!samplerRunning_) {
+    startSampler();
+  }
+  return true;
+}
+
+CpuProfileWrap* CpuProfilerWrap::stopProfiling(const std::string& title) {
+  for (auto it = activeProfiles_.begin(); it != activeProfiles_.end(); ++it) {
+    // An empty title stops the last started profile.
+    if (!title.empty() && (*it)->title() != title) {
+      continue;
+    }
+    if (title.empty() && std::next(it) != activeProfiles_.end()) {
+      continue;
+    }
+
+    if (activeProfiles_.size() == 1) {
+      stopSampler();
+    }
+    // Account ticks that haven't reached a safe point yet.
+    drain(nullptr, SafePoint::CallbackExit);
+
+    std::unique_ptr<CpuProfileWrap> profile = std::move(*it);
+    activeProfiles_.erase(it);
+    profile->finish(now());
+
+    finishedProfiles_.push_back(std::move(profile));
+    return finishedProfiles_.back().get();
+  }
+
+  return nullptr;
+}
+
+void CpuProfilerWrap::deleteProfile(CpuProfileWrap* profile) {
+  for (auto it = finishedProfiles_.begin(); it != finishedProfiles_.end();
+       ++it) {
+    if (it->get() == profile) {
+      finishedProfiles_.erase(it);
+      return;
+    }
+  }
+}
+
+void CpuProfilerWrap::collectSample() {
+  // The signal handler is the only other producer. Keep it from
+  // interrupting this one.
+  sigset_t set;
+  sigset_t oldSet;
+  sigemptyset(&set);
+  sigaddset(&set, SIGPROF);
+  pthread_sigmask(SIG_BLOCK, &set, &oldSet);
+  ring_.add(now(), currentVMState(), segment_.load(std::memory_order_relaxed));
+  pthread_sigmask(SIG_SETMASK, &oldSet, nullptr);
+}
+
+CpuProfilerWrap::VMState CpuProfilerWrap::currentVMState() const {
+  if (inGC_.load(std::memory_order_relaxed)) {
+    return VMState::GC;
+  }
+  if (isolate_->isRunningScript()) {
+    return VMState::JS;
+  }
+  // As in V8, the thread is idle only if the embedder says so, e.g. while
+  // waiting in the event loop. Any other time is spent in embedder code.
+  if (isolate_->isIdle()) {
+    return VMState::Idle;
+  }
+  return VMState::Program;
+}
+
+void CpuProfilerWrap::signalHandler(int signal, siginfo_t* info, void* context) {
+  int savedErrno = errno;
+  CpuProfilerWrap* profiler = s_profiler;
+  if (profiler) {
+    profiler->ring_.add(now(),
+                        profiler->currentVMState(),
+                        profiler->segment_.load(std::memory_order_relaxed));
+  }
+  errno = savedErrno;
+}
+
+// SIGPROF is process-wide while profilers are per thread, so the handler is
+// installed by the first profiler that starts and restored by the last one
+// that stops. Restoring it any earlier would let a SIGPROF sent to another
+// profiling thread reach the previous action, which kills the process by
+// default.
+static std::mutex s_signalHandlerMutex;
+static size_t s_signalHandlerCount = 0;
+static struct sigaction s_oldSigaction;
+
+void CpuProfilerWrap::installSignalHandler() {
+  std::lock_guard<std::mutex> lock(s_signalHandlerMutex);
+  if (s_signalHandlerCount++ > 0) {
+    return;
+  }
+
+  struct sigaction sa;
+  sa.sa_sigaction = signalHandler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART | SA_SIGINFO;
+  sigaction(SIGPROF, &sa, &s_oldSigaction);
+}
+
+void CpuProfilerWrap::uninstallSignalHandler() {
+  std::lock_guard<std::mutex> lock(s_signalHandlerMutex);
+  LWNODE_CHECK(s_signalHandlerCount > 0);
+  if (--s_signalHandlerCount > 0) {
+    return;
+  }
+
+  // The sampler of this thread has been joined, but a SIGPROF it sent may
+  // still be pending. Consume it before the previous action is back.
+  sigset_t set;
+  sigset_t oldSet;
+  sigemptyset(&set);
+  sigaddset(&set, SIGPROF);
+  pthread_sigmask(SIG_BLOCK, &set, &oldSet);
+  struct timespec zero = {0, 0};
+  while (sigtimedwait(&set, nullptr, &zero) == SIGPROF) {
+  }
+  sigaction(SIGPROF, &s_oldSigaction, nullptr);
+  pthread_sigmask(SIG_SETMASK, &oldSet, nullptr);
+}
+
+void CpuProfilerWrap::onGCStart(void* data) {
+  reinterpret_cast<CpuProfilerWrap*>(data)->inGC_.store(
+      true, std::memory_order_relaxed);
+}
+
+void CpuProfilerWrap::onGCEnd(void* data) {
+  reinterpret_cast<CpuProfilerWrap*>(data)->inGC_.store(
+      false, std::memory_order_relaxed);
+}
+
+void CpuProfilerWrap::startSampler() {
+  LWNODE_CHECK(!samplerRunning_);
+
+  // Touch the thread local before signals start arriving, so that the
+  // handler never triggers a lazy TLS allocation.
+  s_profiler = this;
+  jsThread_ = pthread_self();
+
+  installSignalHandler();
+
+  Memory::addGCEventListener(Memory::GCEventType::MARK_START, onGCStart, this);
+  Memory::addGCEventListener(Memory::GCEventType::RECLAIM_END, onGCEnd, this);
+
+  samplerRunning_ = true;
+  sampler_ = std::thread([this]() {
+    while (samplerRunning_.load(std::memory_order_relaxed)) {
+      std::this_thread::sleep_for(
+          std::chrono::microseconds(std::max(samplingIntervalUs_, 100)));
+      if (!samplerRunning_.load(std::memory_order_relaxed)) {
+        break;
+      }
+      pthread_kill(jsThread_, SIGPROF);
+    }
+  });
+}
+
+void CpuProfilerWrap::stopSampler() {
+  if (!samplerRunning_) {
+    return;
+  }
+
+  samplerRunning_ = false;
+  sampler_.join();
+
+  Memory::removeGCEventListener(
+      Memory::GCEventType::MARK_START, onGCStart, this);
+  Memory::removeGCEventListener(
+      Memory::GCEventType::RECLAIM_END, onGCEnd, this);
+
+  uninstallSignalHandler();
+  s_profiler = nullptr;
+
+  if (ring_.dropped() > 0) {
+    LWNODE_DLOG_WARN("CpuProfiler: %zu ticks dropped", ring_.dropped());
+  }
+}
+
+void CpuProfilerWrap::processTicks(ExecutionStateRef* state,
+                                   SafePoint safePoint) {
+  if (ring_.hasItems()) {
+    drain(state, safePoint);
+  }
+  segment_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CpuProfilerWrap::drain(ExecutionStateRef* state, SafePoint safePoint) {
+  std::vector<CpuProfileWrap::Frame> stack;
+  bool hasStack = false;
+  uint32_t segment = segment_.load(std::memory_order_relaxed);
+
+  ring_.setConsuming(true);
+  Tick tick;
+  while (ring_.pop(&tick)) {
+    VMState vmState = tick.state;
+    const std::vector<CpuProfileWrap::Frame>* frames = nullptr;
+
+    if (vmState == VMState::JS) {
+      if (state == nullptr || tick.segment != segment) {
+        // The stack these ticks interrupted is gone.
+        vmState = VMState::Program;
+      } else {
+        if (!hasStack) {
+          hasStack = true;
+          captureStackFrames(state, &scriptIds_, &stack);
+          // Before the callback runs, the time belongs to its caller.
+          if (safePoint == SafePoint::CallbackEntry && !stack.empty() &&
+              stack.back().sourceType == v8::CpuProfileNode::kCallback) {
+            stack.pop_back();
+          }
+        }
+        frames = &stack;
+      }
+    }
+
+    // Spread the merged ticks evenly over the time they were taken in.
+    int64_t duration = tick.lastTimestamp - tick.timestamp;
+    for (uint32_t i = 0; i < tick.count; i++) {
+      int64_t timestamp = tick.timestamp;
+      if (tick.count > 1) {
+        timestamp += duration * i / (tick.count - 1);
+      }
+      addSample(vmState, frames, timestamp);
+    }
+  }
+  ring_.setConsuming(false);
+}
+
+void CpuProfilerWrap::addSample(VMState state,
+                                const std::vector<CpuProfileWrap::Frame>* stack,
+                                int64_t timestamp) {
+  CpuProfileWrap::Frame frame{"",
+                              "",
+                              v8::UnboundScript::kNoScriptId,
+                              v8::CpuProfileNode::kNoLineNumberInfo,
+                              v8::CpuProfileNode::kNoColumnNumberInfo,
+                              v8::CpuProfileNode::kInternal};
+  switch (state) {
+    case VMState::GC:
+      frame.functionName = kGCName;
+      frame.sourceType = v8::CpuProfileNode::kUnresolved;
+      break;
+    case VMState::Idle:
+      frame.functionName = kIdleName;
+      break;
+    case VMState::Program:
+      frame.functionName = kProgramName;
+      break;
+    case VMState::JS:
+      break;
+  }
+
+  for (auto& profile : activeProfiles_) {
+    if (timestamp < profile->startTime()) {
+      continue;
+    }
+    if (state == VMState::JS) {
+      profile->addSample(*stack, timestamp);
+    } else {
+      profile->addSample(frame, timestamp);
+    }
+  }
+}
+
+// --- ScriptEntryScope ---
+
+ScriptEntryScope::ScriptEntryScope(IsolateWrap* isolate) : isolate_(isolate) {
+  isolate_->increaseScriptDepth();
+  CpuProfilerWrap::onScriptBoundary();
+}
+
+ScriptEntryScope::~ScriptEntryScope() {
+  CpuProfilerWrap::onScriptBoundary();
+  isolate_->decreaseScriptDepth();
+}
+
+// --- helpers ---
+
+void captureStackFrames(ExecutionStateRef* state,
+                        std::map<std::string, int>* scriptIds,
+                        std::vector<CpuProfileWrap::Frame>* frames) {
+  auto stackTraceData = state->computeStackTrace();
+  for (size_t i = stackTraceData.size(); i > 0; i--) {
+    const auto& data = stackTraceData[i - 1];
+    std::string url = data.srcName->toStdUTF8String();
+
+    int scriptId = v8::UnboundScript::kNoScriptId;
+    if (!url.empty()) {
+      auto it = scriptIds->find(url);
+      if (it == scriptIds->end()) {
+        it = scriptIds->emplace(url, scriptIds->size() + 1).first;
+      }
+      scriptId = it->second;
+    }
+
+    frames->push_back({data.functionName->toStdUTF8String(),
+                       url,
+                       scriptId,
+                       static_cast<int>(data.loc.line),
+                       static_cast<int>(data.loc.column),
+                       data.isAssociatedWithJavaScriptCode
+                           ? v8::CpuProfileNode::kScript
+                           : v8::CpuProfileNode::kCallback});
+  }
+}
+
+std::string createDiagnosticFilename(const char* prefix, const char* ext) {
+  static int s_sequence = 0;
+
+  time_t rawTime = time(nullptr);
+  struct tm tmInfo;
+  localtime_r(&rawTime, &tmInfo);
+
+  char buffer[256];
+  snprintf(buffer,
+           sizeof(buffer),
+           "%s.%04d%02d%02d.%02d%02d%02d.%d.%ld.%d.%s",
+           prefix,
+           tmInfo.tm_year + 1900,
+           tmInfo.tm_mon + 1,
+           tmInfo.tm_mday,
+           tmInfo.tm_hour,
+           tmInfo.tm_min,
+           tmInfo.tm_sec,
+           getpid(),
+           static_cast<long>(syscall(SYS_gettid)),
+           ++s_sequence,
+           ext);
+  return buffer;
+}
+
+// --- --cpu-prof ---
+
+static CpuProfilerWrap* g_flagsProfiler;
+static const char* kFlagsProfileTitle = "--cpu-prof";
+
+void startCpuProfileFromFlags(IsolateWrap* isolate) {
+  auto flags = Global::flags();
+  if (!flags->isOn(Flag::Type::CpuProf) || g_flagsProfiler) {
+    return;
+  }
+
+  g_flagsProfiler = new CpuProfilerWrap(isolate);
+  g_flagsProfiler->setSamplingInterval(
+      atoi(flags->value(Flag::Type::CpuProfInterval, "1000").c_str()));
+  g_flagsProfiler->startProfiling(kFlagsProfileTitle,
+                                 v8::kLeafNodeLineNumbers,
+                                 true,
+                                 v8::CpuProfilingOptions::kNoSampleLimit);
+}
+
+void stopCpuProfileFromFlags(IsolateWrap* isolate) {
+  if (!g_flagsProfiler) {
+    return;
+  }
+
+  auto profile = g_flagsProfiler->stopProfiling(kFlagsProfileTitle);
+  if (profile) {
+    auto flags = Global::flags();
+    std::string filename = flags->value(
+        Flag::Type::CpuProfName, createDiagnosticFilename("CPU", "cpuprofile"));
+    std::string dir = flags->value(Flag::Type::CpuProfDir);
+    if (!dir.empty()) {
+      filename = dir + "/" + filename;
+    }
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (out.is_open()) {
+      out << profile->toJSON();
+    } else {
+      LWNODE_LOG_ERROR("failed to write cpu profile: %s", filename.c_str());
+    }
+  }
+
+  delete g_flagsProfiler;
+  g_flagsProfiler = nullptr;
+}
+
+}  // namespace EscargotShim
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <signal.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "v8-profiler.h"
+
+#include "utils/compiler.h"
+
+namespace Escargot {
+class ExecutionStateRef;
+}
+
+namespace EscargotShim {
+
+class IsolateWrap;
+class CpuProfilerWrap;
+
+class CpuProfileNodeWrap {
+ public:
+  CpuProfileNodeWrap(CpuProfileNodeWrap* parent,
+                     unsigned id,
+                     const std::string& functionName,
+                     const std::string& url,
+                     int scriptId,
+                     int lineNumber,
+                     int columnNumber,
+                     int callerLineNumber,
+                     v8::CpuProfileNode::SourceType sourceType)
+      : parent_(parent),
+        id_(id),
+        functionName_(functionName),
+        url_(url),
+        scriptId_(scriptId),
+        lineNumber_(lineNumber),
+        columnNumber_(columnNumber),
+        callerLineNumber_(callerLineNumber),
+        sourceType_(sourceType) {}
+
+  static v8::CpuProfileNode* toV8(CpuProfileNodeWrap* node) {
+    return reinterpret_cast<v8::CpuProfileNode*>(node);
+  }
+  static const CpuProfileNodeWrap* fromV8(const v8::CpuProfileNode* node) {
+    return reinterpret_cast<const CpuProfileNodeWrap*>(node);
+  }
+
+  CpuProfileNodeWrap* findOrAddChild(unsigned* nextId,
+                                     const std::string& functionName,
+                                     const std::string& url,
+                                     int scriptId,
+                                     int lineNumber,
+                                     int columnNumber,
+                                     int callerLineNumber,
+                                     v8::CpuProfileNode::SourceType type);
+
+  void incrementHitCount(int line);
+
+  CpuProfileNodeWrap* parent() const { return parent_; }
+  unsigned id() const { return id_; }
+  const std::string& functionName() const { return functionName_; }
+  const std::string& url() const { return url_; }
+  int scriptId() const { return scriptId_; }
+  int lineNumber() const { return lineNumber_; }
+  int columnNumber() const { return columnNumber_; }
+  unsigned hitCount() const { return hitCount_; }
+  v8::CpuProfileNode::SourceType sourceType() const { return sourceType_; }
+
+  size_t childrenCount() const { return children_.size(); }
+  CpuProfileNodeWrap* child(size_t index) const {
+    return children_[index].get();
+  }
+
+  const std::map<int, unsigned>& lineTicks() const { return lineTicks_; }
+
+ private:
+  CpuProfileNodeWrap* parent_ = nullptr;
+  unsigned id_ = 0;
+  std::string functionName_;
+  std::string url_;
+  int scriptId_ = v8::UnboundScript::kNoScriptId;
+  int lineNumber_ = v8::CpuProfileNode::kNoLineNumberInfo;
+  int columnNumber_ = v8::CpuProfileNode::kNoColumnNumberInfo;
+  // The line of the call site in the parent, if nodes are separated by it
+  int callerLineNumber_ = v8::CpuProfileNode::kNoLineNumberInfo;
+  unsigned hitCount_ = 0;
+  v8::CpuProfileNode::SourceType sourceType_ =
+      v8::CpuProfileNode::SourceType::kScript;
+  std::vector<std::unique_ptr<CpuProfileNodeWrap>> children_;
+  std::map<int, unsigned> lineTicks_;
+};
+
+class CpuProfileWrap {
+ public:
+  CpuProfileWrap(CpuProfilerWrap* profiler,
+                 IsolateWrap* isolate,
+                 const std::string& title,
+                 v8::CpuProfilingMode mode,
+                 bool recordSamples,
+                 unsigned maxSamples,
+                 int64_t startTime);
+
+  static v8::CpuProfile* toV8(CpuProfileWrap* profile) {
+    return reinterpret_cast<v8::CpuProfile*>(profile);
+  }
+  static CpuProfileWrap* fromV8(v8::CpuProfile* profile) {
+    return reinterpret_cast<CpuProfileWrap*>(profile);
+  }
+  static const CpuProfileWrap* fromV8(const v8::CpuProfile* profile) {
+    return reinterpret_cast<const CpuProfileWrap*>(profile);
+  }
+
+  // A stack is a list of frames from the outermost caller to the leaf.
+  struct Frame {
+    std::string functionName;
+    std::string url;
+    int scriptId;
+    int lineNumber;
+    int columnNumber;
+    v8::CpuProfileNode::SourceType sourceType;
+  };
+
+  void addSample(const std::vector<Frame>& stack, int64_t timestamp);
+  void addSample(const Frame& frame, int64_t timestamp);
+
+  void finish(int64_t endTime) { endTime_ = endTime; }
+
+  // Serialize into the Chrome DevTools `.cpuprofile` JSON format.
+  std::string toJSON() const;
+
+  CpuProfilerWrap* profiler() const { return profiler_; }
+  IsolateWrap* isolate() const { return isolate_; }
+  const std::string& title() const { return title_; }
+  CpuProfileNodeWrap* root() const { return root_.get(); }
+  int64_t startTime() const { return startTime_; }
+  int64_t endTime() const { return endTime_; }
+  size_t samplesCount() const { return samples_.size(); }
+  CpuProfileNodeWrap* sample(size_t index) const { return samples_[index]; }
+  int64_t timestamp(size_t index) const { return timestamps_[index]; }
+
+ private:
+  CpuProfilerWrap* profiler_ = nullptr;
+  IsolateWrap* isolate_ = nullptr;
+  std::string title_;
+  v8::CpuProfilingMode mode_ = v8::kLeafNodeLineNumbers;
+  bool recordSamples_ = false;
+  unsigned maxSamples_ = 0;
+  int64_t startTime_ = 0;
+  int64_t endTime_ = 0;
+  unsigned nextNodeId_ = 1;
+  std::unique_ptr<CpuProfileNodeWrap> root_;
+  std::vector<CpuProfileNodeWrap*> samples_;
+  std::vector<int64_t> timestamps_;
+};
+
+/*
+  CpuProfilerWrap is a sampling profiler driven by SIGPROF.
+
+  A sampler thread sends SIGPROF to the JS thread every sampling interval. The
+  signal handler is async-signal-safe: it only stores a tick (timestamp, VM
+  state and segment) into a preallocated single-producer/single-consumer ring
+  buffer. Consecutive ticks of the same state and segment are merged into one
+  entry, so the buffer doesn't fill up while the thread waits or runs JS for
+  long.
+
+  Escargot frames can't be walked from a signal handler since computing a
+  stack trace allocates, so pending ticks are resolved into interpreter frames
+  at the next safe point, which is the entry and the exit of every native
+  callback made from JavaScript (see `CpuProfilerWrap::onSafePoint`).
+
+  Every safe point, and every call from the embedder into JavaScript, starts a
+  new segment. A JS tick is only attributed to the stack of the safe point
+  that ends its own segment:
+  - At a callback entry, it is the stack of the JS code that made the call.
+  - At a callback exit, it is the stack of the callback itself.
+  JS ticks whose segment ended without a safe point, e.g. JS run from the
+  embedder that made no native call, can't be attributed to any stack and are
+  reported as (program), as V8 does for ticks it can't symbolize.
+
+  NOTE: Within a segment, functions called and returned before the safe point
+  is reached are charged to the frame live at the safe point. The interrupted
+  PC only points into the interpreter loop and can't be mapped to a function
+  without walking Escargot frames, so nothing finer is recorded.
+*/
+class CpuProfilerWrap {
+ public:
+  enum class VMState : uint8_t { JS, GC, Idle, Program };
+
+  explicit CpuProfilerWrap(IsolateWrap* isolate);
+  ~CpuProfilerWrap();
+
+  static v8::CpuProfiler* toV8(CpuProfilerWrap* profiler) {
+    return reinterpret_cast<v8::CpuProfiler*>(profiler);
+  }
+  static CpuProfilerWrap* fromV8(v8::CpuProfiler* profiler) {
+    return reinterpret_cast<CpuProfilerWrap*>(profiler);
+  }
+
+  void setSamplingInterval(int us) { samplingIntervalUs_ = us; }
+  int samplingInterval() const { return samplingIntervalUs_; }
+
+  bool startProfiling(const std::string& title,
+                      v8::CpuProfilingMode mode,
+                      bool recordSamples,
+                      unsigned maxSamples);
+  CpuProfileWrap* stopProfiling(const std::string& title);
+  void deleteProfile(CpuProfileWrap* profile);
+
+  // Record a tick synchronously, e.g. for CpuProfiler::CollectSample()
+  void collectSample();
+
+  // The profiler sampling on this thread, if any
+  static CpuProfilerWrap* current() { return s_profiler; }
+
+  enum class SafePoint : uint8_t { CallbackEntry, CallbackExit };
+
+  // A native callback is entered or left on |state|. Pending ticks are
+  // resolved and a new segment starts.
+  static inline void onSafePoint(Escargot::ExecutionStateRef* state,
+                                 SafePoint safePoint) {
+    if (s_profiler) {
+      s_profiler->processTicks(state, safePoint);
+    }
+  }
+
+  // The embedder calls into JavaScript or returns from it. A new segment
+  // starts, so that no tick taken on either side is charged to a stack
+  // captured on the other.
+  static inline void onScriptBoundary() {
+    if (s_profiler) {
+      s_profiler->segment_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Timestamps are in microseconds of the monotonic clock.
+  static int64_t now();
+
+ private:
+  // A run of |count| ticks taken from |timestamp| to |lastTimestamp|
+  struct Tick {
+    int64_t timestamp;
+    int64_t lastTimestamp;
+    uint32_t count;
+    uint32_t segment;
+    VMState state;
+  };
+
+  // Preallocated lock-free SPSC ring buffer. The producer is the signal
+  // handler and the consumer is the JS thread at safe points. Both run on the
+  // JS thread, so the producer may only interrupt the consumer.
+  class TickRing {
+   public:
+    static constexpr size_t kCapacity = 4096;
+
+    // Adds the tick to the newest entry if it is of the same state and
+    // segment and the consumer isn't reading the buffer.
+    void add(int64_t timestamp, VMState state, uint32_t segment);
+    bool pop(Tick* tick);
+    bool hasItems() const {
+      return head_.load(std::memory_order_acquire) !=
+             tail_.load(std::memory_order_acquire);
+    }
+    void setConsuming(bool consuming) {
+      consuming_.store(consuming, std::memory_order_seq_cst);
+    }
+    size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+   private:
+    Tick buffer_[kCapacity];
+    std::atomic<size_t> head_{0};
+    std::atomic<size_t> tail_{0};
+    std::atomic<size_t> dropped_{0};
+    std::atomic<bool> consuming_{false};
+  };
+
+  void startSampler();
+  void stopSampler();
+  void processTicks(Escargot::ExecutionStateRef* state, SafePoint safePoint);
+  void drain(Escargot::ExecutionStateRef* state, SafePoint safePoint);
+  void addSample(VMState state,
+                 const std::vector<CpuProfileWrap::Frame>* stack,
+                 int64_t timestamp);
+
+  VMState currentVMState() const;
+
+  static void installSignalHandler();
+  static void uninstallSignalHandler();
+  static void signalHandler(int signal, siginfo_t* info, void* context);
+  static void onGCStart(void* data);
+  static void onGCEnd(void* data);
+
+  IsolateWrap* isolate_ = nullptr;
+  int samplingIntervalUs_ = 1000;
+  std::vector<std::unique_ptr<CpuProfileWrap>> activeProfiles_;
+  std::vector<std::unique_ptr<CpuProfileWrap>> finishedProfiles_;
+  std::map<std::string, int> scriptIds_;
+
+  TickRing ring_;
+  std::atomic<uint32_t> segment_{0};
+  std::atomic<bool> inGC_{false};
+  std::atomic<bool> samplerRunning_{false};
+  std::thread sampler_;
+  pthread_t jsThread_;
+
+  static THREAD_LOCAL CpuProfilerWrap* s_profiler;
+};
+
+/*
+  ScriptEntryScope marks a call from the embedder into JavaScript, e.g.
+  Script::Run. Ticks taken inside are reported as JavaScript rather than as
+  embedder code, and a new profiler segment starts on entry and on exit.
+*/
+class ScriptEntryScope {
+ public:
+  explicit ScriptEntryScope(IsolateWrap* isolate);
+  ~ScriptEntryScope();
+
+  ScriptEntryScope(const ScriptEntryScope&) = delete;
+  ScriptEntryScope& operator=(const ScriptEntryScope&) = delete;
+
+ private:
+  IsolateWrap* isolate_;
+};
+
+// Collect the current JS stack as frames from the outermost caller to the
+// leaf. Script ids are assigned to urls through `scriptIds`.
+void captureStackFrames(Escargot::ExecutionStateRef* state,
+                        std::map<std::string, int>* scriptIds,
+                        std::vector<CpuProfileWrap::Frame>* frames);
+
+// e.g. CPU.20210909.103000.1234.1234.1.cpuprofile as node does
+std::string createDiagnosticFilename(const char* prefix, const char* ext);
+
+// Handle `--cpu-prof`: profile the whole process lifetime of the isolate and
+// write `.cpuprofile` on dispose.
+void startCpuProfileFromFlags(IsolateWrap* isolate);
+void stopCpuProfileFromFlags(IsolateWrap* isolate);
+
+}  // namespace EscargotShim
@@ -16,11 +16,16 @@
 
 #include "engine.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
 #include "api/global.h"
+#include "arraybuffer-allocator.h"
+#include "arraybuffer-pool.h"
 #include "handle.h"
+#include "isolate.h"
 #include "utils/misc.h"
 #include "utils/string-util.h"
 
@@ -30,6 +35,21 @@ namespace EscargotShim {
 
 static Platform* s_platform;
 
+// Keeps the data behind the header aligned as malloc() would.
+static constexpr size_t kOwnerHeaderSize = 16;
+
+static bool isPooled(size_t length) {
+  return ArrayBufferPool::isEnabled() && ArrayBufferPool::canHold(length);
+}
+
+Platform::Platform()
+    : defaultArrayBufferAllocator_(
+          v8::ArrayBuffer::Allocator::NewDefaultAllocator()),
+      defaultArrayBufferDecorator_(new ArrayBufferAllocatorDecorator()) {
+  defaultArrayBufferDecorator_->set_array_buffer_allocator(
+      defaultArrayBufferAllocator_);
+}
+
 Platform* Platform::GetInstance() {
   if (s_platform == nullptr) {
     s_platform = new Platform();
@@ -51,19 +71,89 @@ void Platform::markJSJobEnqueued(ContextRef* relatedContext) {
 
 void Platform::markJSJobFromAnotherThreadExists(ContextRef* relatedContext) {}
 
+ArrayBufferAllocatorDecorator* Platform::currentArrayBufferAllocator() {
+  auto lwIsolate = IsolateWrap::GetCurrent();
+  if (LWNODE_LIKELY(lwIsolate != nullptr &&
+                    lwIsolate->array_buffer_allocator_decorator())) {
+    return lwIsolate->array_buffer_allocator_decorator();
+  }
+  return defaultArrayBufferDecorator_;
+}
+
+void* Platform::allocateData(ArrayBufferAllocatorDecorator* allocator,
+                            size_t length) {
+  if (isPooled(length)) {
+    void* data = allocator->Allocate(length);
+    if (LWNODE_LIKELY(data != nullptr)) {
+      ArrayBufferPool::setOwner(data, allocator);
+      allocator->ref();
+    }
+    return data;
+  }
+
+  auto header =
+      static_cast<char*>(allocator->Allocate(kOwnerHeaderSize + length));
+  if (LWNODE_UNLIKELY(header == nullptr)) {
+    return nullptr;
+  }
+  *reinterpret_cast<ArrayBufferAllocatorDecorator**>(header) = allocator;
+  allocator->ref();
+  return header + kOwnerHeaderSize;
+}
+
+ArrayBufferAllocatorDecorator* Platform::ownerOf(void* data, size_t length) {
+  if (isPooled(length)) {
+    return static_cast<ArrayBufferAllocatorDecorator*>(
+        ArrayBufferPool::ownerOf(data));
+  }
+  return *reinterpret_cast<ArrayBufferAllocatorDecorator**>(
+      static_cast<char*>(data) - kOwnerHeaderSize);
+}
+
+void Platform::freeData(ArrayBufferAllocatorDecorator* allocator,
+                        void* data,
+                        size_t length) {
+  if (isPooled(length)) {
+    allocator->Free(data, length);
+  } else {
+    allocator->Free(static_cast<char*>(data) - kOwnerHeaderSize,
+                    kOwnerHeaderSize + length);
+  }
+  allocator->deref();
+}
+
 void* Platform::onMallocArrayBufferObjectDataBuffer(size_t sizeInByte) {
-  return allocator_->Allocate(sizeInByte);
+  return allocateData(currentArrayBufferAllocator(), sizeInByte);
 }
 
 void Platform::onFreeArrayBufferObjectDataBuffer(void* buffer,
                                                  size_t sizeInByte) {
-  return allocator_->Free(buffer, sizeInByte);
+  if (buffer == nullptr) {
+    return;
+  }
+  freeData(ownerOf(buffer, sizeInByte), buffer, sizeInByte);
 }
 
 void* Platform::onReallocArrayBufferObjectDataBuffer(void* oldBuffer,
                                                      size_t oldSizeInByte,
                                                      size_t newSizeInByte) {
-  return allocator_->Reallocate(oldBuffer, oldSizeInByte, newSizeInByte);
+  if (oldBuffer == nullptr) {
+    return onMallocArrayBufferObjectDataBuffer(newSizeInByte);
+  }
+
+  // The data stays with its allocator. It is moved since the header, or the
+  // slab, of the new data may differ from the old one.
+  auto allocator = ownerOf(oldBuffer, oldSizeInByte);
+  void* newBuffer = allocateData(allocator, newSizeInByte);
+  if (LWNODE_UNLIKELY(newBuffer == nullptr && newSizeInByte > 0)) {
+    // The old data is left as it was.
+    return nullptr;
+  }
+  if (newBuffer != nullptr) {
+    memcpy(newBuffer, oldBuffer, std::min(oldSizeInByte, newSizeInByte));
+  }
+  freeData(allocator, oldBuffer, oldSizeInByte);
+  return newBuffer;
 }
 
 PlatformRef::LoadModuleResult Platform::onLoadModule(
@@ -209,6 +299,17 @@ bool GCHeap::isTraced(void* address) {
   return false;
 }
 
+void GCHeap::iteratePersistents(
+    const std::function<void(void* address, const AddressInfo& info)>&
+        visitor) {
+  for (const HeapSegment& it : persistents_) {
+    visitor(GC_UNWRAP_PERSISTENT_POINTER(it.first), it.second);
+  }
+  for (const HeapSegment& it : weakPhantoms_) {
+    visitor(GC_UNWRAP_WEAK_POINTER(it.first), it.second);
+  }
+}
+
 void GCHeap::disposePhantomWeak(void* address) {
   LWNODE_CALL_TRACE_ID(
       GCHEAP,
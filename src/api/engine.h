@@ -19,6 +19,7 @@
 #include <EscargotPublic.h>
 #include <string.h>
 #include <v8.h>
+#include <functional>
 #include <thread>
 #include <vector>
 
@@ -28,6 +29,8 @@ using namespace Escargot;
 
 namespace EscargotShim {
 
+class ArrayBufferAllocatorDecorator;
+
 class Platform : public PlatformRef {
  public:
   static Platform* GetInstance();
@@ -63,13 +66,30 @@ class Platform : public PlatformRef {
                          PersistentRefHolder<ScriptRef>>>
       loadedModules;
 
-  void setAllocator(v8::ArrayBuffer::Allocator* allocator) {
-    allocator_ = allocator;
-  }
 
  private:
-  Platform() = default;
-  v8::ArrayBuffer::Allocator* allocator_ = nullptr;
+  Platform();
+
+  ArrayBufferAllocatorDecorator* currentArrayBufferAllocator();
+
+  /*
+    ArrayBuffer data is allocated by the allocator of the isolate entered on
+    the calling thread, and freed by the allocator it came from. Escargot
+    doesn't tell which isolate data belongs to when it is freed, which may
+    happen on another thread (e.g. a transferred buffer), so the allocator
+    is recorded with the data: in the slab of a pooled block, and in a
+    header in front of any other data.
+  */
+  static void* allocateData(ArrayBufferAllocatorDecorator* allocator,
+                            size_t length);
+  static ArrayBufferAllocatorDecorator* ownerOf(void* data, size_t length);
+  static void freeData(ArrayBufferAllocatorDecorator* allocator,
+                       void* data,
+                       size_t length);
+
+  v8::ArrayBuffer::Allocator* defaultArrayBufferAllocator_ = nullptr;
+  // Used on threads without an entered isolate
+  ArrayBufferAllocatorDecorator* defaultArrayBufferDecorator_ = nullptr;
 };
 
 class GCHeap : public gc {
@@ -113,6 +133,11 @@ class GCHeap : public gc {
   void postGarbageCollectionProcessing();
   static void processGCEvent(void* data);
 
+  // Visit persistent handles which are either strong or weak.
+  void iteratePersistents(
+      const std::function<void(void* address, const AddressInfo& info)>&
+          visitor);
+
   static GCHeap* create() { return new GCHeap(); }
 
  private:
@@ -23,6 +23,14 @@ namespace EscargotShim {
   T(DataCloneErrorOutOfMemory,                                                 \
     RangeError,                                                                \
     "Data cannot be cloned, out of memory.")                                   \
+  T(DataCloneError, None, "Data cannot be cloned.")                           \
+  T(DataCloneDeserializationError,                                             \
+    None,                                                                      \
+    "Unable to deserialize cloned data.")                                      \
+  T(DataCloneDeserializationVersionError,                                      \
+    None,                                                                      \
+    "Unable to deserialize cloned data due to invalid or unsupported "         \
+    "version.")                                                                \
   T(InternalFieldsOutOfRange, RangeError, "Internal field out of bounds.")     \
   T(NotReadValue, RangeError, "Cannot read value")                             \
   T(IllegalInvocation, TypeError, "Illegal invocation")                        \
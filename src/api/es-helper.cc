@@ -42,6 +42,29 @@ EvalResult::EvalResult(EvalResult&& src)
 
 // --- ObjectRefHelper ---
 
+// Returns the execution state to run an operation on |object| with, without
+// entering a sandbox. nullptr is returned unless the operation is requested
+// from a native callback and can't run JavaScript code or throw.
+static ExecutionStateRef* getSandboxFreeState(ContextRef* context,
+                                              ObjectRef* object) {
+  auto state = IsolateWrap::GetCurrent()->callbackState();
+  if (state == nullptr || state->context() != context ||
+      !ObjectRefHelper::isOrdinaryObject(object)) {
+    return nullptr;
+  }
+  return state;
+}
+
+static bool isPropertyKey(ValueRef* key) {
+  return key->isString() || key->isSymbol() || key->isUInt32();
+}
+
+static EvalResult createSuccessfulResult(ValueRef* value) {
+  EvalResult r;
+  r.result = value;
+  return r;
+}
+
 ObjectRef* ObjectRefHelper::create(ContextRef* context) {
   EvalResult r =
       Evaluator::execute(context, [](ExecutionStateRef* state) -> ValueRef* {
@@ -61,6 +84,10 @@ EvalResult ObjectRefHelper::setProperty(ContextRef* context,
   LWNODE_DCHECK_NOT_NULL(key);
   LWNODE_DCHECK_NOT_NULL(value);
 
+  // NOTE: Unlike hasOwnProperty, this always enters the sandbox. Any
+  // property may be an accessor that runs JavaScript, and the engine API
+  // can't tell a data property from an accessor without allocating a
+  // descriptor object, which costs more than the sandbox.
   return Evaluator::execute(
       context,
       [](ExecutionStateRef* state,
@@ -160,6 +187,7 @@ EvalResult ObjectRefHelper::getProperty(ContextRef* context,
   LWNODE_DCHECK_NOT_NULL(object);
   LWNODE_DCHECK_NOT_NULL(key);
 
+  // NOTE: This always enters the sandbox, see setProperty().
   return Evaluator::execute(
       context,
       [](ExecutionStateRef* esState,
@@ -203,6 +231,12 @@ EvalResult ObjectRefHelper::hasOwnProperty(ContextRef* context,
   LWNODE_DCHECK_NOT_NULL(object);
   LWNODE_DCHECK_NOT_NULL(key);
 
+  auto state = getSandboxFreeState(context, object);
+  if (state && isPropertyKey(key)) {
+    return createSuccessfulResult(
+        ValueRef::create(object->hasOwnProperty(state, key)));
+  }
+
   return Evaluator::execute(
       context,
       [](ExecutionStateRef* state,
@@ -255,33 +289,6 @@ EvalResult ObjectRefHelper::deleteProperty(ContextRef* context,
       key);
 }
 
-EvalResult ObjectRefHelper::deletePrivateProperty(ContextRef* context,
-                                                  SymbolRef* privateValueSymbol,
-                                                  ObjectRef* object,
-                                                  ValueRef* key) {
-  LWNODE_DCHECK_NOT_NULL(object);
-  LWNODE_DCHECK_NOT_NULL(key);
-
-  return Evaluator::execute(
-      context,
-      [](ExecutionStateRef* state,
-         SymbolRef* privateValueSymbol,
-         ObjectRef* object,
-         ValueRef* key) -> ValueRef* {
-        ValueRef* privateValuesObj = object->get(state, privateValueSymbol);
-
-        if (privateValuesObj->isUndefined()) {
-          return ValueRef::create(false);
-        }
-
-        return ValueRef::create(
-            privateValuesObj->asObject()->deleteProperty(state, key));
-      },
-      privateValueSymbol,
-      object,
-      key);
-}
-
 EvalResult ObjectRefHelper::defineAccessorProperty(
     ContextRef* context,
     ObjectRef* object,
@@ -308,7 +315,16 @@ EvalResult ObjectRefHelper::defineDataProperty(
     ObjectRef* object,
     ValueRef* propertyName,
     const ObjectRef::DataPropertyDescriptor& descriptor) {
-  LWNODE_DCHECK(propertyName->isSymbol() || propertyName->isString());
+  LWNODE_DCHECK(propertyName->isSymbol() || propertyName->isString() ||
+                propertyName->isUInt32());
+
+  // [[DefineOwnProperty]] of an ordinary object doesn't throw, but reports a
+  // failure with false.
+  auto state = getSandboxFreeState(context, object);
+  if (state) {
+    return createSuccessfulResult(ValueRef::create(
+        object->defineDataProperty(state, propertyName, descriptor)));
+  }
 
   return Evaluator::execute(
       context,
@@ -324,6 +340,57 @@ EvalResult ObjectRefHelper::defineDataProperty(
       descriptor);
 }
 
+static bool defineDataPropertiesWith(
+    ExecutionStateRef* state,
+    ObjectRef* object,
+    size_t count,
+    ValueRef* const* keys,
+    ValueRef* const* values,
+    const ObjectRef::PresentAttribute* attributes) {
+  for (size_t i = 0; i < count; i++) {
+    LWNODE_DCHECK(keys[i]->isSymbol() || keys[i]->isString() ||
+                  keys[i]->isUInt32());
+    if (!object->defineDataProperty(
+            state,
+            keys[i],
+            ObjectRef::DataPropertyDescriptor(values[i], attributes[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+EvalResult ObjectRefHelper::defineDataProperties(
+    ContextRef* context,
+    ObjectRef* object,
+    size_t count,
+    ValueRef* const* keys,
+    ValueRef* const* values,
+    const ObjectRef::PresentAttribute* attributes) {
+  auto state = getSandboxFreeState(context, object);
+  if (state) {
+    return createSuccessfulResult(ValueRef::create(defineDataPropertiesWith(
+        state, object, count, keys, values, attributes)));
+  }
+
+  return Evaluator::execute(
+      context,
+      [](ExecutionStateRef* state,
+         ObjectRef* object,
+         size_t count,
+         ValueRef* const* keys,
+         ValueRef* const* values,
+         const ObjectRef::PresentAttribute* attributes) -> ValueRef* {
+        return ValueRef::create(defineDataPropertiesWith(
+            state, object, count, keys, values, attributes));
+      },
+      object,
+      count,
+      keys,
+      values,
+      attributes);
+}
+
 ObjectRef* ObjectRefHelper::getPrototype(ContextRef* context,
                                          ObjectRef* object) {
   EvalResult r = Evaluator::execute(
@@ -357,80 +424,74 @@ EvalResult ObjectRefHelper::setPrototype(ContextRef* context,
   return r;
 }
 
-EvalResult ObjectRefHelper::getPrivate(ContextRef* context,
-                                       SymbolRef* privateValueSymbol,
-                                       ObjectRef* object,
-                                       ValueRef* key) {
-  return Evaluator::execute(
-      context,
-      [](ExecutionStateRef* state,
-         SymbolRef* privateValueSymbol,
-         ObjectRef* object,
-         ValueRef* key) -> ValueRef* {
-        ValueRef* hiddenValuesRef =
-            object->getOwnProperty(state, privateValueSymbol);
-
-        if (hiddenValuesRef->isUndefined()) {
-          return ValueRef::createUndefined();
-        }
+ValueRef* ObjectRefHelper::getPrivate(ObjectRef* object, ValueRef* key) {
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (extraData) {
+    auto value = extraData->getPrivate(key);
+    if (value) {
+      return value;
+    }
+  }
+  return ValueRef::createUndefined();
+}
 
-        return ValueRef::create(hiddenValuesRef->asObject()->get(state, key));
-      },
-      privateValueSymbol,
-      object,
-      key);
+bool ObjectRefHelper::hasPrivate(ObjectRef* object, ValueRef* key) {
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  return extraData && extraData->hasPrivate(key);
 }
 
-EvalResult ObjectRefHelper::setPrivate(ContextRef* context,
-                                       SymbolRef* privateValueSymbol,
-                                       ObjectRef* object,
-                                       ValueRef* key,
-                                       ValueRef* value) {
+void ObjectRefHelper::setPrivate(ObjectRef* object,
+                                 ValueRef* key,
+                                 ValueRef* value) {
   LWNODE_CHECK(key->isSymbol());
 
-  return Evaluator::execute(
-      context,
-      [](ExecutionStateRef* state,
-         ContextRef* context,
-         SymbolRef* privateValueSymbol,
-         ObjectRef* object,
-         ValueRef* key,
-         ValueRef* value) -> ValueRef* {
-        ValueRef* hiddenValuesRef = object->get(state, privateValueSymbol);
-
-        ObjectRef* hiddenValuesObject = nullptr;
-
-        if (hiddenValuesRef->isUndefined()) {
-          // 'PRIVATE_SYMBOL_KEY' doesn't exist. create it.
-          hiddenValuesObject = ObjectRef::create(state);
-
-          auto result =
-              defineDataProperty(
-                  context,
-                  object,
-                  privateValueSymbol,
-                  ObjectRef::DataPropertyDescriptor(
-                      hiddenValuesObject,
-                      static_cast<ObjectRef::PresentAttribute>(
-                          ObjectRef::PresentAttribute::WritablePresent |
-                          ObjectRef::PresentAttribute::NonEnumerablePresent |
-                          ObjectRef::PresentAttribute::NonConfigurablePresent)))
-                  .isSuccessful();
-
-          LWNODE_DCHECK(result);
-        } else {
-          hiddenValuesObject = hiddenValuesRef->asObject();
-        }
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (extraData == nullptr) {
+    extraData = new PrivateValuesData();
+    object->setExtraData(extraData);
+  }
+  extraData->setPrivate(key, value);
+}
 
-        hiddenValuesObject->set(state, key, value);
+bool ObjectRefHelper::deletePrivate(ObjectRef* object, ValueRef* key) {
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (extraData) {
+    return extraData->deletePrivate(key);
+  }
+  return true;
+}
 
-        return ValueRef::create(true);
-      },
-      context,
-      privateValueSymbol,
-      object,
-      key,
-      value);
+// Private values belong to the object, not to its extra data, so they are
+// carried over whenever the extra data is replaced.
+static void replaceExtraData(ObjectRef* object, ExtraData* data) {
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (extraData) {
+    extraData->movePrivateValuesTo(data);
+  }
+  object->setExtraData(data);
+}
+
+bool ObjectRefHelper::isOrdinaryObject(ObjectRef* object) {
+  if (object->isProxyObject() || object->isArrayObject() ||
+      object->isTypedArrayObject() || object->isModuleNamespaceObject()) {
+    return false;
+  }
+
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (extraData == nullptr || extraData->isPrivateValuesData()) {
+    return true;
+  }
+  if (!extraData->isObjectData() || extraData->isGlobalObjectData()) {
+    return false;
+  }
+
+  auto objectTemplate = extraData->asObjectData()->objectTemplate();
+  if (objectTemplate == nullptr) {
+    return true;
+  }
+  auto objectTemplateData =
+      ExtraDataHelper::getObjectTemplateExtraData(objectTemplate);
+  return objectTemplateData && !objectTemplateData->hasPropertyHandler();
 }
 
 bool ObjectRefHelper::hasExtraData(ObjectRef* object) {
@@ -443,12 +504,14 @@ bool ObjectRefHelper::hasExtraData(ObjectRef* object) {
 void ObjectRefHelper::setExtraData(ObjectRef* object,
                                    ObjectData* data,
                                    bool isForceReplace) {
-  if (isForceReplace == false && object->extraData()) {
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (isForceReplace == false && extraData &&
+      !extraData->isPrivateValuesData()) {
     LWNODE_DLOG_WARN(
         "Replacing already existing extra data. Is this intended?");
   }
 
-  object->setExtraData(data);
+  replaceExtraData(object, data);
 }
 
 ObjectData* ObjectRefHelper::getExtraData(ObjectRef* object) {
@@ -593,6 +656,66 @@ void ArrayObjectRefHelper::set(ContextRef* context,
   LWNODE_CHECK(result.isSuccessful());
 }
 
+EvalResult ArrayObjectRefHelper::getElements(ContextRef* context,
+                                             ArrayObjectRef* object,
+                                             uint32_t length,
+                                             GCVector<ValueRef*>* elements) {
+  elements->clear();
+  elements->reserve(length);
+
+  return Evaluator::execute(
+      context,
+      [](ExecutionStateRef* state,
+         ArrayObjectRef* object,
+         uint32_t length,
+         GCVector<ValueRef*>* elements) -> ValueRef* {
+        // Only own elements are read, so a hole is never filled from the
+        // prototype chain.
+        for (uint32_t i = 0; i < length; i++) {
+          auto index = ValueRef::create(i);
+          if (!object->hasOwnProperty(state, index)) {
+            elements->push_back(nullptr);
+            continue;
+          }
+          elements->push_back(object->getOwnProperty(state, index));
+        }
+        return ValueRef::createUndefined();
+      },
+      object,
+      length,
+      elements);
+}
+
+EvalResult ArrayObjectRefHelper::setElements(
+    ContextRef* context,
+    ArrayObjectRef* object,
+    const GCVector<ValueRef*>& elements) {
+  return Evaluator::execute(
+      context,
+      [](ExecutionStateRef* state,
+         ArrayObjectRef* object,
+         const GCVector<ValueRef*>* elements) -> ValueRef* {
+        // The elements are defined as own data properties, so neither a
+        // setter on the prototype chain nor a frozen prototype gets in the
+        // way, as with CreateDataProperty in V8.
+        auto attribute = static_cast<ObjectRef::PresentAttribute>(
+            ObjectRef::PresentAttribute::WritablePresent |
+            ObjectRef::PresentAttribute::EnumerablePresent |
+            ObjectRef::PresentAttribute::ConfigurablePresent);
+        for (size_t i = 0; i < elements->size(); i++) {
+          if ((*elements)[i]) {
+            object->defineDataProperty(
+                state,
+                ValueRef::create((uint32_t)i),
+                ObjectRef::DataPropertyDescriptor((*elements)[i], attribute));
+          }
+        }
+        return ValueRef::createUndefined();
+      },
+      object,
+      &elements);
+}
+
 static std::string getCodeLine(const std::string& codeString, int errorLine) {
   if (errorLine < 1 || codeString.empty()) {
     return "";
@@ -852,26 +975,42 @@ void EvalResultHelper::attachBuiltinPrint(ContextRef* context,
 
 int ObjectRefHelper::getInternalFieldCount(ObjectRef* object) {
   auto data = getExtraData(object);
-  if (data == nullptr) {
+  if (data == nullptr || !data->isInternalFieldData()) {
     return 0;
   }
   return data->internalFieldCount();
 }
 
+// The embedder may pass any index, so it is checked here instead of in
+// InternalFieldData.
+static ObjectData* getInternalFieldData(ObjectRef* object,
+                                        int idx,
+                                        const char* location) {
+  auto data = ObjectRefHelper::getExtraData(object);
+  LWNODE_CHECK_NOT_NULL(data);
+
+  if (LWNODE_UNLIKELY(!data->isInternalFieldData() ||
+                      !data->isValidIndex(idx))) {
+    IsolateWrap::GetCurrent()->onFatalError(location,
+                                            "Internal field out of bounds");
+    return nullptr;
+  }
+  return data;
+}
+
 void ObjectRefHelper::setInternalField(ObjectRef* object,
                                        int idx,
                                        InternalField* lwValue) {
-  auto data = getExtraData(object);
-  LWNODE_CHECK_NOT_NULL(data);
-
-  data->setInternalField(idx, lwValue);
+  auto data = getInternalFieldData(object, idx, "v8::Object::SetInternalField");
+  if (data) {
+    data->setInternalField(idx, lwValue);
+  }
 }
 
 InternalField* ObjectRefHelper::getInternalField(ObjectRef* object, int idx) {
-  auto data = getExtraData(object);
-  LWNODE_CHECK_NOT_NULL(data);
-
-  auto field = reinterpret_cast<InternalField*>(data->internalField(idx));
+  auto data = getInternalFieldData(object, idx, "v8::Object::GetInternalField");
+  auto field = data ? reinterpret_cast<InternalField*>(data->internalField(idx))
+                    : nullptr;
   if (!field) {
     return IsolateWrap::GetCurrent()->undefined_value();
   }
@@ -882,19 +1021,17 @@ InternalField* ObjectRefHelper::getInternalField(ObjectRef* object, int idx) {
 void ObjectRefHelper::setInternalPointer(ObjectRef* object,
                                          int idx,
                                          void* ptr) {
-  auto data = getExtraData(object);
-  LWNODE_CHECK_NOT_NULL(data);
-
-  data->setInternalField(idx, ptr);
+  auto data = getInternalFieldData(
+      object, idx, "v8::Object::SetAlignedPointerInInternalField");
+  if (data) {
+    data->setInternalField(idx, ptr);
+  }
 }
 
 void* ObjectRefHelper::getInternalPointer(ObjectRef* object, int idx) {
-  auto extraData = getExtraData(object);
-  LWNODE_CHECK_NOT_NULL(extraData);
-
-  auto data = extraData->internalField(idx);
-
-  return data;
+  auto data = getInternalFieldData(
+      object, idx, "v8::Object::GetAlignedPointerFromInternalField");
+  return data ? data->internalField(idx) : nullptr;
 }
 
 // --- ExtraDataHelper ---
@@ -922,36 +1059,36 @@ void ExtraDataHelper::setExtraData(FunctionTemplateRef* ftpl,
 void ExtraDataHelper::setExtraData(FunctionObjectRef* functionObject,
                                    FunctionData* data,
                                    bool force) {
-  auto extraData = functionObject->extraData();
-  if (!force && extraData) {
+  auto extraData = getExtraData(functionObject);
+  if (!force && extraData && !extraData->isPrivateValuesData()) {
     LWNODE_DLOG_WARN("Replacing ExtraData: Is this intended?");
   }
-  functionObject->setExtraData(data);
+  replaceExtraData(functionObject, data);
 }
 
 void ExtraDataHelper::setExtraData(ObjectRef* exceptionObject,
                                    ExceptionObjectData* data) {
-  auto extraData = exceptionObject->extraData();
-  if (extraData) {
+  auto extraData = getExtraData(exceptionObject);
+  if (extraData && !extraData->isPrivateValuesData()) {
     LWNODE_DLOG_WARN("Replacing ExtraData: Is this intended?");
   }
-  exceptionObject->setExtraData(data);
+  replaceExtraData(exceptionObject, data);
 }
 
 void ExtraDataHelper::setExtraData(ObjectRef* callSite, StackTraceData* data) {
-  auto extraData = callSite->extraData();
-  if (extraData) {
+  auto extraData = getExtraData(callSite);
+  if (extraData && !extraData->isPrivateValuesData()) {
     LWNODE_DLOG_WARN("Replacing ExtraData: Is this intended?");
   }
-  callSite->setExtraData(data);
+  replaceExtraData(callSite, data);
 }
 
 void ExtraDataHelper::setExtraData(ObjectRef* object, ObjectData* data) {
-  auto extraData = object->extraData();
-  if (extraData) {
+  auto extraData = getExtraData(object);
+  if (extraData && !extraData->isPrivateValuesData()) {
     LWNODE_DLOG_WARN("Replacing ExtraData: Is this intended?");
   }
-  object->setExtraData(data);
+  replaceExtraData(object, data);
 }
 
 void ObjectTemplateRefHelper::setInternalFieldCount(ObjectTemplateRef* otpl,
@@ -1011,9 +1148,10 @@ void ExceptionHelper::addStackPropertyCallback(ExecutionStateRef* state,
     return;
   }
 
+  // Only the frames are kept; CallSites and the string are made on demand.
   StackTrace stackTrace(state, error->asObject());
-  auto sites = stackTrace.genCallSites(state->computeStackTrace());
-  stackTrace.addStackProperty(sites);
+  stackTrace.addStackProperty(
+      stackTrace.captureFrames(state->computeStackTrace()));
 }
 
 // --- StringRefHelper ---
@@ -1050,4 +1188,76 @@ bool StringRefHelper::isOneByteString(StringRef* str) {
   return true;
 }
 
+size_t StringRefHelper::hash(StringRef* str) {
+  auto bufferData = str->stringBufferAccessData();
+
+  // FNV-1a
+  size_t hash = 2166136261u;
+  for (size_t i = 0; i < bufferData.length; i++) {
+    hash ^= bufferData.charAt(i);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// --- StringRefBuilder ---
+
+void StringRefBuilder::append(StringRef* string) {
+  auto bufferData = string->stringBufferAccessData();
+
+  if (!bufferData.has8BitContent) {
+    if (is8Bit_) {
+      widen();
+    }
+    utf16_.append(reinterpret_cast<const char16_t*>(bufferData.buffer),
+                  bufferData.length);
+    return;
+  }
+
+  auto buffer = reinterpret_cast<const char*>(bufferData.buffer);
+  if (is8Bit_) {
+    latin1_.append(buffer, bufferData.length);
+  } else {
+    for (size_t i = 0; i < bufferData.length; i++) {
+      utf16_.push_back(static_cast<uint8_t>(buffer[i]));
+    }
+  }
+}
+
+void StringRefBuilder::append(const char* ascii, size_t length) {
+  if (is8Bit_) {
+    latin1_.append(ascii, length);
+  } else {
+    utf16_.append(ascii, ascii + length);
+  }
+}
+
+void StringRefBuilder::appendNumber(size_t number) {
+  char digits[24];
+  size_t start = sizeof(digits);
+  do {
+    digits[--start] = '0' + (number % 10);
+    number /= 10;
+  } while (number > 0);
+  append(digits + start, sizeof(digits) - start);
+}
+
+void StringRefBuilder::widen() {
+  is8Bit_ = false;
+  utf16_.reserve(latin1_.length());
+  for (char c : latin1_) {
+    utf16_.push_back(static_cast<uint8_t>(c));
+  }
+  latin1_.clear();
+}
+
+StringRef* StringRefBuilder::finalize() {
+  if (is8Bit_) {
+    return StringRef::createFromLatin1(
+        reinterpret_cast<const unsigned char*>(latin1_.data()),
+        latin1_.length());
+  }
+  return StringRef::createFromUTF16(utf16_.data(), utf16_.length());
+}
+
 }  // namespace EscargotShim
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <EscargotPublic.h>
+#include <string>
 #include "extra-data.h"
 #include "utils/gc-util.h"
 
@@ -91,31 +92,34 @@ class ObjectRefHelper {
                                           ObjectRef* object,
                                           uint32_t index);
 
-  static EvalResult getPrivate(ContextRef* context,
-                               SymbolRef* privateValueSymbol,
-                               ObjectRef* object,
-                               ValueRef* key);
-  static EvalResult setPrivate(ContextRef* context,
-                               SymbolRef* privateValueSymbol,
-                               ObjectRef* object,
-                               ValueRef* key,
-                               ValueRef* value);
+  // Private values are kept in the extra data of an object, so they are
+  // neither visible nor observable from JavaScript.
+  static ValueRef* getPrivate(ObjectRef* object, ValueRef* key);
+  static bool hasPrivate(ObjectRef* object, ValueRef* key);
+  static void setPrivate(ObjectRef* object, ValueRef* key, ValueRef* value);
+  static bool deletePrivate(ObjectRef* object, ValueRef* key);
 
   static EvalResult deleteProperty(ContextRef* context,
                                    ObjectRef* object,
                                    ValueRef* key);
 
-  static EvalResult deletePrivateProperty(ContextRef* context,
-                                          SymbolRef* privateValueSymbol,
-                                          ObjectRef* object,
-                                          ValueRef* key);
-
   static EvalResult defineDataProperty(
       ContextRef* context,
       ObjectRef* object,
       ValueRef* propertyName,
       const ObjectRef::DataPropertyDescriptor& descriptor);
 
+  // Define |count| data properties in a single engine entry. |attributes|
+  // holds one attribute per property. The result is false if a definition
+  // fails, and the rest are skipped.
+  static EvalResult defineDataProperties(
+      ContextRef* context,
+      ObjectRef* object,
+      size_t count,
+      ValueRef* const* keys,
+      ValueRef* const* values,
+      const ObjectRef::PresentAttribute* attributes);
+
   static EvalResult defineAccessorProperty(
       ContextRef* context,
       ObjectRef* object,
@@ -126,6 +130,11 @@ class ObjectRefHelper {
                            ObjectData* data,
                            bool isForceReplace = false);
   static bool hasExtraData(ObjectRef* object);
+
+  // True if looking up or defining own properties of |object| can't run
+  // JavaScript code or throw, i.e. it is neither a proxy, an exotic object
+  // nor an instance of a template with property handlers.
+  static bool isOrdinaryObject(ObjectRef* object);
   static ObjectData* getExtraData(ObjectRef* object);
 
   static int getInternalFieldCount(ObjectRef* object);
@@ -163,6 +172,18 @@ class ArrayObjectRefHelper {
                   ArrayObjectRef* object,
                   ValueRef::ValueIndex index,
                   ValueRef* value);
+
+  // Get the first |length| own elements in a single engine entry. A hole is
+  // stored as nullptr.
+  static EvalResult getElements(ContextRef* context,
+                                ArrayObjectRef* object,
+                                uint32_t length,
+                                GCVector<ValueRef*>* elements);
+  // Set |elements| from index 0 in a single engine entry. nullptr is left
+  // as a hole.
+  static EvalResult setElements(ContextRef* context,
+                                ArrayObjectRef* object,
+                                const GCVector<ValueRef*>& elements);
 };
 
 class ObjectTemplateData;
@@ -262,7 +283,7 @@ class ArrayBufferHelper {
 
   template <class T>
   static ArrayBufferViewRef* createView(ContextRef* context,
-                                        ArrayBufferObjectRef* abo,
+                                        ArrayBufferRef* abo,
                                         size_t byteOffset,
                                         size_t arrayLength,
                                         ArrayType type) {
@@ -347,6 +368,32 @@ class StringRefHelper {
 
   static bool isAsciiString(StringRef* str);
   static bool isOneByteString(StringRef* str);
+
+  // Content hash; equal strings have equal hashes.
+  static size_t hash(StringRef* str);
+};
+
+// Builds a StringRef out of pieces without a round trip through UTF-8. The
+// content stays one byte per character until a two-byte string is appended.
+class StringRefBuilder {
+ public:
+  void append(StringRef* string);
+  void append(const char* ascii, size_t length);
+  template <size_t N>
+  void append(const char (&ascii)[N]) {
+    append(ascii, N - 1);
+  }
+  void appendNumber(size_t number);
+
+  bool isEmpty() const { return latin1_.empty() && utf16_.empty(); }
+  StringRef* finalize();
+
+ private:
+  void widen();
+
+  bool is8Bit_ = true;
+  std::string latin1_;
+  std::u16string utf16_;
 };
 
 }  // namespace EscargotShim
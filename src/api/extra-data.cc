@@ -26,8 +26,67 @@ using namespace Escargot;
 
 namespace EscargotShim {
 
-bool InternalFieldData::isValidIndex(int idx) {
-  return 0 <= idx && idx < internalFieldCount();
+int ExtraData::findPrivate(ValueRef* key) {
+  if (privateValues_ == nullptr) {
+    return -1;
+  }
+  for (size_t i = 0; i < privateValues_->size(); i++) {
+    if ((*privateValues_)[i].key == key) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool ExtraData::hasPrivate(ValueRef* key) {
+  return findPrivate(key) >= 0;
+}
+
+ValueRef* ExtraData::getPrivate(ValueRef* key) {
+  int idx = findPrivate(key);
+  if (idx < 0) {
+    return nullptr;
+  }
+  return (*privateValues_)[idx].value;
+}
+
+void ExtraData::setPrivate(ValueRef* key, ValueRef* value) {
+  int idx = findPrivate(key);
+  if (idx >= 0) {
+    (*privateValues_)[idx].value = value;
+    return;
+  }
+
+  if (privateValues_ == nullptr) {
+    privateValues_ = new GCVector<PrivateValue>();
+  }
+  privateValues_->push_back({key, value});
+}
+
+bool ExtraData::deletePrivate(ValueRef* key) {
+  int idx = findPrivate(key);
+  if (idx < 0) {
+    return true;
+  }
+
+  // The order of private values doesn't matter, so the last one fills in.
+  (*privateValues_)[idx] = privateValues_->back();
+  privateValues_->pop_back();
+  return true;
+}
+
+void ExtraData::movePrivateValuesTo(ExtraData* other) {
+  if (privateValues_ == nullptr || other == this) {
+    return;
+  }
+  if (other->privateValues_ == nullptr) {
+    other->privateValues_ = privateValues_;
+  } else {
+    forEachPrivate([other](ValueRef* key, ValueRef* value) {
+      other->setPrivate(key, value);
+    });
+  }
+  privateValues_ = nullptr;
 }
 
 static std::string toObjectDataString(const ObjectData* data,
@@ -49,13 +108,6 @@ static std::string toObjectDataString(const ObjectData* data,
 ObjectData::ObjectData(FunctionObjectRef* functionObject)
     : TemplateData(), functionObject_(functionObject) {}
 
-int InternalFieldData::internalFieldCount() {
-  if (internalFields_ == nullptr) {
-    return 0;
-  }
-  return internalFields_->size();
-}
-
 void InternalFieldData::setInternalFieldCount(int size) {
   LWNODE_CALL_TRACE_ID(OBJDATA, "%d", size);
 
@@ -66,45 +118,17 @@ void InternalFieldData::setInternalFieldCount(int size) {
     return;
   }
 
-  internalFields_ = new GCContainer<void*>(size);
-  for (int i = 0; i < size; i++) {
-    setInternalField(i, nullptr);
-  }
-}
-
-void InternalFieldData::setInternalField(int idx, void* lwValue) {
-  LWNODE_CHECK_NOT_NULL(internalFields_);
-  if (!isValidIndex(idx)) {
-    auto lwIsolate = IsolateWrap::GetCurrent();
-    lwIsolate->onFatalError("InternalFieldData::setInternalField",
-                            "Internal field out of bounds");
-    return;
-  }
-
-  // TODO: Update type
-  // LWNODE_CALL_TRACE_ID(
-  //     OBJDATA, "%s", toObjectDataString(this, idx, lwValue).c_str());
-
-  internalFields_->set(idx, lwValue);
-}
-
-void* InternalFieldData::internalField(int idx) {
-  LWNODE_CHECK_NOT_NULL(internalFields_);
-  if (!isValidIndex(idx)) {
-    auto lwIsolate = IsolateWrap::GetCurrent();
-    lwIsolate->onFatalError("InternalFieldData::internalField",
-                            "Internal field out of bounds");
-    return nullptr;
+  if (size <= kInlineInternalFieldCount) {
+    internalFields_ = inlineInternalFields_;
+  } else {
+    internalFields_ =
+        reinterpret_cast<void**>(Memory::gcMalloc(sizeof(void*) * size));
   }
+  internalFieldCount_ = size;
 
-  void* field = internalFields_->get(idx);
-  if (field) {
-    // TODO: Update type
-    // LWNODE_CALL_TRACE_ID(
-    //     OBJDATA, "%s", toObjectDataString(this, idx, field).c_str());
+  for (int i = 0; i < size; i++) {
+    internalFields_[i] = nullptr;
   }
-
-  return field;
 }
 
 ObjectData::ObjectData(ObjectTemplateRef* objectTemplate)
@@ -192,7 +216,7 @@ bool FunctionData::checkSignature(Escargot::ExecutionStateRef* state,
   // e.g., 1.x();
   // 1 is not created by FunctionTemplate
   auto extraData = ExtraDataHelper::getExtraData(receiver);
-  if (extraData == nullptr) {
+  if (extraData == nullptr || extraData->isPrivateValuesData()) {
     // receiver is not created by functionTemplate.
     return false;
   }
@@ -242,7 +266,7 @@ ExceptionObjectData::ExceptionObjectData(
 GCVector<StackTraceData*>* ExceptionObjectData::stackTrace(
     ObjectRef* exceptionObject) {
   auto extraData = ExtraDataHelper::getExtraData(exceptionObject);
-  if (extraData) {
+  if (extraData && extraData->isExceptionObjectData()) {
     return extraData->asExceptionObjectData()->stackTrace();
   } else {
     // FIXME: Check if missing extradata is ok. We print a warning
@@ -47,6 +47,7 @@ class ExtraData : public gc {
   virtual bool isExceptionObjectData() const { return false; }
   virtual bool isStackTraceData() const { return false; }
   virtual bool isGlobalObjectData() const { return false; }
+  virtual bool isPrivateValuesData() const { return false; }
 
   InternalFieldData* asInternalFieldData() {
     LWNODE_CHECK(isInternalFieldData());
@@ -92,22 +93,85 @@ class ExtraData : public gc {
     LWNODE_CHECK(isStackTraceData());
     return reinterpret_cast<StackTraceData*>(this);
   }
+
+  // Private values (v8::Private) of the object owning this data.
+  // @note keys are private symbols, which are compared by identity.
+  bool hasPrivate(ValueRef* key);
+  ValueRef* getPrivate(ValueRef* key);  // nullptr if not found
+  void setPrivate(ValueRef* key, ValueRef* value);
+  bool deletePrivate(ValueRef* key);
+
+  // Move the private values to |other|, which replaces this data.
+  void movePrivateValuesTo(ExtraData* other);
+
+  template <typename Fn>
+  void forEachPrivate(const Fn& fn) {
+    if (privateValues_ == nullptr) {
+      return;
+    }
+    for (const auto& privateValue : *privateValues_) {
+      fn(privateValue.key, privateValue.value);
+    }
+  }
+
+ private:
+  struct PrivateValue {
+    ValueRef* key;
+    ValueRef* value;
+  };
+
+  int findPrivate(ValueRef* key);
+
+  // Most extra data never has a private value, so the storage is allocated
+  // on the first setPrivate(). A few private values are set on an object, so
+  // a linear search is faster than a property lookup.
+  GCVector<PrivateValue>* privateValues_{nullptr};
+};
+
+// Extra data of an object which has nothing but private values, e.g. a plain
+// object or a function created in JavaScript.
+class PrivateValuesData : public ExtraData {
+ public:
+  bool isPrivateValuesData() const override { return true; }
 };
 
 class InternalFieldData : public ExtraData {
  public:
+  // Fields up to this count are stored in this object itself. Most wrappers
+  // in node have one or two fields.
+  static const int kInlineInternalFieldCount = 2;
+
   InternalFieldData() = default;
   InternalFieldData(int count) { setInternalFieldCount(count); }
+  InternalFieldData(const InternalFieldData&) = delete;
+  InternalFieldData& operator=(const InternalFieldData&) = delete;
+
   bool isInternalFieldData() const override { return true; }
 
-  virtual int internalFieldCount();
-  virtual void setInternalFieldCount(int size);
-  virtual void* internalField(int idx);
-  virtual void setInternalField(int idx, void* lwValue);
+  int internalFieldCount() const { return internalFieldCount_; }
+  void setInternalFieldCount(int size);
+
+  bool isValidIndex(int idx) const {
+    return 0 <= idx && idx < internalFieldCount_;
+  }
+
+  // @note The index isn't checked in release builds. Callers taking an index
+  // from the embedder check it with isValidIndex() first.
+  void* internalField(int idx) {
+    LWNODE_DCHECK(isValidIndex(idx));
+    return internalFields_[idx];
+  }
+
+  void setInternalField(int idx, void* lwValue) {
+    LWNODE_DCHECK(isValidIndex(idx));
+    internalFields_[idx] = lwValue;
+  }
 
  private:
-  bool isValidIndex(int idx);
-  GCContainer<void*>* internalFields_{nullptr};
+  int internalFieldCount_{0};
+  // Points to inlineInternalFields_ or to a separate array for more fields
+  void** internalFields_{nullptr};
+  void* inlineInternalFields_[kInlineInternalFieldCount]{};
 };
 
 class TemplateData : public InternalFieldData {
@@ -149,7 +213,13 @@ class FunctionTemplateData : public TemplateData {
     callbackData_ = callbackData;
   }
 
+  // Templates made by v8::Function::New() are used once, so their functions
+  // aren't cached per context.
+  bool doNotCache() const { return doNotCache_; }
+  void setDoNotCache() { doNotCache_ = true; }
+
  private:
+  bool doNotCache_{false};
   v8::Isolate* isolate_{nullptr};
   v8::FunctionCallback callback_{nullptr};
   v8::Value* callbackData_{nullptr};
@@ -166,7 +236,12 @@ class ObjectTemplateData : public TemplateData {
 
   ObjectData* createObjectData(ObjectTemplateRef* objectTemplate);
 
+  // Named or indexed property handlers (interceptors) are set
+  bool hasPropertyHandler() const { return hasPropertyHandler_; }
+  void setHasPropertyHandler() { hasPropertyHandler_ = true; }
+
  private:
+  bool hasPropertyHandler_{false};
 };
 
 class ObjectData : public TemplateData {
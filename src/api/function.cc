@@ -111,12 +111,15 @@ PropertyCallbackInfoWrap<T>::PropertyCallbackInfoWrap(v8::Isolate* isolate,
           reinterpret_cast<v8::internal::Address*>(m_implicitArgs)) {
   auto lwIsolate = IsolateWrap::fromV8(isolate);
   // m_implicitArgs[F::kShouldThrowOnErrorIndex]; // TODO
-  m_implicitArgs[F::kHolderIndex] = ValueWrap::createValue(holder);
+  auto lwHolder = ValueWrap::createValue(holder);
+  m_implicitArgs[F::kHolderIndex] = lwHolder;
   m_implicitArgs[F::kIsolateIndex] = reinterpret_cast<HandleWrap*>(isolate);
   // m_implicitArgs[F::kReturnValueDefaultValueIndex]; // TODO
   m_implicitArgs[F::kReturnValueIndex] = lwIsolate->defaultReturnValue();
   m_implicitArgs[F::kDataIndex] = data;
-  m_implicitArgs[F::kThisIndex] = ValueWrap::createValue(thisValue);
+  // The receiver is mostly the holder itself, which needs no handle of its own.
+  m_implicitArgs[F::kThisIndex] =
+      thisValue == holder ? lwHolder : ValueWrap::createValue(thisValue);
 }
 
 template <typename T>
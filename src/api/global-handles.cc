@@ -165,6 +165,9 @@ bool GlobalHandles::makeWeak(ValueWrap* lwValue,
                                             embedderFields,
                                             nullptr);
             LWNODE_CHECK_NOT_NULL(globalHandles->isolate_);
+            // The GC may run this in the middle of any callback.
+            CallbackStateScope callbackStateScope(globalHandles->isolate_,
+                                                  nullptr);
             gcObjectInfo->runCallback(info);
           }
 
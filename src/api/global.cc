@@ -44,13 +44,14 @@ void Global::initGlobalObject(ContextWrap* lwContext) {
                                      lwContext);
   ObjectRefHelper::setExtraData(context->globalObject(), globalObjectData);
 
-  initErrorObject(context);
+  initErrorObject(lwContext);
   initEvalObject(context);
 }
 
-void Global::initErrorObject(ContextRef* context) {
-  Evaluator::EvaluatorResult r =
-      Evaluator::execute(context, [](ExecutionStateRef* state) -> ValueRef* {
+void Global::initErrorObject(ContextWrap* lwContext) {
+  Evaluator::EvaluatorResult r = Evaluator::execute(
+      lwContext->get(),
+      [](ExecutionStateRef* state, ContextWrap* lwContext) -> ValueRef* {
         auto errorObject = state->context()
                                ->globalObject()
                                ->get(state, StringRef::createFromASCII("Error"))
@@ -60,13 +61,11 @@ void Global::initErrorObject(ContextRef* context) {
                          StringRef::createFromASCII("captureStackTrace"),
                          StackTrace::createCaptureStackTrace(state));
 
-        // TODO: get number from '--stack-trace-limit' options
-        errorObject->set(state,
-                         StringRef::createFromASCII("stackTraceLimit"),
-                         ValueRef::create(20));
+        StackTrace::defineStackTraceLimit(state, errorObject, lwContext);
 
         return ValueRef::createUndefined();
-      });
+      },
+      lwContext);
 
   LWNODE_CHECK(r.isSuccessful());
 }
@@ -37,7 +37,7 @@ class Global {
  private:
   static std::unique_ptr<Flags> s_flags;
 
-  static void initErrorObject(Escargot::ContextRef* context);
+  static void initErrorObject(ContextWrap* lwContext);
   static void initEvalObject(Escargot::ContextRef* context);
 };
 
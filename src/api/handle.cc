@@ -322,6 +322,9 @@ void PersistentWrap::invokeFinalizer() {
   v8::WeakCallbackInfo<void> data(
       v8Isolate_, parameter_, embedderFields, nullptr);
 
+  // The GC may run this in the middle of any callback.
+  CallbackStateScope callbackStateScope(IsolateWrap::fromV8(v8Isolate_),
+                                        nullptr);
   weak_callback_(data);
 
   isFinalizerCalled = true;
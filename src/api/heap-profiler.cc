@@ -0,0 +1,1241 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "heap-profiler.h"
+
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <deque>
+#include <fstream>
+
+#include "api.h"
+#include "base.h"
+#include "context.h"
+#include "cpu-profiler.h"
+#include "engine.h"
+#include "extra-data.h"
+#include "global.h"
+#include "isolate.h"
+#include "utils/string-util.h"
+
+using namespace Escargot;
+
+namespace EscargotShim {
+
+// Strings longer than this are truncated in node names.
+static const size_t kMaxStringNameLength = 1024;
+
+// --- HeapSnapshotWrap ---
+
+int HeapSnapshotWrap::addString(const std::string& str) {
+  auto it = stringIndices_.find(str);
+  if (it != stringIndices_.end()) {
+    return it->second;
+  }
+
+  int index = strings_.size();
+  strings_.push_back(str);
+  stringIndices_.emplace(str, index);
+  return index;
+}
+
+int HeapSnapshotWrap::addNode(v8::HeapGraphNode::Type type,
+                              const std::string& name,
+                              v8::SnapshotObjectId id,
+                              size_t selfSize) {
+  int index = nodes_.size();
+  nodes_.emplace_back(this, type, addString(name), id, selfSize);
+  nodeIndices_.emplace(id, index);
+  maxObjectId_ = std::max(maxObjectId_, id);
+  return index;
+}
+
+void HeapSnapshotWrap::addEdge(v8::HeapGraphEdge::Type type,
+                               const std::string& name,
+                               int from,
+                               int to) {
+  nodes_[from].addEdge(
+      HeapGraphEdgeWrap(this, type, addString(name), from, to));
+}
+
+void HeapSnapshotWrap::addEdge(v8::HeapGraphEdge::Type type,
+                               int index,
+                               int from,
+                               int to) {
+  nodes_[from].addEdge(HeapGraphEdgeWrap(this, type, index, from, to));
+}
+
+const HeapGraphNodeWrap* HeapSnapshotWrap::nodeById(
+    v8::SnapshotObjectId id) const {
+  auto it = nodeIndices_.find(id);
+  if (it != nodeIndices_.end()) {
+    return &nodes_[it->second];
+  }
+  return nullptr;
+}
+
+v8::SnapshotObjectId HeapSnapshotWrap::maxObjectId() const {
+  return maxObjectId_;
+}
+
+class ChunkedWriter {
+ public:
+  explicit ChunkedWriter(v8::OutputStream* stream)
+      : stream_(stream), chunkSize_(std::max(stream->GetChunkSize(), 64)) {
+    buffer_.reserve(chunkSize_ * 2);
+  }
+
+  std::string& buffer() { return buffer_; }
+
+  // Returns false if the stream aborted.
+  bool flushIfNeeded() {
+    if (buffer_.size() < static_cast<size_t>(chunkSize_)) {
+      return !aborted_;
+    }
+    return flush();
+  }
+
+  bool flush() {
+    if (aborted_ || buffer_.empty()) {
+      return !aborted_;
+    }
+    if (stream_->WriteAsciiChunk(&buffer_[0], buffer_.size()) ==
+        v8::OutputStream::kAbort) {
+      aborted_ = true;
+    }
+    buffer_.clear();
+    return !aborted_;
+  }
+
+  void finish() {
+    if (flush()) {
+      stream_->EndOfStream();
+    }
+  }
+
+ private:
+  v8::OutputStream* stream_;
+  int chunkSize_;
+  std::string buffer_;
+  bool aborted_ = false;
+};
+
+static const int kNodeFieldCount = 6;
+
+void HeapSnapshotWrap::serialize(v8::OutputStream* stream) const {
+  ChunkedWriter writer(stream);
+  std::string& out = writer.buffer();
+
+  size_t edgeCount = 0;
+  for (const auto& node : nodes_) {
+    edgeCount += node.edges().size();
+  }
+
+  out +=
+      "{\"snapshot\":{\"meta\":{"
+      "\"node_fields\":[\"type\",\"name\",\"id\",\"self_size\","
+      "\"edge_count\",\"trace_node_id\"],"
+      "\"node_types\":[[\"hidden\",\"array\",\"string\",\"object\",\"code\","
+      "\"closure\",\"regexp\",\"number\",\"native\",\"synthetic\","
+      "\"concatenated string\",\"sliced string\",\"symbol\",\"bigint\"],"
+      "\"string\",\"number\",\"number\",\"number\",\"number\",\"number\"],"
+      "\"edge_fields\":[\"type\",\"name_or_index\",\"to_node\"],"
+      "\"edge_types\":[[\"context\",\"element\",\"property\",\"internal\","
+      "\"hidden\",\"shortcut\",\"weak\"],\"string_or_number\",\"node\"],"
+      "\"trace_function_info_fields\":[\"function_id\",\"name\","
+      "\"script_name\",\"script_id\",\"line\",\"column\"],"
+      "\"trace_node_fields\":[\"id\",\"function_info_index\",\"count\","
+      "\"size\",\"children\"],"
+      "\"sample_fields\":[\"timestamp_us\",\"last_assigned_id\"],"
+      "\"location_fields\":[\"object_index\",\"script_id\",\"line\","
+      "\"column\"]},";
+  out += "\"node_count\":" + std::to_string(nodes_.size());
+  out += ",\"edge_count\":" + std::to_string(edgeCount);
+  out += ",\"trace_function_count\":0},\n\"nodes\":[";
+
+  for (size_t i = 0; i < nodes_.size(); i++) {
+    const auto& node = nodes_[i];
+    if (i > 0) {
+      out += ",\n";
+    }
+    out += std::to_string(node.type());
+    out += ',';
+    out += std::to_string(node.name());
+    out += ',';
+    out += std::to_string(node.id());
+    out += ',';
+    out += std::to_string(node.selfSize());
+    out += ',';
+    out += std::to_string(node.edges().size());
+    out += ",0";
+    if (!writer.flushIfNeeded()) {
+      return;
+    }
+  }
+
+  out += "],\n\"edges\":[";
+  bool first = true;
+  for (const auto& node : nodes_) {
+    for (const auto& edge : node.edges()) {
+      if (!first) {
+        out += ",\n";
+      }
+      first = false;
+      out += std::to_string(edge.type());
+      out += ',';
+      out += std::to_string(edge.nameOrIndex());
+      out += ',';
+      out += std::to_string(edge.to() * kNodeFieldCount);
+      if (!writer.flushIfNeeded()) {
+        return;
+      }
+    }
+  }
+
+  out +=
+      "],\n\"trace_function_infos\":[],\n\"trace_tree\":[],\n"
+      "\"samples\":[],\n\"locations\":[],\n\"strings\":[";
+  for (size_t i = 0; i < strings_.size(); i++) {
+    if (i > 0) {
+      out += ",\n";
+    }
+    strAppendJSONQuoted(out, strings_[i], true);
+    if (!writer.flushIfNeeded()) {
+      return;
+    }
+  }
+  out += "]}";
+
+  writer.finish();
+}
+
+// --- EmbedderGraphImpl ---
+
+class EmbedderGraphImpl : public v8::EmbedderGraph {
+ public:
+  class V8NodeImpl : public Node {
+   public:
+    explicit V8NodeImpl(ValueRef* value) : value_(value) {}
+    const char* Name() override { return "V8Node"; }
+    size_t SizeInBytes() override { return 0; }
+    bool IsEmbedderNode() override { return false; }
+    ValueRef* value() { return value_; }
+
+   private:
+    ValueRef* value_;
+  };
+
+  struct Edge {
+    Node* from;
+    Node* to;
+    const char* name;
+  };
+
+  Node* V8Node(const v8::Local<v8::Value>& value) override {
+    nodes_.emplace_back(new V8NodeImpl(VAL(*value)->value()));
+    return nodes_.back().get();
+  }
+
+  Node* AddNode(std::unique_ptr<Node> node) override {
+    nodes_.push_back(std::move(node));
+    return nodes_.back().get();
+  }
+
+  void AddEdge(Node* from, Node* to, const char* name) override {
+    // @note `name` is expected to be a string literal, as V8 does.
+    edges_.push_back({from, to, name});
+  }
+
+  const std::vector<std::unique_ptr<Node>>& nodes() const { return nodes_; }
+  const std::vector<Edge>& edges() const { return edges_; }
+
+ private:
+  std::vector<std::unique_ptr<Node>> nodes_;
+  std::vector<Edge> edges_;
+};
+
+// --- HeapSnapshotGenerator ---
+
+/*
+  HeapSnapshotGenerator walks the object graph reachable from the roots that
+  the shim knows about: persistent handles in GCHeap, eternal handles, global
+  objects of contexts and the embedder graph. JS values are visited through
+  the Escargot public API without running any JavaScript: only own property
+  descriptors of objects which have no proxy traps or interceptors are read,
+  so getters, traps and property handlers are never invoked.
+
+  GC stays enabled during the walk, since reading a descriptor allocates. The
+  values found so far are kept alive by GC-aware containers, so an address
+  can't be reused by another value while it identifies a node.
+
+  The Boehm heap doesn't carry type information, so blocks which aren't
+  reachable through JS values (e.g. closure scopes) are accounted in the
+  self size of their owners only when they are the owner's GC block.
+*/
+class HeapSnapshotGenerator {
+ public:
+  HeapSnapshotGenerator(IsolateWrap* isolate,
+                        HeapProfilerWrap* profiler,
+                        HeapSnapshotWrap* snapshot,
+                        v8::ActivityControl* control)
+      : isolate_(isolate),
+        profiler_(profiler),
+        snapshot_(snapshot),
+        control_(control),
+        valueKey_(StringRef::createFromASCII("value")),
+        getKey_(StringRef::createFromASCII("get")),
+        setKey_(StringRef::createFromASCII("set")),
+        nameKey_(StringRef::createFromASCII("name")),
+        constructorKey_(StringRef::createFromASCII("constructor")) {}
+
+  void generate();
+
+ private:
+  int addSyntheticNode(const std::string& name) {
+    return snapshot_->addNode(
+        v8::HeapGraphNode::kSynthetic, name, profiler_->nextSyntheticId(), 0);
+  }
+
+  int nodeFor(ValueRef* value);
+  void addValueEdge(int from,
+                    v8::HeapGraphEdge::Type type,
+                    const std::string& name,
+                    ValueRef* value);
+  void addValueElement(int from, int index, ValueRef* value);
+
+  void addRoots();
+  void addEmbedderGraph();
+  void visit(ExecutionStateRef* state, ValueRef* value, int node);
+  void visitObject(ExecutionStateRef* state, ObjectRef* object, int node);
+  void visitInternalFields(ObjectRef* object, int node);
+  void visitPrivateValues(ObjectRef* object, int node);
+
+  ValueRef* getOwnDataProperty(ExecutionStateRef* state,
+                               ObjectRef* object,
+                               ValueRef* key);
+  std::string nodeName(ExecutionStateRef* state, ValueRef* value);
+  v8::HeapGraphNode::Type nodeType(ValueRef* value);
+  size_t selfSize(ValueRef* value);
+
+  IsolateWrap* isolate_;
+  HeapProfilerWrap* profiler_;
+  HeapSnapshotWrap* snapshot_;
+  v8::ActivityControl* control_;
+
+  int root_ = 0;
+  int gcRoots_ = 0;
+  int globalHandles_ = 0;
+  int eternalHandles_ = 0;
+  int embedderRoots_ = 0;
+
+  // Descriptor fields and names looked up on every object
+  StringRef* valueKey_;
+  StringRef* getKey_;
+  StringRef* setKey_;
+  StringRef* nameKey_;
+  StringRef* constructorKey_;
+
+  GCUnorderedMapT<ValueRef*, int> nodes_;
+  std::unordered_map<int, std::string> mergedNames_;
+  GCDequeT<std::pair<ValueRef*, int>> worklist_;
+};
+
+static bool isHeapValue(ValueRef* value) {
+  return value && (value->isObject() || value->isString() ||
+                   value->isSymbol() || value->isBigInt());
+}
+
+v8::HeapGraphNode::Type HeapSnapshotGenerator::nodeType(ValueRef* value) {
+  if (value->isString()) {
+    return v8::HeapGraphNode::kString;
+  } else if (value->isSymbol()) {
+    return v8::HeapGraphNode::kSymbol;
+  } else if (value->isBigInt()) {
+    return v8::HeapGraphNode::kBigInt;
+  } else if (value->isArrayObject()) {
+    return v8::HeapGraphNode::kArray;
+  } else if (value->isFunctionObject()) {
+    return v8::HeapGraphNode::kClosure;
+  } else if (value->isRegExpObject()) {
+    return v8::HeapGraphNode::kRegExp;
+  }
+  return v8::HeapGraphNode::kObject;
+}
+
+size_t HeapSnapshotGenerator::selfSize(ValueRef* value) {
+  void* base = GC_base(value);
+  return (base == value) ? GC_size(base) : sizeof(void*);
+}
+
+// Own property descriptors can be read without running JavaScript, unless
+// [[GetOwnProperty]] is a proxy trap or calls property handlers.
+static bool canReadOwnProperties(ObjectRef* object) {
+  if (object->isProxyObject()) {
+    return false;
+  }
+
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (!extraData || !extraData->isObjectData()) {
+    return true;
+  }
+  auto objectTemplate = extraData->asObjectData()->objectTemplate();
+  if (!objectTemplate) {
+    return true;
+  }
+  auto objectTemplateData =
+      ExtraDataHelper::getObjectTemplateExtraData(objectTemplate);
+  return !objectTemplateData || !objectTemplateData->hasPropertyHandler();
+}
+
+// Read a data property without side effects. Accessors aren't invoked.
+ValueRef* HeapSnapshotGenerator::getOwnDataProperty(ExecutionStateRef* state,
+                                                    ObjectRef* object,
+                                                    ValueRef* key) {
+  if (!canReadOwnProperties(object)) {
+    return nullptr;
+  }
+  auto descriptor = object->getOwnPropertyDescriptor(state, key);
+  if (!descriptor->isObject()) {
+    return nullptr;
+  }
+  // A descriptor is an ordinary object, and only its own fields are read.
+  auto desc = descriptor->asObject();
+  if (!desc->hasOwnProperty(state, valueKey_)) {
+    return nullptr;
+  }
+  return desc->get(state, valueKey_);
+}
+
+std::string HeapSnapshotGenerator::nodeName(ExecutionStateRef* state,
+                                            ValueRef* value) {
+  if (value->isString()) {
+    auto name = value->asString()->toStdUTF8String();
+    if (name.length() > kMaxStringNameLength) {
+      name.resize(kMaxStringNameLength);
+    }
+    return name;
+  } else if (value->isSymbol()) {
+    return "symbol";
+  } else if (value->isBigInt()) {
+    return "bigint";
+  }
+
+  auto object = value->asObject();
+  if (object->isFunctionObject()) {
+    auto name = getOwnDataProperty(state, object, nameKey_);
+    if (name && name->isString()) {
+      return name->asString()->toStdUTF8String();
+    }
+    return "";
+  }
+
+  if (object->isProxyObject()) {
+    return "Proxy";
+  }
+
+  // Objects are named after their constructors, as V8 does.
+  auto proto = object->getPrototype(state);
+  if (proto->isObject()) {
+    auto constructor =
+        getOwnDataProperty(state, proto->asObject(), constructorKey_);
+    if (constructor && constructor->isFunctionObject()) {
+      auto name =
+          getOwnDataProperty(state, constructor->asObject(), nameKey_);
+      if (name && name->isString() && name->asString()->length() > 0) {
+        return name->asString()->toStdUTF8String();
+      }
+    }
+  }
+  return "Object";
+}
+
+int HeapSnapshotGenerator::nodeFor(ValueRef* value) {
+  auto it = nodes_.find(value);
+  if (it != nodes_.end()) {
+    return it->second;
+  }
+
+  // The name is resolved when the node is visited.
+  int node = snapshot_->addNode(
+      nodeType(value), "", profiler_->getObjectId(value), selfSize(value));
+  nodes_.emplace(value, node);
+  worklist_.emplace_back(value, node);
+  return node;
+}
+
+void HeapSnapshotGenerator::addValueEdge(int from,
+                                         v8::HeapGraphEdge::Type type,
+                                         const std::string& name,
+                                         ValueRef* value) {
+  if (isHeapValue(value)) {
+    snapshot_->addEdge(type, name, from, nodeFor(value));
+  }
+}
+
+void HeapSnapshotGenerator::addValueElement(int from,
+                                            int index,
+                                            ValueRef* value) {
+  if (isHeapValue(value)) {
+    snapshot_->addEdge(v8::HeapGraphEdge::kElement, index, from, nodeFor(value));
+  }
+}
+
+void HeapSnapshotGenerator::addRoots() {
+  root_ = addSyntheticNode("");
+  gcRoots_ = addSyntheticNode("(GC roots)");
+  globalHandles_ = addSyntheticNode("(Global handles)");
+  eternalHandles_ = addSyntheticNode("(Eternal handles)");
+  embedderRoots_ = addSyntheticNode("(Embedder roots)");
+
+  snapshot_->addEdge(v8::HeapGraphEdge::kElement, 1, root_, gcRoots_);
+  snapshot_->addEdge(v8::HeapGraphEdge::kElement, 1, gcRoots_, globalHandles_);
+  snapshot_->addEdge(
+      v8::HeapGraphEdge::kElement, 2, gcRoots_, eternalHandles_);
+  snapshot_->addEdge(v8::HeapGraphEdge::kElement, 3, gcRoots_, embedderRoots_);
+
+  // 1. the global object of the current context
+  if (isolate_->InContext()) {
+    auto global = isolate_->GetCurrentContext()->get()->globalObject();
+    addValueEdge(root_, v8::HeapGraphEdge::kShortcut, "global", global);
+  }
+
+  // 2. persistent handles
+  int index = 1;
+  Engine::current()->gcHeap()->iteratePersistents(
+      [&](void* address, const GCHeap::AddressInfo& info) {
+        auto handle = reinterpret_cast<ValueWrap*>(address);
+        auto type = (info.strong > 0) ? v8::HeapGraphEdge::kElement
+                                      : v8::HeapGraphEdge::kWeak;
+        ValueRef* value = nullptr;
+        if (handle->type() == HandleWrap::Type::JsValue) {
+          value = handle->value();
+        } else if (handle->type() == HandleWrap::Type::Context) {
+          value = handle->context()->get()->globalObject();
+        }
+
+        if (!isHeapValue(value)) {
+          return;
+        }
+        if (type == v8::HeapGraphEdge::kWeak) {
+          snapshot_->addEdge(
+              type, std::to_string(index), globalHandles_, nodeFor(value));
+        } else {
+          snapshot_->addEdge(type, index, globalHandles_, nodeFor(value));
+        }
+        index++;
+      });
+
+  // 3. eternal handles
+  index = 1;
+  for (auto eternal : isolate_->eternals()) {
+    auto handle = reinterpret_cast<ValueWrap*>(eternal);
+    if (handle->type() == HandleWrap::Type::JsValue) {
+      addValueElement(eternalHandles_, index++, handle->value());
+    }
+  }
+}
+
+void HeapSnapshotGenerator::addEmbedderGraph() {
+  auto& callbacks = profiler_->embedderGraphCallbacks();
+  if (callbacks.empty()) {
+    return;
+  }
+
+  EmbedderGraphImpl graph;
+  for (auto& callback : callbacks) {
+    callback.first(isolate_->toV8(), &graph, callback.second);
+  }
+
+  std::unordered_map<v8::EmbedderGraph::Node*, int> graphNodes;
+  auto resolve = [&](v8::EmbedderGraph::Node* node) -> int {
+    auto it = graphNodes.find(node);
+    if (it != graphNodes.end()) {
+      return it->second;
+    }
+
+    int index = -1;
+    if (!node->IsEmbedderNode()) {
+      auto value = static_cast<EmbedderGraphImpl::V8NodeImpl*>(node)->value();
+      if (isHeapValue(value)) {
+        index = nodeFor(value);
+      }
+    } else {
+      std::string name = node->Name();
+      if (node->NamePrefix()) {
+        name = std::string(node->NamePrefix()) + " " + name;
+      }
+
+      auto wrapper = node->WrapperNode();
+      if (wrapper && !wrapper->IsEmbedderNode()) {
+        // Merge the embedder node into its wrapper to simplify retaining
+        // paths, as V8 does.
+        auto value =
+            static_cast<EmbedderGraphImpl::V8NodeImpl*>(wrapper)->value();
+        if (isHeapValue(value)) {
+          index = nodeFor(value);
+          snapshot_->node(index)->addSelfSize(node->SizeInBytes());
+          mergedNames_.emplace(index, name);
+        }
+      }
+
+      if (index < 0) {
+        const void* nativeObject = node->GetNativeObject();
+        index = snapshot_->addNode(
+            v8::HeapGraphNode::kNative,
+            name,
+            nativeObject ? profiler_->getNativeObjectId(nativeObject)
+                         : profiler_->nextSyntheticId(),
+            node->SizeInBytes());
+      }
+
+      if (node->IsRootNode()) {
+        snapshot_->addEdge(
+            v8::HeapGraphEdge::kElement,
+            snapshot_->node(embedderRoots_)->edges().size() + 1,
+            embedderRoots_,
+            index);
+      }
+    }
+
+    graphNodes.emplace(node, index);
+    return index;
+  };
+
+  for (auto& node : graph.nodes()) {
+    resolve(node.get());
+  }
+
+  for (auto& edge : graph.edges()) {
+    int from = resolve(edge.from);
+    int to = resolve(edge.to);
+    if (from < 0 || to < 0) {
+      continue;
+    }
+
+    if (edge.name) {
+      snapshot_->addEdge(v8::HeapGraphEdge::kInternal, edge.name, from, to);
+    } else {
+      snapshot_->addEdge(v8::HeapGraphEdge::kElement,
+                         snapshot_->node(from)->edges().size() + 1,
+                         from,
+                         to);
+    }
+  }
+}
+
+void HeapSnapshotGenerator::visitPrivateValues(ObjectRef* object, int node) {
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (!extraData) {
+    return;
+  }
+
+  extraData->forEachPrivate([&](ValueRef* key, ValueRef* value) {
+    std::string name = "<private>";
+    auto description = key->asSymbol()->descriptionString();
+    if (description) {
+      name = description->toStdUTF8String();
+    }
+    addValueEdge(node, v8::HeapGraphEdge::kInternal, name, value);
+  });
+}
+
+void HeapSnapshotGenerator::visitInternalFields(ObjectRef* object, int node) {
+  auto extraData = ExtraDataHelper::getExtraData(object);
+  if (!extraData || !extraData->isInternalFieldData()) {
+    return;
+  }
+
+  auto data = extraData->asInternalFieldData();
+  for (int i = 0; i < data->internalFieldCount(); i++) {
+    // An internal field holds either a handle or an aligned pointer. Only
+    // handles allocated in the GC heap are followed.
+    void* field = data->internalField(i);
+    if (!field || GC_base(field) != field) {
+      continue;
+    }
+    auto handle = reinterpret_cast<ValueWrap*>(field);
+    if (handle->isValid() && handle->type() == HandleWrap::Type::JsValue) {
+      addValueEdge(node,
+                   v8::HeapGraphEdge::kInternal,
+                   "internal_field_" + std::to_string(i),
+                   handle->value());
+    }
+  }
+}
+
+void HeapSnapshotGenerator::visitObject(ExecutionStateRef* state,
+                                        ObjectRef* object,
+                                        int node) {
+  if (object->isProxyObject()) {
+    return;
+  }
+
+  addValueEdge(node,
+               v8::HeapGraphEdge::kProperty,
+               "__proto__",
+               object->getPrototype(state));
+
+  visitInternalFields(object, node);
+  visitPrivateValues(object, node);
+
+  if (!canReadOwnProperties(object)) {
+    return;
+  }
+
+  auto keys = object->ownPropertyKeys(state);
+  for (size_t i = 0; i < keys->size(); i++) {
+    auto key = keys->at(i);
+    auto descriptor = object->getOwnPropertyDescriptor(state, key);
+    if (!descriptor->isObject()) {
+      continue;
+    }
+
+    // Property keys are either symbols or strings, including array indices.
+    std::string name = "<symbol>";
+    if (key->isString()) {
+      name = key->asString()->toStdUTF8String();
+    }
+    bool isElement = !name.empty() && name.length() < 10 &&
+                     std::all_of(name.begin(), name.end(), ::isdigit);
+    int index = isElement ? atoi(name.c_str()) : 0;
+
+    auto desc = descriptor->asObject();
+    if (desc->hasOwnProperty(state, valueKey_)) {
+      auto value = desc->get(state, valueKey_);
+      if (isElement) {
+        addValueElement(node, index, value);
+      } else {
+        addValueEdge(node, v8::HeapGraphEdge::kProperty, name, value);
+      }
+      continue;
+    }
+
+    // An accessor property; the functions are followed, never called.
+    if (desc->hasOwnProperty(state, getKey_)) {
+      addValueEdge(node,
+                   v8::HeapGraphEdge::kProperty,
+                   "get " + name,
+                   desc->get(state, getKey_));
+    }
+    if (desc->hasOwnProperty(state, setKey_)) {
+      addValueEdge(node,
+                   v8::HeapGraphEdge::kProperty,
+                   "set " + name,
+                   desc->get(state, setKey_));
+    }
+  }
+}
+
+void HeapSnapshotGenerator::visit(ExecutionStateRef* state,
+                                  ValueRef* value,
+                                  int node) {
+  std::string name = nodeName(state, value);
+  auto merged = mergedNames_.find(node);
+  if (merged != mergedNames_.end()) {
+    name = merged->second + " / " + name;
+  }
+  snapshot_->node(node)->setName(snapshot_->addString(name));
+
+  if (value->isObject()) {
+    visitObject(state, value->asObject(), node);
+  }
+}
+
+void HeapSnapshotGenerator::generate() {
+  addRoots();
+  addEmbedderGraph();
+
+  ContextWrap* lwContext =
+      isolate_->InContext() ? isolate_->GetCurrentContext() : nullptr;
+  if (!lwContext) {
+    LWNODE_DLOG_WARN("HeapSnapshot: no context to visit JS values");
+    return;
+  }
+
+  auto r = Evaluator::execute(
+      lwContext->get(),
+      [](ExecutionStateRef* state, HeapSnapshotGenerator* self) -> ValueRef* {
+        size_t done = 0;
+        while (!self->worklist_.empty()) {
+          auto item = self->worklist_.front();
+          self->worklist_.pop_front();
+          self->visit(state, item.first, item.second);
+
+          if (self->control_ && (++done % 1024) == 0) {
+            auto total = done + self->worklist_.size();
+            if (self->control_->ReportProgressValue(done, total) ==
+                v8::ActivityControl::kAbort) {
+              break;
+            }
+          }
+        }
+        return ValueRef::createUndefined();
+      },
+      this);
+
+  if (!r.isSuccessful()) {
+    LWNODE_DLOG_WARN("HeapSnapshot: failed to visit the heap");
+  }
+}
+
+// --- SamplingHeapProfilerWrap ---
+
+THREAD_LOCAL SamplingHeapProfilerWrap* SamplingHeapProfilerWrap::s_profiler;
+
+size_t SamplingHeapProfilerWrap::Node::selfSize() const {
+  size_t size = 0;
+  for (const auto& allocation : allocations) {
+    size += allocation.first * allocation.second;
+  }
+  return size;
+}
+
+SamplingHeapProfilerWrap::SamplingHeapProfilerWrap(IsolateWrap* isolate,
+                                                   uint64_t sampleInterval,
+                                                   int stackDepth)
+    : isolate_(isolate),
+      sampleInterval_(sampleInterval),
+      stackDepth_(stackDepth),
+      pendingBytes_(0) {
+  root_.reset(new Node{nullptr,
+                       nextNodeId_++,
+                       "(root)",
+                       "",
+                       v8::UnboundScript::kNoScriptId,
+                       v8::AllocationProfile::kNoLineNumberInfo,
+                       v8::AllocationProfile::kNoColumnNumberInfo});
+
+  LWNODE_CHECK_NULL(s_profiler);
+  s_profiler = this;
+
+  // Bytes allocated before sampling starts aren't charged.
+  claimAllocatedBytes();
+}
+
+SamplingHeapProfilerWrap::~SamplingHeapProfilerWrap() {
+  if (s_profiler == this) {
+    s_profiler = nullptr;
+  }
+}
+
+// The total bytes allocated by the process that some profiler has claimed
+static std::atomic<size_t> s_claimedTotalBytes{0};
+
+uint64_t SamplingHeapProfilerWrap::claimAllocatedBytes() {
+  size_t totalBytes = GC_get_total_bytes();
+  size_t claimed = s_claimedTotalBytes.load(std::memory_order_relaxed);
+  while (claimed < totalBytes) {
+    if (s_claimedTotalBytes.compare_exchange_weak(
+            claimed, totalBytes, std::memory_order_relaxed)) {
+      return totalBytes - claimed;
+    }
+  }
+  return 0;
+}
+
+// The coarse clock is read without a system call and ticks every few
+// milliseconds, which is fine enough to throttle the checks.
+static int64_t coarseNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void SamplingHeapProfilerWrap::sample(ExecutionStateRef* state) {
+  auto self = s_profiler;
+  int64_t now = coarseNow();
+  if (now - self->lastCheckTime_ < kCheckIntervalUs) {
+    return;
+  }
+  self->lastCheckTime_ = now;
+
+  self->pendingBytes_ += claimAllocatedBytes();
+  if (self->pendingBytes_ < self->sampleInterval_) {
+    return;
+  }
+
+  unsigned count = self->pendingBytes_ / self->sampleInterval_;
+  self->pendingBytes_ -= count * self->sampleInterval_;
+  self->addSample(state, count);
+
+  // Don't charge the bytes allocated by capturing the stack to anyone.
+  claimAllocatedBytes();
+}
+
+void SamplingHeapProfilerWrap::addSample(ExecutionStateRef* state,
+                                         unsigned count) {
+  std::vector<CpuProfileWrap::Frame> stack;
+  captureStackFrames(state, &scriptIds_, &stack);
+
+  // Keep the innermost frames only.
+  size_t begin = 0;
+  if (stackDepth_ > 0 && stack.size() > static_cast<size_t>(stackDepth_)) {
+    begin = stack.size() - stackDepth_;
+  }
+
+  Node* node = root_.get();
+  for (size_t i = begin; i < stack.size(); i++) {
+    const auto& frame = stack[i];
+
+    Node* child = nullptr;
+    for (auto& candidate : node->children) {
+      if (candidate->scriptId == frame.scriptId &&
+          candidate->lineNumber == frame.lineNumber &&
+          candidate->columnNumber == frame.columnNumber &&
+          candidate->name == frame.functionName) {
+        child = candidate.get();
+        break;
+      }
+    }
+
+    if (!child) {
+      child = new Node{node,
+                       nextNodeId_++,
+                       frame.functionName,
+                       frame.url,
+                       frame.scriptId,
+                       frame.lineNumber,
+                       frame.columnNumber};
+      node->children.emplace_back(child);
+    }
+    node = child;
+  }
+
+  node->allocations[sampleInterval_] += count;
+
+  if (!samples_.empty() && samples_.back().nodeId == node->id) {
+    samples_.back().count += count;
+  } else if (samples_.size() < kMaxSamples) {
+    samples_.push_back({node->id, sampleInterval_, count, nextSampleId_++});
+  }
+}
+
+namespace {
+
+class AllocationProfileWrap : public v8::AllocationProfile {
+ public:
+  v8::AllocationProfile::Node* GetRootNode() override {
+    return nodes_.empty() ? nullptr : &nodes_.front();
+  }
+  const std::vector<v8::AllocationProfile::Sample>& GetSamples() override {
+    return samples_;
+  }
+
+  // NOTE: Nodes are kept in a deque so that pointers to them stay valid.
+  std::deque<v8::AllocationProfile::Node> nodes_;
+  std::vector<v8::AllocationProfile::Sample> samples_;
+};
+
+}  // namespace
+
+v8::AllocationProfile* SamplingHeapProfilerWrap::getAllocationProfile() const {
+  auto profile = new AllocationProfileWrap();
+  auto isolate = isolate_->toV8();
+
+  auto newString = [isolate](const std::string& str) {
+    return v8::String::NewFromUtf8(isolate, str.c_str()).ToLocalChecked();
+  };
+
+  std::vector<std::pair<const Node*, v8::AllocationProfile::Node*>> worklist;
+  profile->nodes_.emplace_back();
+  worklist.emplace_back(root_.get(), &profile->nodes_.back());
+
+  while (!worklist.empty()) {
+    auto from = worklist.back().first;
+    auto to = worklist.back().second;
+    worklist.pop_back();
+
+    to->name = newString(from->name);
+    to->script_name = newString(from->url);
+    to->script_id = from->scriptId;
+    to->start_position = 0;
+    to->line_number = from->lineNumber;
+    to->column_number = from->columnNumber;
+    to->node_id = from->id;
+    for (const auto& allocation : from->allocations) {
+      to->allocations.push_back({allocation.first, allocation.second});
+    }
+
+    for (const auto& child : from->children) {
+      profile->nodes_.emplace_back();
+      to->children.push_back(&profile->nodes_.back());
+      worklist.emplace_back(child.get(), &profile->nodes_.back());
+    }
+  }
+
+  for (const auto& sample : samples_) {
+    profile->samples_.push_back(
+        {sample.nodeId, sample.size, sample.count, sample.sampleId});
+  }
+
+  return profile;
+}
+
+static void appendAllocationNodeJSON(std::string& out,
+                                     const SamplingHeapProfilerWrap::Node* node) {
+  out += "{\"callFrame\":{\"functionName\":";
+  strAppendJSONQuoted(out, node->name);
+  out += ",\"scriptId\":\"";
+  out += std::to_string(std::max(node->scriptId, 0));
+  out += "\",\"url\":";
+  strAppendJSONQuoted(out, node->url);
+  // callFrame positions are 0-based.
+  out += ",\"lineNumber\":";
+  out += std::to_string(std::max(node->lineNumber - 1, -1));
+  out += ",\"columnNumber\":";
+  out += std::to_string(std::max(node->columnNumber - 1, -1));
+  out += "},\"selfSize\":";
+  out += std::to_string(node->selfSize());
+  out += ",\"id\":";
+  out += std::to_string(node->id);
+  out += ",\"children\":[";
+  for (size_t i = 0; i < node->children.size(); i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    appendAllocationNodeJSON(out, node->children[i].get());
+  }
+  out += "]}";
+}
+
+std::string SamplingHeapProfilerWrap::toJSON() const {
+  std::string out;
+  out += "{\"head\":";
+  appendAllocationNodeJSON(out, root_.get());
+
+  out += ",\"samples\":[";
+  for (size_t i = 0; i < samples_.size(); i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    out += "{\"size\":";
+    out += std::to_string(samples_[i].size * samples_[i].count);
+    out += ",\"nodeId\":";
+    out += std::to_string(samples_[i].nodeId);
+    out += ",\"ordinal\":";
+    out += std::to_string(samples_[i].sampleId);
+    out += '}';
+  }
+  out += "]}";
+
+  return out;
+}
+
+// --- HeapProfilerWrap ---
+
+HeapProfilerWrap::~HeapProfilerWrap() {
+  clearObjectIds();
+}
+
+HeapSnapshotWrap* HeapProfilerWrap::takeHeapSnapshot(
+    v8::ActivityControl* control) {
+  isolate_->CollectGarbage();
+
+  auto snapshot = new HeapSnapshotWrap(isolate_);
+  snapshots_.emplace_back(snapshot);
+
+  snapshotSerial_++;
+  HeapSnapshotGenerator(isolate_, this, snapshot, control).generate();
+  pruneObjectIds();
+
+  return snapshot;
+}
+
+void HeapProfilerWrap::deleteHeapSnapshot(HeapSnapshotWrap* snapshot) {
+  for (auto it = snapshots_.begin(); it != snapshots_.end(); ++it) {
+    if (it->get() == snapshot) {
+      snapshots_.erase(it);
+      return;
+    }
+  }
+}
+
+HeapProfilerWrap::ObjectIdEntry& HeapProfilerWrap::addObjectId(
+    const void* address, bool isWeak) {
+  auto id = nextId();
+  auto& entry = objectIds_[address];
+  entry.id = id;
+  entry.value = const_cast<void*>(address);
+  entry.lastSnapshot = snapshotSerial_;
+  if (isWeak) {
+    GC_general_register_disappearing_link(&entry.value, entry.value);
+  } else {
+    entry.value = nullptr;
+  }
+  addresses_.emplace(id, address);
+  return entry;
+}
+
+void HeapProfilerWrap::removeObjectId(
+    std::unordered_map<const void*, ObjectIdEntry>::iterator it) {
+  // A link already cleared by GC is no longer registered.
+  if (it->second.value) {
+    GC_unregister_disappearing_link(&it->second.value);
+  }
+  addresses_.erase(it->second.id);
+  objectIds_.erase(it);
+}
+
+v8::SnapshotObjectId HeapProfilerWrap::getObjectId(ValueRef* value) {
+  // Only the base of a GC block can be linked weakly.
+  bool isWeak = (GC_base(value) == value);
+  auto it = objectIds_.find(value);
+  if (it != objectIds_.end()) {
+    // A cleared link means the address was reclaimed, and now holds another
+    // value.
+    if (!isWeak || it->second.value) {
+      it->second.lastSnapshot = snapshotSerial_;
+      return it->second.id;
+    }
+    removeObjectId(it);
+  }
+  return addObjectId(value, isWeak).id;
+}
+
+v8::SnapshotObjectId HeapProfilerWrap::getNativeObjectId(
+    const void* address) {
+  auto it = objectIds_.find(address);
+  if (it != objectIds_.end()) {
+    it->second.lastSnapshot = snapshotSerial_;
+    return it->second.id;
+  }
+  return addObjectId(address, false).id;
+}
+
+v8::SnapshotObjectId HeapProfilerWrap::findNativeObjectId(
+    const void* address) const {
+  auto it = objectIds_.find(address);
+  if (it != objectIds_.end()) {
+    return it->second.id;
+  }
+  return v8::HeapProfiler::kUnknownObjectId;
+}
+
+ValueRef* HeapProfilerWrap::findObjectById(v8::SnapshotObjectId id) const {
+  auto it = addresses_.find(id);
+  if (it == addresses_.end()) {
+    return nullptr;
+  }
+  // Only values linked weakly are known to be alive.
+  return reinterpret_cast<ValueRef*>(objectIds_.at(it->second).value);
+}
+
+// Drop the ids of values collected since they were given, and of the other
+// addresses the last snapshot didn't report, so the table only grows with
+// the heap.
+void HeapProfilerWrap::pruneObjectIds() {
+  for (auto it = objectIds_.begin(); it != objectIds_.end();) {
+    auto next = std::next(it);
+    if (!it->second.value && it->second.lastSnapshot != snapshotSerial_) {
+      removeObjectId(it);
+    }
+    it = next;
+  }
+}
+
+void HeapProfilerWrap::clearObjectIds() {
+  while (!objectIds_.empty()) {
+    removeObjectId(objectIds_.begin());
+  }
+}
+
+bool HeapProfilerWrap::startSamplingHeapProfiler(uint64_t sampleInterval,
+                                                 int stackDepth) {
+  if (samplingProfiler_) {
+    return false;
+  }
+
+  if (SamplingHeapProfilerWrap::isSampling()) {
+    LWNODE_DLOG_WARN("another HeapProfiler is sampling on this thread");
+    return false;
+  }
+
+  samplingProfiler_.reset(
+      new SamplingHeapProfilerWrap(isolate_, sampleInterval, stackDepth));
+  return true;
+}
+
+void HeapProfilerWrap::addBuildEmbedderGraphCallback(
+    v8::HeapProfiler::BuildEmbedderGraphCallback callback, void* data) {
+  embedderGraphCallbacks_.emplace_back(callback, data);
+}
+
+void HeapProfilerWrap::removeBuildEmbedderGraphCallback(
+    v8::HeapProfiler::BuildEmbedderGraphCallback callback, void* data) {
+  auto it = std::find(embedderGraphCallbacks_.begin(),
+                      embedderGraphCallbacks_.end(),
+                      EmbedderGraphCallback(callback, data));
+  if (it != embedderGraphCallbacks_.end()) {
+    embedderGraphCallbacks_.erase(it);
+  }
+}
+
+// --- --heap-prof ---
+
+static const char* kDefaultHeapProfInterval = "524288";
+static const int kHeapProfStackDepth = 16;
+
+void startHeapProfileFromFlags(IsolateWrap* isolate) {
+  auto flags = Global::flags();
+  if (!flags->isOn(Flag::Type::HeapProf)) {
+    return;
+  }
+
+  uint64_t interval = strtoull(
+      flags->value(Flag::Type::HeapProfInterval, kDefaultHeapProfInterval)
+          .c_str(),
+      nullptr,
+      10);
+  if (interval == 0) {
+    interval = strtoull(kDefaultHeapProfInterval, nullptr, 10);
+  }
+
+  isolate->heapProfiler()->startSamplingHeapProfiler(interval,
+                                                     kHeapProfStackDepth);
+}
+
+void stopHeapProfileFromFlags(IsolateWrap* isolate) {
+  auto flags = Global::flags();
+  if (!flags->isOn(Flag::Type::HeapProf)) {
+    return;
+  }
+
+  auto heapProfiler = isolate->heapProfiler();
+  auto profiler = heapProfiler->samplingProfiler();
+  if (!profiler) {
+    return;
+  }
+
+  std::string filename = flags->value(
+      Flag::Type::HeapProfName, createDiagnosticFilename("Heap", "heapprofile"));
+  std::string dir = flags->value(Flag::Type::HeapProfDir);
+  if (!dir.empty()) {
+    filename = dir + "/" + filename;
+  }
+
+  std::ofstream out(filename, std::ios::out | std::ios::binary);
+  if (out.is_open()) {
+    out << profiler->toJSON();
+  } else {
+    LWNODE_LOG_ERROR("failed to write heap profile: %s", filename.c_str());
+  }
+
+  heapProfiler->stopSamplingHeapProfiler();
+}
+
+}  // namespace EscargotShim
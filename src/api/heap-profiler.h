@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "v8-profiler.h"
+
+#include "utils/compiler.h"
+
+namespace Escargot {
+class ExecutionStateRef;
+class ValueRef;
+}
+
+namespace EscargotShim {
+
+class IsolateWrap;
+class HeapSnapshotWrap;
+
+class HeapGraphEdgeWrap {
+ public:
+  HeapGraphEdgeWrap(HeapSnapshotWrap* snapshot,
+                    v8::HeapGraphEdge::Type type,
+                    int nameOrIndex,
+                    int from,
+                    int to)
+      : snapshot_(snapshot),
+        type_(type),
+        nameOrIndex_(nameOrIndex),
+        from_(from),
+        to_(to) {}
+
+  static const v8::HeapGraphEdge* toV8(const HeapGraphEdgeWrap* edge) {
+    return reinterpret_cast<const v8::HeapGraphEdge*>(edge);
+  }
+  static const HeapGraphEdgeWrap* fromV8(const v8::HeapGraphEdge* edge) {
+    return reinterpret_cast<const HeapGraphEdgeWrap*>(edge);
+  }
+
+  HeapSnapshotWrap* snapshot() const { return snapshot_; }
+  v8::HeapGraphEdge::Type type() const { return type_; }
+  // A string index for named edges, otherwise an element index.
+  int nameOrIndex() const { return nameOrIndex_; }
+  bool hasIndex() const {
+    return type_ == v8::HeapGraphEdge::kElement ||
+           type_ == v8::HeapGraphEdge::kHidden;
+  }
+  int from() const { return from_; }
+  int to() const { return to_; }
+
+ private:
+  HeapSnapshotWrap* snapshot_;
+  v8::HeapGraphEdge::Type type_;
+  int nameOrIndex_;
+  int from_;
+  int to_;
+};
+
+class HeapGraphNodeWrap {
+ public:
+  HeapGraphNodeWrap(HeapSnapshotWrap* snapshot,
+                    v8::HeapGraphNode::Type type,
+                    int name,
+                    v8::SnapshotObjectId id,
+                    size_t selfSize)
+      : snapshot_(snapshot),
+        type_(type),
+        name_(name),
+        id_(id),
+        selfSize_(selfSize) {}
+
+  static const v8::HeapGraphNode* toV8(const HeapGraphNodeWrap* node) {
+    return reinterpret_cast<const v8::HeapGraphNode*>(node);
+  }
+  static const HeapGraphNodeWrap* fromV8(const v8::HeapGraphNode* node) {
+    return reinterpret_cast<const HeapGraphNodeWrap*>(node);
+  }
+
+  HeapSnapshotWrap* snapshot() const { return snapshot_; }
+  v8::HeapGraphNode::Type type() const { return type_; }
+  int name() const { return name_; }
+  v8::SnapshotObjectId id() const { return id_; }
+  size_t selfSize() const { return selfSize_; }
+  const std::vector<HeapGraphEdgeWrap>& edges() const { return edges_; }
+
+  void setName(int name) { name_ = name; }
+  void addSelfSize(size_t size) { selfSize_ += size; }
+  void addEdge(const HeapGraphEdgeWrap& edge) { edges_.push_back(edge); }
+
+ private:
+  HeapSnapshotWrap* snapshot_;
+  v8::HeapGraphNode::Type type_;
+  int name_;
+  v8::SnapshotObjectId id_;
+  size_t selfSize_;
+  std::vector<HeapGraphEdgeWrap> edges_;
+};
+
+class HeapSnapshotWrap {
+ public:
+  static const v8::HeapSnapshot* toV8(const HeapSnapshotWrap* snapshot) {
+    return reinterpret_cast<const v8::HeapSnapshot*>(snapshot);
+  }
+  static HeapSnapshotWrap* fromV8(v8::HeapSnapshot* snapshot) {
+    return reinterpret_cast<HeapSnapshotWrap*>(snapshot);
+  }
+  static const HeapSnapshotWrap* fromV8(const v8::HeapSnapshot* snapshot) {
+    return reinterpret_cast<const HeapSnapshotWrap*>(snapshot);
+  }
+
+  explicit HeapSnapshotWrap(IsolateWrap* isolate) : isolate_(isolate) {}
+
+  IsolateWrap* isolate() const { return isolate_; }
+
+  int addNode(v8::HeapGraphNode::Type type,
+              const std::string& name,
+              v8::SnapshotObjectId id,
+              size_t selfSize);
+  void addEdge(v8::HeapGraphEdge::Type type,
+               const std::string& name,
+               int from,
+               int to);
+  void addEdge(v8::HeapGraphEdge::Type type, int index, int from, int to);
+
+  int addString(const std::string& str);
+  const std::string& string(int index) const { return strings_[index]; }
+
+  size_t nodesCount() const { return nodes_.size(); }
+  HeapGraphNodeWrap* node(size_t index) { return &nodes_[index]; }
+  const HeapGraphNodeWrap* node(size_t index) const { return &nodes_[index]; }
+  const HeapGraphNodeWrap* nodeById(v8::SnapshotObjectId id) const;
+  v8::SnapshotObjectId maxObjectId() const;
+
+  // Serialize into the V8 `.heapsnapshot` JSON format. The output is streamed
+  // in chunks, so the whole document is never held in memory.
+  void serialize(v8::OutputStream* stream) const;
+
+ private:
+  IsolateWrap* isolate_ = nullptr;
+  std::vector<HeapGraphNodeWrap> nodes_;
+  // id -> index of the first node with the id
+  std::unordered_map<v8::SnapshotObjectId, int> nodeIndices_;
+  v8::SnapshotObjectId maxObjectId_ = 0;
+  std::vector<std::string> strings_;
+  std::unordered_map<std::string, int> stringIndices_;
+};
+
+/*
+  SamplingHeapProfilerWrap attributes allocated bytes to JS call sites.
+
+  Escargot allocates straight from the GC heap and has no allocation hook, so
+  allocations can't be sampled one by one as V8 does. Instead, the number of
+  bytes allocated so far is checked at safe points (native callbacks made from
+  JavaScript); whenever it has grown by the sampling interval, the current
+  stack is captured and charged with one sample per interval crossed.
+
+  Reading the allocated bytes takes the GC allocation lock, so it is done at
+  most once per kCheckIntervalUs rather than at every safe point.
+
+  NOTE: The bytes are charged to the stack of the safe point that checks them,
+  not to the stacks that allocated them. Bytes allocated by JS code that
+  returned before the check, or by native code, are charged to whatever makes
+  the check, so the profile is only accurate for call sites that allocate
+  steadily.
+
+  The GC only counts the bytes allocated by the whole process. Each byte is
+  claimed by the first profiler to reach a safe point after it was allocated,
+  so profilers of isolates on other threads never charge the same bytes
+  twice. Bytes allocated by threads which aren't sampling are still charged
+  to whichever profiler claims them.
+
+  Samples are never removed, so the profile reports all bytes allocated
+  while sampling, including those already collected. The stacks are merged
+  into the tree as they are captured; consecutive samples of the same stack
+  share a record, and at most kMaxSamples records are kept.
+*/
+class SamplingHeapProfilerWrap {
+ public:
+  static constexpr size_t kMaxSamples = 64 * 1024;
+  static constexpr int64_t kCheckIntervalUs = 1000;
+
+  struct Node {
+    Node* parent;
+    unsigned id;
+    std::string name;
+    std::string url;
+    int scriptId;
+    int lineNumber;
+    int columnNumber;
+    std::vector<std::unique_ptr<Node>> children;
+    // size -> count
+    std::map<size_t, unsigned> allocations;
+
+    size_t selfSize() const;
+  };
+
+  struct Sample {
+    unsigned nodeId;
+    size_t size;
+    unsigned count;
+    uint64_t sampleId;
+  };
+
+  SamplingHeapProfilerWrap(IsolateWrap* isolate,
+                           uint64_t sampleInterval,
+                           int stackDepth);
+  ~SamplingHeapProfilerWrap();
+
+  // Safe points
+  static inline bool isSampling() { return s_profiler != nullptr; }
+  static void sample(Escargot::ExecutionStateRef* state);
+
+  // The caller takes ownership of the result.
+  v8::AllocationProfile* getAllocationProfile() const;
+
+  // Serialize into the Chrome DevTools `.heapprofile` JSON format.
+  std::string toJSON() const;
+
+ private:
+  // Returns the bytes allocated since any profiler last claimed them.
+  static uint64_t claimAllocatedBytes();
+  void addSample(Escargot::ExecutionStateRef* state, unsigned count);
+
+  IsolateWrap* isolate_ = nullptr;
+  uint64_t sampleInterval_ = 0;
+  int stackDepth_ = 0;
+  // Bytes claimed but not charged yet, less than sampleInterval_
+  uint64_t pendingBytes_ = 0;
+  // The time of the last check, in microseconds of the coarse clock
+  int64_t lastCheckTime_ = 0;
+  unsigned nextNodeId_ = 1;
+  uint64_t nextSampleId_ = 1;
+  std::unique_ptr<Node> root_;
+  std::vector<Sample> samples_;
+  std::map<std::string, int> scriptIds_;
+
+  static THREAD_LOCAL SamplingHeapProfilerWrap* s_profiler;
+};
+
+class HeapProfilerWrap {
+ public:
+  explicit HeapProfilerWrap(IsolateWrap* isolate) : isolate_(isolate) {}
+  ~HeapProfilerWrap();
+
+  static v8::HeapProfiler* toV8(HeapProfilerWrap* profiler) {
+    return reinterpret_cast<v8::HeapProfiler*>(profiler);
+  }
+  static HeapProfilerWrap* fromV8(v8::HeapProfiler* profiler) {
+    return reinterpret_cast<HeapProfilerWrap*>(profiler);
+  }
+
+  HeapSnapshotWrap* takeHeapSnapshot(v8::ActivityControl* control);
+  void deleteHeapSnapshot(HeapSnapshotWrap* snapshot);
+  void deleteAllHeapSnapshots() { snapshots_.clear(); }
+  size_t snapshotCount() const { return snapshots_.size(); }
+  HeapSnapshotWrap* snapshot(size_t index) { return snapshots_[index].get(); }
+
+  // Object ids are kept across snapshots so that they can be compared.
+  v8::SnapshotObjectId getObjectId(Escargot::ValueRef* value);
+  v8::SnapshotObjectId getNativeObjectId(const void* address);
+  v8::SnapshotObjectId findNativeObjectId(const void* address) const;
+  v8::SnapshotObjectId nextSyntheticId() { return nextId(); }
+  // Returns nullptr unless |id| is the id of a value which is still alive.
+  Escargot::ValueRef* findObjectById(v8::SnapshotObjectId id) const;
+  void clearObjectIds();
+
+  bool startSamplingHeapProfiler(uint64_t sampleInterval, int stackDepth);
+  void stopSamplingHeapProfiler() { samplingProfiler_.reset(); }
+  SamplingHeapProfilerWrap* samplingProfiler() const {
+    return samplingProfiler_.get();
+  }
+
+  typedef std::pair<v8::HeapProfiler::BuildEmbedderGraphCallback, void*>
+      EmbedderGraphCallback;
+  void addBuildEmbedderGraphCallback(
+      v8::HeapProfiler::BuildEmbedderGraphCallback callback, void* data);
+  void removeBuildEmbedderGraphCallback(
+      v8::HeapProfiler::BuildEmbedderGraphCallback callback, void* data);
+  const std::vector<EmbedderGraphCallback>& embedderGraphCallbacks() const {
+    return embedderGraphCallbacks_;
+  }
+
+ private:
+  // V8 uses odd numbers for ids of heap objects.
+  v8::SnapshotObjectId nextId() {
+    nextObjectId_ += 2;
+    return nextObjectId_;
+  }
+
+  struct ObjectIdEntry {
+    v8::SnapshotObjectId id;
+    // A disappearing link to the value, cleared by GC once the value is
+    // collected. nullptr for native objects and interior pointers, whose
+    // ids are dropped as soon as a snapshot no longer reports them.
+    void* value;
+    // The snapshot which last reported the address
+    size_t lastSnapshot;
+  };
+
+  ObjectIdEntry& addObjectId(const void* address, bool isWeak);
+  void removeObjectId(
+      std::unordered_map<const void*, ObjectIdEntry>::iterator it);
+  void pruneObjectIds();
+
+  IsolateWrap* isolate_ = nullptr;
+  std::vector<std::unique_ptr<HeapSnapshotWrap>> snapshots_;
+  // @note addresses are kept in the malloc heap, which isn't scanned by GC.
+  // Entries are never moved once added, as the links point into them.
+  std::unordered_map<const void*, ObjectIdEntry> objectIds_;
+  std::unordered_map<v8::SnapshotObjectId, const void*> addresses_;
+  size_t snapshotSerial_ = 0;
+  v8::SnapshotObjectId nextObjectId_ = 1;
+  std::vector<EmbedderGraphCallback> embedderGraphCallbacks_;
+  std::unique_ptr<SamplingHeapProfilerWrap> samplingProfiler_;
+};
+
+// Handle `--heap-prof`: sample allocations for the whole process lifetime of
+// the isolate and write `.heapprofile` on dispose.
+void startHeapProfileFromFlags(IsolateWrap* isolate);
+void stopHeapProfileFromFlags(IsolateWrap* isolate);
+
+}  // namespace EscargotShim
@@ -15,9 +15,16 @@
  */
 
 #include "isolate.h"
+
+#include <mutex>
+
 #include "api.h"
 #include "base.h"
 #include "context.h"
+#include "cpu-profiler.h"
+#include "heap-profiler.h"
+#include "memory-measurement.h"
+#include "microtask-queue.h"
 #include "es-helper.h"
 #include "extra-data.h"
 #include "utils/compiler.h"
@@ -180,6 +187,9 @@ void Isolate::ReportPendingMessages(bool isVerbose) {
         EscargotShim::IsolateWrap::toV8(this), exception);
 
     if (message_callback_ != nullptr) {
+      // The message isn't reported on an execution state.
+      EscargotShim::CallbackStateScope callbackStateScope(
+          EscargotShim::IsolateWrap::fromV8(this), nullptr);
       message_callback_(message, exception);
     }
   }
@@ -195,13 +205,16 @@ void Isolate::RestorePendingMessageFromTryCatch(v8::TryCatch* handler) {
   set_pending_exception(VAL(*handler->Exception())->value());
 }
 
-void Isolate::RunPromiseHook(PromiseHookType type,
+void Isolate::RunPromiseHook(Escargot::ExecutionStateRef* state,
+                             PromiseHookType type,
                              Escargot::PromiseObjectRef* promise,
                              Escargot::ValueRef* parent) {
   if (!promise_hook_ || !promise) {
     return;
   }
 
+  EscargotShim::CallbackStateScope callbackStateScope(
+      EscargotShim::IsolateWrap::fromV8(this), state);
   promise_hook_(type,
                 v8::Utils::ToLocal<Promise>(promise),
                 v8::Utils::ToLocal<Value>(parent));
@@ -217,6 +230,8 @@ ValueRef* Isolate::RunPrepareStackTraceCallback(ExecutionStateRef* state,
                              PrepareStackTraceCallback());
 
     auto v8Isolate = lwContext->GetIsolate()->toV8();
+    EscargotShim::CallbackStateScope callbackStateScope(
+        EscargotShim::IsolateWrap::fromV8(this), state);
     v8::MaybeLocal<v8::Value> maybyResult = prepare_stack_trace_callback_(
         v8::Utils::NewLocal<Context>(v8Isolate, lwContext),
         v8::Utils::NewLocal<Value>(v8Isolate, error),
@@ -273,10 +288,7 @@ IsolateWrap::IsolateWrap() {
   LWNODE_CALL_TRACE_ID(ISOWRAP, "malc: %p", this);
 
   global_handles_ = new GlobalHandles(this);
-
-  privateValuesSymbol_ = PersistentRefHolder<SymbolRef>(
-      SymbolRef::create(StringRef::createFromUTF8(PRIVATE_VALUES.data(),
-                                                  PRIVATE_VALUES.length())));
+  microtaskQueue_ = new MicrotaskQueueWrap(this, v8::MicrotasksPolicy::kAuto);
 
   threadManager_ = new ThreadManager();
 
@@ -307,6 +319,10 @@ IsolateWrap::IsolateWrap() {
 
 IsolateWrap::~IsolateWrap() {
   LWNODE_CALL_TRACE_ID(ISOWRAP, "free: %p", this);
+
+  if (arrayBufferDecorator_) {
+    arrayBufferDecorator_->deref();
+  }
 }
 
 IsolateWrap* IsolateWrap::New() {
@@ -320,6 +336,20 @@ void IsolateWrap::Dispose() {
   // NOTE: check unlock_gc_release(); is needed (and where)
   // unlock_gc_release();
 
+  stopCpuProfileFromFlags(this);
+  stopHeapProfileFromFlags(this);
+
+  delete heapProfiler_;
+  heapProfiler_ = nullptr;
+
+  for (auto measurement : memoryMeasurements_) {
+    measurement->cancel();
+  }
+  memoryMeasurements_.clear();
+
+  delete microtaskQueue_;
+  microtaskQueue_ = nullptr;
+
   global_handles()->dispose();
   RegisteredExtension::unregisterAll();
 
@@ -336,6 +366,9 @@ void IsolateWrap::set_array_buffer_allocator(
 
 void IsolateWrap::set_array_buffer_allocator_shared(
     std::shared_ptr<v8::ArrayBuffer::Allocator> allocator) {
+  // ArrayBuffers of this isolate may be freed after it is disposed, e.g.
+  // after being transferred.
+  arrayBufferDecorator_->set_array_buffer_allocator_shared(allocator);
   array_buffer_allocator_shared_ = std::move(allocator);
 }
 
@@ -381,11 +414,10 @@ void IsolateWrap::Initialize(const v8::Isolate::CreateParams& params) {
     isolate->set_array_buffer_allocator(params.array_buffer_allocator);
   }
 
+  // ArrayBuffers are allocated through the decorator of the isolate entered on
+  // the allocating thread. See Platform::onMallocArrayBufferObjectDataBuffer.
   LWNODE_CHECK_NOT_NULL(arrayBufferDecorator_->array_buffer_allocator());
 
-  auto platform = Platform::GetInstance();
-  platform->setAllocator(array_buffer_allocator());
-
   vmInstance_ = VMInstanceRef::create();
   vmInstance_->setOnVMInstanceDelete([](VMInstanceRef* instance) {
     // Do Nothing
@@ -441,11 +473,14 @@ void IsolateWrap::Initialize(const v8::Isolate::CreateParams& params) {
 
       // 2. run PromiseHook
       IsolateWrap::GetCurrent()->RunPromiseHook(
-          (v8::PromiseHookType)type, promise, parent);
+          state, (v8::PromiseHookType)type, promise, parent);
     };
 
     vmInstance_->registerPromiseHook(fn);
   }
+
+  startCpuProfileFromFlags(this);
+  startHeapProfileFromFlags(this);
 }
 
 void IsolateWrap::Enter() {
@@ -471,6 +506,13 @@ void IsolateWrap::Exit() {
   s_previousIsolate = nullptr;
 }
 
+HeapProfilerWrap* IsolateWrap::heapProfiler() {
+  if (!heapProfiler_) {
+    heapProfiler_ = new HeapProfilerWrap(this);
+  }
+  return heapProfiler_;
+}
+
 IsolateWrap* IsolateWrap::GetCurrent() {
   return s_currentIsolate;
 }
@@ -544,12 +586,85 @@ ContextWrap* IsolateWrap::GetCurrentContext() {
   return contextScopes_.back();
 }
 
+void IsolateWrap::addContext(ContextWrap* context) {
+  if (contexts_.size() >= contextsPruneThreshold_) {
+    // Drop the slots of contexts already collected.
+    size_t live = 0;
+    for (size_t i = 0; i < contexts_.size(); i++) {
+      if (*contexts_[i] != nullptr) {
+        contexts_[live++] = contexts_[i];
+      }
+    }
+    contexts_.resize(live);
+    contextsPruneThreshold_ = std::max(live * 2, contextsPruneThreshold_);
+  }
+
+  auto slot = reinterpret_cast<ContextWrap**>(
+      GC_MALLOC_ATOMIC(sizeof(ContextWrap*)));
+  *slot = context;
+  GC_general_register_disappearing_link(reinterpret_cast<void**>(slot),
+                                        context);
+  contexts_.push_back(slot);
+}
+
+void IsolateWrap::getContexts(GCVector<ContextWrap*>* contexts) {
+  for (size_t i = 0; i < contexts_.size(); i++) {
+    if (*contexts_[i] != nullptr) {
+      contexts->push_back(*contexts_[i]);
+    }
+  }
+}
+
+void IsolateWrap::addMemoryMeasurement(MemoryMeasurementWrap* measurement) {
+  memoryMeasurements_.push_back(measurement);
+}
+
+void IsolateWrap::removeMemoryMeasurement(MemoryMeasurementWrap* measurement) {
+  for (size_t i = 0; i < memoryMeasurements_.size(); i++) {
+    if (memoryMeasurements_[i] == measurement) {
+      memoryMeasurements_.erase(i);
+      return;
+    }
+  }
+}
+
+bool IsolateWrap::hasMemoryMeasurement(MemoryMeasurementWrap* measurement) {
+  for (size_t i = 0; i < memoryMeasurements_.size(); i++) {
+    if (memoryMeasurements_[i] == measurement) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void IsolateWrap::addEternal(GCManagedObject* value) {
   LWNODE_CALL_TRACE_ID(ISOWRAP, "%p", value);
   eternals_.push_back(value);
 }
 
+typedef GCMap<BackingStoreRef*, int, BackingStoreComparator>
+    BackingStoreCounter;
+
+// Counters of the BackingStores which may be released on any thread: the
+// shared ones and the ones detached from their isolates
+static std::mutex s_sharedBackingStoresMutex;
+static PersistentRefHolder<BackingStoreCounter>* s_sharedBackingStores;
+
+static BackingStoreCounter* sharedBackingStores() {
+  if (!s_sharedBackingStores) {
+    s_sharedBackingStores =
+        new PersistentRefHolder<BackingStoreCounter>(new BackingStoreCounter());
+  }
+  return s_sharedBackingStores->get();
+}
+
 void IsolateWrap::addBackingStore(BackingStoreRef* value) {
+  if (value->isShared()) {
+    std::lock_guard<std::mutex> lock(s_sharedBackingStoresMutex);
+    (*sharedBackingStores())[value]++;
+    return;
+  }
+
   auto itr = backingStoreCounter_.find(value);
   if (itr != backingStoreCounter_.end()) {
     ++itr->second;
@@ -566,73 +681,107 @@ void IsolateWrap::removeBackingStore(BackingStoreRef* value) {
     } else {
       --itr->second;
     }
-  } else {
-    LWNODE_CHECK_MSG(false, "increment/decrement count do not match");
+    return;
+  }
+
+  // The BackingStore is shared, or has been handed over from another isolate.
+  std::lock_guard<std::mutex> lock(s_sharedBackingStoresMutex);
+  auto counter = sharedBackingStores();
+  auto it = counter->find(value);
+  if (it != counter->end()) {
+    if (--it->second == 0) {
+      counter->erase(it);
+    }
+    return;
   }
+  LWNODE_CHECK_MSG(false, "increment/decrement count do not match");
 }
 
-SymbolRef* IsolateWrap::createApiSymbol(StringRef* name) {
-  // FIXME: Use a set
-  auto newSymbol = SymbolRef::create(name);
-  bool found = false;
-  for (size_t i = 0; i < apiSymbols_.size(); i++) {
-    if (apiSymbols_[i]->descriptionString()->equals(name)) {
-      apiSymbols_[i] = newSymbol;
-      found = true;
-      break;
+void IsolateWrap::beginBackingStoreTransfer(BackingStoreRef* value) {
+  transferringBackingStores_[value]++;
+}
+
+void IsolateWrap::endBackingStoreTransfer(BackingStoreRef* value) {
+  auto itr = transferringBackingStores_.find(value);
+  LWNODE_CHECK(itr != transferringBackingStores_.end());
+  if (--itr->second == 0) {
+    transferringBackingStores_.erase(itr);
+  }
+}
+
+void IsolateWrap::detachBackingStore(BackingStoreRef* value) {
+  if (transferringBackingStores_.find(value) ==
+      transferringBackingStores_.end()) {
+    return;
+  }
+
+  auto itr = backingStoreCounter_.find(value);
+  if (itr == backingStoreCounter_.end()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(s_sharedBackingStoresMutex);
+  (*sharedBackingStores())[value] += itr->second;
+  backingStoreCounter_.erase(itr);
+}
+
+SymbolRef* ApiSymbolRegistry::get(StringRef* name) {
+  auto range = symbols_.equal_range(StringRefHelper::hash(name));
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->descriptionString()->equals(name)) {
+      return it->second;
     }
   }
+  return nullptr;
+}
 
-  if (!found) {
-    apiSymbols_.push_back(newSymbol);
-    LWNODE_DLOG_INFO("malc: api symbol: %s", name->toStdUTF8String().c_str());
+void ApiSymbolRegistry::set(SymbolRef* symbol) {
+  auto name = symbol->descriptionString();
+  auto hash = StringRefHelper::hash(name);
+  auto range = symbols_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->descriptionString()->equals(name)) {
+      it->second = symbol;
+      return;
+    }
   }
+  symbols_.emplace(hash, symbol);
+}
+
+SymbolRef* IsolateWrap::createApiSymbol(StringRef* name) {
+  auto newSymbol = SymbolRef::create(name);
+  apiSymbols_.set(newSymbol);
+  LWNODE_DLOG_INFO("malc: api symbol: %s", name->toStdUTF8String().c_str());
 
   return newSymbol;
 }
 
 SymbolRef* IsolateWrap::getApiSymbol(StringRef* name) {
-  // FIXME: Use a set
   LWNODE_CALL_TRACE_ID(ISOWRAP);
 
-  for (auto apiSymbols : apiSymbols_) {
-    if (apiSymbols->descriptionString()->equals(name)) {
-      return apiSymbols;
-    }
+  auto symbol = apiSymbols_.get(name);
+  if (symbol) {
+    return symbol;
   }
 
   return createApiSymbol(name);
 }
 
 SymbolRef* IsolateWrap::createApiPrivateSymbol(StringRef* name) {
-  // FIXME: Use a set
   auto newSymbol = SymbolRef::create(name);
-  bool found = false;
-  for (size_t i = 0; i < apiPrivateSymbols_.size(); i++) {
-    if (apiPrivateSymbols_[i]->descriptionString()->equals(name)) {
-      apiPrivateSymbols_[i] = newSymbol;
-      found = true;
-      break;
-    }
-  }
-
-  if (!found) {
-    apiPrivateSymbols_.push_back(newSymbol);
-    LWNODE_DLOG_INFO("malc: private symbol: %s",
-                     name->toStdUTF8String().c_str());
-  }
+  apiPrivateSymbols_.set(newSymbol);
+  LWNODE_DLOG_INFO("malc: private symbol: %s",
+                   name->toStdUTF8String().c_str());
 
   return newSymbol;
 }
 
 SymbolRef* IsolateWrap::getApiPrivateSymbol(StringRef* name) {
-  // FIXME: Use a set
   LWNODE_CALL_TRACE_ID(ISOWRAP);
 
-  for (auto apiPrivateSymbol : apiPrivateSymbols_) {
-    if (apiPrivateSymbol->descriptionString()->equals(name)) {
-      return apiPrivateSymbol;
-    }
+  auto symbol = apiPrivateSymbols_.get(name);
+  if (symbol) {
+    return symbol;
   }
 
   return createApiPrivateSymbol(name);
@@ -701,8 +850,8 @@ void IsolateWrap::SetPendingExceptionAndMessage(
   if (exception->isObject()) {
     auto extraData = ExtraDataHelper::getExtraData(exception->asObject());
 
-    if (extraData) {
-      LWNODE_CHECK(extraData->isExceptionObjectData());
+    // NOTE: An object may have extra data only to keep its private values.
+    if (extraData && extraData->isExceptionObjectData()) {
       // NOTE: Exception has created in the `else` below.
       LWNODE_LOG_WARN("esException already contains an extraData: %p\n",
                       extraData);
@@ -821,7 +970,7 @@ void IsolateWrap::SetPromiseHook(v8::PromiseHook callback) {
                PromiseObjectRef* promise,
                ValueRef* parent) {
     IsolateWrap::GetCurrent()->RunPromiseHook(
-        (v8::PromiseHookType)type, promise, parent);
+        state, (v8::PromiseHookType)type, promise, parent);
   };
 
   vmInstance()->registerPromiseHook(fn);
@@ -839,7 +988,9 @@ void IsolateWrap::SetPromiseRejectCallback(v8::PromiseRejectCallback callback) {
     // then, temporally disable stack overflow to execute the callback without
     // any exception
     StackOverflowDisabler disabler(state);
-    IsolateWrap::GetCurrent()->ReportPromiseReject(promise, value, event);
+    auto lwIsolate = IsolateWrap::GetCurrent();
+    CallbackStateScope callbackStateScope(lwIsolate, state);
+    lwIsolate->ReportPromiseReject(promise, value, event);
   };
 
   vmInstance()->registerPromiseRejectCallback(fn);
@@ -53,7 +53,8 @@ class Isolate : public gc {
   bool PropagatePendingExceptionToExternalTryCatch();
   void ReportPendingMessages(bool isVerbose = false);
 
-  void RunPromiseHook(PromiseHookType type,
+  void RunPromiseHook(Escargot::ExecutionStateRef* state,
+                      PromiseHookType type,
                       Escargot::PromiseObjectRef* promise,
                       Escargot::ValueRef* parent);
 
@@ -105,6 +106,16 @@ class Isolate : public gc {
   void decreaseCallDepth() { callDepth_--; }
   size_t callDepth() { return callDepth_; }
   bool hasCallDepth();
+
+  // JavaScript runs if the embedder has called into it, see
+  // ScriptEntryScope, or a native callback is being run.
+  void increaseScriptDepth() { scriptDepth_++; }
+  void decreaseScriptDepth() { scriptDepth_--; }
+  bool isRunningScript() const { return scriptDepth_ > 0 || callDepth_ > 0; }
+
+  // Set by the embedder with v8::Isolate::SetIdle()
+  void setIdle(bool isIdle) { isIdle_ = isIdle; }
+  bool isIdle() const { return isIdle_; }
   bool sholdReportPendingMessage(bool isVerbose);
 
   EscargotShim::GlobalHandles* global_handles() { return global_handles_; }
@@ -138,6 +149,8 @@ class Isolate : public gc {
   Escargot::ValueRef* pending_exception_{nullptr};
   Escargot::ValueRef* pending_message_obj_{nullptr};
   size_t callDepth_ = 0;
+  size_t scriptDepth_ = 0;
+  bool isIdle_{false};
   bool prepareStackTraceRecursion_{false};
 };
 }  // namespace internal
@@ -146,6 +159,9 @@ class Isolate : public gc {
 namespace EscargotShim {
 
 class ContextWrap;
+class HeapProfilerWrap;
+class MemoryMeasurementWrap;
+class MicrotaskQueueWrap;
 
 typedef gc GCManagedObject;
 
@@ -155,14 +171,26 @@ struct BackingStoreComparator {
   }
 };
 
+// Symbols created by Symbol::ForApi and Private::ForApi, keyed by the hash
+// of their descriptions
+class ApiSymbolRegistry {
+ public:
+  // Returns nullptr if no symbol is registered with |name|.
+  SymbolRef* get(StringRef* name);
+  // Registers |symbol|, replacing a symbol with the same description.
+  void set(SymbolRef* symbol);
+  size_t size() const { return symbols_.size(); }
+
+ private:
+  GCUnorderedMultiMap<size_t, SymbolRef*> symbols_;
+};
+
 class IsolateWrap final : public v8::internal::Isolate {
  public:
   enum class State { None, Active, Disposed };
 
   ~IsolateWrap();
 
-  const std::string PRIVATE_VALUES = "__private_values__";
-
   static IsolateWrap* New();
   void Initialize(const v8::Isolate::CreateParams& params);
   void Dispose();
@@ -196,6 +224,9 @@ class IsolateWrap final : public v8::internal::Isolate {
   v8::ArrayBuffer::Allocator* array_buffer_allocator() {
     return arrayBufferDecorator_->array_buffer_allocator();
   }
+  ArrayBufferAllocatorDecorator* array_buffer_allocator_decorator() {
+    return arrayBufferDecorator_;
+  }
 
   ArrayBufferAllocatorDecorator* arrayBufferDecorator_ = nullptr;
 
@@ -215,15 +246,35 @@ class IsolateWrap final : public v8::internal::Isolate {
   ContextWrap* GetCurrentContext();
   size_t getNumberOfContexts();
 
+  // Every context created in this isolate. They are held weakly.
+  void addContext(ContextWrap* context);
+  void getContexts(GCVector<ContextWrap*>* contexts);
+
+  // Memory measurements in progress
+  void addMemoryMeasurement(MemoryMeasurementWrap* measurement);
+  void removeMemoryMeasurement(MemoryMeasurementWrap* measurement);
+  bool hasMemoryMeasurement(MemoryMeasurementWrap* measurement);
+
   // Eternal
   void addEternal(GCManagedObject* value);
+  const GCVector<GCManagedObject*>& eternals() { return eternals_; }
 
   // Increment/Decrement a counter when either a unique_ptr<v8::BackingStore>
   // or shared_ptr<v8::BackingStore> is created. It holds a BackingStore when
-  // it is transferred between Array/SharedArrayBuffers.
+  // it is transferred between Array/SharedArrayBuffers. A shared BackingStore
+  // is counted process-wide since it is referred to from several isolates.
   void addBackingStore(BackingStoreRef* value);
   void removeBackingStore(BackingStoreRef* value);
 
+  // A serializer marks the BackingStores it transfers until it is destroyed.
+  // When the ArrayBuffer of a marked BackingStore is detached, its counter
+  // moves out of this isolate, and the BackingStore is held until the last
+  // reference is released on any thread. Detaching any other ArrayBuffer
+  // leaves its counter here.
+  void beginBackingStoreTransfer(BackingStoreRef* value);
+  void endBackingStoreTransfer(BackingStoreRef* value);
+  void detachBackingStore(BackingStoreRef* value);
+
   VMInstanceRef* get() { return vmInstance_; }
   VMInstanceRef* vmInstance() { return vmInstance_; }
 
@@ -262,8 +313,6 @@ class IsolateWrap final : public v8::internal::Isolate {
   void lock_gc_release() { release_lock_.reset(this); }
   void unlock_gc_release() { release_lock_.release(); }
 
-  SymbolRef* privateValuesSymbol() { return privateValuesSymbol_.get(); }
-
   void SetPromiseHook(v8::PromiseHook callback);
 
   void SetPromiseRejectCallback(v8::PromiseRejectCallback callback);
@@ -279,6 +328,17 @@ class IsolateWrap final : public v8::internal::Isolate {
 
   State getState() { return state_; }
 
+  MicrotaskQueueWrap* defaultMicrotaskQueue() { return microtaskQueue_; }
+
+  // The execution state of the innermost embedder callback being run, or
+  // nullptr. It is set by CallbackStateScope.
+  // @note Operations that can't throw may use it instead of entering a new
+  // sandbox with Evaluator::execute.
+  ExecutionStateRef* callbackState() { return callbackState_; }
+  void setCallbackState(ExecutionStateRef* state) { callbackState_ = state; }
+
+  HeapProfilerWrap* heapProfiler();
+
  private:
   IsolateWrap();
 
@@ -286,13 +346,20 @@ class IsolateWrap final : public v8::internal::Isolate {
 
   GCVector<GCManagedObject*> eternals_;
   GCMap<BackingStoreRef*, int, BackingStoreComparator> backingStoreCounter_;
+  // BackingStore -> the number of serializers transferring it
+  GCMap<BackingStoreRef*, int, BackingStoreComparator>
+      transferringBackingStores_;
 
   GCVector<HandleScopeWrap*> handleScopes_;
   GCVector<ContextWrap*> contextScopes_;
+  // @note Each slot is allocated as pointer-free memory and registered as a
+  // disappearing link, so it doesn't keep the context alive.
+  GCVector<ContextWrap**> contexts_;
+  size_t contextsPruneThreshold_ = 16;
+  GCVector<MemoryMeasurementWrap*> memoryMeasurements_;
 
-  PersistentRefHolder<SymbolRef> privateValuesSymbol_;
-  GCVector<SymbolRef*> apiSymbols_;
-  GCVector<SymbolRef*> apiPrivateSymbols_;
+  ApiSymbolRegistry apiSymbols_;
+  ApiSymbolRegistry apiPrivateSymbols_;
 
   // Isolate Scope
   static THREAD_LOCAL IsolateWrap* s_currentIsolate;
@@ -308,10 +375,37 @@ class IsolateWrap final : public v8::internal::Isolate {
   ValueWrap* globalSlot_[internal::Internals::kRootIndexSize]{};
 
   ThreadManager* threadManager_ = nullptr;
+  HeapProfilerWrap* heapProfiler_ = nullptr;
+  MicrotaskQueueWrap* microtaskQueue_ = nullptr;
+  ExecutionStateRef* callbackState_ = nullptr;
 
   v8::PromiseRejectCallback promise_reject_callback_{nullptr};
 
   State state_ = State::None;
 };
 
+/*
+  CallbackStateScope makes |state| the callback state of |isolate| while an
+  embedder callback runs, and restores the previous one when it returns. Every
+  embedder callback is run in one, so the state is never that of an outer
+  callback whose JavaScript has called into the engine again. Callbacks that
+  aren't run on an execution state, e.g. weak callbacks run by the GC, clear
+  it with nullptr.
+*/
+class CallbackStateScope {
+ public:
+  CallbackStateScope(IsolateWrap* isolate, ExecutionStateRef* state)
+      : isolate_(isolate), previousState_(isolate->callbackState()) {
+    isolate_->setCallbackState(state);
+  }
+  ~CallbackStateScope() { isolate_->setCallbackState(previousState_); }
+
+  CallbackStateScope(const CallbackStateScope&) = delete;
+  CallbackStateScope& operator=(const CallbackStateScope&) = delete;
+
+ private:
+  IsolateWrap* isolate_;
+  ExecutionStateRef* previousState_;
+};
+
 }  // namespace EscargotShim
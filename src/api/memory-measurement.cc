@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "memory-measurement.h"
+
+#include "api.h"
+#include "base.h"
+#include "context.h"
+#include "init/v8.h"
+#include "isolate.h"
+
+using namespace Escargot;
+
+namespace EscargotShim {
+
+class MemoryMeasurementWrap::StepTask : public v8::Task {
+ public:
+  StepTask(IsolateWrap* isolate, MemoryMeasurementWrap* measurement)
+      : isolate_(isolate), measurement_(measurement) {}
+
+  void Run() override {
+    // The measurement may have been cancelled since this task was posted.
+    if (isolate_->hasMemoryMeasurement(measurement_)) {
+      measurement_->step();
+    }
+  }
+
+ private:
+  IsolateWrap* isolate_;
+  MemoryMeasurementWrap* measurement_;
+};
+
+MemoryMeasurementWrap::MemoryMeasurementWrap(
+    IsolateWrap* isolate, std::unique_ptr<v8::MeasureMemoryDelegate> delegate)
+    : isolate_(isolate), delegate_(delegate.release()) {}
+
+void MemoryMeasurementWrap::start(v8::MeasureMemoryExecution execution) {
+  v8::HandleScope handleScope(isolate_->toV8());
+
+  GCVector<ContextWrap*> contexts;
+  isolate_->getContexts(&contexts);
+
+  blocked_.insert(GC_HIDE_POINTER(isolate_));
+  blocked_.insert(GC_HIDE_POINTER(isolate_->vmInstance()));
+  for (auto context : contexts) {
+    blocked_.insert(GC_HIDE_POINTER(context));
+    blocked_.insert(GC_HIDE_POINTER(context->get()));
+    blocked_.insert(GC_HIDE_POINTER(context->get()->globalObject()));
+
+    if (delegate_->ShouldMeasure(
+            v8::Utils::NewLocal<v8::Context>(isolate_->toV8(), context))) {
+      contexts_.push_back(context);
+      sizes_.push_back(0);
+    }
+  }
+
+  // NOTE: V8 folds a measurement into the next GC unless it is eager. Here a
+  // measurement never waits for a GC, so both are scheduled right away.
+  isolate_->addMemoryMeasurement(this);
+  startNextContext();
+  postStep();
+}
+
+void MemoryMeasurementWrap::cancel() {
+  delete delegate_;
+  delegate_ = nullptr;
+  worklist_.clear();
+  owners_.clear();
+  blocked_.clear();
+}
+
+void MemoryMeasurementWrap::postStep() {
+  auto platform = v8::internal::V8::GetCurrentPlatform();
+  platform->GetForegroundTaskRunner(isolate_->toV8())
+      ->PostTask(std::make_unique<StepTask>(isolate_, this));
+}
+
+void MemoryMeasurementWrap::step() {
+  if (visitObjects(kStepBudget)) {
+    complete();
+  } else {
+    postStep();
+  }
+}
+
+bool MemoryMeasurementWrap::startNextContext() {
+  while (currentContext_ < contexts_.size()) {
+    void* global = contexts_[currentContext_]->get()->globalObject();
+    auto it = owners_.find(GC_HIDE_POINTER(global));
+    if (it == owners_.end()) {
+      owners_.emplace(GC_HIDE_POINTER(global), currentContext_);
+      sizes_[currentContext_] += GC_size(global);
+      worklist_.push_back(global);
+      return true;
+    }
+    currentContext_++;
+  }
+  return false;
+}
+
+bool MemoryMeasurementWrap::visitObjects(size_t budget) {
+  while (budget > 0) {
+    if (worklist_.empty()) {
+      currentContext_++;
+      if (!startNextContext()) {
+        return true;
+      }
+    }
+
+    void* object = worklist_.back();
+    worklist_.pop_back();
+    visit(object);
+    budget--;
+  }
+  return false;
+}
+
+void MemoryMeasurementWrap::visit(void* object) {
+  size_t size = 0;
+  if (GC_get_kind_and_size(object, &size) == GC_I_PTRFREE) {
+    return;
+  }
+
+  int owner = owners_[GC_HIDE_POINTER(object)];
+  void** words = reinterpret_cast<void**>(object);
+  for (size_t i = 0; i < size / sizeof(void*); i++) {
+    void* child = GC_base(words[i]);
+    if (child == nullptr || blocked_.count(GC_HIDE_POINTER(child))) {
+      continue;
+    }
+
+    auto it = owners_.find(GC_HIDE_POINTER(child));
+    if (it == owners_.end()) {
+      owners_.emplace(GC_HIDE_POINTER(child), owner);
+      size_t childSize = GC_size(child);
+      if (owner == kShared) {
+        unattributedSize_ += childSize;
+      } else {
+        sizes_[owner] += childSize;
+      }
+      worklist_.push_back(child);
+    } else if (it->second != owner && it->second != kShared) {
+      // Reachable from more than one context
+      size_t childSize = GC_size(child);
+      sizes_[it->second] -= childSize;
+      unattributedSize_ += childSize;
+      it->second = kShared;
+      worklist_.push_back(child);
+    }
+  }
+}
+
+void MemoryMeasurementWrap::complete() {
+  isolate_->removeMemoryMeasurement(this);
+
+  v8::HandleScope handleScope(isolate_->toV8());
+  std::vector<std::pair<v8::Local<v8::Context>, size_t>> result;
+  for (size_t i = 0; i < contexts_.size(); i++) {
+    result.emplace_back(
+        v8::Utils::NewLocal<v8::Context>(isolate_->toV8(), contexts_[i]),
+        sizes_[i]);
+  }
+
+  auto delegate = std::unique_ptr<v8::MeasureMemoryDelegate>(delegate_);
+  cancel();
+  delegate->MeasurementComplete(result, unattributedSize_);
+}
+
+// --- Default delegate ---
+
+namespace {
+
+bool isSameContext(v8::Local<v8::Context> a, v8::Local<v8::Context> b) {
+  return ContextWrap::fromV8(*a) == ContextWrap::fromV8(*b);
+}
+
+class DefaultMeasureMemoryDelegate : public v8::MeasureMemoryDelegate {
+ public:
+  DefaultMeasureMemoryDelegate(v8::Isolate* isolate,
+                               v8::Local<v8::Context> context,
+                               v8::Local<v8::Promise::Resolver> promiseResolver,
+                               v8::MeasureMemoryMode mode)
+      : isolate_(isolate),
+        context_(isolate, context),
+        promiseResolver_(isolate, promiseResolver),
+        mode_(mode) {}
+
+  bool ShouldMeasure(v8::Local<v8::Context> context) override {
+    // Only contexts of the same origin are measured, as V8 does.
+    auto current = context_.Get(isolate_);
+    return context->GetSecurityToken()->StrictEquals(
+        current->GetSecurityToken());
+  }
+
+  void MeasurementComplete(
+      const std::vector<std::pair<v8::Local<v8::Context>, size_t>>&
+          contextSizes,
+      size_t unattributedSize) override {
+    auto context = context_.Get(isolate_);
+    v8::Context::Scope contextScope(context);
+
+    size_t totalSize = 0;
+    size_t currentSize = 0;
+    for (const auto& contextAndSize : contextSizes) {
+      totalSize += contextAndSize.second;
+      if (isSameContext(contextAndSize.first, context)) {
+        currentSize = contextAndSize.second;
+      }
+    }
+
+    auto result = v8::Object::New(isolate_);
+    set(result, "total", newResult(totalSize, unattributedSize));
+
+    if (mode_ == v8::MeasureMemoryMode::kDetailed) {
+      set(result, "current", newResult(currentSize, unattributedSize));
+
+      auto other = v8::Array::New(isolate_);
+      uint32_t index = 0;
+      for (const auto& contextAndSize : contextSizes) {
+        if (!isSameContext(contextAndSize.first, context)) {
+          other
+              ->Set(context,
+                    index++,
+                    newResult(contextAndSize.second, unattributedSize))
+              .Check();
+        }
+      }
+      set(result, "other", other);
+    }
+
+    promiseResolver_.Get(isolate_)->Resolve(context, result).Check();
+  }
+
+ private:
+  // { jsMemoryEstimate: size, jsMemoryRange: [size, size + shared] }
+  v8::Local<v8::Object> newResult(size_t size, size_t sharedSize) {
+    auto result = v8::Object::New(isolate_);
+    set(result, "jsMemoryEstimate", v8::Number::New(isolate_, size));
+
+    auto range = v8::Array::New(isolate_, 2);
+    auto context = context_.Get(isolate_);
+    range->Set(context, 0, v8::Number::New(isolate_, size)).Check();
+    range->Set(context, 1, v8::Number::New(isolate_, size + sharedSize))
+        .Check();
+    set(result, "jsMemoryRange", range);
+    return result;
+  }
+
+  void set(v8::Local<v8::Object> object,
+           const char* name,
+           v8::Local<v8::Value> value) {
+    object
+        ->Set(context_.Get(isolate_),
+              v8::String::NewFromUtf8(isolate_, name).ToLocalChecked(),
+              value)
+        .Check();
+  }
+
+  v8::Isolate* isolate_;
+  v8::Global<v8::Context> context_;
+  v8::Global<v8::Promise::Resolver> promiseResolver_;
+  v8::MeasureMemoryMode mode_;
+};
+
+}  // namespace
+
+std::unique_ptr<v8::MeasureMemoryDelegate>
+MemoryMeasurementWrap::createDefaultDelegate(
+    v8::Isolate* isolate,
+    v8::Local<v8::Context> context,
+    v8::Local<v8::Promise::Resolver> promiseResolver,
+    v8::MeasureMemoryMode mode) {
+  return std::make_unique<DefaultMeasureMemoryDelegate>(
+      isolate, context, promiseResolver, mode);
+}
+
+}  // namespace EscargotShim
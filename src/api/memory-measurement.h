@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+
+#include "v8.h"
+
+#include "utils/gc-util.h"
+
+namespace EscargotShim {
+
+class IsolateWrap;
+class ContextWrap;
+
+/*
+  MemoryMeasurementWrap attributes GC heap bytes to contexts.
+
+  Starting from the global object of each measured context, the GC heap is
+  walked the way the collector marks it: every word of a traced object that
+  points into the heap is an edge. An object reachable from a single context
+  is charged to it, and an object reachable from several contexts is reported
+  as unattributed. The isolate, the VM instance and the other contexts are
+  never entered since everything is reachable from them.
+
+  The walk runs in bounded steps posted to the foreground task runner of the
+  isolate so that the event loop keeps going. Only the objects still to be
+  visited are kept alive between steps; the visited ones are remembered by
+  hidden addresses, so the measurement never retains garbage. Objects
+  allocated meanwhile may be missed, including those reusing the address of
+  a collected object; the result is an estimate, as it is in V8.
+*/
+class MemoryMeasurementWrap : public gc {
+ public:
+  MemoryMeasurementWrap(IsolateWrap* isolate,
+                        std::unique_ptr<v8::MeasureMemoryDelegate> delegate);
+
+  // Select the contexts to measure and schedule the first step.
+  void start(v8::MeasureMemoryExecution execution);
+
+  // Abandon the measurement without reporting, e.g. on isolate dispose.
+  void cancel();
+
+  static std::unique_ptr<v8::MeasureMemoryDelegate> createDefaultDelegate(
+      v8::Isolate* isolate,
+      v8::Local<v8::Context> context,
+      v8::Local<v8::Promise::Resolver> promiseResolver,
+      v8::MeasureMemoryMode mode);
+
+ private:
+  class StepTask;
+
+  // Number of objects visited in a step
+  static const size_t kStepBudget = 4096;
+  static const int kShared = -1;
+
+  void postStep();
+  void step();
+  bool visitObjects(size_t budget);
+  bool startNextContext();
+  void visit(void* object);
+  void complete();
+
+  IsolateWrap* isolate_ = nullptr;
+  // @note owned; a gc object has no destructor to release a unique_ptr.
+  v8::MeasureMemoryDelegate* delegate_ = nullptr;
+
+  GCVector<ContextWrap*> contexts_;
+  GCVector<size_t> sizes_;
+  size_t unattributedSize_ = 0;
+  size_t currentContext_ = 0;
+
+  // @note addresses are hidden with GC_HIDE_POINTER so that GC doesn't take
+  // them for references.
+  GCUnorderedSet<GC_hidden_pointer> blocked_;
+  // object -> the index of the context reaching it, or kShared
+  GCUnorderedMap<GC_hidden_pointer, int> owners_;
+  GCVector<void*> worklist_;
+};
+
+}  // namespace EscargotShim
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "microtask-queue.h"
+
+#include <algorithm>
+
+#include "api.h"
+#include "base.h"
+#include "context.h"
+#include "cpu-profiler.h"
+#include "isolate.h"
+
+using namespace Escargot;
+
+namespace EscargotShim {
+
+MicrotaskQueueWrap::MicrotaskQueueWrap(IsolateWrap* isolate,
+                                       v8::MicrotasksPolicy policy)
+    : isolate_(isolate), policy_(policy) {
+  microtasks_.reset(new GCDeque<Microtask>());
+}
+
+MicrotaskQueueWrap::~MicrotaskQueueWrap() {
+  microtasks_.release();
+}
+
+void MicrotaskQueueWrap::EnqueueMicrotask(v8::Isolate* isolate,
+                                          v8::Local<v8::Function> microtask) {
+  microtasks_->push_back({CVAL(*microtask)->value(), nullptr, nullptr});
+}
+
+void MicrotaskQueueWrap::EnqueueMicrotask(v8::Isolate* isolate,
+                                          v8::MicrotaskCallback callback,
+                                          void* data) {
+  microtasks_->push_back({nullptr, callback, data});
+}
+
+void MicrotaskQueueWrap::AddMicrotasksCompletedCallback(
+    v8::MicrotasksCompletedCallbackWithData callback, void* data) {
+  CompletedCallback completedCallback(callback, data);
+  auto it = std::find(completedCallbacks_.begin(),
+                      completedCallbacks_.end(),
+                      completedCallback);
+  if (it == completedCallbacks_.end()) {
+    completedCallbacks_.push_back(completedCallback);
+  }
+}
+
+void MicrotaskQueueWrap::RemoveMicrotasksCompletedCallback(
+    v8::MicrotasksCompletedCallbackWithData callback, void* data) {
+  auto it = std::find(completedCallbacks_.begin(),
+                      completedCallbacks_.end(),
+                      CompletedCallback(callback, data));
+  if (it != completedCallbacks_.end()) {
+    completedCallbacks_.erase(it);
+  }
+}
+
+void MicrotaskQueueWrap::PerformCheckpoint(v8::Isolate* isolate) {
+  if (isRunning_ || scopeDepth_ > 0 || suppressions_ > 0) {
+    return;
+  }
+  runMicrotasks();
+}
+
+void MicrotaskQueueWrap::onCallCompleted() {
+  if (policy_ == v8::MicrotasksPolicy::kAuto) {
+    PerformCheckpoint(isolate_->toV8());
+  }
+}
+
+// Marks the queue as running for a checkpoint, and calls the completed
+// callbacks when the checkpoint ends, however it ends.
+class MicrotaskQueueWrap::CheckpointScope {
+ public:
+  explicit CheckpointScope(MicrotaskQueueWrap* queue) : queue_(queue) {
+    queue_->isRunning_ = true;
+    queue_->checkpointCount_++;
+  }
+  ~CheckpointScope() {
+    queue_->isRunning_ = false;
+    queue_->callCompletedCallbacks();
+  }
+
+ private:
+  MicrotaskQueueWrap* queue_;
+};
+
+void MicrotaskQueueWrap::runMicrotasks() {
+  LWNODE_CALL_TRACE_ID(MICROTASK, "%p", this);
+
+  GCHeap::ProcessingHoldScope scope;
+  CheckpointScope checkpointScope(this);
+
+  do {
+    while (!microtasks_->empty()) {
+      Microtask microtask = microtasks_->front();
+      microtasks_->pop_front();
+      executedCount_++;
+      runMicrotask(microtask);
+    }
+
+    if (isDefault() && !runPendingJobs()) {
+      return;
+    }
+  } while (!microtasks_->empty());
+}
+
+void MicrotaskQueueWrap::callCompletedCallbacks() {
+  // Callbacks may remove themselves while being called.
+  auto callbacks = completedCallbacks_;
+  for (const auto& callback : callbacks) {
+    callback.first(isolate_->toV8(), callback.second);
+  }
+}
+
+bool MicrotaskQueueWrap::runMicrotask(const Microtask& microtask) {
+  if (microtask.callback) {
+    microtask.callback(microtask.data);
+    return true;
+  }
+
+  auto creationContext = microtask.function->asObject()->creationContext();
+  auto esContext = creationContext.hasValue()
+                       ? creationContext.get()
+                       : isolate_->GetCurrentContext()->get();
+
+  ScriptEntryScope scriptEntryScope(isolate_);
+  auto r = Evaluator::execute(
+      esContext,
+      [](ExecutionStateRef* state, ValueRef* function) -> ValueRef* {
+        return function->call(state, ValueRef::createUndefined(), 0, nullptr);
+      },
+      microtask.function);
+
+  if (!r.isSuccessful()) {
+    isolate_->handleException(std::move(r));
+    return false;
+  }
+  return true;
+}
+
+bool MicrotaskQueueWrap::isDefault() const {
+  return isolate_->defaultMicrotaskQueue() == this;
+}
+
+bool MicrotaskQueueWrap::runPendingJobs() {
+  auto vmInstance = isolate_->vmInstance();
+
+  while (vmInstance->hasPendingJob()) {
+    executedCount_++;
+    ScriptEntryScope scriptEntryScope(isolate_);
+    auto r = vmInstance->executePendingJob();
+    if (!r.isSuccessful()) {
+      __DLOG_EVAL_EXCEPTION(r);
+      isolate_->SetTerminationOnExternalTryCatch();
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace EscargotShim
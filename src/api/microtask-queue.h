@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <EscargotPublic.h>
+#include <v8.h>
+#include <utility>
+#include <vector>
+
+#include "utils/gc-util.h"
+
+namespace v8 {
+namespace internal {
+
+// v8::MicrotaskQueue can only be constructed by this class.
+class MicrotaskQueue : public v8::MicrotaskQueue {
+ protected:
+  MicrotaskQueue() = default;
+};
+
+}  // namespace internal
+}  // namespace v8
+
+namespace EscargotShim {
+
+class IsolateWrap;
+
+/*
+  MicrotaskQueueWrap runs microtasks enqueued through the V8 API together with
+  the promise jobs of Escargot.
+
+  Escargot keeps a single job queue per VMInstance and doesn't tell which
+  context a promise job belongs to, so promise jobs can't be split between
+  queues. They belong to the default queue of the isolate: only its
+  checkpoints drain them. A queue created with v8::MicrotaskQueue::New() runs
+  the microtasks enqueued on it and nothing else, so a checkpoint of a vm
+  context never runs promise reactions of other contexts in the middle of
+  their code. Promise reactions of such a context run at the next checkpoint
+  of the default queue instead.
+*/
+class MicrotaskQueueWrap : public v8::internal::MicrotaskQueue {
+ public:
+  MicrotaskQueueWrap(IsolateWrap* isolate, v8::MicrotasksPolicy policy);
+  ~MicrotaskQueueWrap() override;
+
+  static MicrotaskQueueWrap* fromV8(v8::MicrotaskQueue* queue) {
+    return static_cast<MicrotaskQueueWrap*>(queue);
+  }
+  static MicrotaskQueueWrap* fromV8(v8::internal::MicrotaskQueue* queue) {
+    return static_cast<MicrotaskQueueWrap*>(queue);
+  }
+
+  // v8::MicrotaskQueue
+  void EnqueueMicrotask(v8::Isolate* isolate,
+                        v8::Local<v8::Function> microtask) override;
+  void EnqueueMicrotask(v8::Isolate* isolate,
+                        v8::MicrotaskCallback callback,
+                        void* data = nullptr) override;
+  void AddMicrotasksCompletedCallback(
+      v8::MicrotasksCompletedCallbackWithData callback,
+      void* data = nullptr) override;
+  void RemoveMicrotasksCompletedCallback(
+      v8::MicrotasksCompletedCallbackWithData callback,
+      void* data = nullptr) override;
+  void PerformCheckpoint(v8::Isolate* isolate) override;
+  bool IsRunningMicrotasks() const override { return isRunning_; }
+  int GetMicrotasksScopeDepth() const override { return scopeDepth_; }
+
+  v8::MicrotasksPolicy policy() const { return policy_; }
+  void setPolicy(v8::MicrotasksPolicy policy) { policy_ = policy; }
+
+  // MicrotasksScope
+  void increaseScopeDepth() { scopeDepth_++; }
+  int decreaseScopeDepth() { return --scopeDepth_; }
+
+  // SuppressMicrotaskExecutionScope
+  void increaseSuppressions() { suppressions_++; }
+  void decreaseSuppressions() { suppressions_--; }
+
+  // Called when the outermost call into JavaScript returns
+  void onCallCompleted();
+
+  // Metrics
+  size_t checkpointCount() const { return checkpointCount_; }
+  size_t executedCount() const { return executedCount_; }
+  size_t pendingCount() const { return microtasks_->size(); }
+
+ private:
+  struct Microtask {
+    Escargot::ValueRef* function;
+    v8::MicrotaskCallback callback;
+    void* data;
+  };
+
+  class CheckpointScope;
+
+  void runMicrotasks();
+  bool runMicrotask(const Microtask& microtask);
+  void callCompletedCallbacks();
+  bool runPendingJobs();
+  bool isDefault() const;
+
+  IsolateWrap* isolate_ = nullptr;
+  v8::MicrotasksPolicy policy_ = v8::MicrotasksPolicy::kAuto;
+  bool isRunning_ = false;
+  int scopeDepth_ = 0;
+  int suppressions_ = 0;
+  size_t checkpointCount_ = 0;
+  size_t executedCount_ = 0;
+
+  // @note this object isn't GC-allocated, so the queue is held persistently.
+  Escargot::PersistentRefHolder<GCDeque<Microtask>> microtasks_;
+
+  typedef std::pair<v8::MicrotasksCompletedCallbackWithData, void*>
+      CompletedCallback;
+  std::vector<CompletedCallback> completedCallbacks_;
+};
+
+}  // namespace EscargotShim
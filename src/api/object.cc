@@ -47,9 +47,11 @@ static ValueRef* accessorPropertyGetter(
       "name: %s",
       VAL(wrapper->m_name)->value()->asString()->toStdUTF8String().c_str())
 
-  v8Getter(v8::Utils::ToLocal<Name>(VAL(wrapper->m_name)), info);
-
   auto lwIsolate = IsolateWrap::fromV8(wrapper->m_isolate);
+  {
+    CallbackStateScope callbackStateScope(lwIsolate, state);
+    v8Getter(v8::Utils::ToLocal<Name>(VAL(wrapper->m_name)), info);
+  }
   lwIsolate->ThrowErrorIfHasException(state);
 
   return VAL(*info.GetReturnValue().Get())->value();
@@ -73,9 +75,12 @@ static bool accessorPropertySetter(
 
   auto v8Setter = wrapper->m_setter;
   LWNODE_CHECK_NOT_NULL(v8Setter);
-  v8Setter(v8::Utils::ToLocal<Name>(VAL(wrapper->m_name)), v8SetValue, info);
-
   auto lwIsolate = IsolateWrap::fromV8(wrapper->m_isolate);
+  {
+    CallbackStateScope callbackStateScope(lwIsolate, state);
+    v8Setter(
+        v8::Utils::ToLocal<Name>(VAL(wrapper->m_name)), v8SetValue, info);
+  }
   lwIsolate->ThrowErrorIfHasException(state);
 
   return true;
@@ -17,6 +17,8 @@
 #if defined(LWNODE_ENABLE_EXPERIMENTAL_SERIALIZATION)
 
 #include <cmath>
+#include <string>
+#include <vector>
 
 #include "base.h"
 #include "context.h"
@@ -169,13 +171,69 @@ enum class ArrayBufferViewTag : uint8_t {
   kDataView = '?',
 };
 
+// Sub-tags of kError
+enum class ErrorTag : uint8_t {
+  // The prototype is EvalError.prototype, etc. Error.prototype if absent.
+  kEvalErrorPrototype = 'E',
+  kRangeErrorPrototype = 'R',
+  kReferenceErrorPrototype = 'F',
+  kSyntaxErrorPrototype = 'S',
+  kTypeErrorPrototype = 'T',
+  kUriErrorPrototype = 'U',
+  // Followed by a string.
+  kMessage = 'm',
+  // Followed by a string.
+  kStack = 's',
+  // The end of this error information.
+  kEnd = '.',
+};
+
+// The version of the format written, as of V8 8.4
+static const uint32_t kLatestVersion = 13;
+
+// Arrays longer than this are written as sparse arrays.
+static const uint32_t kMaxDenseArrayLength = 1 << 20;
+
+// The regular expression flags known to the engine: global, ignoreCase,
+// multiline, sticky, unicode and dotAll, in the bit order V8 writes them.
+static const uint32_t kRegExpFlagsMask = (1 << 6) - 1;
+
+static const char kHexDigits[] = "0123456789abcdef";
+
 ValueSerializer::ValueSerializer(IsolateWrap* lwIsolate,
                                  v8::ValueSerializer::Delegate* delegate)
     : lwIsolate_(lwIsolate), delegate_(delegate) {
   LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Create serializer");
+  idMap_.reset(new GCUnorderedMap<ObjectRef*, uint32_t>());
+  transferMap_.reset(new GCUnorderedMap<ObjectRef*, uint32_t>());
 }
 
-void ValueSerializer::WriteHeader() {}
+ValueSerializer::~ValueSerializer() {
+  for (auto backingStore : transferredBackingStores_) {
+    lwIsolate_->endBackingStoreTransfer(backingStore);
+  }
+  idMap_.release();
+  transferMap_.release();
+}
+
+void ValueSerializer::TransferArrayBuffer(uint32_t transferId,
+                                          ArrayBufferObjectRef* arrayBuffer) {
+  LWNODE_CHECK(transferMap_->find(arrayBuffer) == transferMap_->end());
+  transferMap_->emplace(arrayBuffer, transferId);
+
+  // The embedder detaches the buffer once it is serialized, and hands its
+  // backing store over to the receiver.
+  if (arrayBuffer->backingStore().hasValue()) {
+    auto backingStore = arrayBuffer->backingStore().value();
+    lwIsolate_->beginBackingStoreTransfer(backingStore);
+    transferredBackingStores_.push_back(backingStore);
+  }
+}
+
+void ValueSerializer::WriteHeader() {
+  WriteTag(SerializationTag::kVersion);
+  WriteVarint<uint32_t>(kLatestVersion);
+}
 
 bool ValueSerializer::WriteValue(ValueRef* value) {
   if (value->isUndefined()) {
@@ -191,30 +249,15 @@ bool ValueSerializer::WriteValue(ValueRef* value) {
   } else if (value->isNumber()) {
     return WriteNumber(value->asNumber());
   } else if (value->isBigInt()) {
-    LWNODE_UNIMPLEMENT;
-  } else if (value->isArrayBufferObject()) {
-    auto arrayBuffer = value->asArrayBufferObject();
-    return WriteArrayBuffer(arrayBuffer->byteLength(),
-                            arrayBuffer->rawBuffer());
-  } else if (value->isDataViewObject()) {
-    LWNODE_UNIMPLEMENT;
+    WriteTag(SerializationTag::kBigInt);
+    WriteBigIntContents(value->asBigInt());
   } else if (value->isString()) {
     WriteString(value->asString());
-  } else if (value->isTypedArrayObject()) {
-    return WriteTypedArrayObject(value->asArrayBufferView());
-  } else if (value->isArrayObject()) {
-    return WriteJsArray(value->asArrayObject());
-  } else if (value->isSymbol()) {
-    LWNODE_UNIMPLEMENT;
-  } else if (value->isFunctionObject()) {
-    LWNODE_UNIMPLEMENT;
   } else if (value->isObject()) {
-    if (!WriteObject(value->asObject())) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot write object");
-      return false;
-    }
+    return WriteJSReceiver(value->asObject());
   } else {
-    LWNODE_UNIMPLEMENT;
+    // e.g. a symbol
+    ThrowDataCloneError(ErrorMessageType::kDataCloneError);
     return false;
   }
   return ThrowIfOutOfMemory();
@@ -238,6 +281,18 @@ bool ValueSerializer::WriteNumber(double value) {
   return ThrowIfOutOfMemory();
 }
 
+void ValueSerializer::WriteRawUint32(uint32_t value) {
+  WriteVarint<uint32_t>(value);
+}
+
+void ValueSerializer::WriteRawUint64(uint64_t value) {
+  WriteVarint<uint64_t>(value);
+}
+
+void ValueSerializer::WriteRawDouble(double value) {
+  WriteRawBytes(&value, sizeof(value));
+}
+
 bool ValueSerializer::WriteBoolean(bool value) {
   if (value) {
     WriteTag(SerializationTag::kTrue);
@@ -320,11 +375,107 @@ void ValueSerializer::WriteString(StringRef* string) {
   }
 }
 
+// A BigInt is written as V8 does: the sign and the byte length of its digits
+// in a bitfield, followed by the 64-bit digits from the least significant.
+void ValueSerializer::WriteBigIntContents(BigIntRef* bigInt) {
+  // The digits aren't exposed by the engine, so they are taken from the
+  // hexadecimal representation.
+  std::string hex = bigInt->toString(16)->toStdUTF8String();
+  bool sign = !hex.empty() && hex[0] == '-';
+  size_t begin = sign ? 1 : 0;
+  size_t nibbleCount = hex.size() - begin;
+  if (nibbleCount == 1 && hex[begin] == '0') {
+    nibbleCount = 0;
+  }
+
+  std::vector<uint64_t> digits((nibbleCount + 15) / 16, 0);
+  for (size_t i = 0; i < nibbleCount; i++) {
+    char c = hex[hex.size() - 1 - i];
+    uint64_t nibble = (c <= '9') ? (c - '0') : (tolower(c) - 'a' + 10);
+    digits[i / 16] |= nibble << ((i % 16) * 4);
+  }
+
+  uint32_t byteLength = digits.size() * sizeof(uint64_t);
+  WriteVarint<uint32_t>((byteLength << 1) | (sign ? 1 : 0));
+  WriteRawBytes(digits.data(), byteLength);
+}
+
+bool ValueSerializer::WriteJSReceiver(ObjectRef* object) {
+  bool isArrayBufferView = object->isArrayBufferView();
+
+  // An array buffer view is preceded by its buffer, which is assigned an ID
+  // before the view.
+  if (isArrayBufferView && !treatArrayBufferViewsAsHostObjects_ &&
+      idMap_->find(object) == idMap_->end()) {
+    auto buffer = object->asArrayBufferView()->buffer();
+    if (!buffer || !WriteJSReceiver(buffer)) {
+      return false;
+    }
+  }
+
+  // An object written already is referred to by its ID.
+  auto it = idMap_->find(object);
+  if (it != idMap_->end()) {
+    WriteTag(SerializationTag::kObjectReference);
+    WriteVarint<uint32_t>(it->second);
+    return ThrowIfOutOfMemory();
+  }
+  idMap_->emplace(object, nextId_++);
+
+  if (object->isArrayObject()) {
+    return WriteJsArray(object->asArrayObject());
+  } else if (object->isArrayBufferObject()) {
+    auto arrayBuffer = object->asArrayBufferObject();
+    auto transfer = transferMap_->find(arrayBuffer);
+    if (transfer != transferMap_->end()) {
+      // The contents aren't copied. The embedder hands over the backing
+      // store, and detaches this buffer after serialization.
+      WriteTag(SerializationTag::kArrayBufferTransfer);
+      WriteVarint<uint32_t>(transfer->second);
+      return ThrowIfOutOfMemory();
+    }
+    return WriteArrayBuffer(arrayBuffer->byteLength(),
+                            arrayBuffer->rawBuffer());
+  } else if (isArrayBufferView) {
+    if (treatArrayBufferViewsAsHostObjects_) {
+      return WriteHostObject(object);
+    }
+    return WriteArrayBufferView(object->asArrayBufferView());
+  } else if (object->isDateObject()) {
+    return WriteJsDate(object->asDateObject());
+  } else if (object->isBooleanObject() || object->isNumberObject() ||
+             object->isStringObject() || object->isBigIntObject()) {
+    return WriteJsPrimitiveWrapper(object);
+  } else if (object->isRegExpObject()) {
+    return WriteJsRegExp(object->asRegExpObject());
+  } else if (object->isMapObject()) {
+    return WriteJsMap(object->asMapObject());
+  } else if (object->isSetObject()) {
+    return WriteJsSet(object->asSetObject());
+  } else if (object->isErrorObject()) {
+    return WriteJsError(object->asErrorObject());
+  } else if (object->isSharedArrayBufferObject()) {
+    return WriteSharedArrayBuffer(object->asSharedArrayBufferObject());
+  } else if (object->isCallable() || object->isProxyObject() ||
+             object->isSymbolObject() || object->isPromiseObject() ||
+             object->isWeakMapObject() || object->isWeakSetObject()) {
+    ThrowDataCloneError(ErrorMessageType::kDataCloneError);
+    return false;
+  } else if (ObjectRefHelper::getInternalFieldCount(object) > 0) {
+    return WriteHostObject(object);
+  }
+
+  if (!WriteObject(object)) {
+    LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot write object");
+    return false;
+  }
+  return true;
+}
+
 bool ValueSerializer::WriteHostObject(ObjectRef* object) {
   WriteTag(SerializationTag::kHostObject);
   if (!delegate_) {
-    // @note deps/v8/src/objects/value-serializer.cc(1006) throws an Error
-    LWNODE_CHECK(false);
+    ThrowDataCloneError(ErrorMessageType::kDataCloneError);
     return false;
   }
 
@@ -332,69 +483,355 @@ bool ValueSerializer::WriteHostObject(ObjectRef* object) {
   Maybe<bool> result =
       delegate_->WriteHostObject(v8_isolate, Utils::ToLocal<Object>(object));
 
-  LWNODE_CHECK(!result.IsNothing());
-  LWNODE_CHECK(result.ToChecked());
+  // The delegate has thrown an exception unless the result is true.
+  if (result.IsNothing() || !result.FromJust()) {
+    return false;
+  }
   return ThrowIfOutOfMemory();
 }
 
-bool ValueSerializer::WriteObject(ObjectRef* object) {
-  if (ObjectRefHelper::getInternalFieldCount(object) > 0) {
-    return WriteHostObject(object);
+static bool isArrayIndex(ValueRef* key) {
+  if (key->isUInt32()) {
+    return key->asUInt32() != UINT32_MAX;
+  }
+  if (!key->isString()) {
+    return false;
   }
 
-  auto esContext = lwIsolate_->GetCurrentContext()->get();
-  uint32_t propertiesWritten = 0;
-  WriteTag(SerializationTag::kBeginJSObject);
-  Escargot::ValueVectorRef* keys = nullptr;
-  EvalResult r = Evaluator::execute(
-      esContext,
+  // A canonical numeric string below 2^32 - 1
+  auto bufferData = key->asString()->stringBufferAccessData();
+  if (bufferData.length == 0 || bufferData.length > 10 ||
+      (bufferData.length > 1 && bufferData.charAt(0) == '0')) {
+    return false;
+  }
+  uint64_t index = 0;
+  for (size_t i = 0; i < bufferData.length; i++) {
+    char16_t c = bufferData.charAt(i);
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    index = index * 10 + (c - '0');
+  }
+  return index < UINT32_MAX;
+}
+
+// Collect the enumerable own properties with string keys in a single engine
+// entry, as key and value pairs. Array indices are left out if |skipIndices|.
+static EvalResult getEnumerableOwnProperties(ContextRef* context,
+                                             ObjectRef* object,
+                                             bool skipIndices,
+                                             ValueVectorRef** properties) {
+  return Evaluator::execute(
+      context,
       [](ExecutionStateRef* state,
          ObjectRef* object,
-         Escargot::ValueVectorRef** keys) -> ValueRef* {
-        *keys = object->ownPropertyKeys(state);
+         bool skipIndices,
+         ValueVectorRef** properties) -> ValueRef* {
+        auto keys = ValueVectorRef::create();
+        object->enumerateObjectOwnProperties(
+            state,
+            [keys, skipIndices](ExecutionStateRef* state,
+                                ValueRef* propertyName,
+                                bool isWritable,
+                                bool isEnumerable,
+                                bool isConfigurable) -> bool {
+              if (isEnumerable && !propertyName->isSymbol() &&
+                  !(skipIndices && isArrayIndex(propertyName))) {
+                keys->pushBack(propertyName);
+              }
+              return true;
+            });
+
+        *properties = ValueVectorRef::create();
+        for (size_t i = 0; i < keys->size(); i++) {
+          (*properties)->pushBack(keys->at(i));
+          (*properties)->pushBack(object->get(state, keys->at(i)));
+        }
         return ValueRef::createUndefined();
       },
       object,
-      &keys);
-  LWNODE_CHECK(r.isSuccessful());
+      skipIndices,
+      properties);
+}
 
-  for (size_t i = 0; i < keys->size(); i++) {
-    auto propValueResult =
-        ObjectRefHelper::getProperty(esContext, object, keys->at(i));
-    LWNODE_CHECK(propValueResult.isSuccessful());
-    bool success =
-        WriteValue(keys->at(i)) && WriteValue(propValueResult.result);
-    if (!success) {
+bool ValueSerializer::WriteObjectProperties(ObjectRef* object,
+                                            uint32_t& propertiesWritten,
+                                            bool skipIndices) {
+  auto esContext = lwIsolate_->GetCurrentContext()->get();
+  ValueVectorRef* properties = nullptr;
+  auto r =
+      getEnumerableOwnProperties(esContext, object, skipIndices, &properties);
+  API_HANDLE_EXCEPTION(r, lwIsolate_, false);
+
+  propertiesWritten = 0;
+  for (size_t i = 0; i + 1 < properties->size(); i += 2) {
+    if (!WriteValue(properties->at(i)) || !WriteValue(properties->at(i + 1))) {
       return false;
     }
     propertiesWritten++;
   }
+  return true;
+}
 
+bool ValueSerializer::WriteObject(ObjectRef* object) {
+  uint32_t propertiesWritten = 0;
+  WriteTag(SerializationTag::kBeginJSObject);
+  if (!WriteObjectProperties(object, propertiesWritten)) {
+    return false;
+  }
   WriteTag(SerializationTag::kEndJSObject);
   WriteVarint<uint32_t>(propertiesWritten);
 
   return ThrowIfOutOfMemory();
 }
 
+bool ValueSerializer::WriteSparseJsArray(ArrayObjectRef* array,
+                                         uint32_t length) {
+  uint32_t propertiesWritten = 0;
+  WriteTag(SerializationTag::kBeginSparseJSArray);
+  WriteVarint<uint32_t>(length);
+  if (!WriteObjectProperties(array, propertiesWritten)) {
+    return false;
+  }
+  WriteTag(SerializationTag::kEndSparseJSArray);
+  WriteVarint<uint32_t>(propertiesWritten);
+  WriteVarint<uint32_t>(length);
+  return ThrowIfOutOfMemory();
+}
+
 bool ValueSerializer::WriteJsArray(ArrayObjectRef* array) {
   auto esContext = lwIsolate_->GetCurrentContext()->get();
 
   uint32_t length = ArrayObjectRefHelper::length(esContext, array);
   LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "WriteJsArray start: %u", length);
 
+  if (length > kMaxDenseArrayLength) {
+    return WriteSparseJsArray(array, length);
+  }
+
+  // All the elements are read at once rather than entering the engine for
+  // each of them.
+  GCVector<ValueRef*> elements;
+  auto r =
+      ArrayObjectRefHelper::getElements(esContext, array, length, &elements);
+  API_HANDLE_EXCEPTION(r, lwIsolate_, false);
+
+  // A mostly holey array is smaller written as its present elements only.
+  uint32_t present = 0;
+  for (auto element : elements) {
+    if (element != nullptr) {
+      present++;
+    }
+  }
+  if (present < length / 2) {
+    return WriteSparseJsArray(array, length);
+  }
+
   WriteTag(SerializationTag::kBeginDenseJSArray);
   WriteVarint<uint32_t>(length);
 
   for (uint32_t i = 0; i < length; i++) {
-    auto esValue = ArrayObjectRefHelper::get(esContext, array, i);
-    if (!WriteValue(esValue)) {
+    if (elements[i] == nullptr) {
+      WriteTag(SerializationTag::kTheHole);
+    } else if (!WriteValue(elements[i])) {
       return false;
     }
   }
 
+  // The other properties follow the elements, as V8 writes them.
+  uint32_t propertiesWritten = 0;
+  if (!WriteObjectProperties(array, propertiesWritten, true)) {
+    return false;
+  }
   WriteTag(SerializationTag::kEndDenseJSArray);
+  WriteVarint<uint32_t>(propertiesWritten);
+  WriteVarint<uint32_t>(length);
   LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "WriteJsArray end");
-  return true;
+  return ThrowIfOutOfMemory();
+}
+
+bool ValueSerializer::WriteJsDate(DateObjectRef* date) {
+  WriteTag(SerializationTag::kDate);
+  double value = date->primitiveValue();
+  WriteRawBytes(&value, sizeof(value));
+  return ThrowIfOutOfMemory();
+}
+
+bool ValueSerializer::WriteJsPrimitiveWrapper(ObjectRef* object) {
+  if (object->isBooleanObject()) {
+    WriteTag(object->asBooleanObject()->primitiveValue()
+                 ? SerializationTag::kTrueObject
+                 : SerializationTag::kFalseObject);
+  } else if (object->isNumberObject()) {
+    WriteTag(SerializationTag::kNumberObject);
+    double value = object->asNumberObject()->primitiveValue();
+    WriteRawBytes(&value, sizeof(value));
+  } else if (object->isBigIntObject()) {
+    WriteTag(SerializationTag::kBigIntObject);
+    WriteBigIntContents(object->asBigIntObject()->primitiveValue());
+  } else if (object->isStringObject()) {
+    WriteTag(SerializationTag::kStringObject);
+    WriteString(object->asStringObject()->primitiveValue());
+  } else {
+    ThrowDataCloneError(ErrorMessageType::kDataCloneError);
+    return false;
+  }
+  return ThrowIfOutOfMemory();
+}
+
+bool ValueSerializer::WriteJsRegExp(RegExpObjectRef* regExp) {
+  WriteTag(SerializationTag::kRegExp);
+  WriteString(regExp->source());
+  WriteVarint<uint32_t>(regExp->option());
+  return ThrowIfOutOfMemory();
+}
+
+// Collect the entries of a map as key and value pairs, or the values of a set,
+// in a single engine entry.
+static EvalResult getCollectionEntries(ContextRef* context,
+                                       ObjectRef* collection,
+                                       ValueVectorRef** entries) {
+  return Evaluator::execute(
+      context,
+      [](ExecutionStateRef* state,
+         ObjectRef* collection,
+         ValueVectorRef** entries) -> ValueRef* {
+        auto done = StringRef::createFromASCII("done");
+        auto value = StringRef::createFromASCII("value");
+        bool isMap = collection->isMapObject();
+        auto itr = isMap ? collection->asMapObject()->entries(state)
+                         : collection->asSetObject()->values(state);
+
+        *entries = ValueVectorRef::create();
+        for (auto entry = itr->next(state);
+             entry->asObject()->get(state, done)->isFalse();
+             entry = itr->next(state)) {
+          auto entryValue = entry->asObject()->get(state, value);
+          if (isMap) {
+            auto keyValueArray = entryValue->asObject();
+            (*entries)->pushBack(
+                keyValueArray->getIndexedProperty(state, ValueRef::create(0)));
+            (*entries)->pushBack(
+                keyValueArray->getIndexedProperty(state, ValueRef::create(1)));
+          } else {
+            (*entries)->pushBack(entryValue);
+          }
+        }
+        return ValueRef::createUndefined();
+      },
+      collection,
+      entries);
+}
+
+bool ValueSerializer::WriteJsMap(MapObjectRef* map) {
+  auto esContext = lwIsolate_->GetCurrentContext()->get();
+
+  // The entries are copied first since writing them may modify the map.
+  ValueVectorRef* entries = nullptr;
+  auto r = getCollectionEntries(esContext, map, &entries);
+  API_HANDLE_EXCEPTION(r, lwIsolate_, false);
+
+  WriteTag(SerializationTag::kBeginJSMap);
+  for (size_t i = 0; i < entries->size(); i++) {
+    if (!WriteValue(entries->at(i))) {
+      return false;
+    }
+  }
+  WriteTag(SerializationTag::kEndJSMap);
+  WriteVarint<uint32_t>(entries->size());
+  return ThrowIfOutOfMemory();
+}
+
+bool ValueSerializer::WriteJsSet(SetObjectRef* set) {
+  auto esContext = lwIsolate_->GetCurrentContext()->get();
+
+  ValueVectorRef* entries = nullptr;
+  auto r = getCollectionEntries(esContext, set, &entries);
+  API_HANDLE_EXCEPTION(r, lwIsolate_, false);
+
+  WriteTag(SerializationTag::kBeginJSSet);
+  for (size_t i = 0; i < entries->size(); i++) {
+    if (!WriteValue(entries->at(i))) {
+      return false;
+    }
+  }
+  WriteTag(SerializationTag::kEndJSSet);
+  WriteVarint<uint32_t>(entries->size());
+  return ThrowIfOutOfMemory();
+}
+
+bool ValueSerializer::WriteJsError(ErrorObjectRef* error) {
+  auto esContext = lwIsolate_->GetCurrentContext()->get();
+
+  ObjectRef* prototype = nullptr;
+  StringRef* message = nullptr;
+  ValueRef* stack = nullptr;
+  auto r = Evaluator::execute(
+      esContext,
+      [](ExecutionStateRef* state,
+         ErrorObjectRef* error,
+         ObjectRef** prototype,
+         StringRef** message,
+         ValueRef** stack) -> ValueRef* {
+        auto maybePrototype = error->getPrototypeObject(state);
+        if (maybePrototype.hasValue()) {
+          *prototype = maybePrototype.value();
+        }
+
+        // Only an own data property is taken as the message, as V8 does.
+        auto descriptor = error->getOwnPropertyDescriptor(
+            state, StringRef::createFromASCII("message"));
+        if (descriptor->isObject()) {
+          auto valueKey = StringRef::createFromASCII("value");
+          auto desc = descriptor->asObject();
+          if (desc->hasOwnProperty(state, valueKey)) {
+            *message = desc->get(state, valueKey)->toString(state);
+          }
+        }
+
+        *stack = error->get(state, StringRef::createFromASCII("stack"));
+        return ValueRef::createUndefined();
+      },
+      error,
+      &prototype,
+      &message,
+      &stack);
+  API_HANDLE_EXCEPTION(r, lwIsolate_, false);
+
+  WriteTag(SerializationTag::kError);
+
+  // The tag follows the prototype rather than the name, which can be changed
+  // without changing the kind of the error. Error.prototype is the default,
+  // which has no tag.
+  auto globalObject = esContext->globalObject();
+  const std::pair<ObjectRef*, ErrorTag> kPrototypeTags[] = {
+      {globalObject->evalErrorPrototype(), ErrorTag::kEvalErrorPrototype},
+      {globalObject->rangeErrorPrototype(), ErrorTag::kRangeErrorPrototype},
+      {globalObject->referenceErrorPrototype(),
+       ErrorTag::kReferenceErrorPrototype},
+      {globalObject->syntaxErrorPrototype(), ErrorTag::kSyntaxErrorPrototype},
+      {globalObject->typeErrorPrototype(), ErrorTag::kTypeErrorPrototype},
+      {globalObject->uriErrorPrototype(), ErrorTag::kUriErrorPrototype},
+  };
+  for (const auto& prototypeTag : kPrototypeTags) {
+    if (prototype == prototypeTag.first) {
+      WriteVarint(static_cast<uint8_t>(prototypeTag.second));
+      break;
+    }
+  }
+
+  if (message) {
+    WriteVarint(static_cast<uint8_t>(ErrorTag::kMessage));
+    WriteString(message);
+  }
+
+  if (stack->isString()) {
+    WriteVarint(static_cast<uint8_t>(ErrorTag::kStack));
+    WriteString(stack->asString());
+  }
+
+  WriteVarint(static_cast<uint8_t>(ErrorTag::kEnd));
+  return ThrowIfOutOfMemory();
 }
 
 bool ValueSerializer::WriteArrayBuffer(size_t length, uint8_t* bytes) {
@@ -421,20 +858,34 @@ bool ValueSerializer::WriteArrayBufferView(
 #undef TYPED_ARRAY_CASE
   else {
     LWNODE_DLOG_ERROR("Serializer: Invalid buffer type");
+    ThrowDataCloneError(ErrorMessageType::kDataCloneError);
     return false;
   }
 
   WriteVarint(static_cast<uint8_t>(typeTag));
   WriteVarint(static_cast<uint32_t>(arrayBufferView->byteOffset()));
-  WriteVarint(static_cast<uint32_t>(arrayBufferView->arrayLength()));
+  WriteVarint(static_cast<uint32_t>(arrayBufferView->byteLength()));
   return ThrowIfOutOfMemory();
 }
 
-bool ValueSerializer::WriteTypedArrayObject(
-    Escargot::ArrayBufferViewRef* bufferView) {
-  auto result =
-      WriteArrayBuffer(bufferView->byteLength(), bufferView->rawBuffer());
-  return result && WriteArrayBufferView(bufferView);
+bool ValueSerializer::WriteSharedArrayBuffer(
+    SharedArrayBufferObjectRef* sharedArrayBuffer) {
+  // The memory isn't copied. The delegate hands its backing store over to the
+  // receiver, which looks it up by the ID.
+  if (!delegate_) {
+    ThrowDataCloneError(ErrorMessageType::kDataCloneError);
+    return false;
+  }
+
+  Maybe<uint32_t> index = delegate_->GetSharedArrayBufferId(
+      lwIsolate_->toV8(), Utils::ToLocal<SharedArrayBuffer>(sharedArrayBuffer));
+  if (index.IsNothing()) {
+    return false;
+  }
+
+  WriteTag(SerializationTag::kSharedArrayBuffer);
+  WriteVarint<uint32_t>(index.FromJust());
+  return ThrowIfOutOfMemory();
 }
 
 // base on v8
@@ -465,22 +916,20 @@ bool ValueSerializer::ExpandBuffer(size_t required_capacity) {
 bool ValueSerializer::ThrowIfOutOfMemory() {
   if (out_of_memory_) {
     LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "out of memory");
-    ThrowDataCloneError();
+    ThrowDataCloneError(ErrorMessageType::kDataCloneErrorOutOfMemory);
     return false;
   }
   return true;
 }
 
-void ValueSerializer::ThrowDataCloneError() {
+void ValueSerializer::ThrowDataCloneError(ErrorMessageType type) {
   if (delegate_) {
     delegate_->ThrowDataCloneError(Utils::NewLocal<String>(
-        lwIsolate_->toV8(),
-        ErrorMessage::createErrorStringRef(
-            ErrorMessageType::kDataCloneErrorOutOfMemory)));
+        lwIsolate_->toV8(), ErrorMessage::createErrorStringRef(type)));
   } else {
     auto esContext = lwIsolate_->GetCurrentContext()->get();
-    lwIsolate_->ScheduleThrow(ExceptionHelper::createErrorObject(
-        esContext, ErrorMessageType::kDataCloneErrorOutOfMemory));
+    lwIsolate_->ScheduleThrow(
+        ExceptionHelper::createErrorObject(esContext, type));
   }
 
   if (lwIsolate_->sholdReportPendingMessage(false)) {
@@ -518,93 +967,239 @@ ValueDeserializer::ValueDeserializer(IsolateWrap* lwIsolate,
                                      const size_t size)
     : lwIsolate_(lwIsolate), delegate_(delegate), buffer_(data, size) {
   LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Create deserializer (%zu)", size);
+  idMap_.reset(new GCUnorderedMap<uint32_t, ObjectRef*>());
+  transferMap_.reset(new GCUnorderedMap<uint32_t, ArrayBufferObjectRef*>());
+}
+
+ValueDeserializer::~ValueDeserializer() {
+  idMap_.release();
+  transferMap_.release();
+}
+
+void ValueDeserializer::TransferArrayBuffer(
+    uint32_t transferId, ArrayBufferObjectRef* arrayBuffer) {
+  LWNODE_CHECK(transferMap_->find(transferId) == transferMap_->end());
+  transferMap_->emplace(transferId, arrayBuffer);
+}
+
+bool ValueDeserializer::ReadHeader() {
+  if (CheckTag(SerializationTag::kVersion)) {
+    SerializationTag tag;
+    ReadTag(tag);
+    if (!ReadVarint<uint32_t>(version_) || version_ > kLatestVersion) {
+      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Invalid version: %u", version_);
+      return false;
+    }
+  }
+  return true;
 }
 
 OptionalRef<ValueRef> ValueDeserializer::ReadValue() {
+  OptionalRef<ValueRef> result = ReadValueInternal();
+
+  // An array buffer view follows its buffer, even if the buffer is a
+  // reference.
+  if (result.hasValue() &&
+      (result->isArrayBufferObject() || result->isSharedArrayBufferObject()) &&
+      CheckTag(SerializationTag::kArrayBufferView)) {
+    SerializationTag tag;
+    ReadTag(tag);
+    ArrayBufferRef* arrayBuffer = nullptr;
+    if (result->isArrayBufferObject()) {
+      arrayBuffer = result->asArrayBufferObject();
+    } else {
+      arrayBuffer = result->asSharedArrayBufferObject();
+    }
+    ArrayBufferViewRef* arrayBufferView = nullptr;
+    if (!ReadArrayBufferView(arrayBufferView, arrayBuffer)) {
+      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read array buffer view");
+      return OptionalRef<ValueRef>();
+    }
+    return OptionalRef<ValueRef>(arrayBufferView);
+  }
+
+  return result;
+}
+
+OptionalRef<ValueRef> ValueDeserializer::ReadValueInternal() {
   SerializationTag tag;
   if (!ReadTag(tag)) {
     LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read tag");
     return OptionalRef<ValueRef>();
   }
 
-  if (tag == SerializationTag::kNull) {
-    return OptionalRef<ValueRef>(ValueRef::createNull());
-  } else if (tag == SerializationTag::kUndefined) {
-    return OptionalRef<ValueRef>(ValueRef::createUndefined());
-  } else if (tag == SerializationTag::kTrue) {
-    return OptionalRef<ValueRef>(ValueRef::create(true));
-  } else if (tag == SerializationTag::kFalse) {
-    return OptionalRef<ValueRef>(ValueRef::create(false));
-  } else if (tag == SerializationTag::kDouble) {
-    double number = .0;
-    if (!ReadDouble(number)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read double value");
-      return OptionalRef<ValueRef>();
+  switch (tag) {
+    case SerializationTag::kVerifyObjectCount: {
+      // The count is ignored.
+      uint32_t count = 0;
+      if (!ReadVarint<uint32_t>(count)) {
+        return OptionalRef<ValueRef>();
+      }
+      return ReadValueInternal();
     }
-    return OptionalRef<ValueRef>(ValueRef::create(number));
-  } else if (tag == SerializationTag::kOneByteString) {
-    StringRef* string = nullptr;
-    if (!ReadOneByteString(string)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read one byte string value");
-      return OptionalRef<ValueRef>();
+    case SerializationTag::kUndefined:
+      return OptionalRef<ValueRef>(ValueRef::createUndefined());
+    case SerializationTag::kNull:
+      return OptionalRef<ValueRef>(ValueRef::createNull());
+    case SerializationTag::kTrue:
+      return OptionalRef<ValueRef>(ValueRef::create(true));
+    case SerializationTag::kFalse:
+      return OptionalRef<ValueRef>(ValueRef::create(false));
+    case SerializationTag::kInt32: {
+      int32_t value = 0;
+      if (!ReadZigZag<int32_t>(value)) {
+        LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read int32 value");
+        return OptionalRef<ValueRef>();
+      }
+      return OptionalRef<ValueRef>(ValueRef::create(value));
     }
-    return OptionalRef<ValueRef>(string);
-  } else if (tag == SerializationTag::kTwoByteString) {
-    StringRef* string = nullptr;
-    if (!ReadTwoByteString(string)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read two byte string value");
-      return OptionalRef<ValueRef>();
+    case SerializationTag::kUint32: {
+      uint32_t value = 0;
+      if (!ReadVarint<uint32_t>(value)) {
+        LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read uint32 value");
+        return OptionalRef<ValueRef>();
+      }
+      return OptionalRef<ValueRef>(ValueRef::create(value));
     }
-    return OptionalRef<ValueRef>(string);
-  } else if (tag == SerializationTag::kUint32) {
-    uint32_t value = 0;
-    if (!ReadVarint<uint32_t>(value)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read uint32 value");
-      return OptionalRef<ValueRef>();
+    case SerializationTag::kDouble: {
+      double number = .0;
+      if (!ReadDouble(number)) {
+        LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read double value");
+        return OptionalRef<ValueRef>();
+      }
+      return OptionalRef<ValueRef>(ValueRef::create(number));
     }
-    return OptionalRef<ValueRef>(ValueRef::create(value));
-  } else if (tag == SerializationTag::kInt32) {
-    int32_t value = 0;
-    if (!ReadZigZag<int32_t>(value)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read int32 value");
-      return OptionalRef<ValueRef>();
+    case SerializationTag::kBigInt: {
+      BigIntRef* bigInt = nullptr;
+      if (!ReadBigIntContents(bigInt)) {
+        LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read bigint value");
+        return OptionalRef<ValueRef>();
+      }
+      return OptionalRef<ValueRef>(bigInt);
     }
-    return OptionalRef<ValueRef>(ValueRef::create(value));
-  } else if (tag == SerializationTag::kBeginJSObject) {
-    auto esContext = lwIsolate_->GetCurrentContext()->get();
-    auto object = ObjectRefHelper::create(esContext);
-    if (!ReadObject(object)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read object value");
-      return OptionalRef<ValueRef>();
+    case SerializationTag::kUtf8String: {
+      uint32_t length = 0;
+      const uint8_t* data = nullptr;
+      if (!ReadVarint<uint32_t>(length) || !ReadRawBytes(length, data)) {
+        LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read utf8 string value");
+        return OptionalRef<ValueRef>();
+      }
+      return OptionalRef<ValueRef>(StringRef::createFromUTF8(
+          reinterpret_cast<const char*>(data), static_cast<size_t>(length)));
     }
-    return OptionalRef<ValueRef>(object);
-  } else if (tag == SerializationTag::kHostObject) {
-    ObjectRef* esObject = nullptr;
-    if (!ReadHostObject(esObject)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read host object value");
-      return OptionalRef<ValueRef>();
+    case SerializationTag::kOneByteString: {
+      StringRef* string = nullptr;
+      if (!ReadOneByteString(string)) {
+        LWNODE_CALL_TRACE_ID_LOG(SERIALIZER,
+                                 "Cannot read one byte string value");
+        return OptionalRef<ValueRef>();
+      }
+      return OptionalRef<ValueRef>(string);
     }
-    return OptionalRef<ValueRef>(esObject);
-  } else if (tag == SerializationTag::kBeginDenseJSArray) {
-    ArrayObjectRef* array = nullptr;
-    if (!ReadJsArray(array)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read array value");
-      return OptionalRef<ValueRef>();
+    case SerializationTag::kTwoByteString: {
+      StringRef* string = nullptr;
+      if (!ReadTwoByteString(string)) {
+        LWNODE_CALL_TRACE_ID_LOG(SERIALIZER,
+                                 "Cannot read two byte string value");
+        return OptionalRef<ValueRef>();
+      }
+      return OptionalRef<ValueRef>(string);
     }
-    return OptionalRef<ValueRef>(array);
-  } else if (tag == SerializationTag::kArrayBuffer) {
-    ValueRef* arrayBuffer = nullptr;
-    if (!ReadJsArrayBuffer(arrayBuffer)) {
-      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read array buffer value");
-      return OptionalRef<ValueRef>();
+    default:
+      break;
+  }
+
+  // Objects
+  bool success = false;
+  ObjectRef* object = nullptr;
+
+  switch (tag) {
+    case SerializationTag::kObjectReference:
+      success = ReadObjectReference(object);
+      break;
+    case SerializationTag::kBeginJSObject:
+      success = ReadJsObject(object);
+      break;
+    case SerializationTag::kBeginDenseJSArray: {
+      ArrayObjectRef* array = nullptr;
+      success = ReadDenseJsArray(array);
+      object = array;
+      break;
     }
-    return OptionalRef<ValueRef>(arrayBuffer);
-  } else {
-    LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Fail: %c", (char)tag);
-    LWNODE_UNIMPLEMENT;
+    case SerializationTag::kBeginSparseJSArray: {
+      ArrayObjectRef* array = nullptr;
+      success = ReadSparseJsArray(array);
+      object = array;
+      break;
+    }
+    case SerializationTag::kDate:
+      success = ReadJsDate(object);
+      break;
+    case SerializationTag::kTrueObject:
+    case SerializationTag::kFalseObject:
+    case SerializationTag::kNumberObject:
+    case SerializationTag::kBigIntObject:
+    case SerializationTag::kStringObject:
+      success = ReadJsPrimitiveWrapper(tag, object);
+      break;
+    case SerializationTag::kRegExp:
+      success = ReadJsRegExp(object);
+      break;
+    case SerializationTag::kBeginJSMap:
+      success = ReadJsMap(object);
+      break;
+    case SerializationTag::kBeginJSSet:
+      success = ReadJsSet(object);
+      break;
+    case SerializationTag::kError:
+      success = ReadJsError(object);
+      break;
+    case SerializationTag::kArrayBuffer: {
+      uint32_t id = nextId_++;
+      ArrayBufferObjectRef* arrayBuffer = nullptr;
+      success = ReadArrayBuffer(arrayBuffer);
+      if (success) {
+        AddObjectWithId(id, arrayBuffer);
+      }
+      object = arrayBuffer;
+      break;
+    }
+    case SerializationTag::kArrayBufferTransfer: {
+      uint32_t id = nextId_++;
+      ArrayBufferObjectRef* arrayBuffer = nullptr;
+      success = ReadTransferredArrayBuffer(arrayBuffer);
+      if (success) {
+        AddObjectWithId(id, arrayBuffer);
+      }
+      object = arrayBuffer;
+      break;
+    }
+    case SerializationTag::kSharedArrayBuffer: {
+      uint32_t id = nextId_++;
+      success = ReadSharedArrayBuffer(object);
+      if (success) {
+        AddObjectWithId(id, object);
+      }
+      break;
+    }
+    case SerializationTag::kHostObject: {
+      uint32_t id = nextId_++;
+      success = ReadHostObject(object);
+      if (success) {
+        AddObjectWithId(id, object);
+      }
+      break;
+    }
+    default:
+      LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Unsupported tag: %c", (char)tag);
+      break;
   }
 
-  return OptionalRef<ValueRef>();
+  if (!success) {
+    LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read object: %c", (char)tag);
+    return OptionalRef<ValueRef>();
+  }
+  return OptionalRef<ValueRef>(object);
 }
 
 // base on v8
@@ -625,7 +1220,7 @@ bool ValueDeserializer::CheckTag(SerializationTag check) {
   SerializationTag tag;
   size_t curPosition = buffer_.position;
   do {
-    if (buffer_.isOverflow()) {
+    if (curPosition >= buffer_.size) {
       return false;
     }
     tag = static_cast<SerializationTag>(buffer_.data[curPosition]);
@@ -635,16 +1230,16 @@ bool ValueDeserializer::CheckTag(SerializationTag check) {
   return tag == check;
 }
 
-bool ValueDeserializer::ReadUint32(uint32_t*& value) {
-  if (!CheckTag(SerializationTag::kUint32)) {
-    return false;
-  }
+bool ValueDeserializer::ReadRawUint32(uint32_t* value) {
+  return ReadVarint<uint32_t>(*value);
+}
 
-  OptionalRef<ValueRef> valueRef = ReadValue();
-  if (valueRef) {
-    *value = valueRef->asUInt32();
-  }
-  return valueRef;
+bool ValueDeserializer::ReadRawUint64(uint64_t* value) {
+  return ReadVarint<uint64_t>(*value);
+}
+
+bool ValueDeserializer::ReadRawDouble(double* value) {
+  return ReadDouble(*value);
 }
 
 template <typename T>
@@ -692,15 +1287,12 @@ bool ValueDeserializer::ReadZigZag(T& value) {
 }
 
 bool ValueDeserializer::ReadDouble(double& value) {
-  if (buffer_.position > buffer_.size - sizeof(double)) {
-    return false;
-  }
-  value = 0;
-  memcpy(&value, buffer_.currentPositionAddress(), sizeof(double));
-  buffer_.position += sizeof(double);
-  if (std::isnan(value)) {
+  // NaN is valid, e.g. for an invalid date.
+  const uint8_t* data = nullptr;
+  if (!ReadRawBytes(sizeof(double), data)) {
     return false;
   }
+  memcpy(&value, data, sizeof(double));
   return true;
 }
 
@@ -710,8 +1302,7 @@ bool ValueDeserializer::ReadOneByteString(StringRef*& string) {
   if (!ReadVarint<uint32_t>(length) || !ReadRawBytes(length, data)) {
     return false;
   }
-  string = StringRef::createFromUTF8(reinterpret_cast<const char*>(data),
-                                     static_cast<size_t>(length));
+  string = StringRef::createFromLatin1(data, static_cast<size_t>(length));
   return true;
 }
 
@@ -727,12 +1318,90 @@ bool ValueDeserializer::ReadTwoByteString(StringRef*& string) {
   return true;
 }
 
-bool ValueDeserializer::ReadObject(ObjectRef* object) {
-  size_t propertiesRead = 0;
+bool ValueDeserializer::ReadString(StringRef*& string) {
+  OptionalRef<ValueRef> value = ReadValue();
+  if (!value.hasValue() || !value->isString()) {
+    return false;
+  }
+  string = value->asString();
+  return true;
+}
+
+bool ValueDeserializer::ReadBigIntContents(BigIntRef*& bigInt) {
+  uint32_t bitfield = 0;
+  const uint8_t* data = nullptr;
+  if (!ReadVarint<uint32_t>(bitfield)) {
+    return false;
+  }
+  size_t byteLength = bitfield >> 1;
+  if (byteLength % sizeof(uint64_t) != 0 || !ReadRawBytes(byteLength, data)) {
+    return false;
+  }
+
+  // The engine creates a BigInt from a string, so the digits are converted
+  // to hexadecimal from the most significant one.
+  std::string hex = (bitfield & 1) ? "-" : "";
+  size_t prefixLength = hex.size();
+  for (size_t i = byteLength / sizeof(uint64_t); i > 0; i--) {
+    uint64_t digit = 0;
+    memcpy(&digit, data + (i - 1) * sizeof(uint64_t), sizeof(uint64_t));
+    for (int shift = 60; shift >= 0; shift -= 4) {
+      size_t nibble = (digit >> shift) & 0xF;
+      if (nibble != 0 || hex.size() > prefixLength) {
+        hex.push_back(kHexDigits[nibble]);
+      }
+    }
+  }
+  if (hex.size() == prefixLength) {
+    hex = "0";
+  }
+
+  bigInt =
+      BigIntRef::create(StringRef::createFromASCII(hex.data(), hex.size()), 16);
+  return bigInt != nullptr;
+}
+
+void ValueDeserializer::AddObjectWithId(uint32_t id, ObjectRef* object) {
+  (*idMap_)[id] = object;
+}
+
+bool ValueDeserializer::ReadObjectReference(ObjectRef*& object) {
+  uint32_t id = 0;
+  if (!ReadVarint<uint32_t>(id)) {
+    return false;
+  }
+  auto it = idMap_->find(id);
+  if (it == idMap_->end()) {
+    LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Invalid object reference: %u", id);
+    return false;
+  }
+  object = it->second;
+  return true;
+}
+
+bool ValueDeserializer::ReadJsObject(ObjectRef*& object) {
+  // The object is registered first so that its properties can refer to it.
+  uint32_t id = nextId_++;
+  object = ObjectRefHelper::create(lwIsolate_->GetCurrentContext()->get());
+  AddObjectWithId(id, object);
+
+  uint32_t propertiesRead = 0;
+  uint32_t propertiesWritten = 0;
+  return ReadObjectProperties(
+             object, SerializationTag::kEndJSObject, propertiesRead) &&
+         ReadVarint<uint32_t>(propertiesWritten) &&
+         propertiesRead == propertiesWritten;
+}
+
+bool ValueDeserializer::ReadObjectProperties(ObjectRef* object,
+                                             SerializationTag endTag,
+                                             uint32_t& propertiesRead) {
+  GCVector<ValueRef*> keys;
+  GCVector<ValueRef*> values;
 
-  while (!CheckTag(SerializationTag::kEndJSObject)) {
+  while (!CheckTag(endTag)) {
     auto key = ReadValue();
-    if (!key.hasValue() || key.get()->isUndefinedOrNull()) {
+    if (!key.hasValue() || !(key->isString() || key->isUInt32())) {
       LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read key of object");
       return false;
     }
@@ -741,27 +1410,33 @@ bool ValueDeserializer::ReadObject(ObjectRef* object) {
       LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Cannot read value of object");
       return false;
     }
-
-    ObjectRefHelper::setProperty(
-        lwIsolate_->GetCurrentContext()->context()->get(),
-        object,
-        key.get(),
-        value.get());
-
-    propertiesRead++;
+    keys.push_back(key.get());
+    values.push_back(value.get());
   }
 
   SerializationTag tag;
-  if (!ReadTag(tag)) {
+  ReadTag(tag);
+
+  // All the properties are defined at once.
+  std::vector<ObjectRef::PresentAttribute> attributes(
+      keys.size(),
+      static_cast<ObjectRef::PresentAttribute>(
+          ObjectRef::PresentAttribute::WritablePresent |
+          ObjectRef::PresentAttribute::EnumerablePresent |
+          ObjectRef::PresentAttribute::ConfigurablePresent));
+  auto r = ObjectRefHelper::defineDataProperties(
+      lwIsolate_->GetCurrentContext()->get(),
+      object,
+      keys.size(),
+      keys.data(),
+      values.data(),
+      attributes.data());
+  if (!r.isSuccessful() || !r.result->asBoolean()) {
     return false;
   }
-  if (tag == SerializationTag::kEndJSObject) {
-    uint32_t propertiesWritten;
-    if (ReadVarint<uint32_t>(propertiesWritten)) {
-      return propertiesRead == propertiesWritten;
-    }
-  }
-  return false;
+
+  propertiesRead = keys.size();
+  return true;
 }
 
 bool ValueDeserializer::ReadHostObject(ObjectRef*& esObject) {
@@ -779,51 +1454,365 @@ bool ValueDeserializer::ReadHostObject(ObjectRef*& esObject) {
   return true;
 }
 
-bool ValueDeserializer::ReadJsArray(ArrayObjectRef*& array) {
+bool ValueDeserializer::ReadDenseJsArray(ArrayObjectRef*& array) {
   uint32_t length = 0;
   if (!ReadVarint<uint32_t>(length)) {
     return false;
   }
 
+  // Each element takes at least a byte.
+  if (length > buffer_.size - buffer_.position) {
+    return false;
+  }
+
   LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "ReadJsArray start: %u", length);
-  auto vector = ValueVectorRef::create();
+  auto esContext = lwIsolate_->GetCurrentContext()->get();
+
+  uint32_t id = nextId_++;
+  array = ArrayObjectRefHelper::create(esContext, length);
+  AddObjectWithId(id, array);
 
+  GCVector<ValueRef*> elements;
+  elements.reserve(length);
   for (uint32_t i = 0; i < length; i++) {
+    if (CheckTag(SerializationTag::kTheHole)) {
+      SerializationTag tag;
+      ReadTag(tag);
+      elements.push_back(nullptr);
+      continue;
+    }
+
     OptionalRef<ValueRef> valueRef = ReadValue();
     if (!valueRef.hasValue()) {
       return false;
     }
-    vector->pushBack(valueRef.get());
+    elements.push_back(valueRef.get());
+  }
+
+  auto r = ArrayObjectRefHelper::setElements(esContext, array, elements);
+  if (!r.isSuccessful()) {
+    return false;
+  }
+
+  uint32_t propertiesRead = 0;
+  uint32_t propertiesWritten = 0;
+  uint32_t lengthWritten = 0;
+  if (!ReadObjectProperties(
+          array, SerializationTag::kEndDenseJSArray, propertiesRead) ||
+      !ReadVarint<uint32_t>(propertiesWritten) ||
+      !ReadVarint<uint32_t>(lengthWritten)) {
+    return false;
   }
 
+  LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "ReadJsArray end");
+  return propertiesRead == propertiesWritten && length == lengthWritten;
+}
+
+bool ValueDeserializer::ReadSparseJsArray(ArrayObjectRef*& array) {
+  uint32_t length = 0;
+  if (!ReadVarint<uint32_t>(length)) {
+    return false;
+  }
+
+  uint32_t id = nextId_++;
+  array = ArrayObjectRefHelper::create(lwIsolate_->GetCurrentContext()->get(),
+                                       length);
+  AddObjectWithId(id, array);
+
+  uint32_t propertiesRead = 0;
+  uint32_t propertiesWritten = 0;
+  uint32_t lengthWritten = 0;
+  if (!ReadObjectProperties(
+          array, SerializationTag::kEndSparseJSArray, propertiesRead) ||
+      !ReadVarint<uint32_t>(propertiesWritten) ||
+      !ReadVarint<uint32_t>(lengthWritten)) {
+    return false;
+  }
+  return propertiesRead == propertiesWritten && length == lengthWritten;
+}
+
+bool ValueDeserializer::ReadJsDate(ObjectRef*& date) {
+  double value = 0;
+  if (!ReadDouble(value)) {
+    return false;
+  }
+
+  uint32_t id = nextId_++;
+  auto r = Evaluator::execute(
+      lwIsolate_->GetCurrentContext()->get(),
+      [](ExecutionStateRef* state, double value) -> ValueRef* {
+        auto date = DateObjectRef::create(state);
+        date->setTimeValue(value);
+        return date;
+      },
+      value);
+  if (!r.isSuccessful()) {
+    return false;
+  }
+
+  date = r.result->asObject();
+  AddObjectWithId(id, date);
+  return true;
+}
+
+bool ValueDeserializer::ReadJsPrimitiveWrapper(SerializationTag tag,
+                                               ObjectRef*& object) {
+  uint32_t id = nextId_++;
+  ValueRef* value = nullptr;
+
+  switch (tag) {
+    case SerializationTag::kTrueObject:
+      value = ValueRef::create(true);
+      break;
+    case SerializationTag::kFalseObject:
+      value = ValueRef::create(false);
+      break;
+    case SerializationTag::kNumberObject: {
+      double number = 0;
+      if (!ReadDouble(number)) {
+        return false;
+      }
+      value = ValueRef::create(number);
+      break;
+    }
+    case SerializationTag::kBigIntObject: {
+      BigIntRef* bigInt = nullptr;
+      if (!ReadBigIntContents(bigInt)) {
+        return false;
+      }
+      value = bigInt;
+      break;
+    }
+    case SerializationTag::kStringObject: {
+      StringRef* string = nullptr;
+      if (!ReadString(string)) {
+        return false;
+      }
+      value = string;
+      break;
+    }
+    default:
+      return false;
+  }
+
+  auto r = Evaluator::execute(
+      lwIsolate_->GetCurrentContext()->get(),
+      [](ExecutionStateRef* state, ValueRef* value) -> ValueRef* {
+        if (value->isBoolean()) {
+          auto object = BooleanObjectRef::create(state);
+          object->setPrimitiveValue(state, value);
+          return object;
+        } else if (value->isNumber()) {
+          auto object = NumberObjectRef::create(state);
+          object->setPrimitiveValue(state, value);
+          return object;
+        } else if (value->isBigInt()) {
+          auto object = BigIntObjectRef::create(state);
+          object->setPrimitiveValue(state, value->asBigInt());
+          return object;
+        }
+        auto object = StringObjectRef::create(state);
+        object->setPrimitiveValue(state, value->asString());
+        return object;
+      },
+      value);
+  if (!r.isSuccessful()) {
+    return false;
+  }
+
+  object = r.result->asObject();
+  AddObjectWithId(id, object);
+  return true;
+}
+
+bool ValueDeserializer::ReadJsRegExp(ObjectRef*& regExp) {
+  uint32_t id = nextId_++;
+  StringRef* pattern = nullptr;
+  uint32_t flags = 0;
+  if (!ReadString(pattern) || !ReadVarint<uint32_t>(flags)) {
+    return false;
+  }
+
+  // Flags the engine does not know about are rejected rather than passed on.
+  if (flags & ~kRegExpFlagsMask) {
+    return false;
+  }
+
+  auto r = Evaluator::execute(
+      lwIsolate_->GetCurrentContext()->get(),
+      [](ExecutionStateRef* state,
+         StringRef* pattern,
+         uint32_t flags) -> ValueRef* {
+        return RegExpObjectRef::create(
+            state, pattern, (RegExpObjectRef::RegExpObjectOption)flags);
+      },
+      pattern,
+      flags);
+  if (!r.isSuccessful()) {
+    return false;
+  }
+
+  regExp = r.result->asObject();
+  AddObjectWithId(id, regExp);
+  return true;
+}
+
+bool ValueDeserializer::ReadJsMap(ObjectRef*& map) {
   auto esContext = lwIsolate_->GetCurrentContext()->get();
-  array = ArrayObjectRefHelper::create(esContext, vector);
+
+  uint32_t id = nextId_++;
+  auto r = Evaluator::execute(esContext,
+                              [](ExecutionStateRef* state) -> ValueRef* {
+                                return MapObjectRef::create(state);
+                              });
+  LWNODE_CHECK(r.isSuccessful());
+  map = r.result->asObject();
+  AddObjectWithId(id, map);
+
+  GCVector<ValueRef*> entries;
+  while (!CheckTag(SerializationTag::kEndJSMap)) {
+    OptionalRef<ValueRef> value = ReadValue();
+    if (!value.hasValue()) {
+      return false;
+    }
+    entries.push_back(value.get());
+  }
 
   SerializationTag tag;
+  uint32_t length = 0;
   ReadTag(tag);
+  if (!ReadVarint<uint32_t>(length) || length != entries.size() ||
+      length % 2 != 0) {
+    return false;
+  }
 
-  LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "ReadJsArray end");
-
-  return (tag == SerializationTag::kEndDenseJSArray);
+  r = Evaluator::execute(
+      esContext,
+      [](ExecutionStateRef* state,
+         MapObjectRef* map,
+         const GCVector<ValueRef*>* entries) -> ValueRef* {
+        for (size_t i = 0; i < entries->size(); i += 2) {
+          map->set(state, (*entries)[i], (*entries)[i + 1]);
+        }
+        return ValueRef::createUndefined();
+      },
+      map->asMapObject(),
+      &entries);
+  return r.isSuccessful();
 }
 
-bool ValueDeserializer::ReadJsArrayBuffer(ValueRef*& value) {
-  ArrayBufferObjectRef* arrayBuffer = nullptr;
-  if (!ReadArrayBuffer(arrayBuffer)) {
+bool ValueDeserializer::ReadJsSet(ObjectRef*& set) {
+  auto esContext = lwIsolate_->GetCurrentContext()->get();
+
+  uint32_t id = nextId_++;
+  auto r = Evaluator::execute(esContext,
+                              [](ExecutionStateRef* state) -> ValueRef* {
+                                return SetObjectRef::create(state);
+                              });
+  LWNODE_CHECK(r.isSuccessful());
+  set = r.result->asObject();
+  AddObjectWithId(id, set);
+
+  GCVector<ValueRef*> entries;
+  while (!CheckTag(SerializationTag::kEndJSSet)) {
+    OptionalRef<ValueRef> value = ReadValue();
+    if (!value.hasValue()) {
+      return false;
+    }
+    entries.push_back(value.get());
+  }
+
+  SerializationTag tag;
+  uint32_t length = 0;
+  ReadTag(tag);
+  if (!ReadVarint<uint32_t>(length) || length != entries.size()) {
     return false;
   }
 
-  if (CheckTag(SerializationTag::kArrayBufferView)) {
-    SerializationTag tag;
-    ReadTag(tag);
-    ArrayBufferViewRef* arrayBufferView = nullptr;
-    if (!ReadArrayBufferView(arrayBufferView, arrayBuffer)) {
+  r = Evaluator::execute(
+      esContext,
+      [](ExecutionStateRef* state,
+         SetObjectRef* set,
+         const GCVector<ValueRef*>* entries) -> ValueRef* {
+        for (size_t i = 0; i < entries->size(); i++) {
+          set->add(state, (*entries)[i]);
+        }
+        return ValueRef::createUndefined();
+      },
+      set->asSetObject(),
+      &entries);
+  return r.isSuccessful();
+}
+
+bool ValueDeserializer::ReadJsError(ObjectRef*& error) {
+  uint32_t id = nextId_++;
+  ErrorObjectRef::Code code = ErrorObjectRef::Code::None;
+  StringRef* message = StringRef::emptyString();
+  StringRef* stack = nullptr;
+
+  bool done = false;
+  while (!done) {
+    uint8_t tag = 0;
+    if (!ReadVarint<uint8_t>(tag)) {
+      return false;
+    }
+    switch (static_cast<ErrorTag>(tag)) {
+      case ErrorTag::kEvalErrorPrototype:
+        code = ErrorObjectRef::Code::EvalError;
+        break;
+      case ErrorTag::kRangeErrorPrototype:
+        code = ErrorObjectRef::Code::RangeError;
+        break;
+      case ErrorTag::kReferenceErrorPrototype:
+        code = ErrorObjectRef::Code::ReferenceError;
+        break;
+      case ErrorTag::kSyntaxErrorPrototype:
+        code = ErrorObjectRef::Code::SyntaxError;
+        break;
+      case ErrorTag::kTypeErrorPrototype:
+        code = ErrorObjectRef::Code::TypeError;
+        break;
+      case ErrorTag::kUriErrorPrototype:
+        code = ErrorObjectRef::Code::URIError;
+        break;
+      case ErrorTag::kMessage:
+        if (!ReadString(message)) {
+          return false;
+        }
+        break;
+      case ErrorTag::kStack:
+        if (!ReadString(stack)) {
+          return false;
+        }
+        break;
+      case ErrorTag::kEnd:
+        done = true;
+        break;
+      default:
+        return false;
+    }
+  }
+
+  auto esContext = lwIsolate_->GetCurrentContext()->get();
+  error = ExceptionHelper::createErrorObject(esContext, code, message);
+
+  if (stack) {
+    auto r = ObjectRefHelper::defineDataProperty(
+        esContext,
+        error,
+        StringRef::createFromASCII("stack"),
+        ObjectRef::DataPropertyDescriptor(
+            stack,
+            static_cast<ObjectRef::PresentAttribute>(
+                ObjectRef::PresentAttribute::WritablePresent |
+                ObjectRef::PresentAttribute::NonEnumerablePresent |
+                ObjectRef::PresentAttribute::ConfigurablePresent)));
+    if (!r.isSuccessful()) {
       return false;
     }
-    value = arrayBufferView;
-    return true;
   }
-  value = arrayBuffer;
+
+  AddObjectWithId(id, error);
   return true;
 }
 
@@ -856,39 +1845,94 @@ bool ValueDeserializer::ReadArrayBuffer(
   return true;
 }
 
+bool ValueDeserializer::ReadTransferredArrayBuffer(
+    ArrayBufferObjectRef*& arrayBufferObject) {
+  uint32_t transferId = 0;
+  if (!ReadVarint<uint32_t>(transferId)) {
+    return false;
+  }
+  auto it = transferMap_->find(transferId);
+  if (it == transferMap_->end()) {
+    LWNODE_CALL_TRACE_ID_LOG(SERIALIZER, "Invalid transfer ID: %u", transferId);
+    return false;
+  }
+  arrayBufferObject = it->second;
+  return true;
+}
+
+bool ValueDeserializer::ReadSharedArrayBuffer(ObjectRef*& sharedArrayBuffer) {
+  uint32_t index = 0;
+  if (!delegate_ || !ReadVarint<uint32_t>(index)) {
+    return false;
+  }
+
+  v8::Local<v8::SharedArrayBuffer> result;
+  if (!delegate_->GetSharedArrayBufferFromId(lwIsolate_->toV8(), index)
+           .ToLocal(&result)) {
+    return false;
+  }
+  sharedArrayBuffer = VAL(*result)->value()->asObject();
+  return true;
+}
+
 bool ValueDeserializer::ReadArrayBufferView(
-    ArrayBufferViewRef*& arrayBufferView, ArrayBufferObjectRef* abo) {
+    ArrayBufferViewRef*& arrayBufferView, ArrayBufferRef* abo) {
   uint8_t tag = 0;
   uint32_t byteOffset = 0;
-  uint32_t arrayLength = 0;
+  uint32_t byteLength = 0;
 
   if (!ReadVarint<uint8_t>(tag) || !ReadVarint<uint32_t>(byteOffset) ||
-      !ReadVarint<uint32_t>(arrayLength)) {
+      !ReadVarint<uint32_t>(byteLength)) {
+    return false;
+  }
+
+  if (byteOffset > abo->byteLength() ||
+      byteLength > abo->byteLength() - byteOffset) {
     return false;
   }
 
   auto esContext = lwIsolate_->GetCurrentContext()->get();
+  uint32_t id = nextId_++;
 
   switch (static_cast<ArrayBufferViewTag>(tag)) {
     case ArrayBufferViewTag::kDataView: {
-      return false;
+      auto r = Evaluator::execute(
+          esContext,
+          [](ExecutionStateRef* state,
+             ArrayBufferRef* abo,
+             uint32_t byteOffset,
+             uint32_t byteLength) -> ValueRef* {
+            auto dataView = DataViewObjectRef::create(state);
+            dataView->setBuffer(abo, byteOffset, byteLength, byteLength);
+            return dataView;
+          },
+          abo,
+          byteOffset,
+          byteLength);
+      LWNODE_CHECK(r.isSuccessful());
+      arrayBufferView = r.result->asArrayBufferView();
+      break;
     }
 #define TYPED_ARRAY_CASE(Type, type, TYPE, ctype)                              \
   case ArrayBufferViewTag::k##Type##Array:                                     \
+    if (byteOffset % sizeof(ctype) != 0 || byteLength % sizeof(ctype) != 0) {  \
+      return false;                                                            \
+    }                                                                          \
     arrayBufferView = ArrayBufferHelper::createView<Type##ArrayObjectRef>(     \
         esContext,                                                             \
         abo,                                                                   \
         byteOffset,                                                            \
-        arrayLength,                                                           \
+        byteLength / sizeof(ctype),                                            \
         ArrayBufferHelper::ArrayType::kExternal##Type##Array);                 \
-    return true;
+    break;
       TYPED_ARRAYS(TYPED_ARRAY_CASE)
 #undef TYPED_ARRAY_CASE
     default:
       return false;
   }
 
-  return false;
+  AddObjectWithId(id, arrayBufferView);
+  return true;
 }
 
 bool ValueDeserializer::ReadRawBytes(size_t size, const uint8_t*& data) {
@@ -896,7 +1940,7 @@ bool ValueDeserializer::ReadRawBytes(size_t size, const uint8_t*& data) {
     return false;
   }
 
-  data = buffer_.currentPositionAddress();
+  data = buffer_.data + buffer_.position;
   buffer_.position += size;
   return true;
 }
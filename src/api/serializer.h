@@ -21,6 +21,7 @@
 #include <EscargotPublic.h>
 #include <v8.h>
 
+#include "utils/gc-util.h"
 #include "utils/optional.h"
 
 using namespace Escargot;
@@ -28,6 +29,7 @@ using namespace Escargot;
 namespace EscargotShim {
 
 enum class SerializationTag : uint8_t;
+enum class ErrorMessageType;
 
 class IsolateWrap;
 
@@ -57,17 +59,32 @@ class ValueSerializer {
  public:
   ValueSerializer(IsolateWrap* lwIsolate,
                   v8::ValueSerializer::Delegate* delegate);
+  ~ValueSerializer();
+
   void WriteHeader();
   bool WriteValue(ValueRef* value);
   bool WriteUint32(uint32_t value);
   bool WriteInt32(int32_t value);
   bool WriteNumber(double value);
 
+  // Raw data, used by a host object delegate
+  void WriteRawUint32(uint32_t value);
+  void WriteRawUint64(uint64_t value);
+  void WriteRawDouble(double value);
+  void WriteRawBytes(const void* source, size_t length);
+
+  void SetTreatArrayBufferViewsAsHostObjects(bool mode) {
+    treatArrayBufferViewsAsHostObjects_ = mode;
+  }
+
+  // The buffer is written as |transferId| instead of its contents.
+  void TransferArrayBuffer(uint32_t transferId,
+                           ArrayBufferObjectRef* arrayBuffer);
+
   std::pair<uint8_t*, size_t> Release();
 
  private:
   void WriteTag(SerializationTag tag);
-  void WriteRawBytes(const void* source, size_t length);
   uint8_t* ReserveRawBytes(size_t bytes);
 
   template <typename T>
@@ -76,20 +93,43 @@ class ValueSerializer {
   void WriteZigZag(T value);
   bool WriteBoolean(bool value);
   void WriteString(StringRef* string);
+  void WriteBigIntContents(BigIntRef* bigInt);
+  bool WriteJSReceiver(ObjectRef* object);
   bool WriteObject(ObjectRef* object);
+  bool WriteObjectProperties(ObjectRef* object,
+                             uint32_t& propertiesWritten,
+                             bool skipIndices = false);
+  bool WriteSparseJsArray(ArrayObjectRef* array, uint32_t length);
   bool WriteJsArray(ArrayObjectRef* array);
+  bool WriteJsDate(DateObjectRef* date);
+  bool WriteJsPrimitiveWrapper(ObjectRef* object);
+  bool WriteJsRegExp(RegExpObjectRef* regExp);
+  bool WriteJsMap(MapObjectRef* map);
+  bool WriteJsSet(SetObjectRef* set);
+  bool WriteJsError(ErrorObjectRef* error);
   bool WriteHostObject(ObjectRef* object);
   bool WriteArrayBuffer(size_t length, uint8_t* bytes);
   bool WriteArrayBufferView(ArrayBufferViewRef* arrayBufferView);
-  bool WriteTypedArrayObject(Escargot::ArrayBufferViewRef* bufferView);
+  bool WriteSharedArrayBuffer(SharedArrayBufferObjectRef* sharedArrayBuffer);
   bool ExpandBuffer(size_t required_capacity);
   bool ThrowIfOutOfMemory();
-  void ThrowDataCloneError();
+  void ThrowDataCloneError(ErrorMessageType type);
 
   IsolateWrap* lwIsolate_ = nullptr;
   v8::ValueSerializer::Delegate* delegate_ = nullptr;
   SerializerBuffer buffer_;
   bool out_of_memory_ = false;
+  bool treatArrayBufferViewsAsHostObjects_ = false;
+
+  // object -> the ID it is referred to by kObjectReference
+  Escargot::PersistentRefHolder<GCUnorderedMap<ObjectRef*, uint32_t>> idMap_;
+  uint32_t nextId_ = 0;
+
+  // array buffer -> its transfer ID
+  Escargot::PersistentRefHolder<GCUnorderedMap<ObjectRef*, uint32_t>>
+      transferMap_;
+  // @note held by the isolate until the transfer ends
+  std::vector<BackingStoreRef*> transferredBackingStores_;
 };
 
 class ValueDeserializer {
@@ -98,12 +138,24 @@ class ValueDeserializer {
                     v8::ValueDeserializer::Delegate* delegate,
                     const uint8_t* data,
                     const size_t size);
-  ~ValueDeserializer(){};
+  ~ValueDeserializer();
 
+  bool ReadHeader();
+  uint32_t version() const { return version_; }
   OptionalRef<ValueRef> ReadValue();
-  bool ReadUint32(uint32_t*& value);
+
+  // Raw data, used by a host object delegate
+  bool ReadRawUint32(uint32_t* value);
+  bool ReadRawUint64(uint64_t* value);
+  bool ReadRawDouble(double* value);
+  bool ReadRawBytes(size_t size, const uint8_t*& data);
+
+  // The buffer read for |transferId|, which has been received already.
+  void TransferArrayBuffer(uint32_t transferId,
+                           ArrayBufferObjectRef* arrayBuffer);
 
  private:
+  OptionalRef<ValueRef> ReadValueInternal();
   bool ReadTag(SerializationTag& tag);
   bool CheckTag(SerializationTag tag);
   template <typename T>
@@ -113,19 +165,43 @@ class ValueDeserializer {
   bool ReadDouble(double& value);
   bool ReadOneByteString(StringRef*& string);
   bool ReadTwoByteString(StringRef*& string);
-  bool ReadObject(ObjectRef* object);
+  bool ReadString(StringRef*& string);
+  bool ReadBigIntContents(BigIntRef*& bigInt);
+  bool ReadJsObject(ObjectRef*& object);
+  bool ReadObjectProperties(ObjectRef* object,
+                            SerializationTag endTag,
+                            uint32_t& propertiesRead);
   bool ReadHostObject(ObjectRef*& object);
-  bool ReadJsArray(ArrayObjectRef*& array);
-  bool ReadJsArrayBuffer(ValueRef*& value);
+  bool ReadDenseJsArray(ArrayObjectRef*& array);
+  bool ReadSparseJsArray(ArrayObjectRef*& array);
+  bool ReadJsDate(ObjectRef*& date);
+  bool ReadJsPrimitiveWrapper(SerializationTag tag, ObjectRef*& object);
+  bool ReadJsRegExp(ObjectRef*& regExp);
+  bool ReadJsMap(ObjectRef*& map);
+  bool ReadJsSet(ObjectRef*& set);
+  bool ReadJsError(ObjectRef*& error);
+  bool ReadObjectReference(ObjectRef*& object);
   bool ReadArrayBuffer(ArrayBufferObjectRef*& arayBufferObject);
+  bool ReadTransferredArrayBuffer(ArrayBufferObjectRef*& arrayBufferObject);
+  bool ReadSharedArrayBuffer(ObjectRef*& sharedArrayBuffer);
   bool ReadArrayBufferView(ArrayBufferViewRef*& arrayBufferView,
-                           ArrayBufferObjectRef* arrayBufferObject);
+                           ArrayBufferRef* arrayBuffer);
 
-  bool ReadRawBytes(size_t size, const uint8_t*& data);
+  void AddObjectWithId(uint32_t id, ObjectRef* object);
 
   IsolateWrap* lwIsolate_ = nullptr;
   v8::ValueDeserializer::Delegate* delegate_ = nullptr;
   SerializerBuffer buffer_;
+  uint32_t version_ = 0;
+
+  // ID -> the object read with it
+  Escargot::PersistentRefHolder<GCUnorderedMap<uint32_t, ObjectRef*>> idMap_;
+  uint32_t nextId_ = 0;
+
+  // transfer ID -> the array buffer received
+  Escargot::PersistentRefHolder<
+      GCUnorderedMap<uint32_t, ArrayBufferObjectRef*>>
+      transferMap_;
 };
 
 }  // namespace EscargotShim
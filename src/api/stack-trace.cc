@@ -18,8 +18,11 @@
 #include "api.h"
 #include "base.h"
 #include "context.h"
+#include "global.h"
 #include "isolate.h"
 
+#include <cstdlib>
+
 using namespace Escargot;
 using namespace v8;
 
@@ -38,13 +41,41 @@ class PrepareStackTraceScope {
   IsolateWrap* isolate_;
 };
 
+static const double kDefaultStackTraceLimit = 20;
+
+// The context an error was created in. Like V8, its stack is formatted with
+// the CallSites and the PrepareStackTraceCallback of that context.
+static ContextWrap* errorContext(ExecutionStateRef* state, ObjectRef* error) {
+  auto context = error->creationContext();
+  return ContextWrap::fromEscargot(context.hasValue() ? context.get()
+                                                      : state->context());
+}
+
+void StackTrace::defineStackTraceLimit(ExecutionStateRef* state,
+                                       ObjectRef* errorObject,
+                                       ContextWrap* lwContext) {
+  double stackTraceLimit = kDefaultStackTraceLimit;
+  auto value = Global::flags()->value(Flag::Type::StackTraceLimit);
+  if (!value.empty()) {
+    stackTraceLimit = std::max(strtod(value.c_str(), nullptr), 0.0);
+  }
+
+  lwContext->setErrorConstructor(errorObject);
+  errorObject->set(state,
+                   StringRef::createFromASCII("stackTraceLimit"),
+                   ValueRef::create(stackTraceLimit));
+}
+
 bool StackTrace::getStackTraceLimit(ExecutionStateRef* state,
                                     double& stackTraceLimit) {
-  auto errorObject = state->context()->globalObject()->get(
-      state, StringRef::createFromASCII("Error"));
-  LWNODE_CHECK(errorObject->isObject());
-
-  auto stackTraceLimitValue = errorObject->asObject()->get(
+  // Like V8, the property is read on every capture, so that deleting it or
+  // setting it to a non-number turns stack traces off.
+  auto errorConstructor =
+      ContextWrap::fromEscargot(state->context())->errorConstructor();
+  if (!errorConstructor) {
+    return false;
+  }
+  auto stackTraceLimitValue = errorConstructor->getOwnProperty(
       state, StringRef::createFromASCII("stackTraceLimit"));
 
   if (!stackTraceLimitValue->isNumber()) {
@@ -55,6 +86,15 @@ bool StackTrace::getStackTraceLimit(ExecutionStateRef* state,
   return true;
 }
 
+ArrayObjectRef* StackTrace::NativeAccessorProperty::stackTrace(
+    ExecutionStateRef* state) {
+  if (frames_) {
+    stackTrace_ = createCallSites(state, lwContext_, frames_);
+    frames_ = nullptr;
+  }
+  return stackTrace_;
+}
+
 ValueRef* StackTrace::StackTraceGetter(
     ExecutionStateRef* state,
     ObjectRef* self,
@@ -66,9 +106,9 @@ ValueRef* StackTrace::StackTraceGetter(
   }
 
   auto lwIsolate = IsolateWrap::GetCurrent();
-  auto lwContext = lwIsolate->GetCurrentContext();
+  auto lwContext = accessorData->lwContext();
 
-  if (!accessorData->stackTrace()) {
+  if (!accessorData->hasStackTrace()) {
     auto undefined = ValueRef::createUndefined();
     accessorData->setStackValue(undefined);
     return undefined;
@@ -79,17 +119,22 @@ ValueRef* StackTrace::StackTraceGetter(
     // Avoid calling this function multiple times with 'error.stack' in
     // 'PrepareStackTraceCallback'.
     PrepareStackTraceScope scope(lwIsolate);
+    CallbackStateScope callbackStateScope(lwIsolate, state);
     auto formattedStackTrace = lwIsolate->RunPrepareStackTraceCallback(
-        state, lwContext, self, accessorData->stackTrace());
+        state, lwContext, self, accessorData->stackTrace(state));
     if (!formattedStackTrace->isUndefined()) {
       accessorData->setStackValue(formattedStackTrace);
       return formattedStackTrace;
     }
   }
 
+  // Without a callback, the frames are formatted as they are.
   StackTrace stackTrace(state, self);
   auto stackTraceString =
-      stackTrace.formatStackTraceStringNodeStyle(accessorData->stackTrace());
+      accessorData->hasCallSites()
+          ? stackTrace.formatStackTraceStringNodeStyle(
+                accessorData->stackTrace(state))
+          : stackTrace.formatStackTraceStringNodeStyle(accessorData->frames());
   accessorData->setStackValue(stackTraceString);
   return stackTraceString;
 }
@@ -126,51 +171,33 @@ ValueRef* StackTrace::captureStackTraceCallback(ExecutionStateRef* state,
     exceptionObject->deleteOwnProperty(state, stackString);
   }
 
-  auto callSite = IsolateWrap::GetCurrent()->GetCurrentContext()->callSite();
-  auto stackTraceData = state->computeStackTrace();
-  auto stackTraceVector = ValueVectorRef::create();
-
   ValueRef* filterFunction = nullptr;
   if (argc > 1 && argv[1]->isFunctionObject()) {
     filterFunction = argv[1];
   }
 
-  int stacktraceStartIdx = 1;
-
-  double stackTraceLimit = 0;
-  if (getStackTraceLimit(state, stackTraceLimit)) {
-    size_t maxPrintStackSize =
-        std::min(stackTraceLimit, (double)stackTraceData.size());
-    for (size_t i = 0; i < maxPrintStackSize; i++) {
-      if (StackTrace::checkFilter(filterFunction, stackTraceData[i])) {
-        if (stackTraceVector->size() > 0) {
-          stackTraceVector->erase(0, stackTraceVector->size());
-        }
-        filterFunction = nullptr;
-
-        continue;
-      }
-
-      stackTraceVector->pushBack(
-          callSite->instantiate(state->context(), stackTraceData[i]));
-    }
-  }
-
   // FIXME: it seems there are some cases where we need to freeze the
   // stack string here. Investigate further
   StackTrace stackTrace(state, exceptionObject);
-  stackTrace.addStackProperty(ArrayObjectRef::create(state, stackTraceVector));
+  auto frames =
+      stackTrace.captureFrames(state->computeStackTrace(), filterFunction);
+  stackTrace.addStackProperty(frames ? frames : new StackFrames());
 
   return ValueRef::createUndefined();
 }
 
-void StackTrace::addStackProperty(ArrayObjectRef* stackTrace) {
+void StackTrace::addStackProperty(StackFrames* frames) {
   // NOTE: either Error or Exception contains stack.
   error_->defineNativeDataAccessorProperty(
       state_,
       StringRef::createFromUTF8("stack"),
-      new NativeAccessorProperty(
-          true, false, true, StackTraceGetter, StackTraceSetter, stackTrace));
+      new NativeAccessorProperty(true,
+                                 false,
+                                 true,
+                                 StackTraceGetter,
+                                 StackTraceSetter,
+                                 frames,
+                                 errorContext(state_, error_)));
 }
 
 ValueRef* StackTrace::createCaptureStackTrace(
@@ -207,77 +234,119 @@ ValueRef* StackTrace::prepareStackTraceCallback(ExecutionStateRef* state,
   return StringRef::emptyString();
 }
 
+void StackTrace::appendErrorMessage(StringRefBuilder& builder) {
+  builder.append(error_->toString(state_));
+}
+
 StringRef* StackTrace::formatStackTraceStringNodeStyle(
     ArrayObjectRef* stackTrace) {
-  std::ostringstream oss;
-  auto message = error_->toString(state_)->toStdUTF8String();
-  if (message.length() > 0) {
-    oss << message;
-  }
+  StringRefBuilder builder;
+  appendErrorMessage(builder);
 
   auto esContext = state_->context();
   size_t maxPrintStackSize =
       ArrayObjectRefHelper::length(esContext, stackTrace);
 
   if (maxPrintStackSize > 0) {
-    oss << std::endl;
+    builder.append("\n");
   }
 
-  const std::string separator = "    ";
-
   for (size_t i = 0; i < maxPrintStackSize; ++i) {
-    auto callSiteString = ArrayObjectRefHelper::get(esContext, stackTrace, i)
-                              ->toString(state_)
-                              ->toStdUTF8String();
-    oss << separator << "at " << callSiteString << std::endl;
+    builder.append("    at ");
+    builder.append(ArrayObjectRefHelper::get(esContext, stackTrace, i)
+                       ->toString(state_));
+    builder.append("\n");
   }
 
-  auto stringNodeStyle = oss.str();
-  return StringRef::createFromUTF8(stringNodeStyle.c_str(),
-                                   stringNodeStyle.length());
+  return builder.finalize();
 }
 
-std::string StackTrace::formatStackTraceLine(
-    const Evaluator::StackTraceData& line) {
-  std::ostringstream oss;
+StringRef* StackTrace::formatStackTraceStringNodeStyle(StackFrames* frames) {
+  StringRefBuilder builder;
+  appendErrorMessage(builder);
 
-  auto stdFunctionName = line.functionName->toStdUTF8String();
-  // TODO: 'anonymous' is not unique. 'stdFunctionName' should be unique.
-  // 'anonymous' keyword is related to ScriptCompiler::CompileFunctionInContext.
-  if (stdFunctionName == "anonymous") {
-    stdFunctionName = "";
+  if (frames->size() > 0) {
+    builder.append("\n");
   }
 
-  if (stdFunctionName.empty()) {
-    oss << line.srcName->toStdUTF8String() << ":" << line.loc.line << ":"
-        << line.loc.column;
-  } else {
-    oss << stdFunctionName << " (" << line.srcName->toStdUTF8String() << ":"
-        << line.loc.line << ":" << line.loc.column << ")";
+  for (size_t i = 0; i < frames->size(); ++i) {
+    builder.append("    at ");
+    appendStackTraceLine(builder, (*frames)[i]);
+    builder.append("\n");
   }
 
-  return oss.str();
+  return builder.finalize();
+}
+
+void StackTrace::appendStackTraceLine(StringRefBuilder& builder,
+                                      const Evaluator::StackTraceData& line) {
+  // TODO: 'anonymous' is not unique. 'functionName' should be unique.
+  // 'anonymous' keyword is related to ScriptCompiler::CompileFunctionInContext.
+  auto functionName = line.functionName;
+  bool hasFunctionName =
+      functionName->length() > 0 &&
+      !StringRefHelper::equalsWithASCIIString(functionName, "anonymous");
+
+  if (hasFunctionName) {
+    builder.append(functionName);
+    builder.append(" (");
+  }
+
+  builder.append(line.srcName);
+  builder.append(":");
+  builder.appendNumber(line.loc.line);
+  builder.append(":");
+  builder.appendNumber(line.loc.column);
+
+  if (hasFunctionName) {
+    builder.append(")");
+  }
 }
 
-ArrayObjectRef* StackTrace::genCallSites(
-    const GCManagedVector<Evaluator::StackTraceData>& stackTraceData) {
-  auto callSite = IsolateWrap::GetCurrent()->GetCurrentContext()->callSite();
+StringRef* StackTrace::formatStackTraceLine(
+    const Evaluator::StackTraceData& line) {
+  StringRefBuilder builder;
+  appendStackTraceLine(builder, line);
+  return builder.finalize();
+}
 
+StackFrames* StackTrace::captureFrames(
+    const GCManagedVector<Evaluator::StackTraceData>& stackTraceData,
+    ValueRef* filter) {
   double stackTraceLimit = 0;
   if (!getStackTraceLimit(state_, stackTraceLimit)) {
     return nullptr;
   }
 
-  auto stackTraceVector = ValueVectorRef::create();
+  auto frames = new StackFrames();
   size_t maxPrintStackSize =
       std::min(stackTraceLimit, (double)stackTraceData.size());
 
   for (size_t i = 0; i < maxPrintStackSize; i++) {
+    // Frames up to the filter function are dropped.
+    if (StackTrace::checkFilter(filter, stackTraceData[i])) {
+      frames->clear();
+      filter = nullptr;
+      continue;
+    }
+    frames->push_back(stackTraceData[i]);
+  }
+
+  return frames;
+}
+
+ArrayObjectRef* StackTrace::createCallSites(ExecutionStateRef* state,
+                                            ContextWrap* lwContext,
+                                            StackFrames* frames) {
+  auto callSite = lwContext->callSite();
+  auto stackTraceVector = ValueVectorRef::create();
+
+  for (size_t i = 0; i < frames->size(); i++) {
     stackTraceVector->pushBack(
-        callSite->instantiate(state_->context(), stackTraceData[i]));
+        callSite->instantiate(lwContext->get(), (*frames)[i]));
   }
 
-  return ArrayObjectRef::create(state_, stackTraceVector);
+  return ArrayObjectRef::create(state, stackTraceVector);
 }
 
 CallSite::CallSite(ContextRef* context) : context_(context) {
@@ -380,9 +449,7 @@ void CallSite::injectSitePrototype() {
          bool isNewExpression) -> ValueRef* {
         auto data = ObjectRefHelper::getExtraData(thisValue->asObject())
                         ->asStackTraceData();
-        auto string = StackTrace::formatStackTraceLine(data->stackTraceData());
-
-        return StringRef::createFromUTF8(string.data(), string.length());
+        return StackTrace::formatStackTraceLine(data->stackTraceData());
       });
 
   setCallSitePrototype(
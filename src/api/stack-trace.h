@@ -19,12 +19,20 @@
 #include <EscargotPublic.h>
 #include <GCUtil.h>
 
+#include "utils/gc-util.h"
+
 using namespace Escargot;
 
 namespace EscargotShim {
 
 class StackTraceData;
 
+class ContextWrap;
+class StringRefBuilder;
+
+// Frames captured when an Error is created, up to Error.stackTraceLimit
+typedef GCVector<Evaluator::StackTraceData> StackFrames;
+
 class StackTrace {
  public:
   class NativeAccessorProperty
@@ -35,13 +43,21 @@ class StackTrace {
                            bool isConfigurable,
                            ObjectRef::NativeDataAccessorPropertyGetter getter,
                            ObjectRef::NativeDataAccessorPropertySetter setter,
-                           ArrayObjectRef* stackTrace)
+                           StackFrames* frames,
+                           ContextWrap* lwContext)
         : NativeDataAccessorPropertyData(
               isWritable, isEnumerable, isConfigurable, getter, setter),
-          stackTrace_(stackTrace) {}
-
-    ArrayObjectRef* stackTrace() { return stackTrace_; }
-    void setStackTrace(ArrayObjectRef* stackTrace) { stackTrace_ = stackTrace; }
+          frames_(frames),
+          lwContext_(lwContext) {}
+
+    // CallSites are instantiated from the frames on first use, since the
+    // stack of most errors is never read.
+    ArrayObjectRef* stackTrace(ExecutionStateRef* state);
+    bool hasStackTrace() { return frames_ || stackTrace_; }
+    bool hasCallSites() { return stackTrace_ != nullptr; }
+    StackFrames* frames() { return frames_; }
+    // The context the error was created in
+    ContextWrap* lwContext() { return lwContext_; }
 
     ValueRef* stackValue() { return stackValue_; }
     void setStackValue(ValueRef* stackValue) { stackValue_ = stackValue; }
@@ -50,6 +66,8 @@ class StackTrace {
     void* operator new(size_t size) { return GC_MALLOC(size); }
 
    private:
+    StackFrames* frames_ = nullptr;
+    ContextWrap* lwContext_ = nullptr;
     ArrayObjectRef* stackTrace_ = nullptr;
     ValueRef* stackValue_ = nullptr;
   };
@@ -85,20 +103,36 @@ class StackTrace {
                                ObjectRef::NativeDataAccessorPropertyData* data,
                                ValueRef* setterInputData);
 
-  static std::string formatStackTraceLine(
+  static StringRef* formatStackTraceLine(
       const Evaluator::StackTraceData& line);
 
-  void addStackProperty(ArrayObjectRef* stackTraceVector);
+  void addStackProperty(StackFrames* frames);
+
+  // Returns nullptr if Error.stackTraceLimit isn't a number.
+  StackFrames* captureFrames(
+      const GCManagedVector<Evaluator::StackTraceData>& stackTraceData,
+      ValueRef* filter = nullptr);
 
-  ArrayObjectRef* genCallSites(
-      const GCManagedVector<Evaluator::StackTraceData>& stackTraceData);
+  static ArrayObjectRef* createCallSites(ExecutionStateRef* state,
+                                         ContextWrap* lwContext,
+                                         StackFrames* frames);
 
   StringRef* formatStackTraceStringNodeStyle(ArrayObjectRef* stackTrace);
+  StringRef* formatStackTraceStringNodeStyle(StackFrames* frames);
 
+  // Define Error.stackTraceLimit as a data property, set to the value of
+  // --stack-trace-limit or to 20.
+  static void defineStackTraceLimit(ExecutionStateRef* state,
+                                    ObjectRef* errorObject,
+                                    ContextWrap* lwContext);
   static bool getStackTraceLimit(ExecutionStateRef* state,
                                  double& stackTraceLimit);
 
  private:
+  static void appendStackTraceLine(StringRefBuilder& builder,
+                                   const Evaluator::StackTraceData& line);
+  void appendErrorMessage(StringRefBuilder& builder);
+
   ExecutionStateRef* state_ = nullptr;
   ObjectRef* error_ = nullptr;
 
@@ -40,12 +40,28 @@ void Flags::initFlags() {
   addFlag<Flag>("--debug", Flag::Type::LWNodeOther, true);
   addFlag<Flag>("--stack-size=", Flag::Type::LWNodeOther, true);
   addFlag<Flag>("--nolazy", Flag::Type::LWNodeOther, true);
+  addFlag<FlagWithValue>(
+      "--stack-trace-limit=", Flag::Type::StackTraceLimit, true);
+  // NOTE: node is built without the inspector, so its own profiling options
+  // are compiled out and these flags are forwarded to us.
+  addFlag<Flag>("--cpu-prof", Flag::Type::CpuProf);
+  addFlag<FlagWithValue>("--cpu-prof-dir=", Flag::Type::CpuProfDir, true);
+  addFlag<FlagWithValue>("--cpu-prof-name=", Flag::Type::CpuProfName, true);
+  addFlag<FlagWithValue>(
+      "--cpu-prof-interval=", Flag::Type::CpuProfInterval, true);
+  addFlag<Flag>("--heap-prof", Flag::Type::HeapProf);
+  addFlag<FlagWithValue>("--heap-prof-dir=", Flag::Type::HeapProfDir, true);
+  addFlag<FlagWithValue>("--heap-prof-name=", Flag::Type::HeapProfName, true);
+  addFlag<FlagWithValue>(
+      "--heap-prof-interval=", Flag::Type::HeapProfInterval, true);
 
   // lwnode flags
   addFlag<Flag>("--trace-gc", Flag::Type::TraceGC);
   addFlag<FlagWithNegativeValues>("--trace-call=", Flag::Type::TraceCall, true);
   addFlag<Flag>("--internal-log", Flag::Type::InternalLog);
   addFlag<Flag>("--start-debug-server", Flag::Type::DebugServer);
+  addFlag<Flag>("--arraybuffer-pool", Flag::Type::ArrayBufferPool);
+  addFlag<Flag>("--smaps-sampler", Flag::Type::SmapsSampler);
 }
 
 bool Flag::isPrefixOf(const std::string& name) {
@@ -57,8 +73,10 @@ bool Flag::isPrefixOf(const std::string& name) {
 }
 
 Flag* Flags::findFlagObject(const std::string& name) {
+  // Normalize the flag name only, since a value may be a path.
   std::string normalized = name;
-  std::replace(normalized.begin(), normalized.end(), '_', '-');
+  auto nameEnd = std::min(normalized.find('='), normalized.size());
+  std::replace(normalized.begin(), normalized.begin() + nameEnd, '_', '-');
 
   for (size_t i = 0; i < validFlags_.size(); i++) {
     Flag* flag = validFlags_[i].get();
@@ -91,6 +109,14 @@ void Flags::add(const std::string& userOption) {
 
   add(flag);
 
+  if (flag->hasSingleValue()) {
+    auto pos = userOption.find_first_of('=');
+    if (pos != std::string::npos) {
+      flag->addValue(userOption.substr(pos + 1));
+    }
+    return;
+  }
+
   if (flag->type() == Flag::Type::TraceCall ||
       flag->type() == Flag::Type::UnhandledRejections) {
     std::string optionValues = userOption.substr(userOption.find_first_of('=') +
@@ -137,6 +163,15 @@ bool Flags::isOn(Flag::Type type, const std::string& value) {
   return flag->hasValue(value);
 }
 
+std::string Flags::value(Flag::Type type, const std::string& defaultValue) {
+  Flag* flag = getFlag(type);
+  if (!flag || flag->value().empty()) {
+    return defaultValue;
+  }
+
+  return flag->value();
+}
+
 void Flags::shrinkArgumentList(int* argc, char** argv) {
   int count = 0;
   for (int idx = 0; idx < *argc; idx++) {
@@ -49,6 +49,17 @@ class Flag {
     InternalLog,
     LWNodeOther,
     DebugServer,
+    CpuProf,
+    CpuProfDir,
+    CpuProfName,
+    CpuProfInterval,
+    HeapProf,
+    HeapProfDir,
+    HeapProfName,
+    HeapProfInterval,
+    StackTraceLimit,
+    ArrayBufferPool,
+    SmapsSampler,
   };
 
   Flag(const std::string& name, Type type, bool useAsPrefix = false)
@@ -65,6 +76,9 @@ class Flag {
   virtual void addNegativeValue(const std::string& value) {}
   virtual bool hasNegativeValue(const std::string& value) { return false; }
 
+  virtual bool hasSingleValue() const { return false; }
+  virtual std::string value() const { return ""; }
+
  protected:
   std::string name_;
   Type type_ = Type::Empty;
@@ -89,6 +103,23 @@ class FlagWithValues : public Flag {
   std::set<std::string> values_;
 };
 
+// A flag taking a single value which is kept as it is, e.g. a path.
+class FlagWithValue : public Flag {
+ public:
+  FlagWithValue(const std::string& name, Type type, bool useAsPrefix = false)
+      : Flag(name, type, useAsPrefix) {}
+  virtual ~FlagWithValue() {}
+
+  void addValue(const std::string& value) override { value_ = value; }
+  bool hasValue(const std::string& value) override { return value_ == value; }
+
+  bool hasSingleValue() const override { return true; }
+  std::string value() const override { return value_; }
+
+ private:
+  std::string value_;
+};
+
 class FlagWithNegativeValues : public FlagWithValues {
  public:
   FlagWithNegativeValues(const std::string& name,
@@ -125,6 +156,8 @@ class LWNODE_EXPORT Flags {
   void add(Flag* flag);
 
   bool isOn(Flag::Type type, const std::string& value = "");
+  // Returns the value of a flag given as `--name=value`, or `defaultValue`.
+  std::string value(Flag::Type type, const std::string& defaultValue = "");
   void shrinkArgumentList(int* argc, char** argv);
 
   // NOTE: get() and set() are only used in cctest
@@ -17,8 +17,12 @@
  */
 
 #include "smaps.h"
+#include <fcntl.h>
 #include <unistd.h>
 #include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <string>
@@ -208,6 +212,182 @@ size_t calculateTotalRss(std::vector<SmapContents>& smaps) {
   return total;
 }
 
+// readSmapsTotals
+
+namespace {
+
+/*
+  Fed with the file a chunk at a time, so a line may span two chunks. Only
+  lines of the form `Key:   1234 kB` for the keys of SmapsTotals are summed
+  up. The header line of a mapping has a long first token and is skipped.
+*/
+class SmapsTotalsParser {
+ public:
+  explicit SmapsTotalsParser(SmapsTotals* totals) : totals_(totals) {}
+
+  void feed(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      feed(data[i]);
+    }
+  }
+
+  void finish() { feed('\n'); }
+
+ private:
+  enum class State { Key, Spaces, Value, Skip };
+
+  static constexpr size_t kMaxKeyLength = 16;
+
+  void feed(char c) {
+    if (c == '\n') {
+      if (state_ == State::Value) {
+        *field_ += value_;
+      }
+      state_ = State::Key;
+      keyLength_ = 0;
+      return;
+    }
+
+    switch (state_) {
+      case State::Key:
+        if (c == ':') {
+          field_ = fieldOfKey();
+          state_ = field_ ? State::Spaces : State::Skip;
+        } else if (keyLength_ < kMaxKeyLength) {
+          key_[keyLength_++] = c;
+        } else {
+          state_ = State::Skip;
+        }
+        break;
+      case State::Spaces:
+        if (isDigit(c)) {
+          value_ = c - '0';
+          state_ = State::Value;
+        } else if (c != ' ' && c != '\t') {
+          state_ = State::Skip;
+        }
+        break;
+      case State::Value:
+        if (isDigit(c)) {
+          value_ = value_ * 10 + (c - '0');
+        } else {
+          *field_ += value_;
+          state_ = State::Skip;
+        }
+        break;
+      case State::Skip:
+        break;
+    }
+  }
+
+  static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+  bool isKey(const char* name) const {
+    return strlen(name) == keyLength_ && memcmp(name, key_, keyLength_) == 0;
+  }
+
+  size_t* fieldOfKey() {
+    if (isKey("Rss")) {
+      return &totals_->rss;
+    } else if (isKey("Pss")) {
+      return &totals_->pss;
+    } else if (isKey("Swap")) {
+      return &totals_->swap;
+    } else if (isKey("SwapPss")) {
+      return &totals_->swapPss;
+    }
+    return nullptr;
+  }
+
+  SmapsTotals* totals_;
+  State state_ = State::Key;
+  char key_[kMaxKeyLength];
+  size_t keyLength_ = 0;
+  size_t* field_ = nullptr;
+  size_t value_ = 0;
+};
+
+int openSmaps(const char* pid) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%s/smaps_rollup", pid);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    // smaps_rollup is available since Linux 4.14.
+    snprintf(path, sizeof(path), "/proc/%s/smaps", pid);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+  }
+  return fd;
+}
+
+}  // namespace
+
+bool readSmapsTotals(SmapsTotals* totals, const char* pid) {
+  int fd = openSmaps(pid);
+  if (fd < 0) {
+    return false;
+  }
+
+  SmapsTotals result;
+  SmapsTotalsParser parser(&result);
+  char buffer[4096];
+  bool isRead = true;
+
+  while (true) {
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length > 0) {
+      parser.feed(buffer, length);
+    } else if (length == 0) {
+      break;
+    } else if (errno != EINTR) {
+      isRead = false;
+      break;
+    }
+  }
+  close(fd);
+
+  if (!isRead) {
+    return false;
+  }
+  parser.finish();
+  *totals = result;
+  return true;
+}
+
+// SmapsSampler
+
+SmapsSampler::SmapsSampler(std::chrono::milliseconds interval)
+    : interval_(interval) {
+  readSmapsTotals(&totals_);
+  thread_ = std::thread(&SmapsSampler::run, this);
+}
+
+SmapsSampler::~SmapsSampler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isStopped_ = true;
+  }
+  wakeup_.notify_one();
+  thread_.join();
+}
+
+SmapsTotals SmapsSampler::totals() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return totals_;
+}
+
+void SmapsSampler::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!wakeup_.wait_for(lock, interval_, [this] { return isStopped_; })) {
+    lock.unlock();
+    SmapsTotals totals;
+    bool isRead = readSmapsTotals(&totals);
+    lock.lock();
+    if (isRead) {
+      totals_ = totals;
+    }
+  }
+}
+
 std::string getMemorySnapshotString(std::vector<SmapContents>& smaps,
                                     SnapshotStringOption option) {
   std::stringstream output;
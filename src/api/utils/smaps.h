@@ -18,7 +18,11 @@
 
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -42,6 +46,45 @@ size_t calculateTotalRss(std::vector<SmapContents>& smaps);
 bool dumpMemorySnapshot(std::string outputPath,
                         std::vector<SmapContents>& smaps);
 
+// The sums of the numeric fields over every mapping, in kB.
+struct SmapsTotals {
+  size_t rss = 0;
+  size_t pss = 0;
+  size_t swap = 0;
+  size_t swapPss = 0;
+};
+
+/*
+  Reads /proc/<pid>/smaps_rollup, or /proc/<pid>/smaps on kernels without it,
+  through a fixed buffer and keeps only the fields of SmapsTotals. Unlike
+  parseSmaps(), nothing is allocated. Returns false if neither file can be
+  read.
+*/
+bool readSmapsTotals(SmapsTotals* totals, const char* pid = "self");
+
+/*
+  SmapsSampler calls readSmapsTotals() for the current process on a thread of
+  its own every interval, so that readers never wait for the kernel to walk
+  the mappings. The first sample is taken by the constructor.
+*/
+class SmapsSampler {
+ public:
+  explicit SmapsSampler(std::chrono::milliseconds interval);
+  ~SmapsSampler();
+
+  SmapsTotals totals();
+
+ private:
+  void run();
+
+  std::chrono::milliseconds interval_;
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  bool isStopped_ = false;
+  SmapsTotals totals_;
+  std::thread thread_;
+};
+
 enum SnapshotStringOption {
   kShowDefault = 0,
   kShowFullInfo = 1,
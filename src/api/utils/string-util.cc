@@ -64,3 +64,65 @@ std::vector<std::string> strSplit(const std::string& str, char delimiter) {
 
   return tokens;
 }
+
+static void appendJSONUnicodeEscape(std::string& out, uint32_t code) {
+  static const char kHex[] = "0123456789abcdef";
+  out += "\\u";
+  out += kHex[(code >> 12) & 0xF];
+  out += kHex[(code >> 8) & 0xF];
+  out += kHex[(code >> 4) & 0xF];
+  out += kHex[code & 0xF];
+}
+
+void strAppendJSONQuoted(std::string& out,
+                         const std::string& str,
+                         bool asciiOnly) {
+  out += '"';
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(str.data());
+  const uint8_t* end = p + str.length();
+  while (p < end) {
+    uint8_t c = *p;
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (c < 0x20) {
+          appendJSONUnicodeEscape(out, c);
+        } else if (c < 0x80 || !asciiOnly) {
+          out += c;
+        } else {
+          int length = UTF8Sequence::getLengthNonASCII(c);
+          if (length == 0 || p + length > end) {
+            appendJSONUnicodeEscape(out, 0xFFFD);
+            break;
+          }
+          uint32_t code = UTF8Sequence::read(p, length);
+          if (code > 0xFFFF) {
+            code -= 0x10000;
+            appendJSONUnicodeEscape(out, 0xD800 + (code >> 10));
+            appendJSONUnicodeEscape(out, 0xDC00 + (code & 0x3FF));
+          } else {
+            appendJSONUnicodeEscape(out, code);
+          }
+          // UTF8Sequence::read() has already advanced `p`.
+          continue;
+        }
+        break;
+    }
+    p++;
+  }
+  out += '"';
+}
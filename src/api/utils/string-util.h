@@ -60,6 +60,12 @@ bool strStartsWith(const char* str, const char (&prefix)[N]) {
 
 std::vector<std::string> strSplit(const std::string& str, char delimiter);
 
+// Append `str` to `out` as a quoted JSON string. If `asciiOnly` is set,
+// non-ASCII characters are written as \uXXXX escapes.
+void strAppendJSONQuoted(std::string& out,
+                         const std::string& str,
+                         bool asciiOnly = false);
+
 class UTF8Sequence {
  public:
   static inline bool isASCII(uint16_t character) {
@@ -120,6 +120,12 @@ class EsScope {
     }
     return isolate_->GetCurrentContext()->get();
   }
+  virtual EscargotShim::ContextWrap* lwContext() {
+    if (context_) {
+      return context_;
+    }
+    return isolate_->GetCurrentContext();
+  }
 
   virtual ValueRef* asValue(const v8::Local<v8::Value>& value) {
     return CVAL(*value)->value();
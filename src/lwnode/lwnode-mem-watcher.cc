@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwnode-mem-watcher.h"
+#include <algorithm>
+#include <cmath>
+#include "api/arraybuffer-allocator.h"
+#include "api/utils/gc-util.h"
+#include "api/utils/smaps.h"
+
+using namespace EscargotShim;
+
+namespace LWNode {
+
+MemWatcher::MemWatcher(const Options& options,
+                       ArrayBufferAllocatorDecorator* arrayBuffers,
+                       Notifier notifier)
+    : options_(options),
+      arrayBuffers_(arrayBuffers),
+      notifier_(notifier),
+      samples_(std::min(std::max(options.capacity, static_cast<size_t>(1)),
+                        kMaxCapacity)) {
+  options_.maxIgnoreCount = std::max(options_.maxIgnoreCount,
+                                     static_cast<size_t>(2));
+  if (arrayBuffers_) {
+    arrayBuffers_->ref();
+  }
+  thread_ = std::thread(&MemWatcher::run, this);
+}
+
+MemWatcher::~MemWatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isStopped_ = true;
+  }
+  wakeup_.notify_one();
+  thread_.join();
+
+  if (arrayBuffers_) {
+    arrayBuffers_->deref();
+  }
+}
+
+void MemWatcher::takeSample(Sample* sample,
+                            ArrayBufferAllocatorDecorator* arrayBuffers) {
+  sample->time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::system_clock::now().time_since_epoch())
+                     .count();
+
+  // The safe variant takes the allocation lock, as this runs off the thread
+  // of the isolate.
+  GC_word heapSize = 0;
+  GC_word freeBytes = 0;
+  GC_word unmappedBytes = 0;
+  GC_word bytesSinceGC = 0;
+  GC_word totalBytes = 0;
+  GC_get_heap_usage_safe(
+      &heapSize, &freeBytes, &unmappedBytes, &bytesSinceGC, &totalBytes);
+  sample->heapSize = heapSize;
+  sample->unmappedBytes = unmappedBytes;
+  sample->bytesSinceGC = bytesSinceGC;
+
+  SmapsTotals totals;
+  sample->pssSwap =
+      readSmapsTotals(&totals) ? (totals.pss + totals.swap) * 1024 : 0;
+
+  sample->arrayBufferBytes =
+      arrayBuffers ? arrayBuffers->currentMemorySize() : 0;
+}
+
+void MemWatcher::setEvents(int events) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if ((events & kMax) == 0) {
+    hasTrend_ = false;
+    trendCount_ = 0;
+  }
+  events_ = events;
+  report_.events &= events;
+}
+
+MemWatcher::Report MemWatcher::takeReport() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Report report = report_;
+  if (auto current = latest(0)) {
+    report.current = *current;
+    auto last = latest(1);
+    report.last = last ? *last : *current;
+  }
+  report.max = max_;
+
+  report_ = Report();
+  isNotified_ = false;
+  return report;
+}
+
+void MemWatcher::getHistory(std::vector<Sample>* samples) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  samples->clear();
+  samples->reserve(count_);
+  for (size_t age = count_; age > 0; age--) {
+    samples->push_back(*latest(age - 1));
+  }
+}
+
+void MemWatcher::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto isStopped = [this] { return isStopped_; };
+
+  do {
+    lock.unlock();
+    Sample sample;
+    takeSample(&sample, arrayBuffers_);
+    lock.lock();
+
+    bool shouldNotify = false;
+    record(sample, &shouldNotify);
+    if (shouldNotify) {
+      lock.unlock();
+      notifier_();
+      lock.lock();
+    }
+  } while (!wakeup_.wait_for(lock, options_.interval, isStopped));
+}
+
+void MemWatcher::record(const Sample& sample, bool* shouldNotify) {
+  samples_[next_] = sample;
+  next_ = (next_ + 1) % samples_.size();
+  count_ = std::min(count_ + 1, samples_.size());
+
+  max_.time = sample.time;
+  max_.heapSize = std::max(max_.heapSize, sample.heapSize);
+  max_.unmappedBytes = std::max(max_.unmappedBytes, sample.unmappedBytes);
+  max_.bytesSinceGC = std::max(max_.bytesSinceGC, sample.bytesSinceGC);
+  max_.pssSwap = std::max(max_.pssSwap, sample.pssSwap);
+  max_.arrayBufferBytes =
+      std::max(max_.arrayBufferBytes, sample.arrayBufferBytes);
+
+  int events = kStats;
+  if ((events_ & kMax) && updateTrend(sample)) {
+    events |= kMax;
+  }
+  if (options_.limit > 0 && metricOf(sample) > options_.limit) {
+    events |= kLimit;
+  }
+
+  report_.events |= events & events_;
+  *shouldNotify = report_.events != 0 && !isNotified_;
+  if (*shouldNotify) {
+    isNotified_ = true;
+  }
+}
+
+bool MemWatcher::updateTrend(const Sample& sample) {
+  size_t value = metricOf(max_);
+
+  if (!hasTrend_) {
+    hasTrend_ = true;
+    trendCount_ = 0;
+    trendBase_ = trendLast_ = value;
+    trendBaseTime_ = sample.time;
+    return false;
+  }
+
+  if (value <= trendLast_) {
+    return false;
+  }
+  trendLast_ = value;
+
+  if (++trendCount_ < options_.maxIgnoreCount) {
+    return false;
+  }
+
+  report_.growth = value - trendBase_;
+  report_.growthCount = trendCount_;
+  report_.elapsed = std::round((sample.time - trendBaseTime_) / 1000);
+
+  trendCount_ = 0;
+  trendBase_ = value;
+  trendBaseTime_ = sample.time;
+  return true;
+}
+
+size_t MemWatcher::metricOf(const Sample& sample) const {
+  return options_.metric == Metric::Heap ? sample.heapSize : sample.pssSwap;
+}
+
+const MemWatcher::Sample* MemWatcher::latest(size_t age) const {
+  if (age >= count_) {
+    return nullptr;
+  }
+  return &samples_[(next_ + samples_.size() - 1 - age) % samples_.size()];
+}
+
+}  // namespace LWNode
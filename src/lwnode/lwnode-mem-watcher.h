@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EscargotShim {
+class ArrayBufferAllocatorDecorator;
+}
+
+namespace LWNode {
+
+/*
+  MemWatcher samples the memory usage of an isolate on a thread of its own.
+
+  The latest samples are kept in a ring buffer of a fixed capacity. The
+  running max of each field, the growth of the watched metric and its limit
+  are checked on the sampling thread as well. The notifier is called only
+  when an event asked for with setEvents() occurs, so the JavaScript thread
+  isn't woken every interval unless it asks for every sample with kStats.
+*/
+class MemWatcher {
+ public:
+  // Sizes are in bytes.
+  struct Sample {
+    double time = 0;  // msec since the epoch
+    size_t heapSize = 0;
+    size_t unmappedBytes = 0;
+    size_t bytesSinceGC = 0;
+    size_t pssSwap = 0;
+    size_t arrayBufferBytes = 0;
+  };
+
+  enum Event {
+    kStats = 1 << 0,
+    kMax = 1 << 1,
+    kLimit = 1 << 2,
+  };
+
+  enum class Metric { Heap, PssSwap };
+
+  // A day of samples taken every second
+  static constexpr size_t kMaxCapacity = 24 * 60 * 60;
+
+  struct Options {
+    std::chrono::milliseconds interval{5000};
+    size_t capacity = 60;
+    Metric metric = Metric::PssSwap;
+    // kMax occurs once the max of the metric has grown this many times.
+    size_t maxIgnoreCount = 2;
+    // kLimit occurs on every sample whose metric exceeds the limit, if any.
+    size_t limit = 0;
+  };
+
+  // What happened since the last takeReport()
+  struct Report {
+    int events = 0;
+    Sample current;
+    Sample last;
+    Sample max;
+    // kMax
+    size_t growth = 0;
+    size_t growthCount = 0;
+    double elapsed = 0;  // sec
+  };
+
+  // Called on the sampling thread when an event becomes pending, and not
+  // again until takeReport() is called.
+  typedef std::function<void()> Notifier;
+
+  MemWatcher(const Options& options,
+             EscargotShim::ArrayBufferAllocatorDecorator* arrayBuffers,
+             Notifier notifier);
+  ~MemWatcher();
+
+  static void takeSample(
+      Sample* sample,
+      EscargotShim::ArrayBufferAllocatorDecorator* arrayBuffers);
+
+  // Other events are still tracked, but never reported.
+  void setEvents(int events);
+  Report takeReport();
+
+  // From the oldest sample to the latest one
+  void getHistory(std::vector<Sample>* samples);
+
+ private:
+  void run();
+  void record(const Sample& sample, bool* shouldNotify);
+  bool updateTrend(const Sample& sample);
+  size_t metricOf(const Sample& sample) const;
+  const Sample* latest(size_t age) const;
+
+  Options options_;
+  EscargotShim::ArrayBufferAllocatorDecorator* arrayBuffers_ = nullptr;
+  Notifier notifier_;
+
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  bool isStopped_ = false;
+
+  // The ring buffer
+  std::vector<Sample> samples_;
+  size_t next_ = 0;
+  size_t count_ = 0;
+  Sample max_;
+
+  // The growths of the max since the trend was last reported
+  size_t trendCount_ = 0;
+  size_t trendBase_ = 0;
+  double trendBaseTime_ = 0;
+  size_t trendLast_ = 0;
+  bool hasTrend_ = false;
+
+  int events_ = 0;
+  Report report_;
+  bool isNotified_ = false;
+
+  std::thread thread_;
+};
+
+}  // namespace LWNode
@@ -17,17 +17,26 @@
 #include "lwnode/lwnode.h"
 #include <EscargotPublic.h>
 #include <malloc.h>  // for malloc_trim
+#include <cmath>
 #include <codecvt>
 #include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "api.h"
+#include "api/arraybuffer-pool.h"
 #include "api/context.h"
 #include "api/es-helper.h"
+#include "api/global.h"
 #include "api/isolate.h"
+#include "api/microtask-queue.h"
 #include "api/utils/misc.h"
 #include "api/utils/smaps.h"
 #include "base.h"
+#include "init/v8.h"
 #include "lwnode/lwnode-gc-strategy.h"
 #include "lwnode/lwnode-loader.h"
+#include "lwnode/lwnode-mem-watcher.h"
 
 using namespace v8;
 using namespace EscargotShim;
@@ -67,6 +76,8 @@ static void SetMethod(ContextRef* context,
 }
 
 constexpr auto kSmapCacheDuration = 600ms;
+// Number.MAX_SAFE_INTEGER
+constexpr double kMaxSafeInteger = 9007199254740991.0;
 
 static std::vector<SmapContents>& getSelfSmaps() {
   static std::vector<SmapContents> s_cachedSmaps = parseSmaps("self");
@@ -83,6 +94,28 @@ static std::vector<SmapContents>& getSelfSmaps() {
   return s_cachedSmaps;
 }
 
+// With --smaps-sampler, the totals are refreshed on a thread of their own.
+static SmapsTotals getSelfSmapsTotals() {
+  static bool s_useSampler = Global::flags()->isOn(Flag::Type::SmapsSampler);
+  if (s_useSampler) {
+    static SmapsSampler s_sampler(kSmapCacheDuration);
+    return s_sampler.totals();
+  }
+
+  static SmapsTotals s_cachedTotals;
+  static auto s_lastUpdatedTime = std::chrono::steady_clock::time_point();
+  static bool s_isCached = false;
+
+  auto now = std::chrono::steady_clock::now();
+  if (s_isCached && now - s_lastUpdatedTime < kSmapCacheDuration) {
+    return s_cachedTotals;
+  }
+
+  s_isCached = readSmapsTotals(&s_cachedTotals);
+  s_lastUpdatedTime = now;
+  return s_cachedTotals;
+}
+
 static std::string createDumpFilePath() {
   std::string appName;
   std::ifstream("/proc/self/comm") >> appName;
@@ -101,9 +134,8 @@ static ValueRef* PssUsage(ExecutionStateRef* state,
                           size_t argc,
                           ValueRef** argv,
                           bool isConstructCall) {
-  auto& smaps = getSelfSmaps();
-  size_t total = calculateTotal(smaps, kPss);
-  return ValueRef::create(total);
+  auto totals = getSelfSmapsTotals();
+  return ValueRef::create(totals.pss);
 };
 
 static ValueRef* PssSwapUsage(ExecutionStateRef* state,
@@ -111,9 +143,8 @@ static ValueRef* PssSwapUsage(ExecutionStateRef* state,
                               size_t argc,
                               ValueRef** argv,
                               bool isConstructCall) {
-  auto& smaps = getSelfSmaps();
-  size_t total = calculateTotalPssSwap(smaps);
-  return ValueRef::create(total);
+  auto totals = getSelfSmapsTotals();
+  return ValueRef::create(totals.pss + totals.swap);
 };
 
 static ValueRef* RssUsage(ExecutionStateRef* state,
@@ -121,9 +152,8 @@ static ValueRef* RssUsage(ExecutionStateRef* state,
                           size_t argc,
                           ValueRef** argv,
                           bool isConstructCall) {
-  auto& smaps = getSelfSmaps();
-  size_t total = calculateTotalRss(smaps);
-  return ValueRef::create(total);
+  auto totals = getSelfSmapsTotals();
+  return ValueRef::create(totals.rss);
 };
 
 static ValueRef* MemSnapshot(ExecutionStateRef* state,
@@ -188,6 +218,379 @@ static ValueRef* getGCMemoryStats(ExecutionStateRef* state,
   return ValueRef::create(object);
 }
 
+static ValueRef* getMicrotaskStats(ExecutionStateRef* state,
+                                   ValueRef* thisValue,
+                                   size_t argc,
+                                   ValueRef** argv,
+                                   bool isConstructCall) {
+  auto context = state->context();
+  auto object = ObjectRefHelper::create(context);
+  auto queue = ContextWrap::fromEscargot(context)->microtaskQueue();
+
+  ObjectRefHelper::setProperty(
+      context,
+      object,
+      StringRef::createFromASCII("scopeDepth"),
+      ValueRef::create(queue->GetMicrotasksScopeDepth()))
+      .check();
+
+  ObjectRefHelper::setProperty(context,
+                               object,
+                               StringRef::createFromASCII("checkpoints"),
+                               ValueRef::create(queue->checkpointCount()))
+      .check();
+
+  ObjectRefHelper::setProperty(context,
+                               object,
+                               StringRef::createFromASCII("executed"),
+                               ValueRef::create(queue->executedCount()))
+      .check();
+
+  ObjectRefHelper::setProperty(context,
+                               object,
+                               StringRef::createFromASCII("pending"),
+                               ValueRef::create(queue->pendingCount()))
+      .check();
+
+  return ValueRef::create(object);
+}
+
+static ValueRef* getArrayBufferPoolStats(ExecutionStateRef* state,
+                                         ValueRef* thisValue,
+                                         size_t argc,
+                                         ValueRef** argv,
+                                         bool isConstructCall) {
+  auto context = state->context();
+  auto object = ObjectRefHelper::create(context);
+
+  ArrayBufferPool::Stats stats;
+  if (ArrayBufferPool::isEnabled()) {
+    stats = ArrayBufferPool::getInstance()->stats();
+  }
+
+  std::pair<const char*, size_t> properties[] = {
+      {"allocations", stats.allocations},
+      {"cacheHits", stats.cacheHits},
+      {"bytesInUse", stats.bytesInUse},
+      {"slabsMapped", stats.slabsMapped},
+      {"slabsUnmapped", stats.slabsUnmapped},
+      {"trims", stats.trims},
+  };
+
+  ObjectRefHelper::setProperty(context,
+                               object,
+                               StringRef::createFromASCII("enabled"),
+                               ValueRef::create(ArrayBufferPool::isEnabled()))
+      .check();
+
+  for (const auto& property : properties) {
+    ObjectRefHelper::setProperty(context,
+                                 object,
+                                 StringRef::createFromASCII(property.first),
+                                 ValueRef::create(property.second))
+        .check();
+  }
+
+  return ValueRef::create(object);
+}
+
+// MemWatcher
+
+struct MemWatcherEntry {
+  IsolateWrap* isolate = nullptr;
+  std::unique_ptr<MemWatcher> watcher;
+  PersistentRefHolder<ContextRef> context;
+  PersistentRefHolder<ObjectRef> callback;
+};
+
+static std::mutex s_memWatchersMutex;
+static std::unordered_map<size_t, std::unique_ptr<MemWatcherEntry>>
+    s_memWatchers;
+static size_t s_lastMemWatcherId = 0;
+
+static ObjectRef* createMemorySampleObject(ContextRef* context,
+                                           const MemWatcher::Sample& sample) {
+  auto object = ObjectRefHelper::create(context);
+
+  std::pair<const char*, ValueRef*> properties[] = {
+      {"time", ValueRef::create(sample.time)},
+      {"heapSize", ValueRef::create(sample.heapSize)},
+      {"unmappedBytes", ValueRef::create(sample.unmappedBytes)},
+      {"bytesSinceGC", ValueRef::create(sample.bytesSinceGC)},
+      {"pssSwap", ValueRef::create(sample.pssSwap)},
+      {"arrayBufferBytes", ValueRef::create(sample.arrayBufferBytes)},
+  };
+
+  for (const auto& property : properties) {
+    ObjectRefHelper::setProperty(context,
+                                 object,
+                                 StringRef::createFromASCII(property.first),
+                                 property.second)
+        .check();
+  }
+
+  return object;
+}
+
+static ObjectRef* createMemWatcherReportObject(
+    ContextRef* context, const MemWatcher::Report& report) {
+  auto object = ObjectRefHelper::create(context);
+
+  std::pair<const char*, ValueRef*> properties[] = {
+      {"events", ValueRef::create(report.events)},
+      {"current", createMemorySampleObject(context, report.current)},
+      {"last", createMemorySampleObject(context, report.last)},
+      {"max", createMemorySampleObject(context, report.max)},
+      {"growth", ValueRef::create(report.growth)},
+      {"growthCount", ValueRef::create(report.growthCount)},
+      {"elapsed", ValueRef::create(report.elapsed)},
+  };
+
+  for (const auto& property : properties) {
+    ObjectRefHelper::setProperty(context,
+                                 object,
+                                 StringRef::createFromASCII(property.first),
+                                 property.second)
+        .check();
+  }
+
+  return object;
+}
+
+// Runs on the thread of the isolate that started the watcher.
+static void deliverMemWatcherReport(size_t id) {
+  ContextRef* context = nullptr;
+  ObjectRef* callback = nullptr;
+  MemWatcher::Report report;
+
+  {
+    std::lock_guard<std::mutex> lock(s_memWatchersMutex);
+    auto it = s_memWatchers.find(id);
+    // The watcher may have been stopped since the task was posted.
+    if (it == s_memWatchers.end()) {
+      return;
+    }
+    context = it->second->context.get();
+    callback = it->second->callback.get();
+    report = it->second->watcher->takeReport();
+  }
+
+  if (report.events == 0) {
+    return;
+  }
+
+  auto lwContext = ContextWrap::fromEscargot(context);
+  auto r = Evaluator::execute(
+      context,
+      [](ExecutionStateRef* state,
+         ObjectRef* callback,
+         ObjectRef* report) -> ValueRef* {
+        ValueRef* argv[] = {report};
+        return callback->call(state, ValueRef::createUndefined(), 1, argv);
+      },
+      callback,
+      createMemWatcherReportObject(context, report));
+
+  if (!r.isSuccessful()) {
+    lwContext->GetIsolate()->handleException(std::move(r));
+    return;
+  }
+  lwContext->microtaskQueue()->onCallCompleted();
+}
+
+class MemWatcherTask : public v8::Task {
+ public:
+  explicit MemWatcherTask(size_t id) : id_(id) {}
+
+  void Run() override { deliverMemWatcherReport(id_); }
+
+ private:
+  size_t id_;
+};
+
+static double getNumberArgument(size_t argc,
+                                ValueRef** argv,
+                                size_t index,
+                                double defaultValue) {
+  if (index < argc && argv[index]->isNumber()) {
+    return argv[index]->asNumber();
+  }
+  return defaultValue;
+}
+
+// Returns false if the argument at |index| is given but isn't an integer
+// within [min, max]; |value| is left as is if the argument isn't given.
+template <typename T>
+static bool getIntegerArgument(size_t argc,
+                               ValueRef** argv,
+                               size_t index,
+                               double min,
+                               double max,
+                               T& value) {
+  if (index >= argc || argv[index]->isUndefined()) {
+    return true;
+  }
+  if (!argv[index]->isNumber()) {
+    return false;
+  }
+  double number = argv[index]->asNumber();
+  if (std::trunc(number) != number || number < min || number > max) {
+    return false;
+  }
+  value = static_cast<T>(number);
+  return true;
+}
+
+// startMemWatcher(callback, interval, capacity, usePss, maxIgnoreCount,
+//                 limit) returns the id of the watcher.
+static ValueRef* startMemWatcher(ExecutionStateRef* state,
+                                 ValueRef* thisValue,
+                                 size_t argc,
+                                 ValueRef** argv,
+                                 bool isConstructCall) {
+  if (argc <= 0 || !argv[0]->isFunctionObject()) {
+    return ValueRef::createUndefined();
+  }
+
+  // The arguments are validated by the JS API already; they are checked
+  // again as they size native buffers. An interval of 0 would never let the
+  // sampling thread sleep.
+  MemWatcher::Options options;
+  int64_t interval = options.interval.count();
+  if (!getIntegerArgument(argc, argv, 1, 1, kMaxSafeInteger, interval) ||
+      !getIntegerArgument(
+          argc, argv, 2, 1, MemWatcher::kMaxCapacity, options.capacity) ||
+      !getIntegerArgument(
+          argc, argv, 4, 0, kMaxSafeInteger, options.maxIgnoreCount) ||
+      !getIntegerArgument(argc, argv, 5, 0, kMaxSafeInteger, options.limit)) {
+    return ValueRef::createUndefined();
+  }
+  options.interval = std::chrono::milliseconds(interval);
+  options.metric = (argc > 3 && argv[3]->isFalse())
+                       ? MemWatcher::Metric::Heap
+                       : MemWatcher::Metric::PssSwap;
+
+  auto lwIsolate = ContextWrap::fromEscargot(state->context())->GetIsolate();
+  auto taskRunner = v8::internal::V8::GetCurrentPlatform()
+                        ->GetForegroundTaskRunner(lwIsolate->toV8());
+
+  std::lock_guard<std::mutex> lock(s_memWatchersMutex);
+  size_t id = ++s_lastMemWatcherId;
+
+  auto entry = std::make_unique<MemWatcherEntry>();
+  entry->isolate = lwIsolate;
+  entry->context.reset(state->context());
+  entry->callback.reset(argv[0]->asObject());
+  // @note a task posted after the isolate is disposed is discarded.
+  entry->watcher = std::make_unique<MemWatcher>(
+      options,
+      lwIsolate->array_buffer_allocator_decorator(),
+      [taskRunner, id]() {
+        taskRunner->PostTask(std::make_unique<MemWatcherTask>(id));
+      });
+
+  s_memWatchers.emplace(id, std::move(entry));
+  return ValueRef::create(id);
+}
+
+static MemWatcher* findMemWatcher(size_t argc, ValueRef** argv) {
+  if (argc <= 0 || !argv[0]->isNumber()) {
+    return nullptr;
+  }
+  auto it = s_memWatchers.find(static_cast<size_t>(argv[0]->asNumber()));
+  return it != s_memWatchers.end() ? it->second->watcher.get() : nullptr;
+}
+
+// setMemWatcherEvents(id, events)
+static ValueRef* setMemWatcherEvents(ExecutionStateRef* state,
+                                     ValueRef* thisValue,
+                                     size_t argc,
+                                     ValueRef** argv,
+                                     bool isConstructCall) {
+  std::lock_guard<std::mutex> lock(s_memWatchersMutex);
+  auto watcher = findMemWatcher(argc, argv);
+  if (watcher) {
+    watcher->setEvents(getNumberArgument(argc, argv, 1, 0));
+  }
+  return ValueRef::createUndefined();
+}
+
+// getMemWatcherHistory(id) returns the samples from the oldest one.
+static ValueRef* getMemWatcherHistory(ExecutionStateRef* state,
+                                      ValueRef* thisValue,
+                                      size_t argc,
+                                      ValueRef** argv,
+                                      bool isConstructCall) {
+  std::vector<MemWatcher::Sample> samples;
+  {
+    std::lock_guard<std::mutex> lock(s_memWatchersMutex);
+    auto watcher = findMemWatcher(argc, argv);
+    if (watcher) {
+      watcher->getHistory(&samples);
+    }
+  }
+
+  auto context = state->context();
+  auto elements = ValueVectorRef::create(samples.size());
+  for (size_t i = 0; i < samples.size(); i++) {
+    elements->set(i, createMemorySampleObject(context, samples[i]));
+  }
+  return ArrayObjectRefHelper::create(context, elements);
+}
+
+// stopMemWatcher(id)
+static ValueRef* stopMemWatcher(ExecutionStateRef* state,
+                                ValueRef* thisValue,
+                                size_t argc,
+                                ValueRef** argv,
+                                bool isConstructCall) {
+  std::unique_ptr<MemWatcherEntry> entry;
+  {
+    std::lock_guard<std::mutex> lock(s_memWatchersMutex);
+    if (argc > 0 && argv[0]->isNumber()) {
+      auto it = s_memWatchers.find(static_cast<size_t>(argv[0]->asNumber()));
+      if (it != s_memWatchers.end()) {
+        entry = std::move(it->second);
+        s_memWatchers.erase(it);
+      }
+    }
+  }
+  // Joins the sampling thread.
+  entry.reset();
+  return ValueRef::createUndefined();
+}
+
+void StopMemWatchers(v8::Isolate* isolate) {
+  auto lwIsolate = IsolateWrap::fromV8(isolate);
+  std::vector<std::unique_ptr<MemWatcherEntry>> entries;
+  {
+    std::lock_guard<std::mutex> lock(s_memWatchersMutex);
+    for (auto it = s_memWatchers.begin(); it != s_memWatchers.end();) {
+      if (it->second->isolate == lwIsolate) {
+        entries.push_back(std::move(it->second));
+        it = s_memWatchers.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  // Joins the sampling threads outside the lock, since they may be
+  // delivering reports of other isolates.
+  entries.clear();
+}
+
+static ValueRef* sampleMemory(ExecutionStateRef* state,
+                              ValueRef* thisValue,
+                              size_t argc,
+                              ValueRef** argv,
+                              bool isConstructCall) {
+  auto lwIsolate = ContextWrap::fromEscargot(state->context())->GetIsolate();
+  MemWatcher::Sample sample;
+  MemWatcher::takeSample(&sample,
+                         lwIsolate->array_buffer_allocator_decorator());
+  return createMemorySampleObject(state->context(), sample);
+}
+
 static ValueRef* checkIfHandledAsOneByteString(ExecutionStateRef* state,
                                                ValueRef* thisValue,
                                                size_t argc,
@@ -233,7 +636,16 @@ void InitializeProcessMethods(Local<Object> target, Local<Context> context) {
             CreateReloadableSourceFromFile);
 #endif
   SetMethod(esContext, esTarget, "getGCMemoryStats", getGCMemoryStats);
+  SetMethod(esContext, esTarget, "getMicrotaskStats", getMicrotaskStats);
+  SetMethod(
+      esContext, esTarget, "getArrayBufferPoolStats", getArrayBufferPoolStats);
   SetMethod(esContext, esTarget, "hasSystemInfo", hasSystemInfo);
+  SetMethod(esContext, esTarget, "sampleMemory", sampleMemory);
+  SetMethod(esContext, esTarget, "startMemWatcher", startMemWatcher);
+  SetMethod(esContext, esTarget, "setMemWatcherEvents", setMemWatcherEvents);
+  SetMethod(
+      esContext, esTarget, "getMemWatcherHistory", getMemWatcherHistory);
+  SetMethod(esContext, esTarget, "stopMemWatcher", stopMemWatcher);
 }
 
 void IdleGC(v8::Isolate* isolate) {
@@ -242,6 +654,9 @@ void IdleGC(v8::Isolate* isolate) {
     IsolateWrap::fromV8(isolate)->vmInstance()->enterIdleMode();
   }
   Escargot::Memory::gc();
+  if (ArrayBufferPool::isEnabled()) {
+    ArrayBufferPool::getInstance()->trim();
+  }
   malloc_trim(0);
 }
 
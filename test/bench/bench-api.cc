@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include "shim-bench.h"
+
+using v8::Local;
+
+static Local<v8::String> v8_str(v8::Isolate* isolate, const char* x) {
+  return v8::String::NewFromUtf8(isolate, x).ToLocalChecked();
+}
+
+static Local<v8::Value> CompileRun(Local<v8::Context> context,
+                                   const char* source) {
+  auto isolate = context->GetIsolate();
+  return v8::Script::Compile(context, v8_str(isolate, source))
+      .ToLocalChecked()
+      ->Run(context)
+      .ToLocalChecked();
+}
+
+// Handles
+
+BENCHMARK(LocalNew) {
+  auto isolate = state.isolate();
+  auto object = v8::Object::New(isolate);
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope scope(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      DoNotOptimize(Local<v8::Object>::New(isolate, object));
+    }
+  }
+}
+
+BENCHMARK(HandleScopePushPop) {
+  auto isolate = state.isolate();
+
+  for (size_t i = 0; i < state.iterations(); i++) {
+    v8::HandleScope scope(isolate);
+  }
+}
+
+BENCHMARK(EscapableHandleScope) {
+  auto isolate = state.isolate();
+  auto object = v8::Object::New(isolate);
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope outer(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      v8::EscapableHandleScope scope(isolate);
+      DoNotOptimize(scope.Escape(Local<v8::Object>::New(isolate, object)));
+    }
+  }
+}
+
+BENCHMARK(GlobalCreateDestroy) {
+  auto isolate = state.isolate();
+  auto object = v8::Object::New(isolate);
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i++) {
+    v8::Global<v8::Object> global(isolate, object);
+    global.Reset();
+  }
+}
+
+BENCHMARK(WeakCreateDestroy) {
+  auto isolate = state.isolate();
+  auto object = v8::Object::New(isolate);
+  int parameter = 0;
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i++) {
+    v8::Global<v8::Object> global(isolate, object);
+    global.SetWeak(
+        &parameter,
+        [](const v8::WeakCallbackInfo<int>& info) {},
+        v8::WeakCallbackType::kParameter);
+    global.Reset();
+  }
+}
+
+// Functions
+
+static void NoOpCallback(const v8::FunctionCallbackInfo<v8::Value>& info) {}
+
+static void ReturnArgumentCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  info.GetReturnValue().Set(info[0]);
+}
+
+BENCHMARK(FunctionTemplateCall) {
+  auto isolate = state.isolate();
+  auto context = state.context();
+  auto function = v8::FunctionTemplate::New(isolate, NoOpCallback)
+                      ->GetFunction(context)
+                      .ToLocalChecked();
+  auto receiver = context->Global();
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope scope(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      DoNotOptimize(function->Call(context, receiver, 0, nullptr));
+    }
+  }
+}
+
+BENCHMARK(FunctionTemplateCallFromJS) {
+  auto isolate = state.isolate();
+  auto context = state.context();
+  auto function = v8::FunctionTemplate::New(isolate, ReturnArgumentCallback)
+                      ->GetFunction(context)
+                      .ToLocalChecked();
+  auto loop = CompileRun(context,
+                         "(function(f, n) {"
+                         "  for (let i = 0; i < n; i++) f(i);"
+                         "})")
+                  .As<v8::Function>();
+  Local<v8::Value> argv[] = {
+      function, v8::Number::New(isolate, state.iterations())};
+
+  state.startTiming();
+  DoNotOptimize(loop->Call(context, context->Global(), 2, argv));
+}
+
+// Objects
+
+BENCHMARK(ObjectSet) {
+  auto isolate = state.isolate();
+  auto context = state.context();
+  auto object = v8::Object::New(isolate);
+  auto key = v8_str(isolate, "key");
+  auto value = v8::Integer::New(isolate, 42);
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i++) {
+    DoNotOptimize(object->Set(context, key, value));
+  }
+}
+
+BENCHMARK(ObjectGet) {
+  auto isolate = state.isolate();
+  auto context = state.context();
+  auto object = v8::Object::New(isolate);
+  auto key = v8_str(isolate, "key");
+  object->Set(context, key, v8::Integer::New(isolate, 42)).Check();
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope scope(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      DoNotOptimize(object->Get(context, key));
+    }
+  }
+}
+
+BENCHMARK(ObjectGetIndexed) {
+  auto isolate = state.isolate();
+  auto context = state.context();
+  auto array = v8::Array::New(isolate, 16);
+  for (uint32_t i = 0; i < 16; i++) {
+    array->Set(context, i, v8::Integer::New(isolate, i)).Check();
+  }
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope scope(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      DoNotOptimize(array->Get(context, j & 15));
+    }
+  }
+}
+
+// Runs |function| on |state| from a native callback, where operations on
+// ordinary objects may skip the sandbox.
+static void RunInCallback(BenchState& state, void (*function)(BenchState&)) {
+  struct Data {
+    BenchState* state;
+    void (*function)(BenchState&);
+  } data = {&state, function};
+
+  auto isolate = state.isolate();
+  auto context = state.context();
+  auto callback = v8::FunctionTemplate::New(
+                      isolate,
+                      [](const v8::FunctionCallbackInfo<v8::Value>& info) {
+                        auto data = static_cast<Data*>(
+                            info.Data().As<v8::External>()->Value());
+                        data->function(*data->state);
+                      },
+                      v8::External::New(isolate, &data))
+                      ->GetFunction(context)
+                      .ToLocalChecked();
+  DoNotOptimize(callback->Call(context, context->Global(), 0, nullptr));
+}
+
+BENCHMARK(ObjectSetInCallback) {
+  RunInCallback(state, BenchObjectSet);
+}
+
+BENCHMARK(ObjectGetInCallback) {
+  RunInCallback(state, BenchObjectGet);
+}
+
+// Symbols
+
+// Looks up names already in the registry, spread over more names than a
+// cache of recent lookups would hold.
+static void ForApi(BenchState& state, bool isPrivate) {
+  const int kNameCount = 1024;
+  auto isolate = state.isolate();
+  std::vector<v8::Global<v8::String>> names;
+  for (int i = 0; i < kNameCount; i++) {
+    v8::HandleScope scope(isolate);
+    auto name = v8_str(isolate, ("api-" + std::to_string(i)).c_str());
+    v8::Symbol::ForApi(isolate, name);
+    v8::Private::ForApi(isolate, name);
+    names.emplace_back(isolate, name);
+  }
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope scope(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      auto name = names[j % kNameCount].Get(isolate);
+      if (isPrivate) {
+        DoNotOptimize(v8::Private::ForApi(isolate, name));
+      } else {
+        DoNotOptimize(v8::Symbol::ForApi(isolate, name));
+      }
+    }
+  }
+}
+
+BENCHMARK(SymbolForApi) {
+  ForApi(state, false);
+}
+
+BENCHMARK(PrivateForApi) {
+  ForApi(state, true);
+}
+
+// Strings
+
+static const char kAsciiString[] = "The quick brown fox jumps over the dog";
+static const char kUtf8String[] = "\xed\x95\x9c\xea\xb8\x80 and caf\xc3\xa9";
+
+static void NewFromUtf8(BenchState& state, const char* data) {
+  auto isolate = state.isolate();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope scope(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      DoNotOptimize(v8::String::NewFromUtf8(isolate, data));
+    }
+  }
+}
+
+BENCHMARK(StringNewFromUtf8Ascii) {
+  NewFromUtf8(state, kAsciiString);
+}
+
+BENCHMARK(StringNewFromUtf8) {
+  NewFromUtf8(state, kUtf8String);
+}
+
+static void WriteUtf8(BenchState& state, const std::string& source) {
+  auto isolate = state.isolate();
+  auto string = v8_str(isolate, source.c_str());
+  std::string buffer(string->Utf8Length(isolate) + 1, '\0');
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i++) {
+    DoNotOptimize(string->WriteUtf8(isolate, &buffer[0], buffer.size()));
+  }
+}
+
+BENCHMARK(StringWriteUtf8Ascii) {
+  WriteUtf8(state, kAsciiString);
+}
+
+BENCHMARK(StringWriteUtf8) {
+  WriteUtf8(state, kUtf8String);
+}
+
+BENCHMARK(StringWriteUtf8Long) {
+  std::string source;
+  while (source.size() < 4096) {
+    source += kUtf8String;
+  }
+  WriteUtf8(state, source);
+}
+
+// ArrayBuffers
+
+BENCHMARK(ArrayBufferNew) {
+  auto isolate = state.isolate();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope scope(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      DoNotOptimize(v8::ArrayBuffer::New(isolate, 64));
+    }
+  }
+}
+
+BENCHMARK(ArrayBufferGetBackingStore) {
+  auto isolate = state.isolate();
+  auto buffer = v8::ArrayBuffer::New(isolate, 64);
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i++) {
+    auto backingStore = buffer->GetBackingStore();
+    DoNotOptimize(backingStore->Data());
+  }
+}
+
+// Exceptions
+
+BENCHMARK(TryCatchNoThrow) {
+  auto isolate = state.isolate();
+
+  for (size_t i = 0; i < state.iterations(); i++) {
+    v8::TryCatch tryCatch(isolate);
+    DoNotOptimize(tryCatch.HasCaught());
+  }
+}
+
+BENCHMARK(TryCatchThrow) {
+  auto isolate = state.isolate();
+  auto context = state.context();
+  auto thrower = CompileRun(context, "(function() { throw 1; })")
+                     .As<v8::Function>();
+
+  state.startTiming();
+  for (size_t i = 0; i < state.iterations(); i += kHandleBatch) {
+    v8::HandleScope scope(isolate);
+    for (size_t j = i; j < i + kHandleBatch && j < state.iterations(); j++) {
+      v8::TryCatch tryCatch(isolate);
+      DoNotOptimize(thrower->Call(context, context->Global(), 0, nullptr));
+      DoNotOptimize(tryCatch.Exception());
+    }
+  }
+}
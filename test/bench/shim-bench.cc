@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shim-bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "libplatform/libplatform.h"
+
+#ifndef LWNODE_REVISION
+#define LWNODE_REVISION "unknown"
+#endif
+
+std::vector<Benchmark>& Benchmark::all() {
+  static std::vector<Benchmark> s_benchmarks;
+  return s_benchmarks;
+}
+
+enum class OutputFormat { Text, Json, Csv };
+
+struct Options {
+  std::string filter;
+  OutputFormat format = OutputFormat::Text;
+  std::string outputPath;
+  double minTimeMs = 100;
+  size_t repeat = 5;
+};
+
+struct Result {
+  const char* name;
+  size_t iterations;
+  double medianNs;
+  double minNs;
+  double maxNs;
+};
+
+static inline bool startsWith(const std::string& string,
+                              const std::string& prefix) {
+  return (string.size() >= prefix.size()) &&
+         (string.compare(0, prefix.size(), prefix) == 0);
+}
+
+static void printUsage() {
+  printf(
+      "usage: shim_bench [options]\n"
+      "  -f=<filter>         run benchmarks whose name contains <filter>\n"
+      "  --format=text|json|csv\n"
+      "  --output=<path>     write the results to <path> (default: stdout)\n"
+      "  --min-time=<ms>     minimum time of a run (default: 100)\n"
+      "  --repeat=<n>        runs per benchmark (default: 5)\n"
+      "  --list              list the benchmarks\n");
+}
+
+// Returns the elapsed time of a run in nanoseconds.
+static double runOnce(v8::Isolate* isolate,
+                      v8::Local<v8::Context> context,
+                      const Benchmark& benchmark,
+                      size_t iterations) {
+  v8::HandleScope handleScope(isolate);
+  BenchState state(isolate, context, iterations);
+  benchmark.function(state);
+  auto end = BenchState::Clock::now();
+  return std::chrono::duration<double, std::nano>(end - state.start())
+      .count();
+}
+
+static Result run(v8::Isolate* isolate,
+                  v8::Local<v8::Context> context,
+                  const Benchmark& benchmark,
+                  const Options& options) {
+  const double minTimeNs = options.minTimeMs * 1e6;
+
+  // Find the number of iterations that takes at least minTime.
+  size_t iterations = 1;
+  while (true) {
+    double elapsed = runOnce(isolate, context, benchmark, iterations);
+    if (elapsed >= minTimeNs || iterations >= (1u << 30)) {
+      break;
+    }
+    double scale = elapsed > 0 ? minTimeNs / elapsed : 10;
+    iterations *= std::max(2.0, std::min(scale * 1.2, 10.0));
+  }
+
+  std::vector<double> samples;
+  for (size_t i = 0; i < options.repeat; i++) {
+    samples.push_back(runOnce(isolate, context, benchmark, iterations) /
+                      iterations);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  return {benchmark.name,
+          iterations,
+          samples[samples.size() / 2],
+          samples.front(),
+          samples.back()};
+}
+
+static void writeResults(FILE* out,
+                         const Options& options,
+                         const std::vector<Result>& results) {
+  switch (options.format) {
+    case OutputFormat::Text:
+      fprintf(out,
+              "%-32s %12s %12s %12s %12s\n",
+              "benchmark",
+              "iterations",
+              "ns/op",
+              "min ns/op",
+              "max ns/op");
+      for (const auto& r : results) {
+        fprintf(out,
+                "%-32s %12zu %12.2f %12.2f %12.2f\n",
+                r.name,
+                r.iterations,
+                r.medianNs,
+                r.minNs,
+                r.maxNs);
+      }
+      break;
+    case OutputFormat::Json:
+      fprintf(out,
+              "{\n  \"revision\": \"%s\",\n  \"repeat\": %zu,\n"
+              "  \"benchmarks\": [",
+              LWNODE_REVISION,
+              options.repeat);
+      for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        fprintf(out,
+                "%s\n    {\"name\": \"%s\", \"iterations\": %zu, "
+                "\"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, "
+                "\"max_ns_per_op\": %.3f}",
+                i ? "," : "",
+                r.name,
+                r.iterations,
+                r.medianNs,
+                r.minNs,
+                r.maxNs);
+      }
+      fprintf(out, "\n  ]\n}\n");
+      break;
+    case OutputFormat::Csv:
+      fprintf(out, "revision,benchmark,iterations,ns_per_op,min,max\n");
+      for (const auto& r : results) {
+        fprintf(out,
+                "%s,%s,%zu,%.3f,%.3f,%.3f\n",
+                LWNODE_REVISION,
+                r.name,
+                r.iterations,
+                r.medianNs,
+                r.minNs,
+                r.maxNs);
+      }
+      break;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  Options options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+
+    if (startsWith(arg, "-f=")) {
+      options.filter = arg.substr(strlen("-f="));
+    } else if (arg == "--format=text") {
+      options.format = OutputFormat::Text;
+    } else if (arg == "--format=json") {
+      options.format = OutputFormat::Json;
+    } else if (arg == "--format=csv") {
+      options.format = OutputFormat::Csv;
+    } else if (startsWith(arg, "--output=")) {
+      options.outputPath = arg.substr(strlen("--output="));
+    } else if (startsWith(arg, "--min-time=")) {
+      options.minTimeMs = atof(arg.c_str() + strlen("--min-time="));
+    } else if (startsWith(arg, "--repeat=")) {
+      options.repeat = std::max(atoi(arg.c_str() + strlen("--repeat=")), 1);
+    } else if (arg == "--list") {
+      for (const auto& benchmark : Benchmark::all()) {
+        printf("%s\n", benchmark.name);
+      }
+      return 0;
+    } else {
+      printf("unknown options: %s\n", argv[i]);
+      printUsage();
+      return 1;
+    }
+  }
+
+  std::unique_ptr<v8::Platform> platform = v8::platform::NewDefaultPlatform();
+  v8::V8::InitializePlatform(platform.get());
+  v8::V8::Initialize();
+
+  std::unique_ptr<v8::ArrayBuffer::Allocator> allocator(
+      v8::ArrayBuffer::Allocator::NewDefaultAllocator());
+  v8::Isolate::CreateParams createParams;
+  createParams.array_buffer_allocator = allocator.get();
+  v8::Isolate* isolate = v8::Isolate::New(createParams);
+
+  std::vector<Result> results;
+  {
+    v8::Isolate::Scope isolateScope(isolate);
+    v8::HandleScope handleScope(isolate);
+    v8::Local<v8::Context> context = v8::Context::New(isolate);
+    v8::Context::Scope contextScope(context);
+
+    for (const auto& benchmark : Benchmark::all()) {
+      if (std::string(benchmark.name).find(options.filter) ==
+          std::string::npos) {
+        continue;
+      }
+      results.push_back(run(isolate, context, benchmark, options));
+      if (options.format == OutputFormat::Text) {
+        fprintf(stderr, "%s done\n", benchmark.name);
+      }
+    }
+  }
+
+  isolate->Dispose();
+  v8::V8::Dispose();
+  v8::V8::ShutdownPlatform();
+
+  FILE* out = stdout;
+  if (!options.outputPath.empty()) {
+    out = fopen(options.outputPath.c_str(), "w");
+    if (!out) {
+      fprintf(stderr, "can't open %s\n", options.outputPath.c_str());
+      return 1;
+    }
+  }
+  writeResults(out, options, results);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
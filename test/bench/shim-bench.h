@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "v8.h"
+
+/*
+  Microbenchmarks of the V8 API as implemented by the shim.
+
+  A benchmark is a function that runs its operation state.iterations()
+  times. The runner raises the iteration count until one run takes long
+  enough to be measured, then reports the time per iteration of several
+  runs. Setup done before state.startTiming() isn't measured.
+
+    BENCHMARK(ObjectGet) {
+      auto object = v8::Object::New(state.isolate());
+      state.startTiming();
+      for (size_t i = 0; i < state.iterations(); i++) { ... }
+    }
+
+  Each run is made in a HandleScope of its own, but handles created per
+  iteration should go in a nested scope every kHandleBatch iterations.
+*/
+class BenchState {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  BenchState(v8::Isolate* isolate,
+             v8::Local<v8::Context> context,
+             size_t iterations)
+      : isolate_(isolate),
+        context_(context),
+        iterations_(iterations),
+        start_(Clock::now()) {}
+
+  v8::Isolate* isolate() const { return isolate_; }
+  v8::Local<v8::Context> context() const { return context_; }
+  size_t iterations() const { return iterations_; }
+
+  void startTiming() { start_ = Clock::now(); }
+  Clock::time_point start() const { return start_; }
+
+ private:
+  v8::Isolate* isolate_;
+  v8::Local<v8::Context> context_;
+  size_t iterations_;
+  Clock::time_point start_;
+};
+
+// The number of iterations between two nested HandleScopes
+constexpr size_t kHandleBatch = 1024;
+
+struct Benchmark {
+  typedef void (*Function)(BenchState& state);
+
+  const char* name;
+  Function function;
+
+  static std::vector<Benchmark>& all();
+};
+
+class BenchmarkRegistrar {
+ public:
+  BenchmarkRegistrar(const char* name, Benchmark::Function function) {
+    Benchmark::all().push_back({name, function});
+  }
+};
+
+#define BENCHMARK(Name)                                                        \
+  static void Bench##Name(BenchState& state);                                  \
+  static BenchmarkRegistrar s_benchRegistrar##Name(#Name, Bench##Name);        \
+  static void Bench##Name(BenchState& state)
+
+// Keeps the compiler from dropping a value computed by a benchmark.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
@@ -35,6 +35,8 @@
         'cctest/v14_test-serialize.cc',
         'cctest/test-api.cc',
         'cctest/test-internal.cc',
+        'cctest/test-microtask-queue.cc',
+        'cctest/test-profiler.cc',
         'cctest/test-strings.cc',
       ]
     },
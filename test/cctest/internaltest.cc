@@ -17,8 +17,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string>
 
 #include "cctest.h"
+#include "include/lwnode/lwnode.h"
 #include "include/v8.h"
 using namespace v8;
 
@@ -971,3 +973,4 @@ TEST(PrimitiveArray) {
   CHECK(array->Get(isolate, 3)->IsBoolean());
   CHECK(array->Get(isolate, 4)->IsNull());
 }
+
@@ -32,6 +32,7 @@
 #include <csignal>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <functional>
 
@@ -1368,6 +1369,33 @@ THREADED_PROFILED_TEST(SimpleCallback) {
 // }
 
 
+THREADED_TEST(FunctionTemplateGetFunctionPerContext) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  Local<v8::FunctionTemplate> templ = v8::FunctionTemplate::New(isolate);
+  {
+    v8::HandleScope inner(isolate);
+    Local<Function> fun = templ->GetFunction(env.local()).ToLocalChecked();
+    CHECK(fun->Set(env.local(), v8_str("tag"), v8_num(7)).FromJust());
+  }
+
+  // The function is kept by the context, even with no handle to it.
+  CcTest::CollectAllGarbage();
+  Local<Function> fun = templ->GetFunction(env.local()).ToLocalChecked();
+  CHECK(fun->StrictEquals(templ->GetFunction(env.local()).ToLocalChecked()));
+  CHECK_EQ(7, fun->Get(env.local(), v8_str("tag"))
+                  .ToLocalChecked()
+                  ->Int32Value(env.local())
+                  .FromJust());
+
+  Local<Context> other = Context::New(isolate);
+  Local<Function> otherFun = templ->GetFunction(other).ToLocalChecked();
+  CHECK(!fun->StrictEquals(otherFun));
+  CHECK(otherFun->StrictEquals(templ->GetFunction(other).ToLocalChecked()));
+}
+
 THREADED_TEST(FunctionTemplateSetLength) {
   LocalContext env;
   v8::Isolate* isolate = env->GetIsolate();
@@ -3571,6 +3599,128 @@ THREADED_TEST(PrivateProperties) {
            child->GetOwnPropertyNames(env.local()).ToLocalChecked()->Length());
 }
 
+THREADED_TEST(PrivatePropertiesOnPlainObject) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  const int kCount = 5;
+  v8::Local<v8::Object> obj = v8::Object::New(isolate);
+  v8::Local<v8::Private> privates[kCount];
+  for (int i = 0; i < kCount; i++) {
+    privates[i] = v8::Private::New(isolate);
+    auto value = v8::Integer::New(isolate, i);
+    CHECK(obj->SetPrivate(env.local(), privates[i], value).FromJust());
+  }
+
+  CcTest::CollectAllGarbage();
+
+  // Private values alone don't make the object look like a wrapper.
+  CHECK_EQ(0, obj->InternalFieldCount());
+  v8::Local<v8::FunctionTemplate> templ = v8::FunctionTemplate::New(isolate);
+  CHECK(!templ->HasInstance(obj));
+
+  CHECK(obj->DeletePrivate(env.local(), privates[0]).FromJust());
+  CHECK(obj->DeletePrivate(env.local(), privates[3]).FromJust());
+
+  for (int i = 0; i < kCount; i++) {
+    bool isDeleted = (i == 0 || i == 3);
+    CHECK_EQ(!isDeleted, obj->HasPrivate(env.local(), privates[i]).FromJust());
+    if (!isDeleted) {
+      CHECK_EQ(i, obj->GetPrivate(env.local(), privates[i])
+                      .ToLocalChecked()
+                      ->Int32Value(env.local())
+                      .FromJust());
+    }
+  }
+
+  CHECK(obj->SetPrivate(env.local(), privates[0], v8::Integer::New(isolate, 10))
+            .FromJust());
+  CHECK_EQ(10, obj->GetPrivate(env.local(), privates[0])
+                   .ToLocalChecked()
+                   ->Int32Value(env.local())
+                   .FromJust());
+  CHECK_EQ(0u,
+           obj->GetOwnPropertyNames(env.local()).ToLocalChecked()->Length());
+}
+
+static int32_t getInt32(v8::Local<v8::Context> context,
+                        v8::Local<v8::Object> obj,
+                        const char* key) {
+  return obj->Get(context, v8_str(key))
+      .ToLocalChecked()
+      ->Int32Value(context)
+      .FromJust();
+}
+
+static void GetSetInCallback(const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::Isolate* isolate = info.GetIsolate();
+  v8::Local<v8::Context> context = isolate->GetCurrentContext();
+  v8::Local<v8::Object> obj = info[0].As<v8::Object>();
+
+  // Own and inherited data properties
+  CHECK_EQ(1, getInt32(context, obj, "own"));
+  CHECK_EQ(2, getInt32(context, obj, "inherited"));
+  CHECK(obj->Get(context, v8_str("missing")).ToLocalChecked()->IsUndefined());
+
+  // An inherited getter runs, and what it throws is caught.
+  CHECK_EQ(3, getInt32(context, obj, "getter"));
+  {
+    v8::TryCatch tryCatch(isolate);
+    CHECK(obj->Get(context, v8_str("thrower")).IsEmpty());
+    CHECK(tryCatch.HasCaught());
+  }
+
+  // A JavaScript function calling back into the API in between
+  info[1].As<v8::Function>()
+      ->Call(context, context->Global(), 0, nullptr)
+      .ToLocalChecked();
+
+  CHECK(obj->Set(context, v8_str("own"), v8_num(10)).FromJust());
+  CHECK_EQ(10, getInt32(context, obj, "own"));
+  obj->Set(context, v8_str("readOnly"), v8_num(10)).FromJust();
+  CHECK_EQ(4, getInt32(context, obj, "readOnly"));
+  CHECK(obj->Set(context, v8_str("setter"), v8_num(10)).FromJust());
+  CHECK_EQ(10, getInt32(context, obj, "setterValue"));
+}
+
+static void GetInNestedCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {
+  v8::Local<v8::Context> context = info.GetIsolate()->GetCurrentContext();
+  CHECK_EQ(1, getInt32(context, info[0].As<v8::Object>(), "own"));
+}
+
+THREADED_TEST(ObjectGetSetInCallback) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  auto getSet = v8::FunctionTemplate::New(isolate, GetSetInCallback);
+  auto nested = v8::FunctionTemplate::New(isolate, GetInNestedCallback);
+  CHECK(env->Global()
+            ->Set(env.local(),
+                  v8_str("getSet"),
+                  getSet->GetFunction(env.local()).ToLocalChecked())
+            .FromJust());
+  CHECK(env->Global()
+            ->Set(env.local(),
+                  v8_str("nested"),
+                  nested->GetFunction(env.local()).ToLocalChecked())
+            .FromJust());
+
+  CompileRun(
+      "var proto = {"
+      "  inherited: 2,"
+      "  get getter() { return 3; },"
+      "  get thrower() { throw new Error(); },"
+      "  set setter(v) { this.setterValue = v; },"
+      "};"
+      "var obj = Object.create(proto);"
+      "obj.own = 1;"
+      "Object.defineProperty(obj, 'readOnly', { value: 4 });"
+      "getSet(obj, () => nested(obj));");
+  ExpectInt32("obj.own", 10);
+}
 
 THREADED_TEST(GlobalSymbols) {
   LocalContext env;
@@ -3669,6 +3819,43 @@ THREADED_TEST(GlobalPrivates) {
   // CHECK(!obj->Has(env.local(), intern).FromJust());
 }
 
+THREADED_TEST(ApiSymbolRegistry) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  const int kSymbolCount = 5000;
+  auto name = [](int i) {
+    return v8_str(("api-" + std::to_string(i)).c_str());
+  };
+
+  for (int i = 0; i < kSymbolCount; i++) {
+    v8::HandleScope inner(isolate);
+    v8::Symbol::ForApi(isolate, name(i));
+    v8::Private::ForApi(isolate, name(i));
+  }
+
+  for (int i = 0; i < kSymbolCount; i++) {
+    v8::HandleScope inner(isolate);
+    auto symbol = v8::Symbol::ForApi(isolate, name(i));
+    CHECK(symbol->StrictEquals(v8::Symbol::ForApi(isolate, name(i))));
+    CHECK(symbol->Description()->StrictEquals(name(i)));
+    auto priv = v8::Private::ForApi(isolate, name(i));
+    CHECK(priv->Name()->StrictEquals(name(i)));
+  }
+
+  // A symbol and a private with the same name are different
+  auto obj = v8::Object::New(isolate);
+  CHECK(obj->SetPrivate(env.local(),
+                        v8::Private::ForApi(isolate, name(0)),
+                        v8::Integer::New(isolate, 1))
+            .FromJust());
+  CHECK(!obj->Has(env.local(), v8::Symbol::ForApi(isolate, name(0)))
+             .FromJust());
+  CHECK(obj->HasPrivate(env.local(), v8::Private::ForApi(isolate, name(0)))
+            .FromJust());
+}
+
 THREADED_TEST(HiddenProperties) {
   LocalContext env;
   v8::Isolate* isolate = env->GetIsolate();
@@ -15035,6 +15222,42 @@ TEST(DefineOwnProperty) {
   // }
 }
 
+TEST(ObjectDefineOwnProperties) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  v8::Local<v8::Name> keys[] = {
+      v8_str("a"), v8_str("b"), v8::Symbol::New(isolate, v8_str("c"))};
+  v8::Local<v8::Value> values[] = {v8::Integer::New(isolate, 1),
+                                   v8_str("two"),
+                                   v8::Integer::New(isolate, 3)};
+  v8::PropertyAttribute attributes[] = {
+      v8::None, v8::ReadOnly, v8::DontEnum};
+
+  auto obj = v8::Object::New(isolate);
+  CHECK(obj->DefineOwnProperties(env.local(), 3, keys, values, attributes)
+            .FromJust());
+  CHECK(env->Global()->Set(env.local(), v8_str("obj"), obj).FromJust());
+
+  CHECK_EQ(1, CompileRun("obj.a")->Int32Value(env.local()).FromJust());
+  CHECK(CompileRun("obj.b = 2; obj.b === 'two'")->BooleanValue(isolate));
+  CHECK(CompileRun("Object.keys(obj).join() === 'a,b'")
+            ->BooleanValue(isolate));
+  for (int i = 0; i < 3; i++) {
+    CHECK(obj->Get(env.local(), keys[i])
+              .ToLocalChecked()
+              ->StrictEquals(values[i]));
+  }
+
+  // Definitions stop at the first failure
+  CompileRun("Object.defineProperty(obj, 'd', { value: 0 })");
+  v8::Local<v8::Name> moreKeys[] = {v8_str("d"), v8_str("e")};
+  CHECK(!obj->DefineOwnProperties(env.local(), 2, moreKeys, values)
+             .FromJust());
+  CHECK(!obj->HasOwnProperty(env.local(), v8_str("e")).FromJust());
+}
+
 TEST(DefineProperty) {
   LocalContext env;
   v8::Isolate* isolate = env->GetIsolate();
@@ -18278,6 +18501,128 @@ TEST(IsolateNewDispose) {
 }
 
 
+// Checks that data is freed with the length it was allocated with, and that
+// the allocator isn't deleted before all of its data is freed.
+class TrackingArrayBufferAllocator : public v8::ArrayBuffer::Allocator {
+ public:
+  ~TrackingArrayBufferAllocator() override { CHECK(live_.empty()); }
+
+  void* Allocate(size_t length) override {
+    return track(calloc(length, 1), length);
+  }
+  void* AllocateUninitialized(size_t length) override {
+    return track(malloc(length), length);
+  }
+  void Free(void* data, size_t length) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = live_.find(data);
+      CHECK(it != live_.end());
+      CHECK_EQ(it->second, length);
+      live_.erase(it);
+    }
+    free(data);
+  }
+
+ private:
+  void* track(void* data, size_t length) {
+    if (data) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      live_[data] = length;
+    }
+    return data;
+  }
+
+  std::mutex mutex_;
+  std::map<void*, size_t> live_;
+};
+
+TEST(IsolateDisposeKeepsSharedAllocator) {
+  auto allocator = std::make_shared<TrackingArrayBufferAllocator>();
+  std::weak_ptr<TrackingArrayBufferAllocator> weakAllocator = allocator;
+
+  v8::Isolate::CreateParams create_params;
+  create_params.array_buffer_allocator_shared = std::move(allocator);
+  v8::Isolate* isolate = v8::Isolate::New(create_params);
+  create_params.array_buffer_allocator_shared.reset();
+  {
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::HandleScope handle_scope(isolate);
+    v8::Local<v8::Context> context = v8::Context::New(isolate);
+    v8::Context::Scope context_scope(context);
+
+    // Sizes below, in and above the range of --arraybuffer-pool
+    CompileRun(
+        "var buffers = [new ArrayBuffer(16), new ArrayBuffer(4096),"
+        "               new ArrayBuffer(100000)];"
+        "buffers[0] = buffers[0].slice(4);");
+  }
+  // The isolate keeps the allocator alive for as long as it lives.
+  CHECK(!weakAllocator.expired());
+  isolate->Dispose();
+  // The allocator is deleted only after the data of the isolate was freed,
+  // which its destructor checks.
+}
+
+TEST(ArrayBufferExternalMemory) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  v8::HeapStatistics before;
+  isolate->GetHeapStatistics(&before);
+
+  const size_t kLength = 1024 * 1024;
+  auto arrayBuffer = v8::ArrayBuffer::New(isolate, kLength);
+  CHECK_EQ(arrayBuffer->ByteLength(), kLength);
+
+  v8::HeapStatistics after;
+  isolate->GetHeapStatistics(&after);
+  CHECK_GE(after.external_memory(), before.external_memory() + kLength);
+}
+
+TEST(ArrayBufferExternalMemoryPerIsolate) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  // The other isolate may free its data after Dispose(), so it holds its
+  // allocator for as long as it needs it.
+  v8::Isolate::CreateParams create_params;
+  create_params.array_buffer_allocator_shared =
+      std::make_shared<TrackingArrayBufferAllocator>();
+  v8::Isolate* other = v8::Isolate::New(create_params);
+  create_params.array_buffer_allocator_shared.reset();
+
+  v8::HeapStatistics before;
+  isolate->GetHeapStatistics(&before);
+
+  const size_t kLength = 1024 * 1024;
+  {
+    v8::Isolate::Scope isolate_scope(other);
+    v8::HandleScope handle_scope(other);
+    v8::Local<v8::Context> context = v8::Context::New(other);
+    v8::Context::Scope context_scope(context);
+
+    v8::HeapStatistics otherBefore;
+    other->GetHeapStatistics(&otherBefore);
+    auto arrayBuffer = v8::ArrayBuffer::New(other, kLength);
+    CHECK_EQ(arrayBuffer->ByteLength(), kLength);
+
+    v8::HeapStatistics otherAfter;
+    other->GetHeapStatistics(&otherAfter);
+    CHECK_GE(otherAfter.external_memory(),
+             otherBefore.external_memory() + kLength);
+  }
+
+  // The buffer of the other isolate isn't accounted for by this one.
+  v8::HeapStatistics after;
+  isolate->GetHeapStatistics(&after);
+  CHECK_LT(after.external_memory(), before.external_memory() + kLength);
+
+  other->Dispose();
+}
+
 // UNINITIALIZED_TEST(DisposeIsolateWhenInUse) {
 //   v8::Isolate::CreateParams create_params;
 //   create_params.array_buffer_allocator = CcTest::array_buffer_allocator();
@@ -19311,6 +19656,41 @@ TEST(IndexedInterceptorWithStringProto) {
 }
 
 
+static int s_interceptedGetterCount = 0;
+static void CountingNamedGetter(Local<Name> name,
+                                const v8::PropertyCallbackInfo<Value>& info) {
+  s_interceptedGetterCount++;
+  info.GetReturnValue().Set(v8_num(42));
+}
+
+TEST(NamedPropertyHandlerOnlyInterceptStrings) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  Local<ObjectTemplate> templ = ObjectTemplate::New(isolate);
+  templ->SetHandler(v8::NamedPropertyHandlerConfiguration(
+      CountingNamedGetter,
+      nullptr,
+      nullptr,
+      nullptr,
+      nullptr,
+      Local<Value>(),
+      v8::PropertyHandlerFlags::kOnlyInterceptStrings));
+
+  Local<Object> obj = templ->NewInstance(env.local()).ToLocalChecked();
+  CHECK(env->Global()->Set(env.local(), v8_str("obj"), obj).FromJust());
+
+  s_interceptedGetterCount = 0;
+  ExpectInt32("obj.anything", 42);
+  CHECK_EQ(s_interceptedGetterCount, 1);
+
+  CompileRun("var sym = Symbol(); obj[sym] = 2;");
+  ExpectInt32("obj[sym]", 2);
+  CHECK_EQ(s_interceptedGetterCount, 1);
+}
+
+
 // void CheckCodeGenerationAllowed() {
 //   Local<v8::Context> context = CcTest::isolate()->GetCurrentContext();
 //   Local<Value> result = CompileRun("eval('42')");
@@ -19,6 +19,7 @@
 #include "cctest.h"
 
 #include <EscargotPublic.h>
+#include "api/arraybuffer-pool.h"
 #include "api/context.h"
 #include "api/handlescope.h"
 #include "api/isolate.h"
@@ -27,9 +28,12 @@
 #include <codecvt>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include "api/error-message.h"
 #include "api/es-helper.h"
 #include "api/utils/gc-container.h"
+#include "init/v8.h"
 #include "lwnode-loader.h"
 #include "lwnode.h"
 
@@ -1160,4 +1164,200 @@ TEST(InternalErrorMessage) {
               .FromJust());
   }
 }
+
+static void FunctionNewNotCachedCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {}
+
+TEST(FunctionNewNotCached) {
+  LocalContext context;
+  auto isolate = context->GetIsolate();
+  v8::HandleScope scope(isolate);
+  auto lwContext = ContextWrap::fromV8(*context.local());
+
+  auto templ =
+      v8::FunctionTemplate::New(isolate, FunctionNewNotCachedCallback);
+  templ->GetFunction(context.local()).ToLocalChecked();
+  size_t cacheSize = lwContext->functionCacheSize();
+
+  // Each call makes a template of its own, which is never used again.
+  for (int i = 0; i < 1000; i++) {
+    v8::HandleScope loopScope(isolate);
+    auto function =
+        v8::Function::New(context.local(), FunctionNewNotCachedCallback)
+            .ToLocalChecked();
+    CHECK(function->Call(context.local(), context->Global(), 0, nullptr)
+              .ToLocalChecked()
+              ->IsUndefined());
+  }
+  CHECK_EQ(cacheSize, lwContext->functionCacheSize());
+
+  // Templates made by the embedder are still cached.
+  CHECK(templ->GetFunction(context.local())
+            .ToLocalChecked()
+            ->StrictEquals(templ->GetFunction(context.local())
+                               .ToLocalChecked()));
+  CHECK_EQ(cacheSize, lwContext->functionCacheSize());
+}
+
+TEST(ArrayBufferPoolSlabs) {
+  // The pool is off in cctest, so only this test uses it. A thread of its
+  // own starts with an empty cache and flushes it on exit.
+  auto pool = ArrayBufferPool::getInstance();
+  auto before = pool->stats();
+
+  const size_t kLength = ArrayBufferPool::kMaxSize;
+  // A 1MB slab has a 4KB header, which leaves room for 15 blocks of 64KB.
+  const size_t kBlocksPerSlab = 15;
+
+  std::thread thread([&] {
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < 2 * kBlocksPerSlab + 1; i++) {
+      blocks.push_back(pool->allocate(kLength, true));
+      CHECK_NOT_NULL(blocks.back());
+    }
+    CHECK_EQ(3u, pool->stats().slabsMapped - before.slabsMapped);
+
+    // Freed blocks are reused before another slab is mapped.
+    for (size_t i = 0; i < kBlocksPerSlab; i++) {
+      pool->free(blocks.back());
+      blocks.pop_back();
+    }
+    for (size_t i = 0; i < kBlocksPerSlab; i++) {
+      blocks.push_back(pool->allocate(kLength, true));
+    }
+    CHECK_EQ(3u, pool->stats().slabsMapped - before.slabsMapped);
+    CHECK_EQ(0u, pool->stats().slabsUnmapped - before.slabsUnmapped);
+
+    for (auto block : blocks) {
+      pool->free(block);
+    }
+  });
+  thread.join();
+
+  // Two empty slabs are kept per class until they are trimmed.
+  auto after = pool->stats();
+  CHECK_EQ(1u, after.slabsUnmapped - before.slabsUnmapped);
+  CHECK_EQ(0u, after.bytesInUse - before.bytesInUse);
+
+  pool->trim();
+  after = pool->stats();
+  CHECK_EQ(3u, after.slabsUnmapped - before.slabsUnmapped);
+  CHECK_EQ(2 * kBlocksPerSlab + 1 + kBlocksPerSlab,
+           after.allocations - before.allocations);
+}
+// Runs foreground tasks only when asked to, so that a test can drive them.
+class TaskQueuePlatform : public v8::Platform {
+ public:
+  class QueueTaskRunner : public v8::TaskRunner {
+   public:
+    void PostTask(std::unique_ptr<v8::Task> task) override {
+      tasks_.push_back(std::move(task));
+    }
+    void PostDelayedTask(std::unique_ptr<v8::Task> task,
+                         double delay_in_seconds) override {
+      tasks_.push_back(std::move(task));
+    }
+    void PostIdleTask(std::unique_ptr<v8::IdleTask> task) override {}
+    bool IdleTasksEnabled() override { return false; }
+
+    bool runTask() {
+      if (tasks_.empty()) {
+        return false;
+      }
+      auto task = std::move(tasks_.front());
+      tasks_.erase(tasks_.begin());
+      task->Run();
+      return true;
+    }
+
+   private:
+    std::vector<std::unique_ptr<v8::Task>> tasks_;
+  };
+
+  TaskQueuePlatform() : taskRunner_(std::make_shared<QueueTaskRunner>()) {}
+
+  int NumberOfWorkerThreads() override { return 0; }
+  std::shared_ptr<v8::TaskRunner> GetForegroundTaskRunner(
+      v8::Isolate* isolate) override {
+    return taskRunner_;
+  }
+  void CallOnWorkerThread(std::unique_ptr<v8::Task> task) override {}
+  void CallDelayedOnWorkerThread(std::unique_ptr<v8::Task> task,
+                                 double delay_in_seconds) override {}
+  double MonotonicallyIncreasingTime() override { return 0; }
+  double CurrentClockTimeMillis() override { return 0; }
+  v8::TracingController* GetTracingController() override {
+    return &tracingController_;
+  }
+
+  bool runTask() { return taskRunner_->runTask(); }
+
+ private:
+  std::shared_ptr<QueueTaskRunner> taskRunner_;
+  v8::TracingController tracingController_;
+};
+
+class RecordingMeasureMemoryDelegate : public v8::MeasureMemoryDelegate {
+ public:
+  bool ShouldMeasure(v8::Local<v8::Context> context) override { return true; }
+
+  void MeasurementComplete(
+      const std::vector<std::pair<v8::Local<v8::Context>, size_t>>&
+          contextSizes,
+      size_t unattributedSize) override {
+    for (const auto& contextAndSize : contextSizes) {
+      sizes->emplace_back(ContextWrap::fromV8(*contextAndSize.first),
+                          contextAndSize.second);
+    }
+    *completed = true;
+  }
+
+  std::vector<std::pair<ContextWrap*, size_t>>* sizes = nullptr;
+  bool* completed = nullptr;
+};
+
+TEST(MeasureMemory) {
+  // cctest runs without a platform, which a measurement posts its steps to.
+  TaskQueuePlatform platform;
+  v8::internal::V8::InitializePlatform(&platform);
+
+  {
+    LocalContext context;
+    auto isolate = context->GetIsolate();
+    v8::HandleScope scope(isolate);
+    auto other = v8::Context::New(isolate);
+
+    CompileRun(
+        "var list = [];"
+        "for (var i = 0; i < 10000; i++) { list.push({ value: i }); }");
+
+    std::vector<std::pair<ContextWrap*, size_t>> sizes;
+    bool completed = false;
+    auto delegate = std::make_unique<RecordingMeasureMemoryDelegate>();
+    delegate->sizes = &sizes;
+    delegate->completed = &completed;
+    CHECK(isolate->MeasureMemory(std::move(delegate),
+                                 v8::MeasureMemoryExecution::kEager));
+
+    // The walk takes more than one step, and reports once it's done.
+    CHECK(!completed);
+    while (platform.runTask()) {
+    }
+    CHECK(completed);
+
+    size_t measuredSize = 0;
+    size_t otherSize = 0;
+    for (const auto& contextAndSize : sizes) {
+      if (contextAndSize.first == ContextWrap::fromV8(*context.local())) {
+        measuredSize = contextAndSize.second;
+      } else if (contextAndSize.first == ContextWrap::fromV8(*other)) {
+        otherSize = contextAndSize.second;
+      }
+    }
+    CHECK_GT(measuredSize, 10000 * sizeof(void*));
+    CHECK_GT(measuredSize, otherSize);
+  }
+
+  v8::internal::V8::ShutdownPlatform();
+}
 #endif
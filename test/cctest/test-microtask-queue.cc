@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+
+#include "cctest.h"
+#include "v8.h"
+
+static const char* kEnqueuePromiseReaction =
+    "var ran = 0;"
+    "Promise.resolve().then(() => ran++);";
+
+static void countMicrotask(void* data) {
+  (*static_cast<int*>(data))++;
+}
+
+static void countCompleted(v8::Isolate* isolate, void* data) {
+  (*static_cast<int*>(data))++;
+}
+
+// Restores the policy of the default queue, which the tests share.
+class MicrotasksPolicyScope {
+ public:
+  MicrotasksPolicyScope(v8::Isolate* isolate, v8::MicrotasksPolicy policy)
+      : isolate_(isolate), policy_(isolate->GetMicrotasksPolicy()) {
+    isolate_->SetMicrotasksPolicy(policy);
+  }
+  ~MicrotasksPolicyScope() { isolate_->SetMicrotasksPolicy(policy_); }
+
+ private:
+  v8::Isolate* isolate_;
+  v8::MicrotasksPolicy policy_;
+};
+
+TEST(MicrotasksPolicyExplicit) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  MicrotasksPolicyScope policyScope(isolate, v8::MicrotasksPolicy::kExplicit);
+
+  int count = 0;
+  CompileRun(kEnqueuePromiseReaction);
+  isolate->EnqueueMicrotask(countMicrotask, &count);
+  ExpectInt32("ran", 0);
+  CHECK_EQ(count, 0);
+
+  isolate->PerformMicrotaskCheckpoint();
+  ExpectInt32("ran", 1);
+  CHECK_EQ(count, 1);
+}
+
+TEST(MicrotasksPolicyAuto) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  MicrotasksPolicyScope policyScope(isolate, v8::MicrotasksPolicy::kAuto);
+
+  // Microtasks run when the outermost call into JavaScript returns.
+  int count = 0;
+  isolate->EnqueueMicrotask(countMicrotask, &count);
+  CompileRun(kEnqueuePromiseReaction);
+  CHECK_EQ(count, 1);
+  ExpectInt32("ran", 1);
+}
+
+TEST(MicrotasksPolicyScoped) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  MicrotasksPolicyScope policyScope(isolate, v8::MicrotasksPolicy::kScoped);
+
+  int count = 0;
+  {
+    v8::MicrotasksScope outer(isolate, v8::MicrotasksScope::kRunMicrotasks);
+    {
+      v8::MicrotasksScope inner(isolate, v8::MicrotasksScope::kRunMicrotasks);
+      CompileRun(kEnqueuePromiseReaction);
+      isolate->EnqueueMicrotask(countMicrotask, &count);
+    }
+    // Only the outermost scope runs them.
+    ExpectInt32("ran", 0);
+    CHECK_EQ(count, 0);
+  }
+  ExpectInt32("ran", 1);
+  CHECK_EQ(count, 1);
+}
+
+TEST(MicrotasksCompletedCallback) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  MicrotasksPolicyScope policyScope(isolate, v8::MicrotasksPolicy::kExplicit);
+
+  int completed = 0;
+  isolate->AddMicrotasksCompletedCallback(countCompleted, &completed);
+
+  // The callbacks are called once per checkpoint, even if a microtask
+  // throws.
+  isolate->EnqueueMicrotask(
+      CompileRun("(function() { throw new Error('microtask'); })")
+          .As<v8::Function>());
+  {
+    v8::TryCatch tryCatch(isolate);
+    isolate->PerformMicrotaskCheckpoint();
+  }
+  CHECK_EQ(completed, 1);
+
+  isolate->PerformMicrotaskCheckpoint();
+  CHECK_EQ(completed, 2);
+
+  isolate->RemoveMicrotasksCompletedCallback(countCompleted, &completed);
+  isolate->PerformMicrotaskCheckpoint();
+  CHECK_EQ(completed, 2);
+}
+
+TEST(MicrotaskQueuePerContext) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  MicrotasksPolicyScope policyScope(isolate, v8::MicrotasksPolicy::kExplicit);
+
+  std::unique_ptr<v8::MicrotaskQueue> queue =
+      v8::MicrotaskQueue::New(isolate, v8::MicrotasksPolicy::kExplicit);
+  v8::Local<v8::Context> other = v8::Context::New(isolate,
+                                                  nullptr,
+                                                  {},
+                                                  {},
+                                                  {},
+                                                  queue.get());
+
+  int defaultCount = 0;
+  int otherCount = 0;
+  CompileRun(kEnqueuePromiseReaction);
+  isolate->EnqueueMicrotask(countMicrotask, &defaultCount);
+  {
+    v8::Context::Scope contextScope(other);
+    CompileRun(kEnqueuePromiseReaction);
+    queue->EnqueueMicrotask(isolate, countMicrotask, &otherCount);
+  }
+
+  // A checkpoint of the other queue runs its own microtasks only. Promise
+  // jobs can't be told apart by context, so they wait for the default queue.
+  queue->PerformCheckpoint(isolate);
+  CHECK_EQ(otherCount, 1);
+  CHECK_EQ(defaultCount, 0);
+  ExpectInt32("ran", 0);
+  {
+    v8::Context::Scope contextScope(other);
+    ExpectInt32("ran", 0);
+  }
+
+  // The default queue leaves the microtasks of the other queue alone.
+  queue->EnqueueMicrotask(isolate, countMicrotask, &otherCount);
+  isolate->PerformMicrotaskCheckpoint();
+  CHECK_EQ(defaultCount, 1);
+  CHECK_EQ(otherCount, 1);
+  ExpectInt32("ran", 1);
+  {
+    v8::Context::Scope contextScope(other);
+    ExpectInt32("ran", 1);
+  }
+
+  queue->PerformCheckpoint(isolate);
+  CHECK_EQ(otherCount, 2);
+}
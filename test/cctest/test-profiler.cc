@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2021-present Samsung Electronics Co., Ltd
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <signal.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "cctest.h"
+#include "v8-profiler.h"
+#include "v8.h"
+
+static void profilerNoOpCallback(
+    const v8::FunctionCallbackInfo<v8::Value>& info) {}
+
+static const char* kProfilerSpinSource =
+    "function spin(ms) {"
+    "  var end = Date.now() + ms;"
+    "  while (Date.now() < end) tick();"
+    "}";
+
+static void setUpProfilerContext(v8::Local<v8::Context> context) {
+  v8::Isolate* isolate = context->GetIsolate();
+  auto tick = v8::FunctionTemplate::New(isolate, profilerNoOpCallback)
+                  ->GetFunction(context)
+                  .ToLocalChecked();
+  context->Global()->Set(context, v8_str(isolate, "tick"), tick).Check();
+  v8::Script::Compile(context, v8_str(isolate, kProfilerSpinSource))
+      .ToLocalChecked()
+      ->Run(context)
+      .ToLocalChecked();
+}
+
+static int countProfileNodes(const v8::CpuProfileNode* node,
+                             const char* name) {
+  v8::String::Utf8Value functionName(v8::Isolate::GetCurrent(),
+                                     node->GetFunctionName());
+  int count = strcmp(*functionName, name) == 0 ? 1 : 0;
+  for (int i = 0; i < node->GetChildrenCount(); i++) {
+    count += countProfileNodes(node->GetChild(i), name);
+  }
+  return count;
+}
+
+static bool hasProfileNode(const v8::CpuProfileNode* node, const char* name) {
+  return countProfileNodes(node, name) > 0;
+}
+
+TEST(CpuProfilerSamplesSafePoints) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  setUpProfilerContext(env.local());
+
+  v8::CpuProfiler* profiler = v8::CpuProfiler::New(isolate);
+  profiler->SetSamplingInterval(200);
+  profiler->StartProfiling(v8_str("safe-points"), true);
+  CompileRun("spin(200)");
+  v8::CpuProfile* profile = profiler->StopProfiling(v8_str("safe-points"));
+
+  CHECK_NOT_NULL(profile);
+  CHECK_GT(profile->GetSamplesCount(), 0);
+  CHECK(hasProfileNode(profile->GetTopDownRoot(), "spin"));
+  for (int i = 1; i < profile->GetSamplesCount(); i++) {
+    CHECK_LE(profile->GetSampleTimestamp(i - 1),
+             profile->GetSampleTimestamp(i));
+  }
+
+  profile->Delete();
+  profiler->Dispose();
+}
+
+TEST(CpuProfilerIdleState) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  v8::CpuProfiler* profiler = v8::CpuProfiler::New(isolate);
+  profiler->SetSamplingInterval(200);
+  profiler->StartProfiling(v8_str("idle"), true);
+
+  // A top-level script that makes no native call isn't idle.
+  CompileRun(
+      "var end = Date.now() + 50;"
+      "while (Date.now() < end) {}");
+  v8::CpuProfile* profile = profiler->StopProfiling(v8_str("idle"));
+  CHECK_GT(profile->GetSamplesCount(), 0);
+  CHECK(!hasProfileNode(profile->GetTopDownRoot(), "(idle)"));
+  profile->Delete();
+
+  // Only the embedder tells when it is idle. The ticks of a long wait are
+  // all kept.
+  profiler->StartProfiling(v8_str("idle"), true);
+  isolate->SetIdle(true);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+  isolate->SetIdle(false);
+  profile = profiler->StopProfiling(v8_str("idle"));
+  CHECK(hasProfileNode(profile->GetTopDownRoot(), "(idle)"));
+  CHECK_GT(profile->GetSamplesCount(), 1000);
+  for (int i = 1; i < profile->GetSamplesCount(); i++) {
+    CHECK_LE(profile->GetSampleTimestamp(i - 1),
+             profile->GetSampleTimestamp(i));
+  }
+  profile->Delete();
+
+  profiler->Dispose();
+}
+
+TEST(CpuProfilerCallerLineNumbers) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  setUpProfilerContext(env.local());
+  CompileRun(
+      "function twice() {\n"
+      "  spin(100);\n"
+      "  spin(100);\n"
+      "}");
+
+  v8::CpuProfiler* profiler = v8::CpuProfiler::New(isolate);
+  profiler->SetSamplingInterval(200);
+
+  profiler->StartProfiling(
+      v8_str("leaf-lines"), v8::kLeafNodeLineNumbers, true);
+  CompileRun("twice()");
+  v8::CpuProfile* profile = profiler->StopProfiling(v8_str("leaf-lines"));
+  CHECK_EQ(countProfileNodes(profile->GetTopDownRoot(), "spin"), 1);
+  profile->Delete();
+
+  // Each call site of spin() gets its own node.
+  profiler->StartProfiling(
+      v8_str("caller-lines"), v8::kCallerLineNumbers, true);
+  CompileRun("twice()");
+  profile = profiler->StopProfiling(v8_str("caller-lines"));
+  CHECK_EQ(countProfileNodes(profile->GetTopDownRoot(), "spin"), 2);
+  profile->Delete();
+
+  profiler->Dispose();
+}
+
+TEST(CpuProfilerOverlappingThreads) {
+  struct sigaction before;
+  sigaction(SIGPROF, nullptr, &before);
+
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  setUpProfilerContext(env.local());
+
+  v8::CpuProfiler* profiler = v8::CpuProfiler::New(isolate);
+  profiler->SetSamplingInterval(100);
+  profiler->StartProfiling(v8_str("main"), true);
+
+  std::atomic<bool> isOtherProfiling{false};
+  std::atomic<bool> isMainStopped{false};
+  int otherSamplesCount = 0;
+
+  std::thread other([&]() {
+    v8::Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator =
+        v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+    v8::Isolate* otherIsolate = v8::Isolate::New(create_params);
+    {
+      v8::Isolate::Scope isolate_scope(otherIsolate);
+      v8::HandleScope handle_scope(otherIsolate);
+      v8::Local<v8::Context> context = v8::Context::New(otherIsolate);
+      v8::Context::Scope context_scope(context);
+      setUpProfilerContext(context);
+
+      auto title = v8::String::NewFromUtf8Literal(otherIsolate, "other");
+      v8::CpuProfiler* otherProfiler = v8::CpuProfiler::New(otherIsolate);
+      otherProfiler->SetSamplingInterval(100);
+      otherProfiler->StartProfiling(title, true);
+      isOtherProfiling = true;
+
+      // Keep receiving SIGPROF after the main thread has stopped profiling.
+      auto spin = v8::Script::Compile(
+                      context,
+                      v8::String::NewFromUtf8Literal(otherIsolate, "spin(20)"))
+                      .ToLocalChecked();
+      while (!isMainStopped) {
+        spin->Run(context).ToLocalChecked();
+      }
+      spin->Run(context).ToLocalChecked();
+
+      v8::CpuProfile* profile = otherProfiler->StopProfiling(title);
+      otherSamplesCount = profile->GetSamplesCount();
+      profile->Delete();
+      otherProfiler->Dispose();
+    }
+    otherIsolate->Dispose();
+    delete create_params.array_buffer_allocator;
+  });
+
+  while (!isOtherProfiling) {
+    CompileRun("spin(10)");
+  }
+  CompileRun("spin(50)");
+  v8::CpuProfile* profile = profiler->StopProfiling(v8_str("main"));
+  isMainStopped = true;
+  other.join();
+
+  CHECK_GT(profile->GetSamplesCount(), 0);
+  CHECK_GT(otherSamplesCount, 0);
+  profile->Delete();
+  profiler->Dispose();
+
+  // The last profiler to stop restores the previous action.
+  struct sigaction after;
+  sigaction(SIGPROF, nullptr, &after);
+  CHECK_EQ(reinterpret_cast<void*>(before.sa_handler),
+           reinterpret_cast<void*>(after.sa_handler));
+}
+
+static int s_interceptedGetterCount = 0;
+static void countingNamedGetter(
+    v8::Local<v8::Name> name,
+    const v8::PropertyCallbackInfo<v8::Value>& info) {
+  s_interceptedGetterCount++;
+  info.GetReturnValue().Set(v8_num(42));
+}
+
+class StringOutputStream : public v8::OutputStream {
+ public:
+  void EndOfStream() override { isEnded_ = true; }
+  WriteResult WriteAsciiChunk(char* data, int size) override {
+    buffer_.append(data, size);
+    return kContinue;
+  }
+
+  const std::string& buffer() const { return buffer_; }
+  bool isEnded() const { return isEnded_; }
+
+ private:
+  std::string buffer_;
+  bool isEnded_ = false;
+};
+
+static const v8::HeapGraphNode* findSnapshotNode(
+    const v8::HeapSnapshot* snapshot, const char* name) {
+  for (int i = 0; i < snapshot->GetNodesCount(); i++) {
+    auto node = snapshot->GetNode(i);
+    v8::String::Utf8Value nodeName(v8::Isolate::GetCurrent(), node->GetName());
+    if (strcmp(*nodeName, name) == 0) {
+      return node;
+    }
+  }
+  return nullptr;
+}
+
+static const v8::HeapGraphNode* findSnapshotChild(
+    const v8::HeapGraphNode* node, const char* name) {
+  for (int i = 0; i < node->GetChildrenCount(); i++) {
+    auto edge = node->GetChild(i);
+    v8::String::Utf8Value edgeName(v8::Isolate::GetCurrent(), edge->GetName());
+    if (strcmp(*edgeName, name) == 0) {
+      CHECK_EQ(edge->GetFromNode(), node);
+      return edge->GetToNode();
+    }
+  }
+  return nullptr;
+}
+
+TEST(HeapSnapshotRunsNoJavaScript) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  v8::Local<v8::ObjectTemplate> templ = v8::ObjectTemplate::New(isolate);
+  templ->SetHandler(v8::NamedPropertyHandlerConfiguration(countingNamedGetter));
+  auto intercepted = templ->NewInstance(env.local()).ToLocalChecked();
+  CHECK(env->Global()
+            ->Set(env.local(), v8_str("intercepted"), intercepted)
+            .FromJust());
+
+  CompileRun(
+      "var trapCount = 0;"
+      "class SnapshotHolder {"
+      "  constructor() { this.child = {}; this.list = [{}, 'two', {}]; }"
+      "}"
+      "var holder = new SnapshotHolder();"
+      "Object.defineProperty(holder, 'accessor', {"
+      "  get() { trapCount++; return {}; }"
+      "});"
+      "holder.proxy = new Proxy({}, {"
+      "  getOwnPropertyDescriptor() { trapCount++; },"
+      "  ownKeys() { trapCount++; return []; },"
+      "  getPrototypeOf() { trapCount++; return null; }"
+      "});");
+
+  s_interceptedGetterCount = 0;
+  auto snapshot = isolate->GetHeapProfiler()->TakeHeapSnapshot();
+  CHECK_NOT_NULL(snapshot);
+
+  // Getters, proxy traps and property handlers are never called.
+  ExpectInt32("trapCount", 0);
+  CHECK_EQ(s_interceptedGetterCount, 0);
+
+  auto holder = findSnapshotNode(snapshot, "SnapshotHolder");
+  CHECK_NOT_NULL(holder);
+  CHECK_EQ(holder->GetType(), v8::HeapGraphNode::kObject);
+  CHECK_NOT_NULL(findSnapshotChild(holder, "child"));
+  CHECK_NOT_NULL(findSnapshotChild(holder, "get accessor"));
+  CHECK_NOT_NULL(findSnapshotChild(holder, "__proto__"));
+
+  auto proxy = findSnapshotChild(holder, "proxy");
+  CHECK_NOT_NULL(proxy);
+  CHECK_EQ(proxy->GetChildrenCount(), 0);
+
+  auto list = findSnapshotChild(holder, "list");
+  CHECK_NOT_NULL(list);
+  CHECK_EQ(list->GetType(), v8::HeapGraphNode::kArray);
+  auto two = findSnapshotChild(list, "1");
+  CHECK_NOT_NULL(two);
+  CHECK_EQ(two->GetType(), v8::HeapGraphNode::kString);
+
+  StringOutputStream stream;
+  snapshot->Serialize(&stream);
+  CHECK(stream.isEnded());
+
+  // The JSON parses and its arrays have the sizes that meta describes.
+  auto json = v8::JSON::Parse(env.local(), v8_str(stream.buffer().c_str()))
+                  .ToLocalChecked();
+  CHECK(env->Global()->Set(env.local(), v8_str("json"), json).FromJust());
+  CHECK(CompileRun("var s = json.snapshot;"
+                   "s.meta.node_fields.length === 6 &&"
+                   "s.meta.edge_fields.length === 3 &&"
+                   "json.nodes.length === s.node_count * 6 &&"
+                   "json.edges.length === s.edge_count * 3 &&"
+                   "json.nodes.filter((v, i) => i % 6 === 4)"
+                   "    .reduce((a, b) => a + b, 0) === s.edge_count &&"
+                   "json.edges.filter((v, i) => i % 3 === 2)"
+                   "    .every((to) => to % 6 === 0 &&"
+                   "                   to < json.nodes.length) &&"
+                   "json.strings.includes('SnapshotHolder')")
+            ->BooleanValue(isolate));
+  ExpectInt32("json.snapshot.node_count", snapshot->GetNodesCount());
+
+  const_cast<v8::HeapSnapshot*>(snapshot)->Delete();
+}
+
+TEST(HeapSnapshotObjectIds) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  auto heapProfiler = isolate->GetHeapProfiler();
+
+  auto object = CompileRun("var kept = { name: 'kept' }; kept;");
+  auto id = heapProfiler->GetObjectId(object);
+  CHECK_NE(id, v8::HeapProfiler::kUnknownObjectId);
+
+  auto first = heapProfiler->TakeHeapSnapshot();
+  auto second = heapProfiler->TakeHeapSnapshot();
+
+  // A live value keeps its id across snapshots, and can be found by it.
+  CHECK_EQ(heapProfiler->GetObjectId(object), id);
+  CHECK_NOT_NULL(first->GetNodeById(id));
+  CHECK_NOT_NULL(second->GetNodeById(id));
+  CHECK(heapProfiler->FindObjectById(id)->StrictEquals(object));
+  CHECK_GE(second->GetMaxSnapshotJSObjectId(), id);
+
+  // An id which was never given isn't found.
+  CHECK(heapProfiler->FindObjectById(second->GetMaxSnapshotJSObjectId() + 2)
+            .IsEmpty());
+
+  heapProfiler->ClearObjectIds();
+  CHECK(heapProfiler->FindObjectById(id).IsEmpty());
+  heapProfiler->DeleteAllHeapSnapshots();
+}
+
+static const char* kAllocateSource =
+    "function allocate(n) {"
+    "  var list = [];"
+    "  for (var i = 0; i < n; i++) { list.push({ i: i }); tick(); }"
+    "  return list.length;"
+    "}";
+
+static size_t allocatedBytes(const v8::AllocationProfile::Node* node) {
+  size_t bytes = 0;
+  for (const auto& allocation : node->allocations) {
+    bytes += allocation.size * allocation.count;
+  }
+  for (auto child : node->children) {
+    bytes += allocatedBytes(child);
+  }
+  return bytes;
+}
+
+static bool hasAllocationNode(const v8::AllocationProfile::Node* node,
+                              const char* name) {
+  v8::String::Utf8Value nodeName(v8::Isolate::GetCurrent(), node->name);
+  if (strcmp(*nodeName, name) == 0 && !node->allocations.empty()) {
+    return true;
+  }
+  for (auto child : node->children) {
+    if (hasAllocationNode(child, name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the bytes charged to the isolate of `context` for `allocate(n)`.
+static size_t sampleAllocations(v8::Local<v8::Context> context, int n) {
+  v8::Isolate* isolate = context->GetIsolate();
+  auto heapProfiler = isolate->GetHeapProfiler();
+  auto source = "allocate(" + std::to_string(n) + ")";
+
+  CHECK(heapProfiler->StartSamplingHeapProfiler(1024));
+  v8::Script::Compile(context, v8_str(isolate, source.c_str()))
+      .ToLocalChecked()
+      ->Run(context)
+      .ToLocalChecked();
+  std::unique_ptr<v8::AllocationProfile> profile(
+      heapProfiler->GetAllocationProfile());
+  heapProfiler->StopSamplingHeapProfiler();
+
+  return allocatedBytes(profile->GetRootNode());
+}
+
+TEST(SamplingHeapProfilerChargesCallSites) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  setUpProfilerContext(env.local());
+  CompileRun(kAllocateSource);
+
+  auto heapProfiler = isolate->GetHeapProfiler();
+  CHECK(heapProfiler->StartSamplingHeapProfiler(1024));
+  CompileRun("allocate(100000)");
+  std::unique_ptr<v8::AllocationProfile> profile(
+      heapProfiler->GetAllocationProfile());
+  heapProfiler->StopSamplingHeapProfiler();
+
+  CHECK(hasAllocationNode(profile->GetRootNode(), "allocate"));
+
+  // Every sample is in the tree, and the samples of a call site that
+  // keeps allocating are merged rather than kept one by one.
+  size_t sampledBytes = 0;
+  size_t sampledCount = 0;
+  for (const auto& sample : profile->GetSamples()) {
+    sampledBytes += sample.size * sample.count;
+    sampledCount += sample.count;
+  }
+  CHECK_EQ(sampledBytes, allocatedBytes(profile->GetRootNode()));
+  CHECK_LT(profile->GetSamples().size(), sampledCount);
+}
+
+TEST(SamplingHeapProfilerTwoIsolates) {
+  const int kCount = 100000;
+
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+  setUpProfilerContext(env.local());
+  CompileRun(kAllocateSource);
+
+  size_t aloneBytes = sampleAllocations(env.local(), kCount);
+  CHECK_GT(aloneBytes, 0);
+
+  std::atomic<bool> isOtherReady{false};
+  std::atomic<bool> isStarted{false};
+  size_t otherBytes = 0;
+
+  std::thread other([&]() {
+    v8::Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator =
+        v8::ArrayBuffer::Allocator::NewDefaultAllocator();
+    v8::Isolate* otherIsolate = v8::Isolate::New(create_params);
+    {
+      v8::Isolate::Scope isolate_scope(otherIsolate);
+      v8::HandleScope handle_scope(otherIsolate);
+      v8::Local<v8::Context> context = v8::Context::New(otherIsolate);
+      v8::Context::Scope context_scope(context);
+      setUpProfilerContext(context);
+      v8::Script::Compile(context, v8_str(otherIsolate, kAllocateSource))
+          .ToLocalChecked()
+          ->Run(context)
+          .ToLocalChecked();
+
+      isOtherReady = true;
+      while (!isStarted) {
+      }
+      otherBytes = sampleAllocations(context, kCount);
+    }
+    otherIsolate->Dispose();
+    delete create_params.array_buffer_allocator;
+  });
+
+  while (!isOtherReady) {
+  }
+  isStarted = true;
+  size_t mainBytes = sampleAllocations(env.local(), kCount);
+  other.join();
+
+  // Each isolate allocates as much as the main one did alone. Bytes are
+  // charged once, so the profiles don't add up to twice the bytes of both.
+  CHECK_LT(mainBytes + otherBytes, aloneBytes * 3);
+}
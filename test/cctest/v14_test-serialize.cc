@@ -280,3 +280,251 @@ SERIALIZE_TEST(ArrayObject) {
   CHECK(
       validSerializeTest(CompileRun("var array = [1, true, 'test']; array;")));
 }
+
+SERIALIZE_TEST(ObjectIdentity) {
+  v8::HandleScope scope(isolate());
+
+  SerializerDelegate delegate(isolate());
+  ValueSerializer serializer(isolate(), &delegate);
+  serializer.WriteHeader();
+  Local<Value> value = CompileRun(
+      "var shared = { value: 1 };"
+      "var cyclic = { a: shared, b: shared };"
+      "cyclic.self = cyclic;"
+      "cyclic;");
+  CHECK(serializer.WriteValue(context(), value).FromJust());
+
+  std::pair<uint8_t*, size_t> data = serializer.Release();
+  MallocedBuffer buffer(data.first, data.second);
+
+  ValueDeserializer deserializer(isolate(), buffer.data, buffer.size);
+  CHECK(deserializer.ReadHeader(context()).FromJust());
+  CHECK_EQ(deserializer.GetWireFormatVersion(), 13u);
+
+  Local<Value> output;
+  CHECK(deserializer.ReadValue(context()).ToLocal(&output));
+  CHECK(
+      context()->Global()->Set(context(), v8_str("output"), output).FromJust());
+  CHECK(CompileRun("output.a === output.b && output.self === output")
+            ->BooleanValue(isolate()));
+}
+
+SERIALIZE_TEST(WriteReadBuiltinObjects) {
+  v8::HandleScope scope(isolate());
+
+  SerializerDelegate delegate(isolate());
+  ValueSerializer serializer(isolate(), &delegate);
+  Local<Value> value = CompileRun(
+      "var map = new Map([[1, 'one'], ['two', 2]]);"
+      "[map, new Set([1, 'a']), new Date(1000), /ab+c/gi, 123n, -(2n ** 70n),"
+      " new Number(7), new String('s'), new RangeError('range'),"
+      " [1, , 3], new DataView(new ArrayBuffer(8), 2, 4)];");
+  CHECK(serializer.WriteValue(context(), value).FromJust());
+
+  std::pair<uint8_t*, size_t> data = serializer.Release();
+  MallocedBuffer buffer(data.first, data.second);
+
+  ValueDeserializer deserializer(isolate(), buffer.data, buffer.size);
+  Local<Value> output;
+  CHECK(deserializer.ReadValue(context()).ToLocal(&output));
+  CHECK(
+      context()->Global()->Set(context(), v8_str("output"), output).FromJust());
+  CHECK(CompileRun("output[0].get(1) === 'one' && output[0].get('two') === 2 &&"
+                   "output[1].has('a') && output[2].getTime() === 1000 &&"
+                   "output[3].source === 'ab+c' && output[3].flags === 'gi' &&"
+                   "output[4] === 123n && output[5] === -(2n ** 70n) &&"
+                   "output[6].valueOf() === 7 && output[7].valueOf() === 's' &&"
+                   "output[8] instanceof RangeError &&"
+                   "output[8].message === 'range' &&"
+                   "!(1 in output[9]) && output[9].length === 3 &&"
+                   "output[10].byteOffset === 2 && output[10].byteLength === 4")
+            ->BooleanValue(isolate()));
+}
+
+SERIALIZE_TEST(ArrayPropertiesAndErrorPrototypes) {
+  v8::HandleScope scope(isolate());
+
+  SerializerDelegate delegate(isolate());
+  ValueSerializer serializer(isolate(), &delegate);
+  Local<Value> value = CompileRun(
+      "Array.prototype[1] = 'inherited';"
+      "var array = [1, , 3];"
+      "array.extra = 'extra';"
+      "var renamed = new TypeError('type');"
+      "renamed.name = 'RangeError';"
+      "var named = new Error('error');"
+      "named.name = 'SyntaxError';"
+      "[array, renamed, named];");
+  CHECK(serializer.WriteValue(context(), value).FromJust());
+  CompileRun("delete Array.prototype[1];");
+
+  std::pair<uint8_t*, size_t> data = serializer.Release();
+  MallocedBuffer buffer(data.first, data.second);
+
+  ValueDeserializer deserializer(isolate(), buffer.data, buffer.size);
+  Local<Value> output;
+  CHECK(deserializer.ReadValue(context()).ToLocal(&output));
+  CHECK(
+      context()->Global()->Set(context(), v8_str("output"), output).FromJust());
+  // A hole isn't filled from the prototype, and the other properties of an
+  // array are kept. An error keeps its prototype whatever its name is.
+  CHECK(CompileRun("!(1 in output[0]) && output[0].length === 3 &&"
+                   "output[0][2] === 3 && output[0].extra === 'extra' &&"
+                   "Object.getPrototypeOf(output[1]) === TypeError.prototype &&"
+                   "output[1].message === 'type' &&"
+                   "Object.getPrototypeOf(output[2]) === Error.prototype &&"
+                   "output[2].message === 'error'")
+            ->BooleanValue(isolate()));
+}
+
+SERIALIZE_TEST(HoleyArrayAndRegExpFlags) {
+  v8::HandleScope scope(isolate());
+
+  SerializerDelegate delegate(isolate());
+  ValueSerializer serializer(isolate(), &delegate);
+  Local<Value> value = CompileRun(
+      "var holey = [];"
+      "holey[1] = 'one';"
+      "holey[9999] = 'last';"
+      "var dense = [1, 2, 3];"
+      "[holey, dense];");
+  CHECK(serializer.WriteValue(context(), value).FromJust());
+
+  std::pair<uint8_t*, size_t> data = serializer.Release();
+  MallocedBuffer buffer(data.first, data.second);
+  // The holes of a mostly holey array aren't written one by one.
+  CHECK_LT(buffer.size, 100u);
+
+  // A setter on the prototype doesn't see the elements read back.
+  CompileRun(
+      "var setterCalled = false;"
+      "Object.defineProperty(Array.prototype, 1, {"
+      "  set(v) { setterCalled = true; }, configurable: true });");
+
+  ValueDeserializer deserializer(isolate(), buffer.data, buffer.size);
+  Local<Value> output;
+  CHECK(deserializer.ReadValue(context()).ToLocal(&output));
+  CHECK(
+      context()->Global()->Set(context(), v8_str("output"), output).FromJust());
+  CHECK(CompileRun("delete Array.prototype[1];"
+                   "!setterCalled && output[0].length === 10000 &&"
+                   "output[0][1] === 'one' && output[0][9999] === 'last' &&"
+                   "!(2 in output[0]) && output[1][1] === 2")
+            ->BooleanValue(isolate()));
+
+  // RegExp /ab/ with a flag bit the engine doesn't know.
+  const uint8_t regExp[] = {'R', '"', 2, 'a', 'b', 1 << 6};
+  ValueDeserializer badFlags(isolate(), regExp, sizeof(regExp));
+  TryCatch tryCatch(isolate());
+  CHECK(badFlags.ReadValue(context()).IsEmpty());
+}
+
+SERIALIZE_TEST(WriteFunctionThrows) {
+  v8::HandleScope scope(isolate());
+
+  SerializerDelegate delegate(isolate());
+  ValueSerializer serializer(isolate(), &delegate);
+  TryCatch tryCatch(isolate());
+  CHECK(serializer.WriteValue(context(), CompileRun("(function() {})"))
+            .IsNothing());
+  CHECK(tryCatch.HasCaught());
+}
+
+SERIALIZE_TEST(TransferArrayBuffer) {
+  v8::HandleScope scope(isolate());
+
+  SerializerDelegate delegate(isolate());
+  ValueSerializer serializer(isolate(), &delegate);
+  Local<ArrayBuffer> arrayBuffer =
+      CompileRun("var buffer = new Uint8Array([1, 2, 3, 4]).buffer; buffer;")
+          .As<ArrayBuffer>();
+  Local<Value> value = CompileRun("[buffer, new Uint8Array(buffer, 1, 2)];");
+  serializer.TransferArrayBuffer(0, arrayBuffer);
+  CHECK(serializer.WriteValue(context(), value).FromJust());
+
+  std::shared_ptr<BackingStore> backingStore = arrayBuffer->GetBackingStore();
+  void* data = backingStore->Data();
+  arrayBuffer->Detach();
+  CHECK_EQ(arrayBuffer->ByteLength(), 0u);
+
+  std::pair<uint8_t*, size_t> serialized = serializer.Release();
+  MallocedBuffer buffer(serialized.first, serialized.second);
+  // The contents aren't copied into the serialized data.
+  CHECK_LT(buffer.size, 16u);
+
+  ValueDeserializer deserializer(isolate(), buffer.data, buffer.size);
+  Local<ArrayBuffer> received =
+      ArrayBuffer::New(isolate(), std::move(backingStore));
+  deserializer.TransferArrayBuffer(0, received);
+
+  Local<Value> output;
+  CHECK(deserializer.ReadValue(context()).ToLocal(&output));
+  Local<Array> array = output.As<Array>();
+  CHECK(array->Get(context(), 0).ToLocalChecked()->StrictEquals(received));
+  CHECK_EQ(received->GetBackingStore()->Data(), data);
+
+  CHECK(
+      context()->Global()->Set(context(), v8_str("output"), output).FromJust());
+  CHECK(CompileRun("output[1].buffer === output[0] && output[1][0] === 2")
+            ->BooleanValue(isolate()));
+}
+
+class SharedArrayBufferSerializerDelegate : public SerializerDelegate {
+ public:
+  explicit SharedArrayBufferSerializerDelegate(Isolate* isolate)
+      : SerializerDelegate(isolate) {}
+  Maybe<uint32_t> GetSharedArrayBufferId(
+      Isolate* isolate, Local<SharedArrayBuffer> sharedArrayBuffer) override {
+    backingStores.push_back(sharedArrayBuffer->GetBackingStore());
+    return Just<uint32_t>(backingStores.size() - 1);
+  }
+
+  std::vector<std::shared_ptr<BackingStore>> backingStores;
+};
+
+class SharedArrayBufferDeserializerDelegate
+    : public ValueDeserializer::Delegate {
+ public:
+  explicit SharedArrayBufferDeserializerDelegate(
+      std::vector<std::shared_ptr<BackingStore>>* backingStores)
+      : backingStores_(backingStores) {}
+  MaybeLocal<SharedArrayBuffer> GetSharedArrayBufferFromId(
+      Isolate* isolate, uint32_t id) override {
+    return SharedArrayBuffer::New(isolate, (*backingStores_)[id]);
+  }
+
+ private:
+  std::vector<std::shared_ptr<BackingStore>>* backingStores_;
+};
+
+SERIALIZE_TEST(ShareSharedArrayBuffer) {
+  v8::HandleScope scope(isolate());
+
+  SharedArrayBufferSerializerDelegate serializerDelegate(isolate());
+  ValueSerializer serializer(isolate(), &serializerDelegate);
+  Local<Value> value = CompileRun(
+      "var shared = new Int32Array(new SharedArrayBuffer(8));"
+      "[shared.buffer, shared];");
+  CHECK(serializer.WriteValue(context(), value).FromJust());
+  CHECK_EQ(serializerDelegate.backingStores.size(), 1u);
+
+  std::pair<uint8_t*, size_t> data = serializer.Release();
+  MallocedBuffer buffer(data.first, data.second);
+
+  SharedArrayBufferDeserializerDelegate deserializerDelegate(
+      &serializerDelegate.backingStores);
+  ValueDeserializer deserializer(
+      isolate(), buffer.data, buffer.size, &deserializerDelegate);
+  Local<Value> output;
+  CHECK(deserializer.ReadValue(context()).ToLocal(&output));
+  serializerDelegate.backingStores.clear();
+
+  // The memory is shared with the original buffer.
+  CHECK(
+      context()->Global()->Set(context(), v8_str("output"), output).FromJust());
+  CHECK(CompileRun("Atomics.add(output[1], 1, 5);"
+                   "output[0] instanceof SharedArrayBuffer &&"
+                   "output[1].buffer === output[0] &&"
+                   "Atomics.load(shared, 1) === 5")
+            ->BooleanValue(isolate()));
+}
@@ -633,4 +633,97 @@ TEST(StackTraceLimit) {
   std::string exception = *v8::String::Utf8Value(isolate, r);
 }
 
+TEST(ErrorStackTraceLimit) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  CompileRun("function f(n) { return n == 0 ? new Error('e') : f(n - 1); }");
+  CHECK(CompileRun("Error.stackTraceLimit === 20")->BooleanValue(isolate));
+  CHECK(CompileRun("Object.getOwnPropertyDescriptor(Error, 'stackTraceLimit')"
+                   ".writable")
+            ->BooleanValue(isolate));
+
+  CHECK_EQ(3,
+           CompileRun("Error.stackTraceLimit = 3;"
+                      "f(10).stack.split('\\n    at ').length - 1")
+               ->Int32Value(env.local())
+               .FromJust());
+  CHECK(CompileRun("Error.stackTraceLimit === 3")->BooleanValue(isolate));
+
+  // Frames are captured with the limit at the time the error is created.
+  CHECK(CompileRun("var e = f(10); Error.stackTraceLimit = 1;"
+                   "e.stack.split('\\n    at ').length === 4")
+            ->BooleanValue(isolate));
+
+  CHECK(CompileRun("Error.stackTraceLimit = undefined; f(1).stack")
+            ->IsUndefined());
+
+  // Like V8, the limit is read again on every capture.
+  CHECK(CompileRun("Error.stackTraceLimit = 10; delete Error.stackTraceLimit;"
+                   "f(1).stack")
+            ->IsUndefined());
+  CHECK_EQ(2,
+           CompileRun("Object.defineProperty(Error, 'stackTraceLimit',"
+                      "    { value: 2, writable: true, configurable: true });"
+                      "f(10).stack.split('\\n    at ').length - 1")
+               ->Int32Value(env.local())
+               .FromJust());
+
+  // The limit belongs to the Error constructor, not to the global 'Error'.
+  CHECK_EQ(1,
+           CompileRun("var E = Error;"
+                      "function g(n) { return n == 0 ? new E('e') : g(n - 1); }"
+                      "E.stackTraceLimit = 1; Error = {};"
+                      "var s = g(10).stack; Error = E;"
+                      "s.split('\\n    at ').length - 1")
+               ->Int32Value(env.local())
+               .FromJust());
+}
+
+static v8::MaybeLocal<Value> PrepareStackTraceContextTag(
+    v8::Local<Context> context,
+    v8::Local<Value> error,
+    v8::Local<Array> trace) {
+  return context->Global()->Get(context, v8_str("tag"));
+}
+
+TEST(ErrorStackCreationContext) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  isolate->SetPrepareStackTraceCallback(PrepareStackTraceContextTag);
+  CHECK(env->Global()->Set(env.local(), v8_str("tag"), v8_str("a")).FromJust());
+
+  v8::Local<Context> other = Context::New(isolate);
+  v8::Local<Value> error;
+  {
+    Context::Scope otherScope(other);
+    CHECK(other->Global()->Set(other, v8_str("tag"), v8_str("b")).FromJust());
+    error = CompileRun("new Error('e')");
+  }
+
+  // The stack is formatted in the context the error was created in.
+  CHECK(env->Global()->Set(env.local(), v8_str("error"), error).FromJust());
+  CHECK(CompileRun("error.stack")->Equals(env.local(), v8_str("b")).FromJust());
+  isolate->SetPrepareStackTraceCallback(nullptr);
+}
+
+TEST(ErrorStackTwoByteNames) {
+  LocalContext env;
+  v8::Isolate* isolate = env->GetIsolate();
+  v8::HandleScope scope(isolate);
+
+  CompileRun("function latin() { return new Error('caf\\u00e9'); }"
+             "function \\u{d568}\\u{c218}() { return latin(); }");
+
+  // The stack stays one byte per character until a two-byte name shows up.
+  CHECK(CompileRun("var s = \\u{d568}\\u{c218}().stack;"
+                   "s.startsWith('Error: caf\\u00e9\\n    at latin (') &&"
+                   "s.includes('\\n    at \\u{d568}\\u{c218} (') &&"
+                   "s.endsWith(')\\n')")
+            ->BooleanValue(isolate));
+}
+
 }  // namespace
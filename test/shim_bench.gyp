@@ -0,0 +1,24 @@
+{
+  'includes': ['../common.gypi'],
+  'targets': [
+    {
+      'target_name': 'shim_bench',
+      'type': 'executable',
+      'dependencies': [
+        '../escargotshim.gyp:escargotshim',
+       ],
+      'cflags_cc': [
+        '-Wno-unused-parameter',
+        '-Wno-unused-result',
+        '-std=c++14',
+      ],
+      'include_dirs': [
+        './bench',
+      ],
+      'sources': [
+        'bench/shim-bench.cc',
+        'bench/bench-api.cc',
+      ]
+    },
+  ],
+}